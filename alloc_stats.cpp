@@ -0,0 +1,495 @@
+//
+// Win32 utilities library
+// Allocation statistics.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "alloc_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t NumSamplesPerThread = 64;
+
+std::atomic<bool> s_enabled = false;
+std::atomic<std::size_t> s_sampleRate = 0;
+// Incremented when the statistics get reset. Threads reset their own counters
+// when they notice the change.
+std::atomic<std::uint64_t> s_epoch = 0;
+
+thread_local const char* t_site = nullptr;
+
+
+///////////////////
+
+// Counter that is only written by its owning thread but can be read by any thread.
+class Counter
+{
+ public:
+   void add(std::size_t n)
+   {
+      m_value.store(m_value.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+   }
+   void set(std::size_t n) { m_value.store(n, std::memory_order_relaxed); }
+   std::size_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+ private:
+   std::atomic<std::size_t> m_value = 0;
+};
+
+
+struct TagCounters
+{
+   Counter allocations;
+   Counter deallocations;
+   Counter allocatedBytes;
+   Counter deallocatedBytes;
+   Counter highWaterBytes;
+   std::array<Counter, NumAllocSizeClasses> sizeClasses;
+
+   void reset();
+   void addTo(AllocTagStats& stats) const;
+};
+
+
+void TagCounters::reset()
+{
+   allocations.set(0);
+   deallocations.set(0);
+   allocatedBytes.set(0);
+   deallocatedBytes.set(0);
+   highWaterBytes.set(0);
+   for (Counter& counter : sizeClasses)
+      counter.set(0);
+}
+
+
+void TagCounters::addTo(AllocTagStats& stats) const
+{
+   stats.allocations += allocations.value();
+   stats.deallocations += deallocations.value();
+   stats.allocatedBytes += allocatedBytes.value();
+   stats.deallocatedBytes += deallocatedBytes.value();
+   stats.highWaterBytes = std::max(stats.highWaterBytes, highWaterBytes.value());
+   for (std::size_t i = 0; i < sizeClasses.size(); ++i)
+      stats.sizeClasses[i] += sizeClasses[i].value();
+}
+
+
+///////////////////
+
+// Statistics of one thread.
+class ThreadAllocStats
+{
+ public:
+   ThreadAllocStats();
+   ~ThreadAllocStats();
+   ThreadAllocStats(const ThreadAllocStats&) = delete;
+   ThreadAllocStats& operator=(const ThreadAllocStats&) = delete;
+
+   void recordAllocation(AllocTag tag, std::size_t numBytes);
+   void recordDeallocation(AllocTag tag, std::size_t numBytes);
+   // Has to be called with the registry lock held.
+   void addTo(AllocStatsSnapshot& snapshot) const;
+
+ private:
+   void syncEpoch();
+   void addSample(const AllocSample& sample);
+
+ private:
+   std::array<TagCounters, NumAllocTags> m_tags;
+   std::atomic<std::uint64_t> m_epoch = 0;
+   std::size_t m_allocsSinceSample = 0;
+   mutable std::mutex m_samplesGuard;
+   std::vector<AllocSample> m_samples;
+   std::size_t m_nextSample = 0;
+};
+
+
+///////////////////
+
+// Keeps track of the statistics of all threads.
+class Registry
+{
+ public:
+   static void add(ThreadAllocStats* stats);
+   // Merges the statistics of the exiting thread into the retired statistics.
+   static void remove(ThreadAllocStats* stats);
+   static AllocStatsSnapshot snapshot();
+   static void reset();
+
+ private:
+   static std::mutex& guard();
+   static std::vector<ThreadAllocStats*>& threads();
+   static AllocStatsSnapshot& retired();
+   static std::array<std::size_t, NumAllocTags>& observedHighWater();
+};
+
+
+void Registry::add(ThreadAllocStats* stats)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   threads().push_back(stats);
+}
+
+
+void Registry::remove(ThreadAllocStats* stats)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   stats->addTo(retired());
+   threads().erase(std::remove(threads().begin(), threads().end(), stats),
+                   threads().end());
+}
+
+
+AllocStatsSnapshot Registry::snapshot()
+{
+   std::lock_guard<std::mutex> lock(guard());
+
+   AllocStatsSnapshot snapshot = retired();
+   for (const ThreadAllocStats* stats : threads())
+      stats->addTo(snapshot);
+
+   for (std::size_t i = 0; i < NumAllocTags; ++i)
+   {
+      AllocTagStats& tagStats = snapshot.tags[i];
+      const std::size_t live =
+         static_cast<std::size_t>(std::max<std::int64_t>(tagStats.liveBytes(), 0));
+      observedHighWater()[i] = std::max(observedHighWater()[i], live);
+      tagStats.highWaterBytes = std::max(tagStats.highWaterBytes, observedHighWater()[i]);
+   }
+
+   return snapshot;
+}
+
+
+void Registry::reset()
+{
+   std::lock_guard<std::mutex> lock(guard());
+   retired() = {};
+   observedHighWater() = {};
+   s_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+std::mutex& Registry::guard()
+{
+   // Function-local to be available during static initialization and destruction.
+   static std::mutex registryGuard;
+   return registryGuard;
+}
+
+
+std::vector<ThreadAllocStats*>& Registry::threads()
+{
+   static std::vector<ThreadAllocStats*> threadStats;
+   return threadStats;
+}
+
+
+AllocStatsSnapshot& Registry::retired()
+{
+   static AllocStatsSnapshot retiredStats;
+   return retiredStats;
+}
+
+
+std::array<std::size_t, NumAllocTags>& Registry::observedHighWater()
+{
+   static std::array<std::size_t, NumAllocTags> highWater{};
+   return highWater;
+}
+
+
+///////////////////
+
+// Set when the statistics of the current thread were destroyed during thread exit.
+// Allocations that happen afterwards are not recorded.
+thread_local bool t_isStatsDestroyed = false;
+
+
+ThreadAllocStats* threadStats()
+{
+   if (t_isStatsDestroyed)
+      return nullptr;
+   thread_local ThreadAllocStats stats;
+   return &stats;
+}
+
+
+ThreadAllocStats::ThreadAllocStats() : m_epoch{s_epoch.load(std::memory_order_relaxed)}
+{
+   Registry::add(this);
+}
+
+
+ThreadAllocStats::~ThreadAllocStats()
+{
+   Registry::remove(this);
+   t_isStatsDestroyed = true;
+}
+
+
+void ThreadAllocStats::recordAllocation(AllocTag tag, std::size_t numBytes)
+{
+   syncEpoch();
+
+   TagCounters& counters = m_tags[static_cast<std::size_t>(tag)];
+   counters.allocations.add(1);
+   counters.allocatedBytes.add(numBytes);
+   counters.sizeClasses[allocSizeClass(numBytes)].add(1);
+
+   const std::size_t allocated = counters.allocatedBytes.value();
+   const std::size_t deallocated = counters.deallocatedBytes.value();
+   const std::size_t live = (allocated > deallocated) ? allocated - deallocated : 0;
+   if (live > counters.highWaterBytes.value())
+      counters.highWaterBytes.set(live);
+
+   const std::size_t sampleRate = s_sampleRate.load(std::memory_order_relaxed);
+   if (sampleRate != 0 && ++m_allocsSinceSample >= sampleRate)
+   {
+      m_allocsSinceSample = 0;
+      addSample({tag, numBytes, t_site});
+   }
+}
+
+
+void ThreadAllocStats::recordDeallocation(AllocTag tag, std::size_t numBytes)
+{
+   syncEpoch();
+
+   TagCounters& counters = m_tags[static_cast<std::size_t>(tag)];
+   counters.deallocations.add(1);
+   counters.deallocatedBytes.add(numBytes);
+}
+
+
+void ThreadAllocStats::addTo(AllocStatsSnapshot& snapshot) const
+{
+   // Counters of threads that did not reset themselves yet are outdated.
+   if (m_epoch.load(std::memory_order_relaxed) != s_epoch.load(std::memory_order_relaxed))
+      return;
+
+   for (std::size_t i = 0; i < NumAllocTags; ++i)
+      m_tags[i].addTo(snapshot.tags[i]);
+
+   std::lock_guard<std::mutex> lock(m_samplesGuard);
+   snapshot.samples.insert(snapshot.samples.end(), m_samples.begin(), m_samples.end());
+}
+
+
+void ThreadAllocStats::syncEpoch()
+{
+   const std::uint64_t epoch = s_epoch.load(std::memory_order_relaxed);
+   if (m_epoch.load(std::memory_order_relaxed) == epoch)
+      return;
+
+   for (TagCounters& counters : m_tags)
+      counters.reset();
+   m_allocsSinceSample = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_samplesGuard);
+      m_samples.clear();
+      m_nextSample = 0;
+   }
+   m_epoch.store(epoch, std::memory_order_relaxed);
+}
+
+
+void ThreadAllocStats::addSample(const AllocSample& sample)
+{
+   std::lock_guard<std::mutex> lock(m_samplesGuard);
+   // Keep the most recent samples.
+   if (m_samples.size() < NumSamplesPerThread)
+   {
+      m_samples.push_back(sample);
+   }
+   else
+   {
+      m_samples[m_nextSample] = sample;
+      m_nextSample = (m_nextSample + 1) % NumSamplesPerThread;
+   }
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+const char* allocTagName(AllocTag tag)
+{
+   switch (tag)
+   {
+   case AllocTag::Untagged:
+      return "untagged";
+   case AllocTag::Registry:
+      return "registry";
+   case AllocTag::Timer:
+      return "timer";
+   case AllocTag::User:
+      return "user";
+   default:
+      return "unknown";
+   }
+}
+
+
+std::size_t allocSizeClass(std::size_t numBytes)
+{
+   std::size_t sizeClass = 0;
+   std::size_t classLimit = 16;
+   while (numBytes > classLimit && sizeClass < NumAllocSizeClasses - 1)
+   {
+      classLimit *= 2;
+      ++sizeClass;
+   }
+   return sizeClass;
+}
+
+
+AllocTagStats& AllocTagStats::operator+=(const AllocTagStats& other)
+{
+   allocations += other.allocations;
+   deallocations += other.deallocations;
+   allocatedBytes += other.allocatedBytes;
+   deallocatedBytes += other.deallocatedBytes;
+   highWaterBytes = std::max(highWaterBytes, other.highWaterBytes);
+   for (std::size_t i = 0; i < sizeClasses.size(); ++i)
+      sizeClasses[i] += other.sizeClasses[i];
+   return *this;
+}
+
+
+AllocTagStats AllocStatsSnapshot::total() const
+{
+   AllocTagStats sum;
+   for (const AllocTagStats& tagStats : tags)
+      sum += tagStats;
+   return sum;
+}
+
+
+///////////////////
+
+void enableAllocStats(bool enable)
+{
+   s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+bool isAllocStatsEnabled()
+{
+   return s_enabled.load(std::memory_order_relaxed);
+}
+
+
+void setAllocSampleRate(std::size_t everyNth)
+{
+   s_sampleRate.store(everyNth, std::memory_order_relaxed);
+}
+
+
+AllocStatsSnapshot allocStatsSnapshot()
+{
+   return Registry::snapshot();
+}
+
+
+void resetAllocStats()
+{
+   Registry::reset();
+}
+
+
+void recordAllocation(AllocTag tag, std::size_t numBytes)
+{
+   if (!isAllocStatsEnabled() || tag >= AllocTag::Count)
+      return;
+   if (ThreadAllocStats* stats = threadStats())
+      stats->recordAllocation(tag, numBytes);
+}
+
+
+void recordDeallocation(AllocTag tag, std::size_t numBytes)
+{
+   if (!isAllocStatsEnabled() || tag >= AllocTag::Count)
+      return;
+   if (ThreadAllocStats* stats = threadStats())
+      stats->recordDeallocation(tag, numBytes);
+}
+
+
+///////////////////
+
+ScopedAllocSite::ScopedAllocSite(const char* site) : m_prevSite{t_site}
+{
+   t_site = site;
+}
+
+
+ScopedAllocSite::~ScopedAllocSite()
+{
+   t_site = m_prevSite;
+}
+
+
+///////////////////
+
+InstrumentedResource::InstrumentedResource(AllocTag tag,
+                                           std::pmr::memory_resource* upstream)
+: m_tag{tag}, m_upstream{upstream}
+{
+}
+
+
+void* InstrumentedResource::do_allocate(std::size_t numBytes, std::size_t alignment)
+{
+   void* p = m_upstream->allocate(numBytes, alignment);
+   recordAllocation(m_tag, numBytes);
+   return p;
+}
+
+
+void InstrumentedResource::do_deallocate(void* p, std::size_t numBytes,
+                                         std::size_t alignment)
+{
+   m_upstream->deallocate(p, numBytes, alignment);
+   recordDeallocation(m_tag, numBytes);
+}
+
+
+bool InstrumentedResource::do_is_equal(
+   const std::pmr::memory_resource& other) const noexcept
+{
+   // Memory can be freed through any resource with the same upstream. Only the
+   // attribution would be off.
+   const auto* otherInstrumented = dynamic_cast<const InstrumentedResource*>(&other);
+   return (otherInstrumented && otherInstrumented->m_tag == m_tag &&
+           otherInstrumented->m_upstream->is_equal(*m_upstream));
+}
+
+
+std::pmr::memory_resource* allocResource(AllocTag tag)
+{
+   // Function-local to be available during static initialization.
+   static std::array<InstrumentedResource, NumAllocTags> resources{
+      InstrumentedResource{AllocTag::Untagged}, InstrumentedResource{AllocTag::Registry},
+      InstrumentedResource{AllocTag::Timer}, InstrumentedResource{AllocTag::User}};
+   static_assert(NumAllocTags == 4, "Add resources for new tags.");
+
+   const auto idx = static_cast<std::size_t>(tag);
+   return &resources[idx < NumAllocTags ? idx : 0];
+}
+
+} // namespace win32
@@ -0,0 +1,168 @@
+//
+// Win32 utilities library
+// Allocation statistics.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Subsystems that allocations are attributed to.
+enum class AllocTag : unsigned int
+{
+   Untagged,
+   Registry,
+   Timer,
+   User,
+   Count
+};
+
+constexpr std::size_t NumAllocTags = static_cast<std::size_t>(AllocTag::Count);
+
+WIN32UTIL_API const char* allocTagName(AllocTag tag);
+
+
+// Allocation sizes are counted in power-of-two size classes. The first class counts
+// sizes up to 16 bytes, the last class sizes above 1 MB.
+constexpr std::size_t NumAllocSizeClasses = 18;
+
+WIN32UTIL_API std::size_t allocSizeClass(std::size_t numBytes);
+
+
+// Statistics for one tag.
+struct AllocTagStats
+{
+   std::size_t allocations = 0;
+   std::size_t deallocations = 0;
+   std::size_t allocatedBytes = 0;
+   std::size_t deallocatedBytes = 0;
+   // Estimate of the largest number of live bytes. Each thread tracks the bytes it
+   // allocated minus the bytes it freed, and snapshots check the merged live bytes.
+   // Memory freed on another thread stays live for the allocating thread, so the
+   // estimate can exceed the actual peak. Peaks between snapshots that are spread
+   // over threads can be missed.
+   std::size_t highWaterBytes = 0;
+   std::array<std::size_t, NumAllocSizeClasses> sizeClasses{};
+
+   std::int64_t liveBytes() const;
+   AllocTagStats& operator+=(const AllocTagStats& other);
+};
+
+
+inline std::int64_t AllocTagStats::liveBytes() const
+{
+   return static_cast<std::int64_t>(allocatedBytes) -
+          static_cast<std::int64_t>(deallocatedBytes);
+}
+
+
+// Sampled allocation.
+struct AllocSample
+{
+   AllocTag tag = AllocTag::Untagged;
+   std::size_t numBytes = 0;
+   // Call site that was active when the allocation happened or null.
+   const char* site = nullptr;
+};
+
+
+// Merged statistics of all threads.
+struct AllocStatsSnapshot
+{
+   std::array<AllocTagStats, NumAllocTags> tags;
+   std::vector<AllocSample> samples;
+
+   const AllocTagStats& operator[](AllocTag tag) const;
+   AllocTagStats total() const;
+};
+
+
+inline const AllocTagStats& AllocStatsSnapshot::operator[](AllocTag tag) const
+{
+   return tags[static_cast<std::size_t>(tag)];
+}
+
+
+///////////////////
+
+// Statistics are collected per thread and only merged when a snapshot is taken, so
+// recording does not synchronize threads. Disabled by default.
+WIN32UTIL_API void enableAllocStats(bool enable);
+WIN32UTIL_API bool isAllocStatsEnabled();
+// Records a sample for every n-th allocation of each thread. Zero turns sampling off.
+WIN32UTIL_API void setAllocSampleRate(std::size_t everyNth);
+WIN32UTIL_API AllocStatsSnapshot allocStatsSnapshot();
+WIN32UTIL_API void resetAllocStats();
+
+WIN32UTIL_API void recordAllocation(AllocTag tag, std::size_t numBytes);
+WIN32UTIL_API void recordDeallocation(AllocTag tag, std::size_t numBytes);
+
+
+///////////////////
+
+// Names the call site for allocations of the current thread while in scope.
+// The name is only recorded in samples and has to be a string literal.
+class WIN32UTIL_API ScopedAllocSite
+{
+ public:
+   explicit ScopedAllocSite(const char* site);
+   ~ScopedAllocSite();
+   ScopedAllocSite(const ScopedAllocSite&) = delete;
+   ScopedAllocSite& operator=(const ScopedAllocSite&) = delete;
+
+ private:
+   const char* m_prevSite = nullptr;
+};
+
+
+///////////////////
+
+// Memory resource that records allocations under a tag and forwards them to an
+// upstream resource.
+class WIN32UTIL_API InstrumentedResource : public std::pmr::memory_resource
+{
+ public:
+   explicit InstrumentedResource(
+      AllocTag tag,
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+   AllocTag tag() const;
+   std::pmr::memory_resource* upstream() const;
+
+ private:
+   void* do_allocate(std::size_t numBytes, std::size_t alignment) override;
+   void do_deallocate(void* p, std::size_t numBytes, std::size_t alignment) override;
+   bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+ private:
+   AllocTag m_tag = AllocTag::Untagged;
+   std::pmr::memory_resource* m_upstream = nullptr;
+};
+
+
+inline AllocTag InstrumentedResource::tag() const
+{
+   return m_tag;
+}
+
+inline std::pmr::memory_resource* InstrumentedResource::upstream() const
+{
+   return m_upstream;
+}
+
+
+// Shared instrumented resource for a tag. Used for the library's internal allocations.
+WIN32UTIL_API std::pmr::memory_resource* allocResource(AllocTag tag);
+
+} // namespace win32
@@ -0,0 +1,31 @@
+//
+// Win32 utilities library
+// Utilities for benchmarking.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "bench_util.h"
+#include <cstdio>
+#include <string>
+
+
+volatile std::uintptr_t benchSink = 0;
+
+
+void reportBenchGroup(const std::string& name)
+{
+   std::printf("\n%s\n", name.c_str());
+}
+
+
+void reportBench(const std::string& label, double nsPerOp)
+{
+   std::printf("  %-56s %12.1f ns/op\n", label.c_str(), nsPerOp);
+}
+
+
+void reportValue(const std::string& label, double value, const std::string& unit)
+{
+   std::printf("  %-56s %12.1f %s\n", label.c_str(), value, unit.c_str());
+}
@@ -0,0 +1,53 @@
+//
+// Win32 utilities library
+// Utilities for benchmarking.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+
+// Written by keepAlive() so that the compiler cannot drop the computations that
+// produce the written values.
+extern volatile std::uintptr_t benchSink;
+
+inline void keepAlive(std::uintptr_t val)
+{
+   benchSink = val;
+}
+
+inline void keepAlive(const void* p)
+{
+   benchSink = reinterpret_cast<std::uintptr_t>(p);
+}
+
+
+// Times a function that performs a given number of operations per call. Returns the
+// best of several calls in nanoseconds per operation.
+template <typename Fn>
+double measureNsPerOp(std::size_t numOps, Fn&& fn, std::size_t numRuns = 3)
+{
+   using Clock_t = std::chrono::steady_clock;
+
+   double best = std::numeric_limits<double>::max();
+   for (std::size_t run = 0; run < numRuns; ++run)
+   {
+      const auto start = Clock_t::now();
+      fn();
+      const std::chrono::duration<double, std::nano> elapsed = Clock_t::now() - start;
+      best = std::min(best, elapsed.count() / static_cast<double>(numOps));
+   }
+   return best;
+}
+
+
+void reportBenchGroup(const std::string& name);
+void reportBench(const std::string& label, double nsPerOp);
+void reportValue(const std::string& label, double value, const std::string& unit);
@@ -0,0 +1,155 @@
+//
+// Win32 utilities library
+// Benchmarks for map with lock-free lookups.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "concurrent_id_map_bench.h"
+#include "bench_util.h"
+#include "concurrent_id_map.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Map guarded by a single mutex, like the timer registry before it became lock-free.
+template <typename T> class MutexIdMap
+{
+ public:
+   using Id = std::uintptr_t;
+
+   bool insert(Id id, T* obj)
+   {
+      std::scoped_lock lock{m_guard};
+      m_map[id] = obj;
+      return true;
+   }
+
+   bool erase(Id id)
+   {
+      std::scoped_lock lock{m_guard};
+      return m_map.erase(id) > 0;
+   }
+
+   T* find(Id id) const
+   {
+      std::scoped_lock lock{m_guard};
+      const auto pos = m_map.find(id);
+      return pos != m_map.end() ? pos->second : nullptr;
+   }
+
+ private:
+   mutable std::mutex m_guard;
+   std::unordered_map<Id, T*> m_map;
+};
+
+
+struct Timer
+{
+   int value = 0;
+};
+
+
+constexpr std::size_t NumTimers = 1000;
+constexpr std::size_t NumLookups = 2000000;
+
+
+struct ContentionResult
+{
+   double lookupNs = 0.;
+   double writeNs = 0.;
+};
+
+
+// One thread looks up timers, like the thread that receives WM_TIMER messages, while
+// other threads start and stop their own timers.
+template <typename Map> ContentionResult benchContention(std::size_t numWriters)
+{
+   using Clock_t = std::chrono::steady_clock;
+
+   Map map;
+   std::vector<Timer> timers(NumTimers);
+   for (std::size_t i = 0; i < NumTimers; ++i)
+      map.insert(i + 1, &timers[i]);
+
+   std::atomic<bool> stop = false;
+   std::atomic<std::size_t> numWrites = 0;
+   std::vector<std::thread> writers;
+   for (std::size_t w = 0; w < numWriters; ++w)
+   {
+      writers.emplace_back(
+         [&map, &stop, &numWrites, &timers, w]()
+         {
+            // Ids that do not collide with the ones that are looked up.
+            const std::uintptr_t firstId = (w + 1) * 1000000;
+            std::size_t writes = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+               for (std::uintptr_t id = firstId; id < firstId + 64; ++id)
+                  map.insert(id, &timers[0]);
+               for (std::uintptr_t id = firstId; id < firstId + 64; ++id)
+                  map.erase(id);
+               writes += 128;
+            }
+            numWrites += writes;
+         });
+   }
+
+   const auto start = Clock_t::now();
+   std::uintptr_t sum = 0;
+   for (std::size_t i = 0; i < NumLookups; ++i)
+   {
+      const Timer* timer = map.find((i * 7919) % NumTimers + 1);
+      sum += reinterpret_cast<std::uintptr_t>(timer);
+   }
+   const std::chrono::duration<double, std::nano> elapsed = Clock_t::now() - start;
+   keepAlive(sum);
+
+   stop = true;
+   for (std::thread& th : writers)
+      th.join();
+
+   ContentionResult result;
+   result.lookupNs = elapsed.count() / NumLookups;
+   if (numWrites > 0)
+      result.writeNs = elapsed.count() * numWriters / static_cast<double>(numWrites);
+   return result;
+}
+
+
+template <typename Map> void benchMap(const std::string& name)
+{
+   for (std::size_t numWriters : {std::size_t{0}, std::size_t{3}})
+   {
+      const ContentionResult result = benchContention<Map>(numWriters);
+      const std::string label = name + ", " + std::to_string(numWriters) + " writers";
+      reportBench(label + " lookup", result.lookupNs);
+      if (numWriters > 0)
+         reportBench(label + " insert/erase", result.writeNs);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchConcurrentIdMap()
+{
+   reportBenchGroup("Timer registry: lookups while other threads start and stop timers");
+   benchMap<MutexIdMap<Timer>>("mutex-guarded unordered_map");
+   benchMap<ConcurrentIdMap<Timer>>("ConcurrentIdMap");
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Benchmarks for map with lock-free lookups.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void benchConcurrentIdMap();
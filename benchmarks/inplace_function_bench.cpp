@@ -0,0 +1,108 @@
+//
+// Win32 utilities library
+// Benchmarks for move-only function wrappers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "inplace_function_bench.h"
+#include "bench_util.h"
+#include "inplace_function.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t NumWrappers = 100000;
+
+
+// Callable with a capture of two pointers, which fits the small buffer of all
+// wrappers.
+struct SmallCallable
+{
+   const int* a = nullptr;
+   std::size_t b = 0;
+
+   int operator()(int val) const { return val + *a + static_cast<int>(b); }
+};
+
+
+// Callable with a capture of six pointers, which is beyond the small buffer of
+// std::function with common standard libraries.
+struct LargeCallable
+{
+   const int* a = nullptr;
+   std::size_t b[5] = {};
+
+   int operator()(int val) const { return val + *a + static_cast<int>(b[0] + b[4]); }
+};
+
+
+template <typename Wrapper, typename Callable> void benchWrapper(const std::string& name)
+{
+   const int offset = 1;
+   std::vector<Wrapper> wrappers;
+   wrappers.reserve(NumWrappers);
+
+   const double createNs = measureNsPerOp(NumWrappers,
+                                          [&]()
+                                          {
+                                             wrappers.clear();
+                                             for (std::size_t i = 0; i < NumWrappers; ++i)
+                                             {
+                                                Callable fn;
+                                                fn.a = &offset;
+                                                wrappers.emplace_back(fn);
+                                             }
+                                          });
+   reportBench(name + " create and destroy", createNs);
+
+   std::vector<Wrapper> moved(NumWrappers);
+   const double moveNs = measureNsPerOp(2 * NumWrappers,
+                                        [&]()
+                                        {
+                                           for (std::size_t i = 0; i < NumWrappers; ++i)
+                                              moved[i] = std::move(wrappers[i]);
+                                           for (std::size_t i = 0; i < NumWrappers; ++i)
+                                              wrappers[i] = std::move(moved[i]);
+                                        });
+   reportBench(name + " move", moveNs);
+
+   const double invokeNs = measureNsPerOp(NumWrappers,
+                                          [&]()
+                                          {
+                                             int sum = 0;
+                                             for (const Wrapper& fn : wrappers)
+                                                sum += fn(sum & 1);
+                                             keepAlive(static_cast<std::uintptr_t>(sum));
+                                          });
+   reportBench(name + " invoke", invokeNs);
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchInplaceFunction()
+{
+   reportBenchGroup("Function wrappers: capture of two pointers");
+   benchWrapper<std::function<int(int)>, SmallCallable>("std::function");
+   benchWrapper<InplaceFunction<int(int)>, SmallCallable>("InplaceFunction");
+   benchWrapper<UniqueFunction<int(int)>, SmallCallable>("UniqueFunction");
+
+   reportBenchGroup("Function wrappers: capture of six pointers");
+   benchWrapper<std::function<int(int)>, LargeCallable>("std::function");
+   benchWrapper<InplaceFunction<int(int), 8 * sizeof(void*)>, LargeCallable>(
+      "InplaceFunction");
+   benchWrapper<UniqueFunction<int(int)>, LargeCallable>("UniqueFunction");
+}
@@ -0,0 +1,205 @@
+//
+// Win32 utilities library
+// Benchmarks for object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "object_pool_bench.h"
+#include "bench_util.h"
+#include "object_pool.h"
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Typical small payload, e.g. of a posted task.
+struct Payload
+{
+   std::byte data[64];
+};
+
+
+// Allocates with new and delete.
+class NewDeleteAllocator
+{
+ public:
+   Payload* create() { return new Payload; }
+   void destroy(Payload* obj) { delete obj; }
+};
+
+
+// Keeps freed objects in a list that all threads share through a mutex.
+class MutexFreeListAllocator
+{
+ public:
+   ~MutexFreeListAllocator()
+   {
+      for (void* p : m_free)
+         ::operator delete(p);
+   }
+
+   Payload* create()
+   {
+      void* p = nullptr;
+      {
+         std::scoped_lock lock{m_guard};
+         if (!m_free.empty())
+         {
+            p = m_free.back();
+            m_free.pop_back();
+         }
+      }
+      if (!p)
+         p = ::operator new(sizeof(Payload));
+      return new (p) Payload;
+   }
+
+   void destroy(Payload* obj)
+   {
+      obj->~Payload();
+      std::scoped_lock lock{m_guard};
+      m_free.push_back(obj);
+   }
+
+ private:
+   std::mutex m_guard;
+   std::vector<void*> m_free;
+};
+
+
+class PoolAllocator
+{
+ public:
+   Payload* create() { return m_pool.create(); }
+   void destroy(Payload* obj) { m_pool.destroy(obj); }
+
+ private:
+   ObjectPool<Payload> m_pool;
+};
+
+
+constexpr std::size_t NumSingleThreadOps = 1000000;
+constexpr std::size_t NumPairs = 4;
+constexpr std::size_t NumBatches = 2000;
+constexpr std::size_t BatchSize = 256;
+
+
+// Allocates and frees a working set of objects on one thread.
+template <typename Allocator> double benchSingleThread()
+{
+   Allocator alloc;
+   std::vector<Payload*> objs(BatchSize);
+   return measureNsPerOp(NumSingleThreadOps,
+                         [&]()
+                         {
+                            for (std::size_t i = 0; i < NumSingleThreadOps / BatchSize;
+                                 ++i)
+                            {
+                               for (Payload*& obj : objs)
+                                  obj = alloc.create();
+                               keepAlive(objs.back());
+                               for (Payload* obj : objs)
+                                  alloc.destroy(obj);
+                            }
+                         });
+}
+
+
+// Hands batches of objects from a producer to a consumer thread.
+class Mailbox
+{
+ public:
+   void send(std::vector<Payload*> batch)
+   {
+      {
+         std::scoped_lock lock{m_guard};
+         m_batches.push_back(std::move(batch));
+      }
+      m_ready.notify_one();
+   }
+
+   std::vector<Payload*> receive()
+   {
+      std::unique_lock lock{m_guard};
+      m_ready.wait(lock, [this]() { return !m_batches.empty(); });
+      std::vector<Payload*> batch = std::move(m_batches.front());
+      m_batches.erase(m_batches.begin());
+      return batch;
+   }
+
+ private:
+   std::mutex m_guard;
+   std::condition_variable m_ready;
+   std::vector<std::vector<Payload*>> m_batches;
+};
+
+
+// Producers allocate objects that consumers on other threads free.
+template <typename Allocator> double benchProducerConsumer()
+{
+   Allocator alloc;
+   constexpr std::size_t NumOps = NumPairs * NumBatches * BatchSize;
+   return measureNsPerOp(
+      NumOps,
+      [&]()
+      {
+         std::vector<Mailbox> mailboxes(NumPairs);
+         std::vector<std::thread> threads;
+         for (Mailbox& mailbox : mailboxes)
+         {
+            threads.emplace_back(
+               [&alloc, &mailbox]()
+               {
+                  for (std::size_t i = 0; i < NumBatches; ++i)
+                  {
+                     std::vector<Payload*> batch(BatchSize);
+                     for (Payload*& obj : batch)
+                        obj = alloc.create();
+                     mailbox.send(std::move(batch));
+                  }
+               });
+            threads.emplace_back(
+               [&alloc, &mailbox]()
+               {
+                  for (std::size_t i = 0; i < NumBatches; ++i)
+                  {
+                     for (Payload* obj : mailbox.receive())
+                        alloc.destroy(obj);
+                  }
+               });
+         }
+         for (std::thread& th : threads)
+            th.join();
+      });
+}
+
+
+template <typename Allocator> void benchAllocator(const std::string& name)
+{
+   reportBench(name + " single thread", benchSingleThread<Allocator>());
+   reportBench(name + " producer/consumer", benchProducerConsumer<Allocator>());
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchObjectPool()
+{
+   reportBenchGroup("ObjectPool: allocation and free of 64-byte objects");
+   benchAllocator<NewDeleteAllocator>("new/delete");
+   benchAllocator<MutexFreeListAllocator>("mutex-guarded free list");
+   benchAllocator<PoolAllocator>("ObjectPool");
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Benchmarks for object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void benchObjectPool();
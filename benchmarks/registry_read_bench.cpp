@@ -0,0 +1,127 @@
+//
+// Win32 utilities library
+// Benchmarks for reading registry values.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_read_bench.h"
+#include "bench_util.h"
+#include "alloc_stats.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t NumReads = 100000;
+constexpr std::size_t NumRuns = 3;
+const std::wstring KeyPath = L"Software\\win32_util_benchmarks";
+
+
+// Counts the round trips that reads make to the backend. For the system registry
+// each of them is a system call.
+class QueryCountingBackend : public MemoryRegBackend
+{
+ public:
+   bool queryValue(RegHandle key, const std::wstring& valueName, RegValueType* type,
+                   void* data, std::size_t* numBytes) override
+   {
+      ++numQueries;
+      return MemoryRegBackend::queryValue(key, valueName, type, data, numBytes);
+   }
+
+   std::size_t numQueries = 0;
+};
+
+
+// Reads the way RegKey::readWString did before, with a size query followed by a
+// query for the data.
+std::optional<std::wstring> readWithSizeQuery(RegBackend& backend, RegHandle key,
+                                              const std::wstring& entryName)
+{
+   std::size_t numBytes = 0;
+   RegValueType entryType = RegValueType::None;
+   if (!backend.queryValue(key, entryName, &entryType, nullptr, &numBytes) ||
+       entryType != RegValueType::String)
+   {
+      return {};
+   }
+
+   // '+ 1' for additional zero terminator.
+   ScopedAllocSite site{"readWithSizeQuery"};
+   std::pmr::vector<wchar_t> buffer(numBytes / sizeof(wchar_t) + 1, 0,
+                                    allocResource(AllocTag::Registry));
+   std::size_t numReadBytes = buffer.size() * sizeof(wchar_t);
+   if (!backend.queryValue(key, entryName, nullptr, buffer.data(), &numReadBytes) ||
+       numReadBytes != numBytes)
+   {
+      return {};
+   }
+   buffer.back() = 0;
+   return buffer.data();
+}
+
+
+template <typename ReadFn>
+void benchRead(QueryCountingBackend& backend, const std::string& label, ReadFn read)
+{
+   backend.numQueries = 0;
+   std::size_t numChars = 0;
+   const double ns = measureNsPerOp(NumReads,
+                                    [&]()
+                                    {
+                                       for (std::size_t i = 0; i < NumReads; ++i)
+                                          numChars += read();
+                                    },
+                                    NumRuns);
+   keepAlive(numChars);
+
+   const double queriesPerRead = static_cast<double>(backend.numQueries) /
+                                 static_cast<double>(NumRuns * NumReads);
+   reportBench(label, ns);
+   reportValue(label + " queries", queriesPerRead, "per read");
+}
+
+
+void benchValue(std::size_t numChars)
+{
+   QueryCountingBackend backend;
+   RegKey rk{backend, RegCurrentUser, KeyPath};
+   const std::wstring entryName = L"Value";
+   rk.writeWString(entryName, std::wstring(numChars, L'x'));
+   std::vector<wchar_t> callerBuffer(numChars + 1);
+
+   benchRead(backend, "size query and read",
+             [&]()
+             { return readWithSizeQuery(backend, rk.handle(), entryName)->size(); });
+   benchRead(backend, "RegKey::readWString",
+             [&]() { return rk.readWString(entryName)->size(); });
+   benchRead(backend, "RegKey::readWString into caller buffer",
+             [&]() { return rk.readWString(entryName, callerBuffer)->size(); });
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchRegistryRead()
+{
+   reportBenchGroup("Registry reads of a 16 character string from the memory hive");
+   benchValue(16);
+
+   reportBenchGroup("Registry reads of a 1000 character string from the memory hive");
+   benchValue(1000);
+}
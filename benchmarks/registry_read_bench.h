@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Benchmarks for reading registry values.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void benchRegistryRead();
@@ -0,0 +1,109 @@
+//
+// Win32 utilities library
+// Benchmarks for registry tree traversal.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_walker_bench.h"
+#include "bench_util.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "registry_walker.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring KeyPath = L"Software\\win32_util_benchmarks";
+constexpr std::size_t ThreadCounts[] = {1, 2, 4, 8};
+
+
+// Creates a tree with the given number of subkeys per key, each key holding
+// two entries.
+void createTree(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+                std::size_t fanout, std::size_t depth)
+{
+   RegKey key;
+   key.create(backend, parent, keyPath);
+   key.writeInt32(L"int32", 1);
+   key.writeWString(L"str", L"value");
+   if (depth == 0)
+      return;
+
+   for (std::size_t i = 0; i < fanout; ++i)
+      createTree(backend, key.handle(), L"key" + std::to_wstring(i), fanout, depth - 1);
+}
+
+
+// Simulates a visitor that waits for each key, e.g. for a remote registry or
+// for I/O.
+class WaitingVisitor : public RegWalkVisitor
+{
+ public:
+   explicit WaitingVisitor(std::chrono::microseconds delay) : m_delay{delay} {}
+
+   bool visitKey(const RegKey& /*key*/, const std::wstring& /*path*/,
+                 std::size_t /*depth*/) override
+   {
+      if (m_delay.count() > 0)
+         std::this_thread::sleep_for(m_delay);
+      return true;
+   }
+
+ private:
+   std::chrono::microseconds m_delay;
+};
+
+
+void benchWalk(std::size_t fanout, std::size_t depth, std::chrono::microseconds delay)
+{
+   MemoryRegBackend backend;
+   createTree(backend, RegCurrentUser, KeyPath, fanout, depth);
+
+   for (std::size_t numThreads : ThreadCounts)
+   {
+      WaitingVisitor visitor{delay};
+      RegWalkOptions options;
+      options.numThreads = numThreads;
+
+      std::uint64_t numKeys = 0;
+      std::uint64_t numStolenKeys = 0;
+      const double ns = measureNsPerOp(1,
+                                       [&]()
+                                       {
+                                          const auto stats = walkRegistry(
+                                             backend, RegCurrentUser, KeyPath,
+                                             visitor, options);
+                                          numKeys = stats->numKeys;
+                                          numStolenKeys = stats->numStolenKeys;
+                                       });
+
+      const std::string label =
+         std::to_string(numThreads) + (numThreads == 1 ? " thread" : " threads");
+      reportBench(label + " per key", ns / static_cast<double>(numKeys));
+      reportValue(label + " walk", ns / 1e6, "ms");
+      reportValue(label + " stolen keys", static_cast<double>(numStolenKeys), "keys");
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchRegistryWalker()
+{
+   reportBenchGroup("walkRegistry: 37449 keys (fanout 8, depth 5), counting visitor");
+   benchWalk(8, 5, std::chrono::microseconds{0});
+
+   reportBenchGroup("walkRegistry: 1365 keys (fanout 4, depth 5), 100 us wait per key");
+   benchWalk(4, 5, std::chrono::microseconds{100});
+}
@@ -0,0 +1,159 @@
+//
+// Win32 utilities library
+// Benchmarks for ring buffers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "ring_buffer_bench.h"
+#include "bench_util.h"
+#include "ring_buffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t Capacity = 64 * 1024;
+constexpr std::size_t NumMessages = 2000000;
+// Message sizes cycle through the range, so that messages straddle the end of the
+// buffer at varying offsets.
+constexpr std::size_t MinMessageSize = 24;
+constexpr std::size_t MaxMessageSize = 200;
+
+
+// Looked up at runtime, so that the compiler cannot specialize copies for the size
+// range.
+const std::vector<std::size_t>& messageSizes()
+{
+   static const std::vector<std::size_t> sizes = []()
+   {
+      std::vector<std::size_t> sizes(NumMessages);
+      for (std::size_t i = 0; i < NumMessages; ++i)
+         sizes[i] = MinMessageSize + (i * 37) % (MaxMessageSize - MinMessageSize + 1);
+      return sizes;
+   }();
+   return sizes;
+}
+
+
+std::size_t totalBytes()
+{
+   std::size_t total = 0;
+   for (std::size_t size : messageSizes())
+      total += size;
+   return total;
+}
+
+
+// Single-producer/single-consumer ring that maps its positions into the buffer with
+// a mask and splits copies that wrap around the end.
+class ModuloRingBuffer
+{
+ public:
+   explicit ModuloRingBuffer(std::size_t capacity) : m_buffer(capacity) {}
+
+   bool write(std::span<const std::byte> data)
+   {
+      const std::uint64_t writePos = m_writePos.load(std::memory_order_relaxed);
+      const std::uint64_t readPos = m_readPos.load(std::memory_order_acquire);
+      if (m_buffer.size() - (writePos - readPos) < data.size())
+         return false;
+
+      const std::size_t offset = writePos & (m_buffer.size() - 1);
+      const std::size_t first = std::min(data.size(), m_buffer.size() - offset);
+      std::memcpy(m_buffer.data() + offset, data.data(), first);
+      std::memcpy(m_buffer.data(), data.data() + first, data.size() - first);
+      m_writePos.store(writePos + data.size(), std::memory_order_release);
+      return true;
+   }
+
+   std::size_t read(std::span<std::byte> dest)
+   {
+      const std::uint64_t readPos = m_readPos.load(std::memory_order_relaxed);
+      const std::uint64_t writePos = m_writePos.load(std::memory_order_acquire);
+      const std::size_t numBytes =
+         std::min(static_cast<std::size_t>(writePos - readPos), dest.size());
+
+      const std::size_t offset = readPos & (m_buffer.size() - 1);
+      const std::size_t first = std::min(numBytes, m_buffer.size() - offset);
+      std::memcpy(dest.data(), m_buffer.data() + offset, first);
+      std::memcpy(dest.data() + first, m_buffer.data(), numBytes - first);
+      m_readPos.store(readPos + numBytes, std::memory_order_release);
+      return numBytes;
+   }
+
+ private:
+   std::vector<std::byte> m_buffer;
+   alignas(64) std::atomic<std::uint64_t> m_writePos = 0;
+   alignas(64) std::atomic<std::uint64_t> m_readPos = 0;
+};
+
+
+// Streams messages from producer threads to a consumer that copies them out.
+template <typename RingBuffer> double benchStreaming(std::size_t numProducers)
+{
+   const std::size_t total = totalBytes();
+   return measureNsPerOp(
+      NumMessages,
+      [&]()
+      {
+         RingBuffer ring{Capacity};
+         std::vector<std::byte> message(MaxMessageSize, std::byte{1});
+         const std::vector<std::size_t>& sizes = messageSizes();
+
+         std::vector<std::thread> producers;
+         for (std::size_t p = 0; p < numProducers; ++p)
+         {
+            producers.emplace_back(
+               [&ring, &message, &sizes, p, numProducers]()
+               {
+                  for (std::size_t i = p; i < NumMessages; i += numProducers)
+                  {
+                     const std::span<const std::byte> data{message.data(), sizes[i]};
+                     while (!ring.write(data))
+                        std::this_thread::yield();
+                  }
+               });
+         }
+
+         std::vector<std::byte> dest(4096);
+         std::size_t numRead = 0;
+         while (numRead < total)
+         {
+            const std::size_t n = ring.read(dest);
+            if (n == 0)
+               std::this_thread::yield();
+            numRead += n;
+         }
+         keepAlive(dest.data());
+
+         for (std::thread& th : producers)
+            th.join();
+      });
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchRingBuffer()
+{
+   reportBenchGroup("Ring buffers: streaming 24-200 byte messages through 64 KB");
+   reportBench("modulo-indexed ring, 1 producer", benchStreaming<ModuloRingBuffer>(1));
+   reportBench("SpscRingBuffer, 1 producer", benchStreaming<SpscRingBuffer>(1));
+   reportBench("MpscRingBuffer, 1 producer", benchStreaming<MpscRingBuffer>(1));
+   reportBench("MpscRingBuffer, 4 producers", benchStreaming<MpscRingBuffer>(4));
+}
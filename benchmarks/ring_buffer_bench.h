@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Benchmarks for ring buffers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void benchRingBuffer();
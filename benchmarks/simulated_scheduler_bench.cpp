@@ -0,0 +1,112 @@
+//
+// Win32 utilities library
+// Benchmarks for scheduler with virtual time.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "simulated_scheduler_bench.h"
+#include "bench_util.h"
+#include "simulated_scheduler.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t NumOneShotTimers = 1000000;
+// Delays are spread over one hour of virtual time.
+constexpr std::uint64_t MaxDelayMs = 3600000;
+
+constexpr std::size_t NumPeriodicTimers = 1000;
+// Periods are spread between 10 ms and one second.
+constexpr std::uint64_t MinPeriodMs = 10;
+constexpr std::uint64_t MaxPeriodMs = 1000;
+constexpr std::uint64_t PeriodicSpanMs = 3600000;
+
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+   const auto elapsed = std::chrono::steady_clock::now() - start;
+   return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+
+void benchOneShot()
+{
+   std::mt19937_64 rng{42};
+   std::uniform_int_distribution<std::uint64_t> dist{1, MaxDelayMs};
+   std::vector<std::uint64_t> delays(NumOneShotTimers);
+   for (std::uint64_t& delay : delays)
+      delay = dist(rng);
+
+   std::size_t numFired = 0;
+   const TimerScheduler::Callback_t callback = [&numFired](TimerScheduler::TimerId)
+   { ++numFired; };
+
+   SimulatedScheduler scheduler;
+   const double startNs = measureNsPerOp(
+      NumOneShotTimers,
+      [&]()
+      {
+         for (std::uint64_t delay : delays)
+            scheduler.start(delay, callback);
+      },
+      1);
+   reportBench("start 1M one-shot timers", startNs);
+
+   const auto wallStart = std::chrono::steady_clock::now();
+   scheduler.advanceTo(MaxDelayMs);
+   const double wallMs = elapsedMs(wallStart);
+   keepAlive(numFired);
+   reportBench("expire 1M one-shot timers", wallMs * 1e6 / static_cast<double>(numFired));
+   reportValue("wall time for one virtual hour", wallMs, "ms");
+}
+
+
+void benchPeriodic()
+{
+   std::mt19937_64 rng{7};
+   std::uniform_int_distribution<std::uint64_t> dist{MinPeriodMs, MaxPeriodMs};
+
+   std::size_t numFired = 0;
+   const TimerScheduler::Callback_t callback = [&numFired](TimerScheduler::TimerId)
+   { ++numFired; };
+
+   SimulatedScheduler scheduler;
+   for (std::size_t i = 0; i < NumPeriodicTimers; ++i)
+   {
+      const std::uint64_t period = dist(rng);
+      scheduler.start(period, callback, period);
+   }
+
+   const auto wallStart = std::chrono::steady_clock::now();
+   scheduler.advanceTo(PeriodicSpanMs);
+   const double wallMs = elapsedMs(wallStart);
+   keepAlive(numFired);
+   reportValue("callbacks in one virtual hour",
+               static_cast<double>(numFired), "calls");
+   reportBench("expire periodic timers", wallMs * 1e6 / static_cast<double>(numFired));
+   reportValue("wall time for one virtual hour", wallMs, "ms");
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchSimulatedScheduler()
+{
+   reportBenchGroup("SimulatedScheduler: one-shot timers over one virtual hour");
+   benchOneShot();
+
+   reportBenchGroup("SimulatedScheduler: 1000 periodic timers over one virtual hour");
+   benchPeriodic();
+}
@@ -0,0 +1,164 @@
+//
+// Win32 utilities library
+// Benchmarks for timer wheel.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_wheel_bench.h"
+#include "bench_util.h"
+#include "timer_wheel.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::size_t NumTimers = 1000000;
+// Deadlines are spread over one minute of millisecond ticks.
+constexpr std::uint64_t MaxDeadline = 60000;
+
+
+std::vector<std::uint64_t> makeDeadlines()
+{
+   std::mt19937_64 rng{42};
+   std::uniform_int_distribution<std::uint64_t> dist{1, MaxDeadline};
+   std::vector<std::uint64_t> deadlines(NumTimers);
+   for (std::uint64_t& deadline : deadlines)
+      deadline = dist(rng);
+   return deadlines;
+}
+
+
+void benchWheelOneShot(const std::vector<std::uint64_t>& deadlines)
+{
+   std::size_t numFired = 0;
+   const TimerWheel::Callback_t callback = [&numFired](TimerWheel::TimerId)
+   { ++numFired; };
+
+   TimerWheel wheel;
+   std::vector<TimerWheel::TimerId> ids(NumTimers);
+   const double startNs = measureNsPerOp(
+      NumTimers,
+      [&]()
+      {
+         for (std::size_t i = 0; i < NumTimers; ++i)
+            ids[i] = wheel.start(deadlines[i], callback);
+      },
+      1);
+   reportBench("TimerWheel start 1M one-shot timers", startNs);
+
+   // Stop every other timer, e.g. watchdogs whose operations completed.
+   const double stopNs = measureNsPerOp(
+      NumTimers / 2,
+      [&]()
+      {
+         for (std::size_t i = 0; i < NumTimers; i += 2)
+            wheel.stop(ids[i]);
+      },
+      1);
+   reportBench("TimerWheel stop 500k timers", stopNs);
+
+   const double expireNs = measureNsPerOp(
+      NumTimers / 2,
+      [&]()
+      {
+         for (std::uint64_t tick = 1; tick <= MaxDeadline; ++tick)
+            wheel.advance(tick);
+      },
+      1);
+   reportBench("TimerWheel expire 500k timers tick by tick", expireNs);
+   keepAlive(numFired);
+}
+
+
+void benchWheelPeriodic(const std::vector<std::uint64_t>& deadlines)
+{
+   constexpr std::uint64_t Period = 1000;
+   constexpr std::uint64_t NumTicks = 10 * Period;
+
+   std::size_t numFired = 0;
+   const TimerWheel::Callback_t callback = [&numFired](TimerWheel::TimerId)
+   { ++numFired; };
+
+   TimerWheel wheel;
+   for (std::size_t i = 0; i < NumTimers; ++i)
+      wheel.start(deadlines[i] % Period + 1, callback, Period);
+
+   const double expireNs = measureNsPerOp(
+      NumTimers * (NumTicks / Period),
+      [&]()
+      {
+         for (std::uint64_t tick = 1; tick <= NumTicks; ++tick)
+            wheel.advance(tick);
+      },
+      1);
+   reportBench("TimerWheel 1M periodic timers, 10M expirations", expireNs);
+   keepAlive(numFired);
+}
+
+
+// Binary heap as a baseline for starting and expiring timers.
+void benchHeapOneShot(const std::vector<std::uint64_t>& deadlines)
+{
+   struct HeapTimer
+   {
+      std::uint64_t deadline = 0;
+      std::function<void()> callback;
+
+      bool operator>(const HeapTimer& other) const { return deadline > other.deadline; }
+   };
+
+   std::size_t numFired = 0;
+   const std::function<void()> callback = [&numFired]() { ++numFired; };
+
+   std::priority_queue<HeapTimer, std::vector<HeapTimer>, std::greater<>> heap;
+   const double startNs = measureNsPerOp(
+      NumTimers,
+      [&]()
+      {
+         for (std::size_t i = 0; i < NumTimers; ++i)
+            heap.push({deadlines[i], callback});
+      },
+      1);
+   reportBench("binary heap start 1M one-shot timers", startNs);
+
+   const double expireNs = measureNsPerOp(
+      NumTimers,
+      [&]()
+      {
+         for (std::uint64_t tick = 1; tick <= MaxDeadline; ++tick)
+         {
+            while (!heap.empty() && heap.top().deadline <= tick)
+            {
+               heap.top().callback();
+               heap.pop();
+            }
+         }
+      },
+      1);
+   reportBench("binary heap expire 1M timers tick by tick", expireNs);
+   keepAlive(numFired);
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchTimerWheel()
+{
+   reportBenchGroup("TimerWheel: one million timers");
+   const std::vector<std::uint64_t> deadlines = makeDeadlines();
+   benchWheelOneShot(deadlines);
+   benchWheelPeriodic(deadlines);
+   benchHeapOneShot(deadlines);
+}
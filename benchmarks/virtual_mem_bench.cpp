@@ -0,0 +1,116 @@
+//
+// Win32 utilities library
+// Benchmarks for virtual memory utilities.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "virtual_mem_bench.h"
+#include "bench_util.h"
+#include "virtual_mem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Log record of a typical size.
+struct Record
+{
+   std::uint64_t timestamp = 0;
+   std::uint64_t payload[7] = {};
+};
+
+
+struct GrowthResult
+{
+   double nsPerPush = 0.;
+   // Slowest single push, which includes moving the elements for std::vector.
+   double maxPushUs = 0.;
+};
+
+
+template <typename Array> Array makeArray(std::size_t maxSize);
+
+template <> std::vector<Record> makeArray(std::size_t /*maxSize*/)
+{
+   return {};
+}
+
+template <> ReservedArray<Record> makeArray(std::size_t maxSize)
+{
+   return ReservedArray<Record>{maxSize};
+}
+
+
+void push(std::vector<Record>& arr, const Record& rec)
+{
+   arr.push_back(rec);
+}
+
+void push(ReservedArray<Record>& arr, const Record& rec)
+{
+   arr.pushBack(rec);
+}
+
+
+// Appends records one by one to an empty array.
+template <typename Array> GrowthResult benchGrowth(std::size_t numRecords)
+{
+   using Clock_t = std::chrono::steady_clock;
+
+   GrowthResult result;
+   result.nsPerPush = measureNsPerOp(numRecords,
+                                     [&]()
+                                     {
+                                        Array arr = makeArray<Array>(numRecords);
+                                        for (std::size_t i = 0; i < numRecords; ++i)
+                                           push(arr, Record{i});
+                                        keepAlive(arr.data());
+                                     });
+
+   Array arr = makeArray<Array>(numRecords);
+   for (std::size_t i = 0; i < numRecords; ++i)
+   {
+      const auto start = Clock_t::now();
+      push(arr, Record{i});
+      const std::chrono::duration<double, std::micro> elapsed = Clock_t::now() - start;
+      result.maxPushUs = std::max(result.maxPushUs, elapsed.count());
+   }
+   keepAlive(arr.data());
+   return result;
+}
+
+
+void reportGrowth(const std::string& name, std::size_t numRecords,
+                  const GrowthResult& result)
+{
+   const std::string label = name + " " + std::to_string(numRecords) + " records";
+   reportBench(label, result.nsPerPush);
+   reportValue(label + " slowest push", result.maxPushUs, "us");
+}
+
+} // namespace
+
+
+///////////////////
+
+void benchVirtualMem()
+{
+   reportBenchGroup("ReservedArray: growth by appending 64-byte records");
+   for (std::size_t numRecords : {std::size_t{10000}, std::size_t{1000000}})
+   {
+      reportGrowth("std::vector", numRecords,
+                   benchGrowth<std::vector<Record>>(numRecords));
+      reportGrowth("ReservedArray", numRecords,
+                   benchGrowth<ReservedArray<Record>>(numRecords));
+   }
+}
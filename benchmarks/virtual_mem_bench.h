@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Benchmarks for virtual memory utilities.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void benchVirtualMem();
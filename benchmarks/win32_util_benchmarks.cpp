@@ -0,0 +1,68 @@
+//
+// Win32 utilities library
+// Program entry point for benchmarks.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "concurrent_id_map_bench.h"
+#include "inplace_function_bench.h"
+#include "object_pool_bench.h"
+#include "registry_read_bench.h"
+#include "registry_walker_bench.h"
+#include "ring_buffer_bench.h"
+#include "simulated_scheduler_bench.h"
+#include "timer_wheel_bench.h"
+#include "virtual_mem_bench.h"
+#include <string>
+
+
+namespace
+{
+///////////////////
+
+struct Benchmark
+{
+   const char* name;
+   void (*run)();
+};
+
+const Benchmark Benchmarks[] = {
+   {"concurrent_id_map", benchConcurrentIdMap},
+   {"inplace_function", benchInplaceFunction},
+   {"object_pool", benchObjectPool},
+   {"registry_read", benchRegistryRead},
+   {"registry_walker", benchRegistryWalker},
+   {"ring_buffer", benchRingBuffer},
+   {"simulated_scheduler", benchSimulatedScheduler},
+   {"timer_wheel", benchTimerWheel},
+   {"virtual_mem", benchVirtualMem},
+};
+
+
+// Benchmarks run if their name contains any of the arguments or if there are no
+// arguments.
+bool isSelected(const std::string& name, int argc, char* argv[])
+{
+   if (argc <= 1)
+      return true;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (name.find(argv[i]) != std::string::npos)
+         return true;
+   }
+   return false;
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+   for (const Benchmark& bench : Benchmarks)
+   {
+      if (isSelected(bench.name, argc, argv))
+         bench.run();
+   }
+   return 0;
+}
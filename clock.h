@@ -0,0 +1,112 @@
+//
+// Win32 utilities library
+// Injectable time sources.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <chrono>
+#include <cstdint>
+
+
+namespace win32
+{
+///////////////////
+
+// Source of monotonic time in milliseconds. Lets time-dependent logic be tested
+// without waiting for real time to pass.
+class Clock
+{
+ public:
+   virtual ~Clock() = default;
+   virtual std::uint64_t nowMs() const = 0;
+};
+
+
+///////////////////
+
+// Clock that reads std::chrono::steady_clock.
+class SteadyClock : public Clock
+{
+ public:
+   std::uint64_t nowMs() const override;
+};
+
+
+inline std::uint64_t SteadyClock::nowMs() const
+{
+   using namespace std::chrono;
+   return static_cast<std::uint64_t>(
+      duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+
+// Shared instance for components that default to real time.
+inline const Clock& steadyClock()
+{
+   static const SteadyClock clock;
+   return clock;
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Clock that reads the system tick count like the Win32 timer functions do.
+class TickCountClock : public Clock
+{
+ public:
+   std::uint64_t nowMs() const override;
+};
+
+
+inline std::uint64_t TickCountClock::nowMs() const
+{
+   return ::GetTickCount64();
+}
+
+#endif //_WIN32
+
+
+///////////////////
+
+// Clock whose time only changes when it is set or advanced explicitly.
+class ManualClock : public Clock
+{
+ public:
+   explicit ManualClock(std::uint64_t nowMs = 0);
+
+   std::uint64_t nowMs() const override;
+   void set(std::uint64_t nowMs);
+   void advance(std::uint64_t deltaMs);
+
+ private:
+   std::uint64_t m_now = 0;
+};
+
+
+inline ManualClock::ManualClock(std::uint64_t nowMs) : m_now{nowMs}
+{
+}
+
+inline std::uint64_t ManualClock::nowMs() const
+{
+   return m_now;
+}
+
+inline void ManualClock::set(std::uint64_t nowMs)
+{
+   m_now = nowMs;
+}
+
+inline void ManualClock::advance(std::uint64_t deltaMs)
+{
+   m_now += deltaMs;
+}
+
+} // namespace win32
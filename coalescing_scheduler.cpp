@@ -0,0 +1,199 @@
+//
+// Win32 utilities library
+// Scheduler that coalesces timer expiries.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "coalescing_scheduler.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace win32;
+
+
+namespace win32
+{
+///////////////////
+
+double CoalescingScheduler::Stats::savedWakeupsPerSecond() const
+{
+   if (elapsedMs == 0)
+      return 0.;
+   return static_cast<double>(savedWakeups()) * 1000. / static_cast<double>(elapsedMs);
+}
+
+
+///////////////////
+
+CoalescingScheduler::CoalescingScheduler(std::uint64_t nowMs)
+: m_now{nowMs}, m_statsStart{nowMs}
+{
+}
+
+
+CoalescingScheduler::TimerId CoalescingScheduler::start(std::uint64_t delayMs,
+                                                        std::uint64_t toleranceMs,
+                                                        Callback_t callback,
+                                                        std::uint64_t periodMs)
+{
+   if (!callback)
+      return 0;
+
+   const TimerId id = m_nextId++;
+   m_timers.emplace(id,
+                    Entry{std::move(callback), m_now + delayMs, toleranceMs, periodMs});
+   return id;
+}
+
+
+bool CoalescingScheduler::stop(TimerId id)
+{
+   return m_timers.erase(id) > 0;
+}
+
+
+std::uint64_t CoalescingScheduler::nextWakeup() const
+{
+   // Waking up at the end of the earliest tolerance window expires every timer that
+   // is due by then, while no timer expires later than its window allows.
+   std::uint64_t wakeup = NoWakeup;
+   for (const auto& item : m_timers)
+      wakeup = std::min(wakeup, item.second.due + item.second.tolerance);
+   return wakeup;
+}
+
+
+std::size_t CoalescingScheduler::advance(std::uint64_t nowMs)
+{
+   m_now = std::max(m_now, nowMs);
+
+   // Collect first because callbacks can start and stop timers.
+   std::vector<TimerId> dueIds;
+   for (const auto& item : m_timers)
+   {
+      if (item.second.due <= m_now)
+         dueIds.push_back(item.first);
+   }
+   if (dueIds.empty())
+      return 0;
+
+   std::size_t numExpired = 0;
+   for (TimerId id : dueIds)
+   {
+      auto pos = m_timers.find(id);
+      // Stopped by an earlier callback.
+      if (pos == m_timers.end())
+         continue;
+
+      Entry& entry = pos->second;
+      const bool isPeriodic = (entry.period > 0);
+      if (isPeriodic)
+      {
+         // Stay on the grid of the period but skip due times that already passed.
+         const std::uint64_t numPassed = (m_now - entry.due) / entry.period + 1;
+         entry.due += numPassed * entry.period;
+      }
+
+      // Callbacks can stop their own timer, so call a moved-out callback.
+      Callback_t callback = std::move(entry.callback);
+      if (!isPeriodic)
+         m_timers.erase(pos);
+
+      callback(id);
+      ++numExpired;
+
+      if (isPeriodic)
+      {
+         pos = m_timers.find(id);
+         if (pos != m_timers.end())
+            pos->second.callback = std::move(callback);
+      }
+   }
+
+   m_stats.numExpirations += numExpired;
+   ++m_stats.numWakeups;
+   return numExpired;
+}
+
+
+CoalescingScheduler::Stats CoalescingScheduler::stats() const
+{
+   Stats stats = m_stats;
+   stats.elapsedMs = m_now - m_statsStart;
+   return stats;
+}
+
+
+void CoalescingScheduler::resetStats()
+{
+   m_stats = {};
+   m_statsStart = m_now;
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+CoalescingTimerScheduler::CoalescingTimerScheduler()
+: m_scheduler{GetTickCount64()}, m_osTimer{[this](DWORD) { onTick(); }}
+{
+}
+
+
+CoalescingTimerScheduler::TimerId
+CoalescingTimerScheduler::start(unsigned int timeOutMs, unsigned int toleranceMs,
+                                Callback_t callback, unsigned int periodMs)
+{
+   // Catch up with real time before computing the due time.
+   if (!m_isInTick)
+      m_scheduler.advance(GetTickCount64());
+   const TimerId id =
+      m_scheduler.start(timeOutMs, toleranceMs, std::move(callback), periodMs);
+   reprogram();
+   return id;
+}
+
+
+bool CoalescingTimerScheduler::stop(TimerId id)
+{
+   const bool res = m_scheduler.stop(id);
+   reprogram();
+   return res;
+}
+
+
+void CoalescingTimerScheduler::onTick()
+{
+   m_isInTick = true;
+   m_scheduler.advance(GetTickCount64());
+   m_isInTick = false;
+   reprogram();
+}
+
+
+void CoalescingTimerScheduler::reprogram()
+{
+   // Callbacks that start or stop timers are handled once after the tick.
+   if (m_isInTick)
+      return;
+
+   const std::uint64_t wakeup = m_scheduler.nextWakeup();
+   if (wakeup == CoalescingScheduler::NoWakeup)
+   {
+      m_osTimer.stop();
+      return;
+   }
+
+   const std::uint64_t now = GetTickCount64();
+   const std::uint64_t delay = (wakeup > now) ? wakeup - now : 0;
+   const auto timeOutMs = static_cast<unsigned int>(
+      std::clamp<std::uint64_t>(delay, USER_TIMER_MINIMUM, USER_TIMER_MAXIMUM));
+   m_osTimer.start(timeOutMs);
+}
+
+#endif //_WIN32
+
+} // namespace win32
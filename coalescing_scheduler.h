@@ -0,0 +1,167 @@
+//
+// Win32 utilities library
+// Scheduler that coalesces timer expiries.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "timer.h"
+#endif
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+
+
+namespace win32
+{
+///////////////////
+
+// Schedules timers that may expire up to a tolerance after their due time. Wakeups
+// are placed at the latest time that still lies inside the tolerance window of the
+// next timer, so that all timers whose windows overlap at that time expire together.
+// Time is measured in milliseconds and only advances when the owner calls advance().
+// Not thread-safe.
+class WIN32UTIL_API CoalescingScheduler
+{
+ public:
+   // Zero is never used as id.
+   using TimerId = std::uint64_t;
+   using Callback_t = std::function<void(TimerId)>;
+
+   static constexpr std::uint64_t NoWakeup = std::numeric_limits<std::uint64_t>::max();
+
+   struct Stats
+   {
+      std::uint64_t numExpirations = 0;
+      std::uint64_t numWakeups = 0;
+      // Time that the stats cover.
+      std::uint64_t elapsedMs = 0;
+
+      std::uint64_t savedWakeups() const;
+      // Wakeups that would have been needed without coalescing minus the actual
+      // wakeups, per second.
+      double savedWakeupsPerSecond() const;
+   };
+
+ public:
+   explicit CoalescingScheduler(std::uint64_t nowMs = 0);
+   CoalescingScheduler(const CoalescingScheduler&) = delete;
+   CoalescingScheduler& operator=(const CoalescingScheduler&) = delete;
+
+   std::uint64_t now() const;
+   std::size_t size() const;
+   bool empty() const;
+
+   // Periodic timers are due at multiples of the period after the first due time,
+   // independent of how late they expired.
+   TimerId start(std::uint64_t delayMs, std::uint64_t toleranceMs, Callback_t callback,
+                 std::uint64_t periodMs = 0);
+   // Can be called from callbacks.
+   bool stop(TimerId id);
+   bool isActive(TimerId id) const;
+
+   // Time at which advance() should be called next. NoWakeup if no timers are
+   // active.
+   std::uint64_t nextWakeup() const;
+   // Advances time and expires all timers that are due. Returns the number of
+   // expired timers.
+   std::size_t advance(std::uint64_t nowMs);
+
+   Stats stats() const;
+   void resetStats();
+
+ private:
+   struct Entry
+   {
+      Callback_t callback;
+      std::uint64_t due = 0;
+      std::uint64_t tolerance = 0;
+      std::uint64_t period = 0;
+   };
+
+ private:
+   std::uint64_t m_now = 0;
+   TimerId m_nextId = 1;
+   std::unordered_map<TimerId, Entry> m_timers;
+   Stats m_stats;
+   std::uint64_t m_statsStart = 0;
+};
+
+
+inline std::uint64_t CoalescingScheduler::now() const
+{
+   return m_now;
+}
+
+inline std::size_t CoalescingScheduler::size() const
+{
+   return m_timers.size();
+}
+
+inline bool CoalescingScheduler::empty() const
+{
+   return m_timers.empty();
+}
+
+inline bool CoalescingScheduler::isActive(TimerId id) const
+{
+   return m_timers.find(id) != m_timers.end();
+}
+
+inline std::uint64_t CoalescingScheduler::Stats::savedWakeups() const
+{
+   return numExpirations - numWakeups;
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Runs a coalescing scheduler on a single OS timer that is programmed for the
+// scheduler's next wakeup. Needs a message loop to work.
+class WIN32UTIL_API CoalescingTimerScheduler
+{
+ public:
+   using TimerId = CoalescingScheduler::TimerId;
+   using Callback_t = CoalescingScheduler::Callback_t;
+
+ public:
+   CoalescingTimerScheduler();
+   CoalescingTimerScheduler(const CoalescingTimerScheduler&) = delete;
+   CoalescingTimerScheduler& operator=(const CoalescingTimerScheduler&) = delete;
+
+   TimerId start(unsigned int timeOutMs, unsigned int toleranceMs, Callback_t callback,
+                 unsigned int periodMs = 0);
+   bool stop(TimerId id);
+   bool isActive(TimerId id) const;
+   CoalescingScheduler::Stats stats() const;
+
+ private:
+   void onTick();
+   void reprogram();
+
+ private:
+   CoalescingScheduler m_scheduler;
+   TimedCallback m_osTimer;
+   bool m_isInTick = false;
+};
+
+
+inline bool CoalescingTimerScheduler::isActive(TimerId id) const
+{
+   return m_scheduler.isActive(id);
+}
+
+inline CoalescingScheduler::Stats CoalescingTimerScheduler::stats() const
+{
+   return m_scheduler.stats();
+}
+
+#endif //_WIN32
+
+} // namespace win32
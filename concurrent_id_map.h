@@ -0,0 +1,294 @@
+//
+// Win32 utilities library
+// Map from ids to objects with lock-free lookups.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Maps non-zero ids to object pointers.
+// Lookups are wait-free and never block writers. Writers lock only the shard of the
+// id, so writers for different ids rarely contend.
+// Each shard is an open-addressing table. Erased entries keep their id, so that
+// lookups never see entries move. Tables that get replaced when growing are freed
+// once no lookup can still use them.
+template <typename T> class ConcurrentIdMap
+{
+ public:
+   using Id = std::uintptr_t;
+
+ public:
+   explicit ConcurrentIdMap(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+   ~ConcurrentIdMap();
+   ConcurrentIdMap(const ConcurrentIdMap&) = delete;
+   ConcurrentIdMap& operator=(const ConcurrentIdMap&) = delete;
+
+   // Adds or replaces the object for an id.
+   bool insert(Id id, T* obj);
+   bool erase(Id id);
+   // Returns null if the id is not in the map.
+   T* find(Id id) const;
+   // Only a snapshot if writers are active.
+   std::size_t size() const;
+
+ private:
+   struct Slot
+   {
+      std::atomic<Id> id = 0;
+      std::atomic<T*> obj = nullptr;
+   };
+
+   struct Table
+   {
+      std::size_t capacity = 0;
+      // Number of slots with an id, including erased ones.
+      std::size_t numUsed = 0;
+      Slot* slots = nullptr;
+   };
+
+   static constexpr std::size_t CacheLineSize = 64;
+
+   struct Shard
+   {
+      std::atomic<Table*> table = nullptr;
+      // Number of lookups that are in progress.
+      mutable std::atomic<std::size_t> numReaders = 0;
+      mutable std::mutex writeGuard;
+      std::size_t numObjs = 0;
+      std::pmr::vector<Table*> retired;
+      // Keeps the lookup counters of neighboring shards on separate cache lines.
+      std::byte padding[CacheLineSize];
+   };
+
+   static constexpr std::size_t NumShards = 16;
+   static constexpr std::size_t MinCapacity = 16;
+
+   static std::size_t hash(Id id);
+   static Slot* probe(const Table& table, std::size_t hashValue, Id id);
+
+   Table* allocateTable(std::size_t capacity);
+   void freeTable(Table* table);
+   // Replaces the table of a shard with one that only holds the current objects.
+   void rehash(Shard& shard, std::size_t capacity);
+   void reclaim(Shard& shard);
+
+ private:
+   std::pmr::memory_resource* m_resource = nullptr;
+   std::array<Shard, NumShards> m_shards;
+};
+
+
+template <typename T>
+ConcurrentIdMap<T>::ConcurrentIdMap(std::pmr::memory_resource* resource)
+: m_resource{resource}
+{
+   for (Shard& shard : m_shards)
+      shard.retired = std::pmr::vector<Table*>{resource};
+}
+
+template <typename T> ConcurrentIdMap<T>::~ConcurrentIdMap()
+{
+   for (Shard& shard : m_shards)
+   {
+      for (Table* table : shard.retired)
+         freeTable(table);
+      if (Table* table = shard.table.load(std::memory_order_relaxed))
+         freeTable(table);
+   }
+}
+
+template <typename T> bool ConcurrentIdMap<T>::insert(Id id, T* obj)
+{
+   if (id == 0 || !obj)
+      return false;
+
+   const std::size_t hashValue = hash(id);
+   Shard& shard = m_shards[hashValue % NumShards];
+   std::scoped_lock lock{shard.writeGuard};
+   reclaim(shard);
+
+   Table* table = shard.table.load(std::memory_order_relaxed);
+   Slot* slot = table ? probe(*table, hashValue, id) : nullptr;
+   if (slot && slot->id.load(std::memory_order_relaxed) == id)
+   {
+      if (!slot->obj.exchange(obj, std::memory_order_release))
+         ++shard.numObjs;
+      return true;
+   }
+
+   // Keep at least a quarter of the slots empty, so that probing stays short and
+   // always ends at an empty slot.
+   if (!table || (table->numUsed + 1) * 4 > table->capacity * 3)
+   {
+      std::size_t capacity = MinCapacity;
+      while (capacity < (shard.numObjs + 1) * 2)
+         capacity *= 2;
+      rehash(shard, capacity);
+      table = shard.table.load(std::memory_order_relaxed);
+      slot = probe(*table, hashValue, id);
+   }
+
+   // Publish the object before the id, so lookups that find the id see the object.
+   slot->obj.store(obj, std::memory_order_relaxed);
+   slot->id.store(id, std::memory_order_release);
+   ++table->numUsed;
+   ++shard.numObjs;
+   return true;
+}
+
+template <typename T> bool ConcurrentIdMap<T>::erase(Id id)
+{
+   if (id == 0)
+      return false;
+
+   const std::size_t hashValue = hash(id);
+   Shard& shard = m_shards[hashValue % NumShards];
+   std::scoped_lock lock{shard.writeGuard};
+   reclaim(shard);
+
+   Table* table = shard.table.load(std::memory_order_relaxed);
+   Slot* slot = table ? probe(*table, hashValue, id) : nullptr;
+   if (!slot || slot->id.load(std::memory_order_relaxed) != id)
+      return false;
+   if (!slot->obj.exchange(nullptr, std::memory_order_release))
+      return false;
+
+   --shard.numObjs;
+   return true;
+}
+
+template <typename T> T* ConcurrentIdMap<T>::find(Id id) const
+{
+   if (id == 0)
+      return nullptr;
+
+   const std::size_t hashValue = hash(id);
+   const Shard& shard = m_shards[hashValue % NumShards];
+
+   // Announce the lookup before loading the table. Together with the sequentially
+   // consistent ordering of the table replacement in rehash(), a writer that sees no
+   // readers knows that no lookup can use a replaced table.
+   shard.numReaders.fetch_add(1, std::memory_order_seq_cst);
+   T* obj = nullptr;
+   if (const Table* table = shard.table.load(std::memory_order_seq_cst))
+   {
+      const Slot* slot = probe(*table, hashValue, id);
+      if (slot->id.load(std::memory_order_acquire) == id)
+         obj = slot->obj.load(std::memory_order_acquire);
+   }
+   shard.numReaders.fetch_sub(1, std::memory_order_release);
+
+   return obj;
+}
+
+template <typename T> std::size_t ConcurrentIdMap<T>::size() const
+{
+   std::size_t numObjs = 0;
+   for (const Shard& shard : m_shards)
+   {
+      std::scoped_lock lock{shard.writeGuard};
+      numObjs += shard.numObjs;
+   }
+   return numObjs;
+}
+
+template <typename T> std::size_t ConcurrentIdMap<T>::hash(Id id)
+{
+   // Fibonacci hashing. Timer ids are often small sequential numbers.
+   const std::uint64_t product = static_cast<std::uint64_t>(id) * 0x9E3779B97F4A7C15ull;
+   return static_cast<std::size_t>(product >> 32);
+}
+
+template <typename T>
+typename ConcurrentIdMap<T>::Slot*
+ConcurrentIdMap<T>::probe(const Table& table, std::size_t hashValue, Id id)
+{
+   // Returns the slot of the id or the empty slot that ends the probe sequence.
+   const std::size_t mask = table.capacity - 1;
+   std::size_t idx = (hashValue / NumShards) & mask;
+   for (;;)
+   {
+      const Id slotId = table.slots[idx].id.load(std::memory_order_acquire);
+      if (slotId == id || slotId == 0)
+         return &table.slots[idx];
+      idx = (idx + 1) & mask;
+   }
+}
+
+template <typename T>
+typename ConcurrentIdMap<T>::Table*
+ConcurrentIdMap<T>::allocateTable(std::size_t capacity)
+{
+   void* tableMem = m_resource->allocate(sizeof(Table), alignof(Table));
+   void* slotMem = m_resource->allocate(capacity * sizeof(Slot), alignof(Slot));
+
+   auto* table = new (tableMem) Table{};
+   table->capacity = capacity;
+   table->slots = static_cast<Slot*>(slotMem);
+   for (std::size_t i = 0; i < capacity; ++i)
+      new (&table->slots[i]) Slot{};
+   return table;
+}
+
+template <typename T> void ConcurrentIdMap<T>::freeTable(Table* table)
+{
+   // Slots and tables are trivially destructible.
+   m_resource->deallocate(table->slots, table->capacity * sizeof(Slot), alignof(Slot));
+   m_resource->deallocate(table, sizeof(Table), alignof(Table));
+}
+
+template <typename T> void ConcurrentIdMap<T>::rehash(Shard& shard, std::size_t capacity)
+{
+   Table* newTable = allocateTable(capacity);
+
+   Table* oldTable = shard.table.load(std::memory_order_relaxed);
+   if (oldTable)
+   {
+      for (std::size_t i = 0; i < oldTable->capacity; ++i)
+      {
+         const Slot& oldSlot = oldTable->slots[i];
+         const Id id = oldSlot.id.load(std::memory_order_relaxed);
+         T* obj = oldSlot.obj.load(std::memory_order_relaxed);
+         if (id != 0 && obj)
+         {
+            Slot* slot = probe(*newTable, hash(id), id);
+            slot->obj.store(obj, std::memory_order_relaxed);
+            slot->id.store(id, std::memory_order_relaxed);
+            ++newTable->numUsed;
+         }
+      }
+   }
+
+   shard.table.store(newTable, std::memory_order_seq_cst);
+   if (oldTable)
+      shard.retired.push_back(oldTable);
+   reclaim(shard);
+}
+
+template <typename T> void ConcurrentIdMap<T>::reclaim(Shard& shard)
+{
+   // Lookups that start from now on use the current table.
+   if (shard.retired.empty() || shard.numReaders.load(std::memory_order_seq_cst) != 0)
+      return;
+
+   for (Table* table : shard.retired)
+      freeTable(table);
+   shard.retired.clear();
+}
+
+} // namespace win32
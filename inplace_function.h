@@ -0,0 +1,267 @@
+//
+// Win32 utilities library
+// Move-only function wrappers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+namespace detail
+{
+
+// Operations on the callable that is stored in a function wrapper.
+template <typename R, typename... Args> struct InplaceFunctionOps
+{
+   R (*invoke)(void* storage, Args&&... args);
+   // Move-constructs into the destination and destroys the source.
+   void (*relocate)(void* dest, void* src) noexcept;
+   void (*destroy)(void* storage) noexcept;
+};
+
+
+template <typename F, typename R, typename... Args>
+inline constexpr InplaceFunctionOps<R, Args...> InplaceFunctionOpsFor{
+   [](void* storage, Args&&... args) -> R
+   { return std::invoke(*static_cast<F*>(storage), std::forward<Args>(args)...); },
+   [](void* dest, void* src) noexcept
+   {
+      ::new (dest) F(std::move(*static_cast<F*>(src)));
+      static_cast<F*>(src)->~F();
+   },
+   [](void* storage) noexcept { static_cast<F*>(storage)->~F(); }};
+
+} // namespace detail
+
+
+///////////////////
+
+template <typename Sig, std::size_t Capacity = 4 * sizeof(void*)> class InplaceFunction;
+
+
+// Move-only function wrapper that stores its callable inside the object and never
+// allocates. Callables that do not fit into the capacity or need more than the
+// fundamental alignment are rejected at compile time.
+template <typename R, typename... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+ public:
+   InplaceFunction() = default;
+   InplaceFunction(std::nullptr_t) {}
+   template <typename F,
+             typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, InplaceFunction> &&
+                std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+   InplaceFunction(F&& f);
+   ~InplaceFunction();
+   InplaceFunction(const InplaceFunction&) = delete;
+   InplaceFunction(InplaceFunction&& other) noexcept;
+   InplaceFunction& operator=(const InplaceFunction&) = delete;
+   InplaceFunction& operator=(InplaceFunction&& other) noexcept;
+   InplaceFunction& operator=(std::nullptr_t) noexcept;
+
+   explicit operator bool() const;
+
+   // Like std::function, calls the callable as non-const.
+   R operator()(Args... args) const;
+
+ private:
+   void reset() noexcept;
+
+ private:
+   union Storage
+   {
+      std::max_align_t alignment;
+      std::byte bytes[Capacity];
+   };
+
+   mutable Storage m_storage;
+   const detail::InplaceFunctionOps<R, Args...>* m_ops = nullptr;
+};
+
+
+template <typename R, typename... Args, std::size_t Capacity>
+template <typename F, typename>
+InplaceFunction<R(Args...), Capacity>::InplaceFunction(F&& f)
+{
+   using Fn = std::decay_t<F>;
+   static_assert(sizeof(Fn) <= Capacity, "Callable is too large for InplaceFunction.");
+   static_assert(alignof(Fn) <= alignof(Storage),
+                 "Callable is over-aligned for InplaceFunction.");
+   static_assert(std::is_nothrow_move_constructible_v<Fn>,
+                 "Callable must be nothrow move constructible.");
+
+   if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn> ||
+                 std::is_constructible_v<bool, const Fn&>)
+   {
+      // Null function pointers and empty function objects make an empty wrapper.
+      if (!f)
+         return;
+   }
+
+   ::new (static_cast<void*>(m_storage.bytes)) Fn(std::forward<F>(f));
+   m_ops = &detail::InplaceFunctionOpsFor<Fn, R, Args...>;
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+InplaceFunction<R(Args...), Capacity>::~InplaceFunction()
+{
+   reset();
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+InplaceFunction<R(Args...), Capacity>::InplaceFunction(
+   InplaceFunction&& other) noexcept
+{
+   if (other.m_ops)
+   {
+      other.m_ops->relocate(m_storage.bytes, other.m_storage.bytes);
+      m_ops = std::exchange(other.m_ops, nullptr);
+   }
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+InplaceFunction<R(Args...), Capacity>&
+InplaceFunction<R(Args...), Capacity>::operator=(InplaceFunction&& other) noexcept
+{
+   if (this != &other)
+   {
+      reset();
+      if (other.m_ops)
+      {
+         other.m_ops->relocate(m_storage.bytes, other.m_storage.bytes);
+         m_ops = std::exchange(other.m_ops, nullptr);
+      }
+   }
+   return *this;
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+InplaceFunction<R(Args...), Capacity>&
+InplaceFunction<R(Args...), Capacity>::operator=(std::nullptr_t) noexcept
+{
+   reset();
+   return *this;
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+InplaceFunction<R(Args...), Capacity>::operator bool() const
+{
+   return m_ops != nullptr;
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+void swap(InplaceFunction<R(Args...), Capacity>& a,
+          InplaceFunction<R(Args...), Capacity>& b) noexcept
+{
+   InplaceFunction<R(Args...), Capacity> tmp{std::move(a)};
+   a = std::move(b);
+   b = std::move(tmp);
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+R InplaceFunction<R(Args...), Capacity>::operator()(Args... args) const
+{
+   assert(m_ops);
+   return m_ops->invoke(m_storage.bytes, std::forward<Args>(args)...);
+}
+
+template <typename R, typename... Args, std::size_t Capacity>
+void InplaceFunction<R(Args...), Capacity>::reset() noexcept
+{
+   if (m_ops)
+   {
+      m_ops->destroy(m_storage.bytes);
+      m_ops = nullptr;
+   }
+}
+
+
+///////////////////
+
+template <typename Sig> class UniqueFunction;
+
+
+// Move-only function wrapper that stores small callables inside the object and
+// larger ones on the heap. Unlike std::function it accepts move-only callables.
+template <typename R, typename... Args> class UniqueFunction<R(Args...)>
+{
+ public:
+   static constexpr std::size_t InplaceCapacity = 4 * sizeof(void*);
+
+ public:
+   UniqueFunction() = default;
+   UniqueFunction(std::nullptr_t) {}
+   template <typename F,
+             typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, UniqueFunction> &&
+                std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>>
+   UniqueFunction(F&& f);
+
+   explicit operator bool() const;
+   template <typename R_, typename... Args_>
+   friend void swap(UniqueFunction<R_(Args_...)>& a,
+                    UniqueFunction<R_(Args_...)>& b) noexcept;
+
+   R operator()(Args... args) const;
+
+ private:
+   InplaceFunction<R(Args...), InplaceCapacity> m_fn;
+};
+
+
+template <typename R, typename... Args>
+template <typename F, typename>
+UniqueFunction<R(Args...)>::UniqueFunction(F&& f)
+{
+   using Fn = std::decay_t<F>;
+   if constexpr (std::is_pointer_v<Fn> || std::is_member_pointer_v<Fn> ||
+                 std::is_constructible_v<bool, const Fn&>)
+   {
+      if (!f)
+         return;
+   }
+
+   if constexpr (sizeof(Fn) <= InplaceCapacity &&
+                 alignof(Fn) <= alignof(std::max_align_t) &&
+                 std::is_nothrow_move_constructible_v<Fn>)
+   {
+      m_fn = std::forward<F>(f);
+   }
+   else
+   {
+      m_fn = [fn = std::make_unique<Fn>(std::forward<F>(f))](Args... args) -> R
+      { return std::invoke(*fn, std::forward<Args>(args)...); };
+   }
+}
+
+template <typename R, typename... Args> UniqueFunction<R(Args...)>::operator bool() const
+{
+   return m_fn.operator bool();
+}
+
+template <typename R, typename... Args>
+void swap(UniqueFunction<R(Args...)>& a, UniqueFunction<R(Args...)>& b) noexcept
+{
+   swap(a.m_fn, b.m_fn);
+}
+
+template <typename R, typename... Args>
+R UniqueFunction<R(Args...)>::operator()(Args... args) const
+{
+   return m_fn(std::forward<Args>(args)...);
+}
+
+} // namespace win32
@@ -0,0 +1,191 @@
+//
+// Win32 utilities library
+// Lock-free latency histograms.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "latency_histogram.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::uint64_t NoMin = std::numeric_limits<std::uint64_t>::max();
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+std::size_t histogramBucket(std::uint64_t value)
+{
+   value = std::min(value, HistogramMaxValue);
+   if (value < 2 * HistogramSubBuckets)
+      return static_cast<std::size_t>(value);
+
+   // Shift the value so that its highest bit lands at the top of the sub-bucket range.
+   const unsigned int shift =
+      static_cast<unsigned int>(std::bit_width(value)) - HistogramSubBucketBits - 1;
+   return HistogramSubBuckets * shift + static_cast<std::size_t>(value >> shift);
+}
+
+
+std::uint64_t histogramBucketLowerBound(std::size_t bucket)
+{
+   if (bucket < 2 * HistogramSubBuckets)
+      return bucket;
+
+   const std::size_t shift = bucket / HistogramSubBuckets - 1;
+   const std::uint64_t mantissa = bucket - HistogramSubBuckets * shift;
+   return mantissa << shift;
+}
+
+
+std::uint64_t histogramBucketUpperBound(std::size_t bucket)
+{
+   if (bucket + 1 >= HistogramNumBuckets)
+      return HistogramMaxValue;
+   return histogramBucketLowerBound(bucket + 1) - 1;
+}
+
+
+///////////////////
+
+double HistogramSnapshot::mean() const
+{
+   if (count == 0)
+      return 0.;
+   return static_cast<double>(sum) / static_cast<double>(count);
+}
+
+
+std::uint64_t HistogramSnapshot::percentile(double percent) const
+{
+   if (count == 0)
+      return 0;
+   if (percent <= 0.)
+      return min;
+
+   const double fraction = std::min(percent, 100.) / 100.;
+   const auto rank = std::max<std::uint64_t>(
+      static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(count))), 1);
+
+   std::uint64_t numSeen = 0;
+   for (std::size_t i = 0; i < buckets.size(); ++i)
+   {
+      numSeen += buckets[i];
+      if (numSeen >= rank)
+         return std::clamp(histogramBucketUpperBound(i), min, max);
+   }
+   return max;
+}
+
+
+HistogramSnapshot& HistogramSnapshot::operator+=(const HistogramSnapshot& other)
+{
+   if (other.count == 0)
+      return *this;
+
+   min = (count == 0) ? other.min : std::min(min, other.min);
+   max = std::max(max, other.max);
+   count += other.count;
+   sum += other.sum;
+
+   buckets.resize(std::max(buckets.size(), other.buckets.size()));
+   for (std::size_t i = 0; i < other.buckets.size(); ++i)
+      buckets[i] += other.buckets[i];
+   return *this;
+}
+
+
+std::string HistogramSnapshot::toCsv() const
+{
+   std::ostringstream out;
+   out << "lower,upper,count\n";
+   for (std::size_t i = 0; i < buckets.size(); ++i)
+   {
+      if (buckets[i] > 0)
+      {
+         out << histogramBucketLowerBound(i) << ',' << histogramBucketUpperBound(i) << ','
+             << buckets[i] << '\n';
+      }
+   }
+   return out.str();
+}
+
+
+///////////////////
+
+LatencyHistogram::LatencyHistogram() : m_min{NoMin}
+{
+   for (auto& bucket : m_buckets)
+      bucket.store(0, std::memory_order_relaxed);
+}
+
+
+void LatencyHistogram::record(std::uint64_t value)
+{
+   m_buckets[histogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+   m_count.fetch_add(1, std::memory_order_relaxed);
+   m_sum.fetch_add(value, std::memory_order_relaxed);
+
+   std::uint64_t currMin = m_min.load(std::memory_order_relaxed);
+   while (value < currMin &&
+          !m_min.compare_exchange_weak(currMin, value, std::memory_order_relaxed))
+   {
+   }
+   std::uint64_t currMax = m_max.load(std::memory_order_relaxed);
+   while (value > currMax &&
+          !m_max.compare_exchange_weak(currMax, value, std::memory_order_relaxed))
+   {
+   }
+}
+
+
+HistogramSnapshot LatencyHistogram::snapshot() const
+{
+   HistogramSnapshot snapshot;
+   snapshot.count = m_count.load(std::memory_order_relaxed);
+   if (snapshot.count == 0)
+      return snapshot;
+
+   snapshot.sum = m_sum.load(std::memory_order_relaxed);
+   snapshot.min = m_min.load(std::memory_order_relaxed);
+   snapshot.max = m_max.load(std::memory_order_relaxed);
+
+   // Only copy up to the last used bucket.
+   std::size_t numUsed = 0;
+   for (std::size_t i = 0; i < m_buckets.size(); ++i)
+   {
+      if (m_buckets[i].load(std::memory_order_relaxed) > 0)
+         numUsed = i + 1;
+   }
+   snapshot.buckets.resize(numUsed);
+   for (std::size_t i = 0; i < numUsed; ++i)
+      snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+   return snapshot;
+}
+
+
+void LatencyHistogram::reset()
+{
+   for (auto& bucket : m_buckets)
+      bucket.store(0, std::memory_order_relaxed);
+   m_count.store(0, std::memory_order_relaxed);
+   m_sum.store(0, std::memory_order_relaxed);
+   m_min.store(NoMin, std::memory_order_relaxed);
+   m_max.store(0, std::memory_order_relaxed);
+}
+
+} // namespace win32
@@ -0,0 +1,84 @@
+//
+// Win32 utilities library
+// Lock-free latency histograms.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Values below 2 * SubBuckets are counted exactly. Above that every power-of-two
+// range is split into SubBuckets linear buckets, which bounds the relative error of
+// recorded values to 1 / SubBuckets.
+constexpr unsigned int HistogramSubBucketBits = 5;
+constexpr std::size_t HistogramSubBuckets = std::size_t(1) << HistogramSubBucketBits;
+// Larger values are clamped.
+constexpr unsigned int HistogramMaxValueBits = 40;
+constexpr std::uint64_t HistogramMaxValue =
+   (std::uint64_t(1) << HistogramMaxValueBits) - 1;
+constexpr std::size_t HistogramNumBuckets =
+   HistogramSubBuckets * (HistogramMaxValueBits - HistogramSubBucketBits + 1);
+
+WIN32UTIL_API std::size_t histogramBucket(std::uint64_t value);
+WIN32UTIL_API std::uint64_t histogramBucketLowerBound(std::size_t bucket);
+WIN32UTIL_API std::uint64_t histogramBucketUpperBound(std::size_t bucket);
+
+
+// Copy of a histogram's counts.
+struct WIN32UTIL_API HistogramSnapshot
+{
+   std::uint64_t count = 0;
+   std::uint64_t sum = 0;
+   std::uint64_t min = 0;
+   std::uint64_t max = 0;
+   // Counts per bucket. Empty if nothing was recorded.
+   std::vector<std::uint64_t> buckets;
+
+   double mean() const;
+   // Returns a value that at least the given percentage of recorded values do not
+   // exceed, within the bucket precision.
+   std::uint64_t percentile(double percent) const;
+   HistogramSnapshot& operator+=(const HistogramSnapshot& other);
+   // One line per non-empty bucket: lower bound, upper bound, count.
+   std::string toCsv() const;
+};
+
+
+///////////////////
+
+// Histogram of non-negative values, usually latencies in microseconds, whose
+// recording is lock-free and never allocates.
+// Thread-safe. Snapshots taken during recording can be off by the values that are
+// recorded concurrently.
+class WIN32UTIL_API LatencyHistogram
+{
+ public:
+   LatencyHistogram();
+   LatencyHistogram(const LatencyHistogram&) = delete;
+   LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+   void record(std::uint64_t value);
+   HistogramSnapshot snapshot() const;
+   void reset();
+
+ private:
+   std::array<std::atomic<std::uint64_t>, HistogramNumBuckets> m_buckets;
+   std::atomic<std::uint64_t> m_count = 0;
+   std::atomic<std::uint64_t> m_sum = 0;
+   std::atomic<std::uint64_t> m_min;
+   std::atomic<std::uint64_t> m_max = 0;
+};
+
+} // namespace win32
@@ -0,0 +1,230 @@
+//
+// Win32 utilities library
+// Memory-mapped files.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "mapped_file.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Granularity that file offsets of mappings have to be aligned to.
+std::size_t mappingGranularity()
+{
+#ifdef _WIN32
+   static const std::size_t granularity = []() {
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return static_cast<std::size_t>(info.dwAllocationGranularity);
+   }();
+#else
+   static const auto granularity = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+   return granularity;
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+MappedView::MappedView(void* base, std::size_t mappedSize, std::size_t dataOffset,
+                       std::size_t size, std::uint64_t fileOffset, bool isWritable)
+: m_base{base}, m_mappedSize{mappedSize},
+  m_data{static_cast<std::byte*>(base) + dataOffset}, m_size{size}, m_offset{fileOffset},
+  m_isWritable{isWritable}
+{
+}
+
+
+bool MappedView::advise(AccessHint hint) const
+{
+   if (!m_base)
+      return false;
+
+#ifdef _WIN32
+   // Windows only supports access patterns as flags when opening files.
+   if (hint == AccessHint::WillNeed)
+      return prefetch();
+   return true;
+#else
+   int advice = MADV_NORMAL;
+   switch (hint)
+   {
+   case AccessHint::Normal:
+      advice = MADV_NORMAL;
+      break;
+   case AccessHint::Sequential:
+      advice = MADV_SEQUENTIAL;
+      break;
+   case AccessHint::Random:
+      advice = MADV_RANDOM;
+      break;
+   case AccessHint::WillNeed:
+      advice = MADV_WILLNEED;
+      break;
+   }
+   return madvise(m_base, m_mappedSize, advice) == 0;
+#endif
+}
+
+
+bool MappedView::prefetch() const
+{
+   if (!m_base)
+      return false;
+
+#ifdef _WIN32
+   WIN32_MEMORY_RANGE_ENTRY range;
+   range.VirtualAddress = m_base;
+   range.NumberOfBytes = m_mappedSize;
+   return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != FALSE;
+#else
+   return madvise(m_base, m_mappedSize, MADV_WILLNEED) == 0;
+#endif
+}
+
+
+void MappedView::unmap()
+{
+   if (m_base)
+   {
+#ifdef _WIN32
+      UnmapViewOfFile(m_base);
+#else
+      munmap(m_base, m_mappedSize);
+#endif
+   }
+
+   m_base = nullptr;
+   m_mappedSize = 0;
+   m_data = nullptr;
+   m_size = 0;
+   m_offset = 0;
+   m_isWritable = false;
+}
+
+
+///////////////////
+
+bool MappedFile::open(const std::filesystem::path& path, MapMode mode)
+{
+   close();
+
+#ifdef _WIN32
+   m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+   if (m_file == INVALID_HANDLE_VALUE)
+      return false;
+
+   LARGE_INTEGER fileSize;
+   if (!GetFileSizeEx(m_file, &fileSize))
+   {
+      close();
+      return false;
+   }
+   m_size = static_cast<std::uint64_t>(fileSize.QuadPart);
+
+   if (m_size > 0)
+   {
+      const DWORD protection =
+         (mode == MapMode::CopyOnWrite) ? PAGE_WRITECOPY : PAGE_READONLY;
+      m_mapping = CreateFileMappingW(m_file, NULL, protection, 0, 0, NULL);
+      if (m_mapping == NULL)
+      {
+         close();
+         return false;
+      }
+   }
+#else
+   m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if (m_fd == -1)
+      return false;
+
+   struct stat fileInfo;
+   if (fstat(m_fd, &fileInfo) != 0)
+   {
+      close();
+      return false;
+   }
+   m_size = static_cast<std::uint64_t>(fileInfo.st_size);
+#endif
+
+   m_mode = mode;
+   return true;
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+   if (m_mapping != NULL)
+      CloseHandle(m_mapping);
+   if (m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_file);
+   m_mapping = NULL;
+   m_file = INVALID_HANDLE_VALUE;
+#else
+   if (m_fd != -1)
+      ::close(m_fd);
+   m_fd = -1;
+#endif
+   m_size = 0;
+   m_mode = MapMode::ReadOnly;
+}
+
+
+MappedView MappedFile::map(std::uint64_t offset, std::size_t numBytes) const
+{
+   if (!*this || offset >= m_size)
+      return {};
+
+   const std::uint64_t available = m_size - offset;
+   if (numBytes == ToEnd && available > std::numeric_limits<std::size_t>::max())
+      return {};
+   if (numBytes > available)
+      numBytes = static_cast<std::size_t>(available);
+   if (numBytes == 0)
+      return {};
+
+   // Map from an aligned offset and point the view's data to the requested start.
+   const std::uint64_t alignedOffset = offset - offset % mappingGranularity();
+   const auto dataOffset = static_cast<std::size_t>(offset - alignedOffset);
+   if (numBytes > std::numeric_limits<std::size_t>::max() - dataOffset)
+      return {};
+   const std::size_t mappedSize = dataOffset + numBytes;
+   const bool isWritable = (m_mode == MapMode::CopyOnWrite);
+
+#ifdef _WIN32
+   void* base = MapViewOfFile(
+      m_mapping, isWritable ? FILE_MAP_COPY : FILE_MAP_READ,
+      static_cast<DWORD>(alignedOffset >> 32),
+      static_cast<DWORD>(alignedOffset & 0xFFFFFFFF), mappedSize);
+   if (!base)
+      return {};
+#else
+   const int protection = isWritable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+   void* base = mmap(nullptr, mappedSize, protection, MAP_PRIVATE, m_fd,
+                     static_cast<off_t>(alignedOffset));
+   if (base == MAP_FAILED)
+      return {};
+#endif
+
+   return MappedView{base, mappedSize, dataOffset, numBytes, offset, isWritable};
+}
+
+} // namespace win32
@@ -0,0 +1,249 @@
+//
+// Win32 utilities library
+// Memory-mapped files.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+enum class MapMode
+{
+   ReadOnly,
+   // Pages can be written to but changes are private to the view and never reach
+   // the file.
+   CopyOnWrite
+};
+
+
+// Expected access pattern of mapped memory.
+enum class AccessHint
+{
+   Normal,
+   Sequential,
+   Random,
+   // Memory will be accessed soon and should be read ahead.
+   WillNeed
+};
+
+
+///////////////////
+
+// RAII class for a mapped range of a file.
+class WIN32UTIL_API MappedView
+{
+ public:
+   MappedView() = default;
+   ~MappedView();
+   MappedView(const MappedView&) = delete;
+   MappedView(MappedView&& other) noexcept;
+   MappedView& operator=(const MappedView&) = delete;
+   MappedView& operator=(MappedView&& other) noexcept;
+
+   explicit operator bool() const;
+   friend void swap(MappedView& a, MappedView& b) noexcept;
+
+   const std::byte* data() const;
+   std::size_t size() const;
+   // Position of the view in the file.
+   std::uint64_t offset() const;
+   bool isWritable() const;
+   std::span<const std::byte> span() const;
+   // Empty for read-only views.
+   std::span<std::byte> writableSpan();
+
+   // Hints are advisory. Hints that a platform does not support are ignored.
+   bool advise(AccessHint hint) const;
+   // Reads the view's pages into memory ahead of their use.
+   bool prefetch() const;
+   void unmap();
+
+ private:
+   friend class MappedFile;
+   MappedView(void* base, std::size_t mappedSize, std::size_t dataOffset,
+              std::size_t size, std::uint64_t fileOffset, bool isWritable);
+
+ private:
+   // Start of the mapping. Aligned to the system's mapping granularity.
+   void* m_base = nullptr;
+   std::size_t m_mappedSize = 0;
+   std::byte* m_data = nullptr;
+   std::size_t m_size = 0;
+   std::uint64_t m_offset = 0;
+   bool m_isWritable = false;
+};
+
+
+inline MappedView::~MappedView()
+{
+   unmap();
+}
+
+inline MappedView::MappedView(MappedView&& other) noexcept
+{
+   swap(*this, other);
+}
+
+inline MappedView& MappedView::operator=(MappedView&& other) noexcept
+{
+   unmap();
+   swap(*this, other);
+   return *this;
+}
+
+inline MappedView::operator bool() const
+{
+   return m_base != nullptr;
+}
+
+inline void swap(MappedView& a, MappedView& b) noexcept
+{
+   std::swap(a.m_base, b.m_base);
+   std::swap(a.m_mappedSize, b.m_mappedSize);
+   std::swap(a.m_data, b.m_data);
+   std::swap(a.m_size, b.m_size);
+   std::swap(a.m_offset, b.m_offset);
+   std::swap(a.m_isWritable, b.m_isWritable);
+}
+
+inline const std::byte* MappedView::data() const
+{
+   return m_data;
+}
+
+inline std::size_t MappedView::size() const
+{
+   return m_size;
+}
+
+inline std::uint64_t MappedView::offset() const
+{
+   return m_offset;
+}
+
+inline bool MappedView::isWritable() const
+{
+   return m_isWritable;
+}
+
+inline std::span<const std::byte> MappedView::span() const
+{
+   return {m_data, m_size};
+}
+
+inline std::span<std::byte> MappedView::writableSpan()
+{
+   if (!m_isWritable)
+      return {};
+   return {m_data, m_size};
+}
+
+
+///////////////////
+
+// RAII class for a file that is opened for mapping.
+// Views can cover any range of the file, so files that are larger than the address
+// space can be processed in windows. Views stay valid after the file is closed.
+class WIN32UTIL_API MappedFile
+{
+ public:
+   // Maps the range from the offset to the end of the file.
+   static constexpr std::size_t ToEnd = std::numeric_limits<std::size_t>::max();
+
+ public:
+   MappedFile() = default;
+   ~MappedFile();
+   MappedFile(const MappedFile&) = delete;
+   MappedFile(MappedFile&& other) noexcept;
+   MappedFile& operator=(const MappedFile&) = delete;
+   MappedFile& operator=(MappedFile&& other) noexcept;
+
+   explicit operator bool() const;
+   friend void swap(MappedFile& a, MappedFile& b) noexcept;
+
+   std::uint64_t size() const;
+   MapMode mode() const;
+
+   bool open(const std::filesystem::path& path, MapMode mode = MapMode::ReadOnly);
+   void close();
+   // Maps a range of the file. The range is clipped to the file size. Returns an
+   // invalid view if the range is empty or cannot be mapped.
+   MappedView map(std::uint64_t offset = 0, std::size_t numBytes = ToEnd) const;
+
+ private:
+#ifdef _WIN32
+   HANDLE m_file = INVALID_HANDLE_VALUE;
+   // Null for empty files because they cannot be mapped.
+   HANDLE m_mapping = NULL;
+#else
+   int m_fd = -1;
+#endif
+   std::uint64_t m_size = 0;
+   MapMode m_mode = MapMode::ReadOnly;
+};
+
+
+inline MappedFile::~MappedFile()
+{
+   close();
+}
+
+inline MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+   swap(*this, other);
+}
+
+inline MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+   close();
+   swap(*this, other);
+   return *this;
+}
+
+inline MappedFile::operator bool() const
+{
+#ifdef _WIN32
+   return m_file != INVALID_HANDLE_VALUE;
+#else
+   return m_fd != -1;
+#endif
+}
+
+inline void swap(MappedFile& a, MappedFile& b) noexcept
+{
+#ifdef _WIN32
+   std::swap(a.m_file, b.m_file);
+   std::swap(a.m_mapping, b.m_mapping);
+#else
+   std::swap(a.m_fd, b.m_fd);
+#endif
+   std::swap(a.m_size, b.m_size);
+   std::swap(a.m_mode, b.m_mode);
+}
+
+inline std::uint64_t MappedFile::size() const
+{
+   return m_size;
+}
+
+inline MapMode MappedFile::mode() const
+{
+   return m_mode;
+}
+
+} // namespace win32
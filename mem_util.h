@@ -8,7 +8,13 @@
 #pragma once
 #ifdef _WIN32
 #include <objbase.h>
+#endif
 #include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <span>
+#include <type_traits>
 
 
 namespace win32
@@ -29,8 +35,7 @@ public:
    Mem& operator=(Mem&& other) noexcept;
 
    explicit operator bool() const;
-   template <typename T, typename Derived>
-   friend void swap(Mem<T, Derived>& a, Mem<T, Derived>& b) noexcept;
+   template <typename U, typename D> friend void swap(Mem<U, D>& a, Mem<U, D>& b) noexcept;
 
    T* ptr();
    const T* ptr() const;
@@ -101,6 +106,335 @@ template <typename T, typename Derived> Derived& Mem<T, Derived>::derived(Mem& b
 }
 
 
+///////////////////
+
+// Growth policy for array memory.
+// Grows the capacity geometrically to amortize the cost of reallocations over many
+// resize operations.
+struct GeometricGrowth
+{
+   static constexpr std::size_t MinCapacity = 8;
+
+   static std::size_t nextCapacity(std::size_t capacity, std::size_t required);
+};
+
+
+inline std::size_t GeometricGrowth::nextCapacity(std::size_t capacity,
+                                                 std::size_t required)
+{
+   const std::size_t grown = capacity + capacity / 2;
+   return std::max({grown, required, MinCapacity});
+}
+
+
+///////////////////
+
+// Base class for memory RAII classes that manage arrays.
+// Tracks the number of elements and the allocated capacity and grows the memory
+// through the reallocation functions of the derived class. Derived classes have to
+// provide:
+//  - bool reallocInPlace(std::size_t numBytes)
+//    Resizes the memory without moving it. Returns false if not possible.
+//  - T* reallocMem(std::size_t numBytes)
+//    Allocates or resizes the memory, moving it if necessary. Returns null on failure
+//    and leaves the existing memory untouched.
+// Since the memory gets moved bytewise, the element type has to be trivially copyable.
+template <typename T, typename Derived> class Mem<T[], Derived>
+{
+   static_assert(std::is_trivially_copyable_v<T>,
+                 "Array memory is reallocated bytewise and requires trivial types.");
+
+ public:
+   using Growth_t = GeometricGrowth;
+
+ public:
+   Mem() = default;
+   Mem(T* ptr, std::size_t size);
+   ~Mem();
+   Mem(const Mem&) = delete;
+   Mem(Mem&& other) noexcept;
+   Mem& operator=(const Mem&) = delete;
+   Mem& operator=(Mem&& other) noexcept;
+
+   explicit operator bool() const;
+   template <typename U, typename D>
+   friend void swap(Mem<U[], D>& a, Mem<U[], D>& b) noexcept;
+
+   T* ptr();
+   const T* ptr() const;
+   // Number of elements in use.
+   std::size_t size() const;
+   // Number of elements that fit into the allocated memory.
+   std::size_t capacity() const;
+   bool empty() const;
+   std::span<T> span();
+   std::span<const T> span() const;
+   T& operator[](std::size_t idx);
+   const T& operator[](std::size_t idx) const;
+
+   // Changes the number of elements. Grows the capacity geometrically if necessary.
+   // Added elements are not initialized. On failure the memory remains unchanged.
+   bool resize(std::size_t size);
+   // Makes sure the capacity is at least the given number of elements.
+   bool reserve(std::size_t capacity);
+   // Releases unused capacity.
+   bool shrinkToFit();
+
+ private:
+   // Access derived class that provides custom funtionality.
+   static Derived& derived(Mem& base);
+   bool setCapacity(std::size_t capacity);
+
+ protected:
+   T* m_ptr = nullptr;
+   std::size_t m_size = 0;
+   std::size_t m_capacity = 0;
+};
+
+
+template <typename T, typename Derived>
+Mem<T[], Derived>::Mem(T* ptr, std::size_t size)
+: m_ptr{ptr}, m_size{ptr ? size : 0}, m_capacity{ptr ? size : 0}
+{
+}
+
+template <typename T, typename Derived> Mem<T[], Derived>::~Mem()
+{
+   derived(*this).free();
+}
+
+template <typename T, typename Derived> Mem<T[], Derived>::Mem(Mem&& other) noexcept
+{
+   swap(*this, other);
+}
+
+template <typename T, typename Derived>
+Mem<T[], Derived>& Mem<T[], Derived>::operator=(Mem&& other) noexcept
+{
+   derived(*this).free();
+   m_ptr = other.m_ptr;
+   m_size = other.m_size;
+   m_capacity = other.m_capacity;
+   derived(other).clear();
+   return *this;
+}
+
+template <typename T, typename Derived> Mem<T[], Derived>::operator bool() const
+{
+   return (m_ptr != nullptr);
+}
+
+template <typename T, typename Derived>
+void swap(Mem<T[], Derived>& a, Mem<T[], Derived>& b) noexcept
+{
+   std::swap(a.m_ptr, b.m_ptr);
+   std::swap(a.m_size, b.m_size);
+   std::swap(a.m_capacity, b.m_capacity);
+}
+
+template <typename T, typename Derived> T* Mem<T[], Derived>::ptr()
+{
+   return m_ptr;
+}
+
+template <typename T, typename Derived> const T* Mem<T[], Derived>::ptr() const
+{
+   return m_ptr;
+}
+
+template <typename T, typename Derived> std::size_t Mem<T[], Derived>::size() const
+{
+   return m_size;
+}
+
+template <typename T, typename Derived> std::size_t Mem<T[], Derived>::capacity() const
+{
+   return m_capacity;
+}
+
+template <typename T, typename Derived> bool Mem<T[], Derived>::empty() const
+{
+   return (m_size == 0);
+}
+
+template <typename T, typename Derived> std::span<T> Mem<T[], Derived>::span()
+{
+   return {m_ptr, m_size};
+}
+
+template <typename T, typename Derived>
+std::span<const T> Mem<T[], Derived>::span() const
+{
+   return {m_ptr, m_size};
+}
+
+template <typename T, typename Derived>
+T& Mem<T[], Derived>::operator[](std::size_t idx)
+{
+   return m_ptr[idx];
+}
+
+template <typename T, typename Derived>
+const T& Mem<T[], Derived>::operator[](std::size_t idx) const
+{
+   return m_ptr[idx];
+}
+
+template <typename T, typename Derived> bool Mem<T[], Derived>::resize(std::size_t size)
+{
+   if (size > m_capacity && !setCapacity(Growth_t::nextCapacity(m_capacity, size)))
+   {
+      // Fall back to the exact size in case the geometric growth was too greedy.
+      if (!setCapacity(size))
+         return false;
+   }
+   m_size = size;
+   return true;
+}
+
+template <typename T, typename Derived>
+bool Mem<T[], Derived>::reserve(std::size_t capacity)
+{
+   if (capacity <= m_capacity)
+      return true;
+   return setCapacity(capacity);
+}
+
+template <typename T, typename Derived> bool Mem<T[], Derived>::shrinkToFit()
+{
+   if (m_size == m_capacity)
+      return true;
+   if (m_size == 0)
+   {
+      derived(*this).free();
+      return true;
+   }
+   return setCapacity(m_size);
+}
+
+template <typename T, typename Derived>
+Derived& Mem<T[], Derived>::derived(Mem& base)
+{
+   return static_cast<Derived&>(base);
+}
+
+template <typename T, typename Derived>
+bool Mem<T[], Derived>::setCapacity(std::size_t capacity)
+{
+   if (capacity > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      return false;
+
+   const std::size_t numBytes = capacity * sizeof(T);
+   // Growing in place avoids copying the existing elements.
+   if (m_ptr && derived(*this).reallocInPlace(numBytes))
+   {
+      m_capacity = capacity;
+      return true;
+   }
+
+   T* reallocated = derived(*this).reallocMem(numBytes);
+   if (!reallocated)
+      return false;
+
+   m_ptr = reallocated;
+   m_capacity = capacity;
+   return true;
+}
+
+
+///////////////////
+
+// RAII class for memory allocated by malloc or realloc.
+// Portable backend that is not bound to a Win32 allocator.
+template <typename T> class CrtMem : public Mem<T, CrtMem<T>>
+{
+ public:
+   using Base_t = Mem<T, CrtMem<T>>;
+   // Inherit ctors.
+   using Base_t::Base_t;
+
+   template <typename U> friend void swap(CrtMem<U>& a, CrtMem<U>& b) noexcept;
+   void clear();
+   void free();
+};
+
+
+template <typename T> void swap(CrtMem<T>& a, CrtMem<T>& b) noexcept
+{
+   using Base_t = Mem<T, CrtMem<T>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+}
+
+template <typename T> void CrtMem<T>::clear()
+{
+   this->m_ptr = nullptr;
+}
+
+template <typename T> void CrtMem<T>::free()
+{
+   if (this->m_ptr)
+   {
+      std::free(this->m_ptr);
+      clear();
+   }
+}
+
+
+// RAII class for arrays allocated by malloc or realloc.
+template <typename T> class CrtMem<T[]> : public Mem<T[], CrtMem<T[]>>
+{
+   friend class Mem<T[], CrtMem<T[]>>;
+
+ public:
+   using Base_t = Mem<T[], CrtMem<T[]>>;
+   // Inherit ctors.
+   using Base_t::Base_t;
+
+   template <typename U> friend void swap(CrtMem<U[]>& a, CrtMem<U[]>& b) noexcept;
+   void clear();
+   void free();
+
+ private:
+   bool reallocInPlace(std::size_t numBytes);
+   T* reallocMem(std::size_t numBytes);
+};
+
+
+template <typename T> void swap(CrtMem<T[]>& a, CrtMem<T[]>& b) noexcept
+{
+   using Base_t = Mem<T[], CrtMem<T[]>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+}
+
+template <typename T> void CrtMem<T[]>::clear()
+{
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+}
+
+template <typename T> void CrtMem<T[]>::free()
+{
+   if (this->m_ptr)
+      std::free(this->m_ptr);
+   clear();
+}
+
+template <typename T> bool CrtMem<T[]>::reallocInPlace(std::size_t /*numBytes*/)
+{
+   // The CRT has no in-place reallocation. realloc will try to grow in place anyway.
+   return false;
+}
+
+template <typename T> T* CrtMem<T[]>::reallocMem(std::size_t numBytes)
+{
+   return static_cast<T*>(std::realloc(this->m_ptr, numBytes));
+}
+
+
+#ifdef _WIN32
+
+
 ///////////////////
 
 // RAII class for memory allocated by CoTaskMemAlloc or CoTaskMemRealloc.
@@ -138,6 +472,58 @@ template <typename T> void CoTaskMem<T>::free()
 }
 
 
+// RAII class for arrays allocated by CoTaskMemAlloc or CoTaskMemRealloc.
+template <typename T> class CoTaskMem<T[]> : public Mem<T[], CoTaskMem<T[]>>
+{
+   friend class Mem<T[], CoTaskMem<T[]>>;
+
+ public:
+   using Base_t = Mem<T[], CoTaskMem<T[]>>;
+   // Inherit ctors.
+   using Base_t::Base_t;
+
+   template <typename U> friend void swap(CoTaskMem<U[]>& a, CoTaskMem<U[]>& b) noexcept;
+   void clear();
+   void free();
+
+ private:
+   bool reallocInPlace(std::size_t numBytes);
+   T* reallocMem(std::size_t numBytes);
+};
+
+
+template <typename T> void swap(CoTaskMem<T[]>& a, CoTaskMem<T[]>& b) noexcept
+{
+   using Base_t = Mem<T[], CoTaskMem<T[]>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+}
+
+template <typename T> void CoTaskMem<T[]>::clear()
+{
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+}
+
+template <typename T> void CoTaskMem<T[]>::free()
+{
+   if (this->m_ptr)
+      CoTaskMemFree(this->m_ptr);
+   clear();
+}
+
+template <typename T> bool CoTaskMem<T[]>::reallocInPlace(std::size_t /*numBytes*/)
+{
+   // COM's task allocator does not support in-place reallocation.
+   return false;
+}
+
+template <typename T> T* CoTaskMem<T[]>::reallocMem(std::size_t numBytes)
+{
+   return static_cast<T*>(CoTaskMemRealloc(this->m_ptr, numBytes));
+}
+
+
 ///////////////////
 
 // RAII class for memory allocated by GlobalAlloc or GlobalReAlloc.
@@ -175,6 +561,60 @@ template <typename T> void GlobalMem<T>::free()
 }
 
 
+// RAII class for arrays allocated by GlobalAlloc or GlobalReAlloc as fixed memory.
+template <typename T> class GlobalMem<T[]> : public Mem<T[], GlobalMem<T[]>>
+{
+   friend class Mem<T[], GlobalMem<T[]>>;
+
+ public:
+   using Base_t = Mem<T[], GlobalMem<T[]>>;
+   // Inherit ctors.
+   using Base_t::Base_t;
+
+   template <typename U> friend void swap(GlobalMem<U[]>& a, GlobalMem<U[]>& b) noexcept;
+   void clear();
+   void free();
+
+ private:
+   bool reallocInPlace(std::size_t numBytes);
+   T* reallocMem(std::size_t numBytes);
+};
+
+
+template <typename T> void swap(GlobalMem<T[]>& a, GlobalMem<T[]>& b) noexcept
+{
+   using Base_t = Mem<T[], GlobalMem<T[]>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+}
+
+template <typename T> void GlobalMem<T[]>::clear()
+{
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+}
+
+template <typename T> void GlobalMem<T[]>::free()
+{
+   if (this->m_ptr)
+      GlobalFree(this->m_ptr);
+   clear();
+}
+
+template <typename T> bool GlobalMem<T[]>::reallocInPlace(std::size_t numBytes)
+{
+   // Without GMEM_MOVEABLE fixed memory can only be reallocated in place.
+   return (GlobalReAlloc(this->m_ptr, numBytes, 0) != NULL);
+}
+
+template <typename T> T* GlobalMem<T[]>::reallocMem(std::size_t numBytes)
+{
+   if (!this->m_ptr)
+      return static_cast<T*>(GlobalAlloc(GMEM_FIXED, numBytes));
+   return static_cast<T*>(GlobalReAlloc(this->m_ptr, numBytes, GMEM_MOVEABLE));
+}
+
+
 ///////////////////
 
 // RAII class for memory allocated by LocalAlloc or LocalReAlloc.
@@ -212,6 +652,60 @@ template <typename T> void LocalMem<T>::free()
 }
 
 
+// RAII class for arrays allocated by LocalAlloc or LocalReAlloc as fixed memory.
+template <typename T> class LocalMem<T[]> : public Mem<T[], LocalMem<T[]>>
+{
+   friend class Mem<T[], LocalMem<T[]>>;
+
+ public:
+   using Base_t = Mem<T[], LocalMem<T[]>>;
+   // Inherit ctors.
+   using Base_t::Base_t;
+
+   template <typename U> friend void swap(LocalMem<U[]>& a, LocalMem<U[]>& b) noexcept;
+   void clear();
+   void free();
+
+ private:
+   bool reallocInPlace(std::size_t numBytes);
+   T* reallocMem(std::size_t numBytes);
+};
+
+
+template <typename T> void swap(LocalMem<T[]>& a, LocalMem<T[]>& b) noexcept
+{
+   using Base_t = Mem<T[], LocalMem<T[]>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+}
+
+template <typename T> void LocalMem<T[]>::clear()
+{
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+}
+
+template <typename T> void LocalMem<T[]>::free()
+{
+   if (this->m_ptr)
+      LocalFree(this->m_ptr);
+   clear();
+}
+
+template <typename T> bool LocalMem<T[]>::reallocInPlace(std::size_t numBytes)
+{
+   // Without LMEM_MOVEABLE fixed memory can only be reallocated in place.
+   return (LocalReAlloc(this->m_ptr, numBytes, 0) != NULL);
+}
+
+template <typename T> T* LocalMem<T[]>::reallocMem(std::size_t numBytes)
+{
+   if (!this->m_ptr)
+      return static_cast<T*>(LocalAlloc(LMEM_FIXED, numBytes));
+   return static_cast<T*>(LocalReAlloc(this->m_ptr, numBytes, LMEM_MOVEABLE));
+}
+
+
 ///////////////////
 
 // RAII class for memory allocated by HeapAlloc or HeapReAlloc.
@@ -289,6 +783,111 @@ template <typename T> void HeapMem<T>::free()
    }
 }
 
-} // namespace win32
+
+// RAII class for arrays allocated by HeapAlloc or HeapReAlloc.
+template <typename T> class HeapMem<T[]> : public Mem<T[], HeapMem<T[]>>
+{
+   friend class Mem<T[], HeapMem<T[]>>;
+
+ public:
+   using Base_t = Mem<T[], HeapMem<T[]>>;
+
+   HeapMem() = default;
+   HeapMem(T* ptr, std::size_t size);
+   HeapMem(HANDLE heap, DWORD flags, T* ptr = nullptr, std::size_t size = 0);
+   ~HeapMem() = default;
+   HeapMem(const HeapMem&) = delete;
+   HeapMem(HeapMem&& other) noexcept;
+   HeapMem& operator=(const HeapMem&) = delete;
+   HeapMem& operator=(HeapMem&& other) noexcept;
+
+   template <typename U> friend void swap(HeapMem<U[]>& a, HeapMem<U[]>& b) noexcept;
+   void clear();
+   void free();
+
+ private:
+   bool reallocInPlace(std::size_t numBytes);
+   T* reallocMem(std::size_t numBytes);
+
+ private:
+   HANDLE m_heap = NULL;
+   DWORD m_flags = 0;
+};
+
+
+template <typename T>
+HeapMem<T[]>::HeapMem(T* ptr, std::size_t size) : HeapMem{GetProcessHeap(), 0, ptr, size}
+{
+}
+
+template <typename T>
+HeapMem<T[]>::HeapMem(HANDLE heap, DWORD flags, T* ptr, std::size_t size)
+: Base_t{ptr, size}, m_heap{heap}, m_flags{flags}
+{
+}
+
+template <typename T> HeapMem<T[]>::HeapMem(HeapMem&& other) noexcept
+: Base_t{std::move(other)}, m_heap{other.m_heap}, m_flags{other.m_flags}
+{
+   other.clear();
+}
+
+template <typename T> HeapMem<T[]>& HeapMem<T[]>::operator=(HeapMem&& other) noexcept
+{
+   free();
+   this->m_ptr = other.m_ptr;
+   this->m_size = other.m_size;
+   this->m_capacity = other.m_capacity;
+   m_heap = other.m_heap;
+   m_flags = other.m_flags;
+   other.clear();
+   return *this;
+}
+
+template <typename T> void swap(HeapMem<T[]>& a, HeapMem<T[]>& b) noexcept
+{
+   using Base_t = Mem<T[], HeapMem<T[]>>;
+   swap(static_cast<Base_t&>(a), static_cast<Base_t&>(b));
+   std::swap(a.m_heap, b.m_heap);
+   std::swap(a.m_flags, b.m_flags);
+}
+
+template <typename T> void HeapMem<T[]>::clear()
+{
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+   m_heap = NULL;
+   m_flags = 0;
+}
+
+template <typename T> void HeapMem<T[]>::free()
+{
+   if (this->m_ptr)
+      HeapFree(m_heap, m_flags, this->m_ptr);
+   // Keep the heap and flags for later allocations, e.g. after shrinking to zero.
+   this->m_ptr = nullptr;
+   this->m_size = 0;
+   this->m_capacity = 0;
+}
+
+template <typename T> bool HeapMem<T[]>::reallocInPlace(std::size_t numBytes)
+{
+   return (HeapReAlloc(m_heap, m_flags | HEAP_REALLOC_IN_PLACE_ONLY, this->m_ptr,
+                       numBytes) != NULL);
+}
+
+template <typename T> T* HeapMem<T[]>::reallocMem(std::size_t numBytes)
+{
+   if (!this->m_ptr)
+   {
+      if (!m_heap)
+         m_heap = GetProcessHeap();
+      return static_cast<T*>(HeapAlloc(m_heap, m_flags, numBytes));
+   }
+   return static_cast<T*>(HeapReAlloc(m_heap, m_flags, this->m_ptr, numBytes));
+}
 
 #endif //_WIN32
+
+} // namespace win32
@@ -0,0 +1,1000 @@
+//
+// Win32 utilities library
+// Registry backends that keep keys in memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "memory_registry.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#else
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+struct RootKey
+{
+   RegHandle handle = 0;
+   const wchar_t* name = L"";
+};
+
+constexpr RootKey RootKeys[] = {{RegClassesRoot, L"HKEY_CLASSES_ROOT"},
+                                {RegCurrentUser, L"HKEY_CURRENT_USER"},
+                                {RegLocalMachine, L"HKEY_LOCAL_MACHINE"},
+                                {RegUsers, L"HKEY_USERS"},
+                                {RegCurrentConfig, L"HKEY_CURRENT_CONFIG"}};
+
+
+bool isRootKey(RegHandle handle)
+{
+   for (const RootKey& root : RootKeys)
+      if (root.handle == handle)
+         return true;
+   return false;
+}
+
+
+// Splits a path into its names. Empty names are skipped.
+std::vector<std::wstring> splitPath(const std::wstring& path)
+{
+   std::vector<std::wstring> names;
+   std::size_t start = 0;
+   while (start <= path.size())
+   {
+      std::size_t end = path.find(L'\\', start);
+      if (end == std::wstring::npos)
+         end = path.size();
+      if (end > start)
+         names.push_back(path.substr(start, end - start));
+      start = end + 1;
+   }
+   return names;
+}
+
+
+std::wstring appendPath(std::wstring path, const std::wstring& foldedName)
+{
+   path += L'\\';
+   path += foldedName;
+   return path;
+}
+
+
+struct StoredValue
+{
+   // Name as it was first written.
+   std::wstring name;
+   RegValueType type = RegValueType::None;
+   std::vector<std::byte> data;
+};
+
+
+// Finds the entry at the given index of a map by folded name. Continues after the
+// previous name, if there is one.
+template <typename Map>
+typename Map::const_iterator findEnumPosition(const Map& map, std::size_t idx,
+                                             const std::wstring& prevName)
+{
+   if (idx == 0)
+      return map.begin();
+   if (!prevName.empty())
+      return map.upper_bound(foldRegName(prevName));
+   if (idx >= map.size())
+      return map.end();
+   return std::next(map.begin(), static_cast<std::ptrdiff_t>(idx));
+}
+
+
+// Appends the folded names of a key path.
+std::wstring appendKeyPath(std::wstring path, const std::wstring& keyPath)
+{
+   for (const std::wstring& name : splitPath(keyPath))
+      path = appendPath(std::move(path), foldRegName(name));
+   return path;
+}
+
+
+void storeValue(std::map<std::wstring, StoredValue>& values, const std::wstring& name,
+                RegValueType type, const void* data, std::size_t numBytes)
+{
+   auto [pos, isNew] = values.try_emplace(foldRegName(name));
+   StoredValue& value = pos->second;
+   if (isNew)
+      value.name = name;
+   value.type = type;
+   const auto* bytes = static_cast<const std::byte*>(data);
+   value.data.assign(bytes, bytes + numBytes);
+}
+
+
+///////////////////
+
+// Serialization format of hives. All numbers are in native byte order.
+// Header: magic, version, number of roots
+// Root: handle, key
+// Key: number of values, values, number of subkeys, (subkey name, key) pairs
+// Value: name, type, size, data
+// Name: length, wchar_t code units as uint32
+constexpr char HiveMagic[8] = {'W', '3', '2', 'R', 'E', 'G', 'H', 'V'};
+constexpr std::uint32_t HiveVersion = 1;
+// Deepest nesting that the system registry allows.
+constexpr std::size_t MaxKeyDepth = 512;
+
+
+template <typename T> void append(std::vector<std::byte>& out, const T& val)
+{
+   static_assert(std::is_trivially_copyable_v<T>);
+   const auto* bytes = reinterpret_cast<const std::byte*>(&val);
+   out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+
+void appendName(std::vector<std::byte>& out, const std::wstring& name)
+{
+   append(out, static_cast<std::uint32_t>(name.size()));
+   for (wchar_t ch : name)
+      append(out, static_cast<std::uint32_t>(ch));
+}
+
+
+class HiveReader
+{
+ public:
+   explicit HiveReader(const std::vector<std::byte>& data) : m_data{data} {}
+
+   std::size_t remaining() const { return m_data.size() - m_pos; }
+   template <typename T> bool read(T& val);
+   bool readBytes(std::vector<std::byte>& bytes, std::size_t numBytes);
+   bool readName(std::wstring& name);
+
+ private:
+   const std::vector<std::byte>& m_data;
+   std::size_t m_pos = 0;
+};
+
+
+template <typename T> bool HiveReader::read(T& val)
+{
+   static_assert(std::is_trivially_copyable_v<T>);
+   if (remaining() < sizeof(T))
+      return false;
+   std::memcpy(&val, m_data.data() + m_pos, sizeof(T));
+   m_pos += sizeof(T);
+   return true;
+}
+
+
+bool HiveReader::readBytes(std::vector<std::byte>& bytes, std::size_t numBytes)
+{
+   if (remaining() < numBytes)
+      return false;
+   const auto first = m_data.begin() + static_cast<std::ptrdiff_t>(m_pos);
+   bytes.assign(first, first + static_cast<std::ptrdiff_t>(numBytes));
+   m_pos += numBytes;
+   return true;
+}
+
+
+bool HiveReader::readName(std::wstring& name)
+{
+   std::uint32_t len = 0;
+   if (!read(len) || remaining() / sizeof(std::uint32_t) < len)
+      return false;
+
+   name.resize(len);
+   for (wchar_t& ch : name)
+   {
+      std::uint32_t unit = 0;
+      read(unit);
+      ch = static_cast<wchar_t>(unit);
+   }
+   return true;
+}
+
+
+///////////////////
+
+bool readFile(const std::filesystem::path& path, std::vector<std::byte>& data)
+{
+   std::ifstream in{path, std::ios::binary | std::ios::ate};
+   if (!in)
+      return false;
+
+   const std::streamoff size = in.tellg();
+   if (size < 0)
+      return false;
+   data.resize(static_cast<std::size_t>(size));
+   in.seekg(0);
+   in.read(reinterpret_cast<char*>(data.data()), size);
+   return static_cast<bool>(in);
+}
+
+
+// Writes the file and flushes it to disk, so that a later rename never exposes a
+// file whose data has not reached the disk.
+bool writeFile(const std::filesystem::path& path, const std::vector<std::byte>& data)
+{
+#ifdef _WIN32
+   HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+   bool ok = true;
+   std::size_t offset = 0;
+   while (ok && offset < data.size())
+   {
+      const DWORD chunkSize =
+         static_cast<DWORD>(std::min<std::size_t>(data.size() - offset, 1 << 30));
+      DWORD numWritten = 0;
+      ok = WriteFile(file, data.data() + offset, chunkSize, &numWritten, nullptr) !=
+              FALSE &&
+           numWritten > 0;
+      offset += numWritten;
+   }
+   ok = ok && FlushFileBuffers(file) != FALSE;
+   CloseHandle(file);
+   return ok;
+#else
+   const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0)
+      return false;
+
+   bool ok = true;
+   std::size_t offset = 0;
+   while (ok && offset < data.size())
+   {
+      const ssize_t numWritten = ::write(fd, data.data() + offset, data.size() - offset);
+      if (numWritten < 0 && errno == EINTR)
+         continue;
+      ok = numWritten > 0;
+      if (ok)
+         offset += static_cast<std::size_t>(numWritten);
+   }
+   ok = ok && ::fsync(fd) == 0;
+   ok = (::close(fd) == 0) && ok;
+   return ok;
+#endif
+}
+
+
+// Renames the file over the destination. Returns once the rename is on disk.
+bool replaceFile(const std::filesystem::path& from, const std::filesystem::path& to)
+{
+#ifdef _WIN32
+   return MoveFileExW(from.c_str(), to.c_str(),
+                      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+   if (std::rename(from.c_str(), to.c_str()) != 0)
+      return false;
+
+   // The rename is only durable once the directory is flushed.
+   const std::filesystem::path dir = to.has_parent_path() ? to.parent_path() : ".";
+   const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (fd < 0)
+      return false;
+   const bool ok = ::fsync(fd) == 0;
+   ::close(fd);
+   return ok;
+#endif
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+struct MemoryRegBackend::Key
+{
+   explicit Key(std::wstring foldedPath) : path{std::move(foldedPath)} {}
+
+   // Folded path from the root.
+   std::wstring path;
+   // Names by their folded version.
+   std::map<std::wstring, std::wstring> subkeys;
+   std::map<std::wstring, StoredValue> values;
+   std::map<WatchId, std::shared_ptr<const ChangeCallback_t>> watchers;
+   bool isRemoved = false;
+};
+
+
+///////////////////
+
+MemoryRegBackend::MemoryRegBackend()
+{
+   addRoots(m_keys);
+   for (const RootKey& root : RootKeys)
+      m_handles[root.handle] = {m_keys[foldRegName(root.name)], RegAccessAll};
+}
+
+
+MemoryRegBackend::~MemoryRegBackend() = default;
+
+
+RegHandle MemoryRegBackend::createKey(RegHandle parent, const std::wstring& keyPath,
+                                      RegAccess accessRights, bool* created)
+{
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   auto parentPos = m_handles.find(parent);
+   if (parentPos == m_handles.end() || parentPos->second.key->isRemoved)
+      return 0;
+
+   const OpenKey& parentKey = parentPos->second;
+   const bool canCreate = (parentKey.accessRights & RegAccessCreateSubkey) != 0;
+   bool isNew = false;
+   std::shared_ptr<Key> key =
+      createPath(parentKey.key, keyPath, canCreate, &isNew, notifications);
+   if (!key)
+      return 0;
+
+   const RegHandle handle = m_nextHandle++;
+   m_handles[handle] = {std::move(key), accessRights};
+   if (created)
+      *created = isNew;
+
+   lock.unlock();
+   notify(notifications);
+   return handle;
+}
+
+
+RegHandle MemoryRegBackend::openKey(RegHandle parent, const std::wstring& keyPath,
+                                    RegAccess accessRights)
+{
+   std::unique_lock lock{m_guard};
+
+   auto parentPos = m_handles.find(parent);
+   if (parentPos == m_handles.end() || parentPos->second.key->isRemoved)
+      return 0;
+
+   auto pos = m_keys.find(appendKeyPath(parentPos->second.key->path, keyPath));
+   if (pos == m_keys.end())
+      return 0;
+
+   const RegHandle handle = m_nextHandle++;
+   m_handles[handle] = {pos->second, accessRights};
+   return handle;
+}
+
+
+void MemoryRegBackend::closeKey(RegHandle key)
+{
+   if (isRootKey(key))
+      return;
+
+   std::unique_lock lock{m_guard};
+   m_handles.erase(key);
+}
+
+
+bool MemoryRegBackend::removeKey(RegHandle parent, const std::wstring& keyPath)
+{
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   Key* parentKey = lookup(parent, 0);
+   if (!parentKey)
+      return false;
+
+   const std::vector<std::wstring> names = splitPath(keyPath);
+   if (names.empty())
+   {
+      // Remove only the contents.
+      for (const auto& [foldedName, name] : parentKey->subkeys)
+      {
+         removeSubtree(*m_keys.at(appendPath(parentKey->path, foldedName)),
+                       notifications);
+      }
+      parentKey->subkeys.clear();
+      parentKey->values.clear();
+      changed(*parentKey, notifications);
+
+      lock.unlock();
+      notify(notifications);
+      return true;
+   }
+
+   std::wstring path = parentKey->path;
+   for (const std::wstring& name : names)
+      path = appendPath(std::move(path), foldRegName(name));
+   auto pos = m_keys.find(path);
+   if (pos == m_keys.end())
+      return false;
+
+   const std::size_t sepPos = path.rfind(L'\\');
+   Key& owner = *m_keys.at(path.substr(0, sepPos));
+   owner.subkeys.erase(path.substr(sepPos + 1));
+   changed(owner, notifications);
+   removeSubtree(*pos->second, notifications);
+
+   lock.unlock();
+   notify(notifications);
+   return true;
+}
+
+
+bool MemoryRegBackend::queryValue(RegHandle key, const std::wstring& valueName,
+                                  RegValueType* type, void* data, std::size_t* numBytes)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessQueryValue);
+   if (!k)
+      return false;
+   auto pos = k->values.find(foldRegName(valueName));
+   if (pos == k->values.end())
+      return false;
+
+   const StoredValue& value = pos->second;
+   if (type)
+      *type = value.type;
+   if (!numBytes)
+      return !data;
+
+   const std::size_t bufferSize = *numBytes;
+   *numBytes = value.data.size();
+   if (!data)
+      return true;
+   if (bufferSize < value.data.size())
+      return false;
+   if (!value.data.empty())
+      std::memcpy(data, value.data.data(), value.data.size());
+   return true;
+}
+
+
+bool MemoryRegBackend::setValue(RegHandle key, const std::wstring& valueName,
+                                RegValueType type, const void* data, std::size_t numBytes)
+{
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   Key* k = lookup(key, RegAccessSetValue);
+   if (!k || (!data && numBytes > 0))
+      return false;
+
+   storeValue(k->values, valueName, type, data, numBytes);
+   changed(*k, notifications);
+
+   lock.unlock();
+   notify(notifications);
+   return true;
+}
+
+
+bool MemoryRegBackend::removeValue(RegHandle key, const std::wstring& valueName)
+{
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   Key* k = lookup(key, RegAccessSetValue);
+   if (!k || k->values.erase(foldRegName(valueName)) == 0)
+      return false;
+   changed(*k, notifications);
+
+   lock.unlock();
+   notify(notifications);
+   return true;
+}
+
+
+std::optional<RegKeyInfo> MemoryRegBackend::queryKeyInfo(RegHandle key)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessQueryValue);
+   if (!k)
+      return {};
+
+   RegKeyInfo info;
+   info.numSubkeys = k->subkeys.size();
+   for (const auto& [foldedName, name] : k->subkeys)
+      info.maxSubkeyNameLength = std::max(info.maxSubkeyNameLength, name.size());
+   info.numValues = k->values.size();
+   for (const auto& [foldedName, value] : k->values)
+      info.maxValueNameLength = std::max(info.maxValueNameLength, value.name.size());
+   return info;
+}
+
+
+std::optional<std::vector<std::wstring>> MemoryRegBackend::subkeyNames(RegHandle key)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessEnumerateSubkeys);
+   if (!k)
+      return {};
+
+   std::vector<std::wstring> names;
+   names.reserve(k->subkeys.size());
+   for (const auto& [foldedName, name] : k->subkeys)
+      names.push_back(name);
+   return names;
+}
+
+
+std::optional<std::vector<std::wstring>> MemoryRegBackend::valueNames(RegHandle key)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessQueryValue);
+   if (!k)
+      return {};
+
+   std::vector<std::wstring> names;
+   names.reserve(k->values.size());
+   for (const auto& [foldedName, value] : k->values)
+      names.push_back(value.name);
+   return names;
+}
+
+
+RegEnumResult MemoryRegBackend::enumSubkey(RegHandle key, std::size_t idx,
+                                           std::wstring& name)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessEnumerateSubkeys);
+   if (!k)
+      return RegEnumResult::Failed;
+
+   auto pos = findEnumPosition(k->subkeys, idx, name);
+   if (pos == k->subkeys.end())
+      return RegEnumResult::End;
+   name.assign(pos->second);
+   return RegEnumResult::Read;
+}
+
+
+RegEnumResult MemoryRegBackend::enumValue(RegHandle key, std::size_t idx,
+                                          std::wstring& name, RegValueType* type,
+                                          std::size_t* numBytes)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessQueryValue);
+   if (!k)
+      return RegEnumResult::Failed;
+
+   auto pos = findEnumPosition(k->values, idx, name);
+   if (pos == k->values.end())
+      return RegEnumResult::End;
+   const StoredValue& value = pos->second;
+   name.assign(value.name);
+   if (type)
+      *type = value.type;
+   if (numBytes)
+      *numBytes = value.data.size();
+   return RegEnumResult::Read;
+}
+
+
+bool MemoryRegBackend::applyWrites(const std::vector<RegKeyWrites>& writes)
+{
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   // Check all keys before anything is changed.
+   for (const RegKeyWrites& keyWrites : writes)
+   {
+      auto parentPos = m_handles.find(keyWrites.parent);
+      if (parentPos == m_handles.end() || parentPos->second.key->isRemoved)
+         return false;
+
+      const OpenKey& parentKey = parentPos->second;
+      if ((parentKey.accessRights & RegAccessCreateSubkey) == 0 &&
+          !m_keys.contains(appendKeyPath(parentKey.key->path, keyWrites.keyPath)))
+      {
+         return false;
+      }
+   }
+
+   for (const RegKeyWrites& keyWrites : writes)
+   {
+      const std::shared_ptr<Key> key =
+         createPath(m_handles.at(keyWrites.parent).key, keyWrites.keyPath, true, nullptr,
+                    notifications);
+      assert(key);
+
+      bool isChanged = false;
+      for (const RegValueWrite& value : keyWrites.values)
+      {
+         if (value.isRemoval)
+         {
+            isChanged = (key->values.erase(foldRegName(value.name)) > 0) || isChanged;
+         }
+         else
+         {
+            storeValue(key->values, value.name, value.type, value.data.data(),
+                       value.data.size());
+            isChanged = true;
+         }
+      }
+      if (isChanged)
+         changed(*key, notifications);
+   }
+
+   lock.unlock();
+   notify(notifications);
+   return true;
+}
+
+
+std::optional<RegSnapshot> MemoryRegBackend::readAllValues(RegHandle key)
+{
+   std::shared_lock lock{m_guard};
+
+   const Key* k = lookup(key, RegAccessQueryValue);
+   if (!k)
+      return {};
+
+   // Upper bound that includes the padding for alignment.
+   std::size_t numArenaBytes = 0;
+   for (const auto& [foldedName, value] : k->values)
+      numArenaBytes +=
+         (value.name.size() + 1) * sizeof(wchar_t) + value.data.size() + sizeof(wchar_t);
+
+   RegSnapshot snapshot;
+   snapshot.reserve(k->values.size(), numArenaBytes);
+   for (const auto& [foldedName, value] : k->values)
+      snapshot.add(value.name, value.type, value.data.data(), value.data.size());
+   return snapshot;
+}
+
+
+RegBackend::WatchId MemoryRegBackend::watchKey(RegHandle key, ChangeCallback_t onChange)
+{
+   std::unique_lock lock{m_guard};
+
+   auto pos = m_handles.find(key);
+   if (pos == m_handles.end() || pos->second.key->isRemoved || !onChange)
+      return 0;
+
+   const WatchId id = m_nextWatchId++;
+   pos->second.key->watchers[id] =
+      std::make_shared<const ChangeCallback_t>(std::move(onChange));
+   m_watches[id] = pos->second.key;
+   return id;
+}
+
+
+void MemoryRegBackend::unwatchKey(WatchId id)
+{
+   std::unique_lock lock{m_guard};
+
+   auto pos = m_watches.find(id);
+   if (pos == m_watches.end())
+      return;
+   pos->second->watchers.erase(id);
+   m_watches.erase(pos);
+}
+
+
+std::size_t MemoryRegBackend::numKeys() const
+{
+   std::shared_lock lock{m_guard};
+   return m_keys.size();
+}
+
+
+std::size_t MemoryRegBackend::numOpenHandles() const
+{
+   std::shared_lock lock{m_guard};
+   return m_handles.size() - std::size(RootKeys);
+}
+
+
+std::vector<std::byte> MemoryRegBackend::exportHive() const
+{
+   std::shared_lock lock{m_guard};
+
+   std::vector<std::byte> out(sizeof(HiveMagic));
+   std::memcpy(out.data(), HiveMagic, sizeof(HiveMagic));
+   append(out, HiveVersion);
+   append(out, static_cast<std::uint32_t>(std::size(RootKeys)));
+
+   // Recursion depth is bounded by the maximal key depth.
+   auto appendKey = [this, &out](const Key& key, auto& appendKeyRef) -> void
+   {
+      append(out, static_cast<std::uint32_t>(key.values.size()));
+      for (const auto& [foldedName, value] : key.values)
+      {
+         appendName(out, value.name);
+         append(out, value.type);
+         append(out, static_cast<std::uint64_t>(value.data.size()));
+         out.insert(out.end(), value.data.begin(), value.data.end());
+      }
+
+      append(out, static_cast<std::uint32_t>(key.subkeys.size()));
+      for (const auto& [foldedName, name] : key.subkeys)
+      {
+         appendName(out, name);
+         appendKeyRef(*m_keys.at(appendPath(key.path, foldedName)), appendKeyRef);
+      }
+   };
+
+   for (const RootKey& root : RootKeys)
+   {
+      append(out, static_cast<std::uint64_t>(root.handle));
+      appendKey(*m_keys.at(foldRegName(root.name)), appendKey);
+   }
+   return out;
+}
+
+
+bool MemoryRegBackend::importHive(const std::vector<std::byte>& data)
+{
+   HiveReader reader{data};
+
+   char magic[sizeof(HiveMagic)] = {};
+   std::uint32_t version = 0;
+   std::uint32_t numRoots = 0;
+   if (!reader.read(magic) || std::memcmp(magic, HiveMagic, sizeof(HiveMagic)) != 0 ||
+       !reader.read(version) || version != HiveVersion || !reader.read(numRoots))
+   {
+      return false;
+   }
+
+   KeyTable keys;
+   addRoots(keys);
+
+   auto readKey = [&reader, &keys](Key& key, std::size_t depth, auto& readKeyRef) -> bool
+   {
+      if (depth > MaxKeyDepth)
+         return false;
+
+      std::uint32_t numValues = 0;
+      if (!reader.read(numValues))
+         return false;
+      for (std::uint32_t i = 0; i < numValues; ++i)
+      {
+         StoredValue value;
+         std::uint64_t size = 0;
+         if (!reader.readName(value.name) || !reader.read(value.type) ||
+             !reader.read(size) || size > reader.remaining() ||
+             !reader.readBytes(value.data, static_cast<std::size_t>(size)))
+         {
+            return false;
+         }
+         if (!key.values.emplace(foldRegName(value.name), std::move(value)).second)
+            return false;
+      }
+
+      std::uint32_t numSubkeys = 0;
+      if (!reader.read(numSubkeys))
+         return false;
+      for (std::uint32_t i = 0; i < numSubkeys; ++i)
+      {
+         std::wstring name;
+         if (!reader.readName(name) || name.empty() ||
+             name.find(L'\\') != std::wstring::npos)
+         {
+            return false;
+         }
+
+         const std::wstring foldedName = foldRegName(name);
+         const std::wstring path = appendPath(key.path, foldedName);
+         if (!key.subkeys.emplace(foldedName, std::move(name)).second)
+            return false;
+         auto subkey = std::make_shared<Key>(path);
+         keys.emplace(path, subkey);
+         if (!readKeyRef(*subkey, depth + 1, readKeyRef))
+            return false;
+      }
+      return true;
+   };
+
+   for (std::uint32_t i = 0; i < numRoots; ++i)
+   {
+      std::uint64_t handle = 0;
+      if (!reader.read(handle))
+         return false;
+
+      const RootKey* root = nullptr;
+      for (const RootKey& candidate : RootKeys)
+         if (candidate.handle == static_cast<RegHandle>(handle))
+            root = &candidate;
+      if (!root)
+         return false;
+
+      Key& rootKey = *keys.at(foldRegName(root->name));
+      if (!rootKey.values.empty() || !rootKey.subkeys.empty())
+         return false;
+      if (!readKey(rootKey, 1, readKey))
+         return false;
+   }
+   if (reader.remaining() != 0)
+      return false;
+
+   std::unique_lock lock{m_guard};
+   Notifications notifications;
+
+   for (auto& [path, key] : m_keys)
+   {
+      key->isRemoved = true;
+      changed(*key, notifications);
+   }
+   m_keys = std::move(keys);
+   for (const RootKey& root : RootKeys)
+      m_handles[root.handle] = {m_keys[foldRegName(root.name)], RegAccessAll};
+
+   lock.unlock();
+   notify(notifications);
+   return true;
+}
+
+
+MemoryRegBackend::Key* MemoryRegBackend::lookup(RegHandle handle,
+                                                RegAccess requiredRights) const
+{
+   auto pos = m_handles.find(handle);
+   if (pos == m_handles.end())
+      return nullptr;
+
+   const OpenKey& openKey = pos->second;
+   if (openKey.key->isRemoved ||
+       (openKey.accessRights & requiredRights) != requiredRights)
+   {
+      return nullptr;
+   }
+   return openKey.key.get();
+}
+
+
+std::shared_ptr<MemoryRegBackend::Key>
+MemoryRegBackend::createPath(std::shared_ptr<Key> key, const std::wstring& keyPath,
+                             bool canCreate, bool* created, Notifications& notifications)
+{
+   bool isNew = false;
+   for (const std::wstring& name : splitPath(keyPath))
+   {
+      const std::wstring foldedName = foldRegName(name);
+      const std::wstring path = appendPath(key->path, foldedName);
+
+      auto pos = m_keys.find(path);
+      if (pos == m_keys.end())
+      {
+         if (!canCreate)
+            return {};
+
+         // Only the first created key has watchers.
+         if (!isNew)
+            changed(*key, notifications);
+         key->subkeys.emplace(foldedName, name);
+         pos = m_keys.emplace(path, std::make_shared<Key>(path)).first;
+         isNew = true;
+      }
+      key = pos->second;
+   }
+
+   if (created)
+      *created = isNew;
+   return key;
+}
+
+
+void MemoryRegBackend::removeSubtree(Key& key, Notifications& notifications)
+{
+   for (const auto& [foldedName, name] : key.subkeys)
+      removeSubtree(*m_keys.at(appendPath(key.path, foldedName)), notifications);
+
+   key.isRemoved = true;
+   changed(key, notifications);
+   // Destroys the key unless a handle still references it.
+   const std::wstring path = key.path;
+   m_keys.erase(path);
+}
+
+
+void MemoryRegBackend::changed(const Key& key, Notifications& notifications)
+{
+   m_changeCount.fetch_add(1, std::memory_order_release);
+   for (const auto& [id, callback] : key.watchers)
+      notifications.push_back(callback);
+}
+
+
+void MemoryRegBackend::notify(const Notifications& notifications)
+{
+   for (const auto& callback : notifications)
+      (*callback)();
+}
+
+
+void MemoryRegBackend::addRoots(KeyTable& keys) const
+{
+   for (const RootKey& root : RootKeys)
+   {
+      const std::wstring path = foldRegName(root.name);
+      keys.emplace(path, std::make_shared<Key>(path));
+   }
+}
+
+
+///////////////////
+
+FileRegBackend::FileRegBackend(std::filesystem::path filePath)
+: m_filePath{std::move(filePath)}
+{
+   load();
+}
+
+
+FileRegBackend::~FileRegBackend()
+{
+   if (hasUnsavedChanges())
+      save();
+}
+
+
+bool FileRegBackend::load()
+{
+   const std::lock_guard lock{m_fileGuard};
+
+   std::vector<std::byte> data;
+   if (!readFile(m_filePath, data) || !importHive(data))
+      return false;
+
+   m_savedChangeCount.store(changeCount(), std::memory_order_release);
+   m_wasLoaded.store(true, std::memory_order_release);
+   return true;
+}
+
+
+bool FileRegBackend::applyWrites(const std::vector<RegKeyWrites>& writes)
+{
+   if (!MemoryRegBackend::applyWrites(writes))
+      return false;
+   return save();
+}
+
+
+bool FileRegBackend::save()
+{
+   const std::lock_guard lock{m_fileGuard};
+
+   // Changes made while exporting count as unsaved.
+   const std::uint64_t changes = changeCount();
+   const std::vector<std::byte> data = exportHive();
+
+   std::filesystem::path tempPath = m_filePath;
+   tempPath += L".tmp";
+   if (!writeFile(tempPath, data))
+      return false;
+
+   if (!replaceFile(tempPath, m_filePath))
+   {
+      std::error_code err;
+      std::filesystem::remove(tempPath, err);
+      return false;
+   }
+
+   m_savedChangeCount.store(changes, std::memory_order_release);
+   return true;
+}
+
+} // namespace win32
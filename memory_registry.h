@@ -0,0 +1,170 @@
+//
+// Win32 utilities library
+// Registry backends that keep keys in memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "registry_backend.h"
+#include "win32_util_api.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Registry hive in memory. Names are compared case-insensitively and keys are looked
+// up by their full path, so opening a deep key does not walk its ancestors. Handles
+// of removed keys stay open but all operations on them fail. Thread-safe.
+class WIN32UTIL_API MemoryRegBackend : public RegBackend
+{
+ public:
+   MemoryRegBackend();
+   ~MemoryRegBackend() override;
+   MemoryRegBackend(const MemoryRegBackend&) = delete;
+   MemoryRegBackend& operator=(const MemoryRegBackend&) = delete;
+
+   RegHandle createKey(RegHandle parent, const std::wstring& keyPath,
+                       RegAccess accessRights, bool* created) override;
+   RegHandle openKey(RegHandle parent, const std::wstring& keyPath,
+                     RegAccess accessRights) override;
+   void closeKey(RegHandle key) override;
+   bool removeKey(RegHandle parent, const std::wstring& keyPath) override;
+
+   bool queryValue(RegHandle key, const std::wstring& valueName, RegValueType* type,
+                   void* data, std::size_t* numBytes) override;
+   bool setValue(RegHandle key, const std::wstring& valueName, RegValueType type,
+                 const void* data, std::size_t numBytes) override;
+   bool removeValue(RegHandle key, const std::wstring& valueName) override;
+
+   std::optional<RegKeyInfo> queryKeyInfo(RegHandle key) override;
+   std::optional<std::vector<std::wstring>> subkeyNames(RegHandle key) override;
+   std::optional<std::vector<std::wstring>> valueNames(RegHandle key) override;
+   // Continue after the previous name, so that enumerating takes logarithmic time
+   // per name.
+   RegEnumResult enumSubkey(RegHandle key, std::size_t idx, std::wstring& name) override;
+   RegEnumResult enumValue(RegHandle key, std::size_t idx, std::wstring& name,
+                           RegValueType* type, std::size_t* numBytes) override;
+   // Copies all values while holding the lock once.
+   std::optional<RegSnapshot> readAllValues(RegHandle key) override;
+   // Applies all writes or none.
+   bool applyWrites(const std::vector<RegKeyWrites>& writes) override;
+
+   // Calls back on the thread that made a change, after the change was made.
+   WatchId watchKey(RegHandle key, ChangeCallback_t onChange) override;
+   void unwatchKey(WatchId id) override;
+
+   std::size_t numKeys() const;
+   std::size_t numOpenHandles() const;
+   // Incremented by every modification.
+   std::uint64_t changeCount() const;
+
+   // Serializes all keys and values. Strings are stored as wchar_t code units, so
+   // the data is specific to the platform that wrote it.
+   std::vector<std::byte> exportHive() const;
+   // Replaces all keys with the given data. Open handles to replaced keys behave like
+   // handles to removed keys. Fails for invalid data without changing the hive.
+   bool importHive(const std::vector<std::byte>& data);
+
+ private:
+   struct Key;
+   struct OpenKey
+   {
+      std::shared_ptr<Key> key;
+      RegAccess accessRights = 0;
+   };
+   using KeyTable = std::unordered_map<std::wstring, std::shared_ptr<Key>>;
+   // Callbacks of watchers that are called after the guard is released.
+   using Notifications = std::vector<std::shared_ptr<const ChangeCallback_t>>;
+
+   // Returns null for invalid handles, removed keys and missing access rights.
+   Key* lookup(RegHandle handle, RegAccess requiredRights) const;
+   // Walks the path from the given key and creates missing keys if allowed. Returns
+   // null if a key is missing that cannot be created.
+   std::shared_ptr<Key> createPath(std::shared_ptr<Key> key, const std::wstring& keyPath,
+                                   bool canCreate, bool* created,
+                                   Notifications& notifications);
+   void removeSubtree(Key& key, Notifications& notifications);
+   void addRoots(KeyTable& keys) const;
+   void changed(const Key& key, Notifications& notifications);
+   static void notify(const Notifications& notifications);
+
+ private:
+   mutable std::shared_mutex m_guard;
+   // By folded path from the root.
+   KeyTable m_keys;
+   std::unordered_map<RegHandle, OpenKey> m_handles;
+   RegHandle m_nextHandle = 1;
+   std::unordered_map<WatchId, std::shared_ptr<Key>> m_watches;
+   WatchId m_nextWatchId = 1;
+   std::atomic<std::uint64_t> m_changeCount = 0;
+};
+
+
+inline std::uint64_t MemoryRegBackend::changeCount() const
+{
+   return m_changeCount.load(std::memory_order_acquire);
+}
+
+
+///////////////////
+
+// Memory hive that persists in a file. The file is loaded on construction and
+// written by save() and on destruction if there are unsaved changes. A file that
+// cannot be loaded is only overwritten once the hive is changed.
+class WIN32UTIL_API FileRegBackend : public MemoryRegBackend
+{
+ public:
+   explicit FileRegBackend(std::filesystem::path filePath);
+   ~FileRegBackend() override;
+
+   // Saves the file after applying the writes, so that they reach the file together.
+   bool applyWrites(const std::vector<RegKeyWrites>& writes) override;
+
+   const std::filesystem::path& filePath() const;
+   bool wasLoaded() const;
+   bool hasUnsavedChanges() const;
+
+   // Replaces the hive with the contents of the file.
+   bool load();
+   // Writes a temporary file and renames it over the store, so the file is never
+   // left half-written.
+   bool save();
+
+ private:
+   std::filesystem::path m_filePath;
+   // Serializes loading and saving, which share the file and its temporary file.
+   std::mutex m_fileGuard;
+   std::atomic<bool> m_wasLoaded = false;
+   std::atomic<std::uint64_t> m_savedChangeCount = 0;
+};
+
+
+inline const std::filesystem::path& FileRegBackend::filePath() const
+{
+   return m_filePath;
+}
+
+inline bool FileRegBackend::wasLoaded() const
+{
+   return m_wasLoaded.load(std::memory_order_acquire);
+}
+
+inline bool FileRegBackend::hasUnsavedChanges() const
+{
+   return changeCount() != m_savedChangeCount.load(std::memory_order_acquire);
+}
+
+} // namespace win32
@@ -7,6 +7,7 @@
 //
 #ifdef _WIN32
 #include "message_util.h"
+#include "trace.h"
 #include <cassert>
 
 
@@ -24,6 +25,7 @@ MsgLoopResult mainMessageLoop(HACCEL accelerators)
       int getResult = ::GetMessage(&msg, nullptr, 0, 0);
       if (getResult > 0)
       {
+         WIN32UTIL_TRACE_ZONE("mainMessageLoop dispatch", "message");
          if (!::TranslateAccelerator(msg.hwnd, accelerators, &msg))
          {
             ::TranslateMessage(&msg);
@@ -72,6 +74,7 @@ void modalMessageLoop(HWND modalWnd, bool& stopFlag, HWND parentWnd)
          }
 
          // Dispatch messages.
+         WIN32UTIL_TRACE_ZONE("modalMessageLoop dispatch", "message");
          if (!::IsDialogMessage(modalWnd, &msg))
          {
             ::TranslateMessage(&msg);
@@ -0,0 +1,486 @@
+//
+// Win32 utilities library
+// Object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "object_pool.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <unordered_map>
+
+using namespace win32::detail;
+
+
+namespace
+{
+///////////////////
+
+// The depot head packs a node pointer and a tag that is incremented with each change
+// to protect against the ABA problem. User-space addresses fit into 48 bits on 64-bit
+// platforms with 4-level paging. Nodes are aligned, so the low bits of their addresses
+// are dropped to make room for a larger tag. Batches at addresses that don't fit,
+// e.g. with 5-level paging or tagged pointers, go to a locked overflow list instead.
+constexpr unsigned PtrBits = (sizeof(void*) == 8) ? 48 : 32;
+constexpr unsigned AlignBits = std::countr_zero(alignof(PoolFreeNode));
+constexpr unsigned TagShift = PtrBits - AlignBits;
+constexpr std::uint64_t AddrMask =
+   ((std::uint64_t{1} << PtrBits) - 1) & ~((std::uint64_t{1} << AlignBits) - 1);
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "Object pool depot requires lock-free 64-bit atomics.");
+
+
+std::uint64_t nodeAddress(const PoolFreeNode* node)
+{
+   return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(node));
+}
+
+
+bool fitsDepotHead(const PoolFreeNode* node)
+{
+   return (nodeAddress(node) & ~AddrMask) == 0;
+}
+
+
+std::uint64_t packDepotHead(PoolFreeNode* node, std::uint64_t tag)
+{
+   assert(fitsDepotHead(node));
+   return (tag << TagShift) | (nodeAddress(node) >> AlignBits);
+}
+
+
+PoolFreeNode* depotNode(std::uint64_t head)
+{
+   const std::uint64_t addr = (head << AlignBits) & AddrMask;
+   return reinterpret_cast<PoolFreeNode*>(static_cast<std::uintptr_t>(addr));
+}
+
+
+std::uint64_t depotTag(std::uint64_t head)
+{
+   return head >> TagShift;
+}
+
+
+std::size_t alignUp(std::size_t val, std::size_t align)
+{
+   return (val + align - 1) / align * align;
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+// Keeps track of all live pools so that exiting threads only return their caches to
+// pools that still exist.
+class ObjectPoolBase::Registry
+{
+ public:
+   static std::uint64_t add(ObjectPoolBase* pool);
+   static void remove(std::uint64_t poolId);
+   static bool isAlive(std::uint64_t poolId);
+   static void releaseCache(std::uint64_t poolId, PoolThreadCache& cache);
+
+ private:
+   static std::mutex& guard();
+   static std::unordered_map<std::uint64_t, ObjectPoolBase*>& pools();
+
+ private:
+   // Ids are never reused. Guarded by the registry mutex.
+   static std::uint64_t s_nextId;
+};
+
+
+std::uint64_t ObjectPoolBase::Registry::s_nextId = 1;
+
+
+std::uint64_t ObjectPoolBase::Registry::add(ObjectPoolBase* pool)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   const std::uint64_t id = s_nextId++;
+   pools()[id] = pool;
+   return id;
+}
+
+
+void ObjectPoolBase::Registry::remove(std::uint64_t poolId)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   pools().erase(poolId);
+}
+
+
+bool ObjectPoolBase::Registry::isAlive(std::uint64_t poolId)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   return (pools().find(poolId) != pools().end());
+}
+
+
+void ObjectPoolBase::Registry::releaseCache(std::uint64_t poolId, PoolThreadCache& cache)
+{
+   // Holding the lock prevents the pool from being destroyed while the cache is
+   // returned.
+   std::lock_guard<std::mutex> lock(guard());
+   auto pos = pools().find(poolId);
+   if (pos != pools().end())
+      pos->second->releaseCache(cache);
+}
+
+
+std::mutex& ObjectPoolBase::Registry::guard()
+{
+   // Function-local to be available during static initialization and destruction.
+   static std::mutex registryGuard;
+   return registryGuard;
+}
+
+
+std::unordered_map<std::uint64_t, ObjectPoolBase*>& ObjectPoolBase::Registry::pools()
+{
+   static std::unordered_map<std::uint64_t, ObjectPoolBase*> livePools;
+   return livePools;
+}
+
+
+///////////////////
+
+// The caches that the current thread is bound to.
+// Returns the caches to their pools when the thread exits.
+class ObjectPoolBase::ThreadCaches
+{
+ public:
+   ThreadCaches() = default;
+   ~ThreadCaches();
+   ThreadCaches(const ThreadCaches&) = delete;
+   ThreadCaches& operator=(const ThreadCaches&) = delete;
+
+   PoolThreadCache* find(std::uint64_t poolId);
+   void add(std::uint64_t poolId, PoolThreadCache* cache);
+
+ private:
+   struct Entry
+   {
+      std::uint64_t poolId = 0;
+      PoolThreadCache* cache = nullptr;
+   };
+
+   // Most recently used entry. Avoids the search when a thread mostly works with the
+   // same pool.
+   Entry m_last;
+   std::vector<Entry> m_entries;
+};
+
+
+ObjectPoolBase::ThreadCaches::~ThreadCaches()
+{
+   for (Entry& entry : m_entries)
+      Registry::releaseCache(entry.poolId, *entry.cache);
+}
+
+
+PoolThreadCache* ObjectPoolBase::ThreadCaches::find(std::uint64_t poolId)
+{
+   if (m_last.poolId == poolId)
+      return m_last.cache;
+
+   auto pos = std::find_if(m_entries.begin(), m_entries.end(),
+                           [poolId](const Entry& entry) { return entry.poolId == poolId; });
+   if (pos == m_entries.end())
+      return nullptr;
+
+   m_last = *pos;
+   return m_last.cache;
+}
+
+
+void ObjectPoolBase::ThreadCaches::add(std::uint64_t poolId, PoolThreadCache* cache)
+{
+   // Drop entries of destroyed pools. Their caches were destroyed with the pools.
+   m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                  [](const Entry& entry)
+                                  { return !Registry::isAlive(entry.poolId); }),
+                   m_entries.end());
+
+   m_entries.push_back({poolId, cache});
+   m_last = m_entries.back();
+}
+
+
+///////////////////
+
+ObjectPoolBase::ObjectPoolBase(std::size_t objSize, std::size_t objAlign,
+                               std::size_t objectsPerSlab, std::size_t batchSize,
+                               std::size_t maxSlabs)
+: m_slotSize{alignUp(std::max(objSize, sizeof(PoolFreeNode)),
+                     std::max(objAlign, alignof(PoolFreeNode)))},
+  m_objectsPerSlab{std::max<std::size_t>(objectsPerSlab, 1)},
+  m_batchSize{std::max<std::size_t>(batchSize, 1)}, m_maxSlabs{maxSlabs},
+  m_depot{packDepotHead(nullptr, 0)}
+{
+   m_id = Registry::add(this);
+}
+
+
+ObjectPoolBase::~ObjectPoolBase()
+{
+   shutdown();
+}
+
+
+ObjectPoolStats ObjectPoolBase::stats() const
+{
+   ObjectPoolStats stats;
+   stats.slabs = m_numSlabs.load(std::memory_order_relaxed);
+   stats.capacity = stats.slabs * m_objectsPerSlab;
+
+   std::lock_guard<std::mutex> lock(m_cacheGuard);
+   for (const auto& cache : m_caches)
+   {
+      if (cache->isBound)
+         ++stats.threadCaches;
+      stats.allocations += cache->allocations.value();
+      stats.frees += cache->frees.value();
+      stats.depotPushes += cache->depotPushes.value();
+      stats.depotPops += cache->depotPops.value();
+   }
+   return stats;
+}
+
+
+void* ObjectPoolBase::allocateSlot()
+{
+   PoolThreadCache& cache = threadCache();
+   if (!cache.head && !refill(cache))
+      return nullptr;
+
+   PoolFreeNode* node = cache.head;
+   cache.head = node->next;
+   --cache.count;
+   cache.allocations.increment();
+   return node;
+}
+
+
+void ObjectPoolBase::deallocateSlot(void* p)
+{
+   if (!p)
+      return;
+
+   PoolThreadCache& cache = threadCache();
+   PoolFreeNode* node = new (p) PoolFreeNode;
+   node->next = cache.head;
+   cache.head = node;
+   ++cache.count;
+   cache.frees.increment();
+
+   // Keep one batch in the cache so that alternating allocations and frees don't
+   // bounce objects between cache and depot.
+   if (cache.count >= 2 * m_batchSize)
+      flushBatch(cache, m_batchSize);
+}
+
+
+void ObjectPoolBase::shutdown()
+{
+   if (m_id != 0)
+   {
+      Registry::remove(m_id);
+      m_id = 0;
+   }
+}
+
+
+ObjectPoolBase::ThreadCaches& ObjectPoolBase::threadCaches()
+{
+   thread_local ThreadCaches caches;
+   return caches;
+}
+
+
+PoolThreadCache& ObjectPoolBase::threadCache()
+{
+   PoolThreadCache* cache = threadCaches().find(m_id);
+   if (cache)
+      return *cache;
+   return bindCache();
+}
+
+
+PoolThreadCache& ObjectPoolBase::bindCache()
+{
+   PoolThreadCache* cache = nullptr;
+   {
+      std::lock_guard<std::mutex> lock(m_cacheGuard);
+
+      // Reuse caches released by exited threads.
+      auto pos = std::find_if(m_caches.begin(), m_caches.end(),
+                              [](const auto& cache) { return !cache->isBound; });
+      if (pos != m_caches.end())
+      {
+         cache = pos->get();
+      }
+      else
+      {
+         m_caches.push_back(std::make_unique<PoolThreadCache>());
+         cache = m_caches.back().get();
+      }
+      cache->isBound = true;
+   }
+
+   // Has to happen outside of the cache lock because it accesses the registry.
+   threadCaches().add(m_id, cache);
+   return *cache;
+}
+
+
+void ObjectPoolBase::releaseCache(PoolThreadCache& cache)
+{
+   while (cache.count > 0)
+      flushBatch(cache, m_batchSize);
+
+   std::lock_guard<std::mutex> lock(m_cacheGuard);
+   cache.isBound = false;
+}
+
+
+bool ObjectPoolBase::refill(PoolThreadCache& cache)
+{
+   assert(!cache.head && cache.count == 0);
+
+   PoolFreeNode* batch = popDepot();
+   if (batch)
+   {
+      cache.head = batch;
+      cache.count = batch->batchSize;
+      cache.depotPops.increment();
+      return true;
+   }
+
+   return carveSlab(cache);
+}
+
+
+bool ObjectPoolBase::carveSlab(PoolThreadCache& cache)
+{
+   assert(!cache.head && cache.count == 0);
+
+   std::byte* slab = nullptr;
+   {
+      std::lock_guard<std::mutex> lock(m_slabGuard);
+      if (m_maxSlabs != 0 && m_numSlabs.load(std::memory_order_relaxed) >= m_maxSlabs)
+         return false;
+
+      slab = allocateSlab(m_slotSize * m_objectsPerSlab);
+      if (!slab)
+         return false;
+      m_numSlabs.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   // Split the slots into batches. The first batch goes to the calling thread, the
+   // others to the depot. Slots are linked in address order, and batches are pushed in
+   // reverse order, so that consecutive allocations are adjacent in memory.
+   const std::size_t numBatches = (m_objectsPerSlab + m_batchSize - 1) / m_batchSize;
+   for (std::size_t b = numBatches; b > 0; --b)
+   {
+      const std::size_t first = (b - 1) * m_batchSize;
+      const std::size_t batchSize = std::min(m_batchSize, m_objectsPerSlab - first);
+
+      PoolFreeNode* batch = nullptr;
+      for (std::size_t i = first + batchSize; i > first; --i)
+      {
+         PoolFreeNode* node = new (slab + (i - 1) * m_slotSize) PoolFreeNode;
+         node->next = batch;
+         batch = node;
+      }
+      batch->batchSize = batchSize;
+
+      if (b == 1)
+      {
+         cache.head = batch;
+         cache.count = batchSize;
+      }
+      else
+      {
+         pushDepot(batch);
+      }
+   }
+   return true;
+}
+
+
+void ObjectPoolBase::flushBatch(PoolThreadCache& cache, std::size_t batchSize)
+{
+   batchSize = std::min(batchSize, cache.count);
+   if (batchSize == 0)
+      return;
+
+   PoolFreeNode* batch = cache.head;
+   PoolFreeNode* last = batch;
+   for (std::size_t i = 1; i < batchSize; ++i)
+      last = last->next;
+
+   cache.head = last->next;
+   cache.count -= batchSize;
+   last->next = nullptr;
+   batch->batchSize = batchSize;
+
+   pushDepot(batch);
+   cache.depotPushes.increment();
+}
+
+
+void ObjectPoolBase::pushDepot(PoolFreeNode* batch)
+{
+   if (!fitsDepotHead(batch))
+   {
+      std::lock_guard<std::mutex> lock(m_overflowGuard);
+      batch->nextBatch.store(m_overflow, std::memory_order_relaxed);
+      m_overflow = batch;
+      m_hasOverflow.store(true, std::memory_order_release);
+      return;
+   }
+
+   std::uint64_t head = m_depot.load(std::memory_order_relaxed);
+   do
+   {
+      batch->nextBatch.store(depotNode(head), std::memory_order_relaxed);
+   } while (!m_depot.compare_exchange_weak(head, packDepotHead(batch, depotTag(head) + 1),
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+}
+
+
+PoolFreeNode* ObjectPoolBase::popDepot()
+{
+   std::uint64_t head = m_depot.load(std::memory_order_acquire);
+   while (PoolFreeNode* node = depotNode(head))
+   {
+      // The node might get popped and reused by another thread concurrently. In that
+      // case the tag will have changed and the exchange fails.
+      PoolFreeNode* next = node->nextBatch.load(std::memory_order_relaxed);
+      if (m_depot.compare_exchange_weak(head, packDepotHead(next, depotTag(head) + 1),
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire))
+      {
+         return node;
+      }
+   }
+
+   if (!m_hasOverflow.load(std::memory_order_acquire))
+      return nullptr;
+
+   std::lock_guard<std::mutex> lock(m_overflowGuard);
+   PoolFreeNode* node = m_overflow;
+   if (node)
+      m_overflow = node->nextBatch.load(std::memory_order_relaxed);
+   return node;
+}
+
+} // namespace win32
@@ -0,0 +1,265 @@
+//
+// Win32 utilities library
+// Object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "mem_util.h"
+#include "win32_util_api.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Statistics of an object pool.
+struct ObjectPoolStats
+{
+   // Number of slabs allocated as backing storage.
+   std::size_t slabs = 0;
+   // Number of object slots in all slabs.
+   std::size_t capacity = 0;
+   // Number of threads that are currently bound to a cache of the pool.
+   std::size_t threadCaches = 0;
+   std::size_t allocations = 0;
+   std::size_t frees = 0;
+   // Number of batches of free objects handed to and taken from the global depot.
+   std::size_t depotPushes = 0;
+   std::size_t depotPops = 0;
+
+   std::size_t liveObjects() const { return allocations - frees; }
+};
+
+
+namespace detail
+{
+///////////////////
+
+// Counter that is only written by one thread but can be read by any thread.
+// Avoids the cost of atomic read-modify-write operations.
+class SingleWriterCounter
+{
+ public:
+   void increment()
+   {
+      m_value.store(m_value.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+   }
+   std::size_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+ private:
+   std::atomic<std::size_t> m_value = 0;
+};
+
+
+// Overlays the memory of unused object slots.
+struct PoolFreeNode
+{
+   // Next node in the list of a thread cache or within a batch.
+   PoolFreeNode* next = nullptr;
+   // Next batch in the global depot.
+   std::atomic<PoolFreeNode*> nextBatch = nullptr;
+   // Number of nodes in the batch that this node heads.
+   std::size_t batchSize = 0;
+};
+
+
+// Free objects of a pool that are reserved for one thread.
+// Owned by the pool and bound to at most one thread at a time.
+struct PoolThreadCache
+{
+   PoolFreeNode* head = nullptr;
+   std::size_t count = 0;
+   bool isBound = false;
+
+   SingleWriterCounter allocations;
+   SingleWriterCounter frees;
+   SingleWriterCounter depotPushes;
+   SingleWriterCounter depotPops;
+};
+
+} // namespace detail
+
+
+///////////////////
+
+// Untyped base of object pools.
+// Objects are allocated from thread-local caches without synchronization. Caches that
+// run empty take a batch of free objects from a lock-free global depot or carve a new
+// slab. Caches that overflow (e.g. because objects are freed on a different thread
+// than they were allocated on) return a batch to the depot. Exiting threads return
+// their whole cache to the depot.
+class WIN32UTIL_API ObjectPoolBase
+{
+ public:
+   ObjectPoolBase(const ObjectPoolBase&) = delete;
+   ObjectPoolBase(ObjectPoolBase&&) = delete;
+   ObjectPoolBase& operator=(const ObjectPoolBase&) = delete;
+   ObjectPoolBase& operator=(ObjectPoolBase&&) = delete;
+
+   std::size_t slotSize() const;
+   std::size_t objectsPerSlab() const;
+   // Thread-safe. Statistics of caches of other threads are eventually consistent.
+   ObjectPoolStats stats() const;
+
+ protected:
+   // A max slab count of zero means the pool can grow without limit.
+   ObjectPoolBase(std::size_t objSize, std::size_t objAlign, std::size_t objectsPerSlab,
+                  std::size_t batchSize, std::size_t maxSlabs);
+   virtual ~ObjectPoolBase();
+
+   // Returns memory for one object or null if the pool cannot grow anymore.
+   void* allocateSlot();
+   void deallocateSlot(void* p);
+   // Detaches the pool from all threads. Has to be called before the backing storage
+   // gets destroyed.
+   void shutdown();
+
+ private:
+   // Allocates storage for a new slab. Returns null on failure.
+   virtual std::byte* allocateSlab(std::size_t numBytes) = 0;
+
+   class Registry;
+   class ThreadCaches;
+   static ThreadCaches& threadCaches();
+
+   detail::PoolThreadCache& threadCache();
+   detail::PoolThreadCache& bindCache();
+   void releaseCache(detail::PoolThreadCache& cache);
+   bool refill(detail::PoolThreadCache& cache);
+   bool carveSlab(detail::PoolThreadCache& cache);
+   void flushBatch(detail::PoolThreadCache& cache, std::size_t batchSize);
+   void pushDepot(detail::PoolFreeNode* batch);
+   detail::PoolFreeNode* popDepot();
+
+ private:
+   const std::size_t m_slotSize;
+   const std::size_t m_objectsPerSlab;
+   const std::size_t m_batchSize;
+   const std::size_t m_maxSlabs;
+   std::uint64_t m_id = 0;
+   // Head of the depot of free batches. Packs a node pointer and an ABA tag.
+   std::atomic<std::uint64_t> m_depot;
+   // Batches whose addresses cannot be packed into the depot head.
+   std::mutex m_overflowGuard;
+   detail::PoolFreeNode* m_overflow = nullptr;
+   std::atomic<bool> m_hasOverflow = false;
+   std::mutex m_slabGuard;
+   std::atomic<std::size_t> m_numSlabs = 0;
+   mutable std::mutex m_cacheGuard;
+   std::vector<std::unique_ptr<detail::PoolThreadCache>> m_caches;
+};
+
+
+inline std::size_t ObjectPoolBase::slotSize() const
+{
+   return m_slotSize;
+}
+
+inline std::size_t ObjectPoolBase::objectsPerSlab() const
+{
+   return m_objectsPerSlab;
+}
+
+
+///////////////////
+
+// Memory class family used for the slabs of object pools by default.
+#ifdef _WIN32
+template <typename T> using DefaultSlabMem = HeapMem<T>;
+#else
+template <typename T> using DefaultSlabMem = CrtMem<T>;
+#endif
+
+
+// Thread-safe pool of fixed-size objects of a given type.
+// The slabs are allocated with the given memory class family of mem_util.h.
+// Destroying the pool releases the memory of all objects without destructing them.
+template <typename T, template <typename> class SlabMem = DefaultSlabMem>
+class ObjectPool : public ObjectPoolBase
+{
+   static_assert(alignof(T) <= alignof(std::max_align_t),
+                 "Slab allocators do not support over-aligned types.");
+
+ public:
+   explicit ObjectPool(std::size_t objectsPerSlab = 256, std::size_t batchSize = 32,
+                       std::size_t maxSlabs = 0);
+   ~ObjectPool() override;
+
+   // Returns null if the pool is exhausted.
+   template <typename... Args> T* create(Args&&... args);
+   void destroy(T* obj);
+
+ private:
+   std::byte* allocateSlab(std::size_t numBytes) override;
+
+ private:
+   // Guarded by the base class.
+   std::vector<SlabMem<std::byte[]>> m_slabs;
+};
+
+
+template <typename T, template <typename> class SlabMem>
+ObjectPool<T, SlabMem>::ObjectPool(std::size_t objectsPerSlab, std::size_t batchSize,
+                                   std::size_t maxSlabs)
+: ObjectPoolBase{sizeof(T), alignof(T), objectsPerSlab, batchSize, maxSlabs}
+{
+}
+
+template <typename T, template <typename> class SlabMem>
+ObjectPool<T, SlabMem>::~ObjectPool()
+{
+   shutdown();
+}
+
+template <typename T, template <typename> class SlabMem>
+template <typename... Args>
+T* ObjectPool<T, SlabMem>::create(Args&&... args)
+{
+   void* slot = allocateSlot();
+   if (!slot)
+      return nullptr;
+
+   try
+   {
+      return new (slot) T(std::forward<Args>(args)...);
+   }
+   catch (...)
+   {
+      deallocateSlot(slot);
+      throw;
+   }
+}
+
+template <typename T, template <typename> class SlabMem>
+void ObjectPool<T, SlabMem>::destroy(T* obj)
+{
+   if (obj)
+   {
+      obj->~T();
+      deallocateSlot(obj);
+   }
+}
+
+template <typename T, template <typename> class SlabMem>
+std::byte* ObjectPool<T, SlabMem>::allocateSlab(std::size_t numBytes)
+{
+   SlabMem<std::byte[]> slab;
+   if (!slab.resize(numBytes))
+      return nullptr;
+
+   m_slabs.push_back(std::move(slab));
+   return m_slabs.back().ptr();
+}
+
+} // namespace win32
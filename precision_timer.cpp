@@ -0,0 +1,301 @@
+//
+// Win32 utilities library
+// High-resolution timer.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "precision_timer.h"
+#ifndef _WIN32
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+
+using namespace win32;
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+// Not defined by SDKs before Windows 10 1803.
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+
+namespace
+{
+///////////////////
+
+// Timer whose callback runs on the current thread.
+thread_local const PrecisionTimer* t_callingTimer = nullptr;
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+PrecisionTimer::~PrecisionTimer()
+{
+   stop();
+   if (m_thread.joinable())
+      m_thread.detach();
+   closeOsTimer();
+}
+
+
+bool PrecisionTimer::start(Duration period, MissedTicks policy)
+{
+   if (period <= Duration::zero())
+      return false;
+   return launch(Clock::now() + period, period, policy);
+}
+
+
+bool PrecisionTimer::startOnce(Duration delay)
+{
+   return launch(Clock::now() + std::max(delay, Duration::zero()), Duration::zero(),
+                 MissedTicks::Skip);
+}
+
+
+void PrecisionTimer::stop()
+{
+   m_isStopping = true;
+   interruptWait();
+
+   // A callback that stops its own timer cannot wait for itself. The thread gets
+   // joined when the timer is restarted or destroyed.
+   if (t_callingTimer != this && m_thread.joinable())
+      m_thread.join();
+   m_isRunning = false;
+}
+
+
+bool PrecisionTimer::launch(Clock::time_point firstDeadline, Duration period,
+                            MissedTicks policy)
+{
+   if (!m_callback)
+      return false;
+   // Restarting from the callback would have to join the calling thread.
+   if (t_callingTimer == this)
+      return false;
+
+   stop();
+   if (!openOsTimer())
+      return false;
+
+   m_isStopping = false;
+   m_isRunning = true;
+   m_thread = std::thread{[this, firstDeadline, period, policy]()
+                          { threadFunc(firstDeadline, period, policy); }};
+   return true;
+}
+
+
+void PrecisionTimer::threadFunc(Clock::time_point firstDeadline, Duration period,
+                                MissedTicks policy)
+{
+   t_callingTimer = this;
+   Clock::time_point deadline = firstDeadline;
+
+   while (!m_isStopping && waitUntil(deadline))
+   {
+      Tick tick{deadline, Clock::now(), 0};
+
+      // Deadlines always stay on the grid of the period.
+      Clock::time_point next = deadline + period;
+      if (period > Duration::zero() && policy == MissedTicks::Skip &&
+          next <= tick.firedAt)
+      {
+         const auto numMissed =
+            static_cast<std::uint64_t>((tick.firedAt - deadline) / period);
+         tick.numSkipped = numMissed;
+         next = deadline + period * (numMissed + 1);
+      }
+
+      if (m_isStopping)
+         break;
+      m_callback(tick);
+
+      if (period == Duration::zero())
+         break;
+      deadline = next;
+   }
+
+   m_isRunning = false;
+}
+
+
+#ifdef _WIN32
+
+bool PrecisionTimer::openOsTimer()
+{
+   if (m_osTimer != NULL)
+   {
+      ResetEvent(m_stopEvent);
+      return true;
+   }
+
+   m_osTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                      TIMER_ALL_ACCESS);
+   m_isHighResolution = (m_osTimer != NULL);
+   if (m_osTimer == NULL)
+      m_osTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+   m_stopEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+   if (m_osTimer == NULL || m_stopEvent == NULL)
+   {
+      closeOsTimer();
+      return false;
+   }
+   return true;
+}
+
+
+void PrecisionTimer::closeOsTimer()
+{
+   if (m_osTimer != NULL)
+      CloseHandle(m_osTimer);
+   if (m_stopEvent != NULL)
+      CloseHandle(m_stopEvent);
+   m_osTimer = NULL;
+   m_stopEvent = NULL;
+   m_isHighResolution = false;
+}
+
+
+bool PrecisionTimer::waitUntil(Clock::time_point deadline)
+{
+   const Duration remaining = deadline - Clock::now();
+   if (remaining <= Duration::zero())
+      return !m_isStopping;
+
+   // Relative due times in 100ns units are independent of changes to the system
+   // time.
+   LARGE_INTEGER dueTime;
+   dueTime.QuadPart = -std::max<LONGLONG>(remaining.count() / 100, 1);
+   if (!SetWaitableTimer(m_osTimer, &dueTime, 0, NULL, NULL, FALSE))
+      return false;
+
+   const HANDLE handles[] = {m_osTimer, m_stopEvent};
+   return WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+
+void PrecisionTimer::interruptWait()
+{
+   if (m_stopEvent != NULL)
+      SetEvent(m_stopEvent);
+}
+
+#elif defined(__linux__)
+
+bool PrecisionTimer::openOsTimer()
+{
+   if (m_timerFd != -1)
+   {
+      std::uint64_t count = 0;
+      while (read(m_stopFd, &count, sizeof(count)) > 0)
+         ;
+      return true;
+   }
+
+   m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+   m_stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (m_timerFd == -1 || m_stopFd == -1)
+   {
+      closeOsTimer();
+      return false;
+   }
+
+   m_isHighResolution = true;
+   return true;
+}
+
+
+void PrecisionTimer::closeOsTimer()
+{
+   if (m_timerFd != -1)
+      close(m_timerFd);
+   if (m_stopFd != -1)
+      close(m_stopFd);
+   m_timerFd = -1;
+   m_stopFd = -1;
+   m_isHighResolution = false;
+}
+
+
+bool PrecisionTimer::waitUntil(Clock::time_point deadline)
+{
+   if (deadline <= Clock::now())
+      return !m_isStopping;
+
+   // The steady clock is based on CLOCK_MONOTONIC, so its time points can be used as
+   // absolute deadlines.
+   const auto sinceEpoch =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch());
+   itimerspec spec{};
+   spec.it_value.tv_sec = static_cast<time_t>(sinceEpoch.count() / 1000000000);
+   spec.it_value.tv_nsec = static_cast<long>(sinceEpoch.count() % 1000000000);
+   if (timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+      return false;
+
+   pollfd fds[2] = {{m_timerFd, POLLIN, 0}, {m_stopFd, POLLIN, 0}};
+   for (;;)
+   {
+      const int res = poll(fds, 2, -1);
+      if (res > 0)
+         break;
+      if (res == -1 && errno != EINTR)
+         return false;
+   }
+
+   if (fds[1].revents & POLLIN)
+      return false;
+   std::uint64_t numExpirations = 0;
+   return read(m_timerFd, &numExpirations, sizeof(numExpirations)) > 0;
+}
+
+
+void PrecisionTimer::interruptWait()
+{
+   if (m_stopFd != -1)
+   {
+      const std::uint64_t one = 1;
+      [[maybe_unused]] const ssize_t res = write(m_stopFd, &one, sizeof(one));
+   }
+}
+
+#else
+
+bool PrecisionTimer::openOsTimer()
+{
+   return false;
+}
+
+
+void PrecisionTimer::closeOsTimer()
+{
+}
+
+
+bool PrecisionTimer::waitUntil(Clock::time_point)
+{
+   return false;
+}
+
+
+void PrecisionTimer::interruptWait()
+{
+}
+
+#endif //_WIN32
+
+} // namespace win32
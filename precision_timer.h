@@ -0,0 +1,124 @@
+//
+// Win32 utilities library
+// High-resolution timer.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+// Calls a function after a time-out or periodically with sub-millisecond
+// resolution.
+// Waits on a high-resolution waitable timer on Windows (requires Windows 10 1803,
+// falls back to a regular waitable timer) and on a timerfd on Linux.
+// The callback is called on a worker thread that the timer owns. The timer must not
+// be destroyed from its callback.
+class WIN32UTIL_API PrecisionTimer
+{
+ public:
+   using Clock = std::chrono::steady_clock;
+   using Duration = std::chrono::nanoseconds;
+
+   // What to do when the callback took longer than a period.
+   enum class MissedTicks
+   {
+      // Calls the callback for each missed deadline without waiting in between.
+      CatchUp,
+      // Continues with the next deadline that is still in the future.
+      Skip
+   };
+
+   struct Tick
+   {
+      // When the callback was supposed to be called.
+      Clock::time_point deadline;
+      // When the callback was actually called.
+      Clock::time_point firedAt;
+      // Number of deadlines that were skipped after this one.
+      std::uint64_t numSkipped = 0;
+   };
+
+   using Callback_t = std::function<void(const Tick&)>;
+
+ public:
+   PrecisionTimer() = default;
+   explicit PrecisionTimer(Callback_t callback);
+   ~PrecisionTimer();
+   PrecisionTimer(const PrecisionTimer&) = delete;
+   PrecisionTimer& operator=(const PrecisionTimer&) = delete;
+
+   explicit operator bool() const;
+   bool isRunning() const;
+   // Whether the OS timer has sub-millisecond resolution. Only valid after the
+   // timer was started.
+   bool isHighResolution() const;
+
+   // Deadlines of periodic timers are computed from the start time, so the timer
+   // does not drift no matter how late the callback gets called.
+   bool start(Duration period, MissedTicks policy = MissedTicks::Skip);
+   bool startOnce(Duration delay);
+   // Waits until a running callback has returned unless called from the callback.
+   void stop();
+
+ private:
+   bool launch(Clock::time_point firstDeadline, Duration period, MissedTicks policy);
+   void threadFunc(Clock::time_point firstDeadline, Duration period,
+                   MissedTicks policy);
+   bool openOsTimer();
+   void closeOsTimer();
+   // Returns false if the wait was interrupted by stop().
+   bool waitUntil(Clock::time_point deadline);
+   void interruptWait();
+
+ private:
+   Callback_t m_callback;
+   std::thread m_thread;
+   std::atomic<bool> m_isRunning = false;
+   std::atomic<bool> m_isStopping = false;
+   bool m_isHighResolution = false;
+#ifdef _WIN32
+   HANDLE m_osTimer = NULL;
+   HANDLE m_stopEvent = NULL;
+#else
+   int m_timerFd = -1;
+   int m_stopFd = -1;
+#endif
+};
+
+
+inline PrecisionTimer::PrecisionTimer(Callback_t callback)
+: m_callback{std::move(callback)}
+{
+}
+
+inline PrecisionTimer::operator bool() const
+{
+   return m_callback.operator bool();
+}
+
+inline bool PrecisionTimer::isRunning() const
+{
+   return m_isRunning.load();
+}
+
+inline bool PrecisionTimer::isHighResolution() const
+{
+   return m_isHighResolution;
+}
+
+} // namespace win32
@@ -0,0 +1,443 @@
+//
+// Win32 utilities library
+// Debouncing and throttling of high-rate events.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "clock.h"
+#ifdef _WIN32
+#include "timer.h"
+#include "win32_windows.h"
+#endif
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <variant>
+
+
+namespace win32
+{
+///////////////////
+
+// Collapses a burst of events into a single callback. A burst ends when no event
+// arrived for the wait time. The callback receives the payload of the latest event.
+// Time is read from the clock but only acted upon when the owner calls poll() at
+// the time returned by nextDeadline(). Use TimedDebouncer to drive it with a timer.
+// Not thread-safe.
+template <typename T = std::monostate> class Debouncer
+{
+ public:
+   using Payload = T;
+   using Callback_t = std::function<void(const T&)>;
+
+   static constexpr std::uint64_t NoDeadline = std::numeric_limits<std::uint64_t>::max();
+   static constexpr std::uint64_t NoMaxWait = std::numeric_limits<std::uint64_t>::max();
+
+   struct Options
+   {
+      std::uint64_t waitMs = 0;
+      // Calls back for the first event of a burst.
+      bool leading = false;
+      // Calls back with the latest event when the burst ends. Without it events
+      // after the leading one are dropped.
+      bool trailing = true;
+      // Longest time that a pending event is held back during a burst that does
+      // not end.
+      std::uint64_t maxWaitMs = NoMaxWait;
+   };
+
+ public:
+   Debouncer(const Clock& clock, const Options& options, Callback_t callback);
+   Debouncer(const Debouncer&) = delete;
+   Debouncer& operator=(const Debouncer&) = delete;
+
+   const Options& options() const;
+   bool isBurstActive() const;
+   bool hasPendingEvent() const;
+
+   void trigger(T payload = {});
+   // Time at which poll() should be called next.
+   std::uint64_t nextDeadline() const;
+   // Calls back if a deadline has passed. Returns whether the callback was called.
+   bool poll();
+   // Calls back for a pending event right away.
+   bool flush();
+   // Drops a pending event and ends the burst.
+   void cancel();
+
+ private:
+   void deliver();
+
+ private:
+   const Clock& m_clock;
+   Options m_options;
+   Callback_t m_callback;
+   // Latest event that was not delivered yet.
+   std::optional<T> m_pending;
+   bool m_isBurstActive = false;
+   std::uint64_t m_lastEvent = 0;
+   // Arrival of the oldest event that was not delivered yet.
+   std::uint64_t m_pendingSince = 0;
+};
+
+
+template <typename T>
+Debouncer<T>::Debouncer(const Clock& clock, const Options& options, Callback_t callback)
+: m_clock{clock}, m_options{options}, m_callback{std::move(callback)}
+{
+   assert(m_options.leading || m_options.trailing);
+}
+
+template <typename T>
+const typename Debouncer<T>::Options& Debouncer<T>::options() const
+{
+   return m_options;
+}
+
+template <typename T> bool Debouncer<T>::isBurstActive() const
+{
+   return m_isBurstActive;
+}
+
+template <typename T> bool Debouncer<T>::hasPendingEvent() const
+{
+   return m_pending.has_value();
+}
+
+template <typename T> void Debouncer<T>::trigger(T payload)
+{
+   // Finish a burst that ended while nobody polled.
+   poll();
+
+   const std::uint64_t now = m_clock.nowMs();
+   const bool isNewBurst = !m_isBurstActive;
+   m_isBurstActive = true;
+   m_lastEvent = now;
+
+   if (isNewBurst && m_options.leading)
+   {
+      m_callback(payload);
+      return;
+   }
+   if (!m_options.trailing)
+      return;
+
+   // Latest value wins.
+   if (!m_pending)
+      m_pendingSince = now;
+   m_pending = std::move(payload);
+}
+
+template <typename T> std::uint64_t Debouncer<T>::nextDeadline() const
+{
+   if (!m_isBurstActive)
+      return NoDeadline;
+
+   std::uint64_t deadline = m_lastEvent + m_options.waitMs;
+   if (m_pending && m_options.maxWaitMs != NoMaxWait)
+      deadline = std::min(deadline, m_pendingSince + m_options.maxWaitMs);
+   return deadline;
+}
+
+template <typename T> bool Debouncer<T>::poll()
+{
+   if (!m_isBurstActive)
+      return false;
+
+   const std::uint64_t now = m_clock.nowMs();
+   if (now - m_lastEvent >= m_options.waitMs)
+   {
+      m_isBurstActive = false;
+      if (!m_pending)
+         return false;
+      deliver();
+      return true;
+   }
+
+   if (m_pending && m_options.maxWaitMs != NoMaxWait &&
+       now - m_pendingSince >= m_options.maxWaitMs)
+   {
+      deliver();
+      return true;
+   }
+   return false;
+}
+
+template <typename T> bool Debouncer<T>::flush()
+{
+   if (!m_pending)
+      return false;
+   deliver();
+   return true;
+}
+
+template <typename T> void Debouncer<T>::cancel()
+{
+   m_pending.reset();
+   m_isBurstActive = false;
+}
+
+template <typename T> void Debouncer<T>::deliver()
+{
+   // The callback can trigger new events.
+   T payload = std::move(*m_pending);
+   m_pending.reset();
+   m_callback(payload);
+}
+
+
+///////////////////
+
+// Limits callbacks to one per interval no matter how often events arrive. Events
+// that arrive while the interval is running are collapsed into the latest one.
+// Driven like Debouncer. Use TimedThrottler to drive it with a timer.
+// Not thread-safe.
+template <typename T = std::monostate> class Throttler
+{
+ public:
+   using Payload = T;
+   using Callback_t = std::function<void(const T&)>;
+
+   static constexpr std::uint64_t NoDeadline = std::numeric_limits<std::uint64_t>::max();
+
+   struct Options
+   {
+      std::uint64_t intervalMs = 0;
+      // Calls back for an event that starts an interval.
+      bool leading = true;
+      // Calls back with the latest event received during an interval when the
+      // interval ends.
+      bool trailing = true;
+   };
+
+ public:
+   Throttler(const Clock& clock, const Options& options, Callback_t callback);
+   Throttler(const Throttler&) = delete;
+   Throttler& operator=(const Throttler&) = delete;
+
+   const Options& options() const;
+   bool isIntervalActive() const;
+   bool hasPendingEvent() const;
+
+   void trigger(T payload = {});
+   std::uint64_t nextDeadline() const;
+   bool poll();
+   bool flush();
+   void cancel();
+
+ private:
+   void deliver();
+
+ private:
+   const Clock& m_clock;
+   Options m_options;
+   Callback_t m_callback;
+   std::optional<T> m_pending;
+   bool m_isIntervalActive = false;
+   std::uint64_t m_intervalStart = 0;
+};
+
+
+template <typename T>
+Throttler<T>::Throttler(const Clock& clock, const Options& options, Callback_t callback)
+: m_clock{clock}, m_options{options}, m_callback{std::move(callback)}
+{
+   assert(m_options.leading || m_options.trailing);
+}
+
+template <typename T>
+const typename Throttler<T>::Options& Throttler<T>::options() const
+{
+   return m_options;
+}
+
+template <typename T> bool Throttler<T>::isIntervalActive() const
+{
+   return m_isIntervalActive;
+}
+
+template <typename T> bool Throttler<T>::hasPendingEvent() const
+{
+   return m_pending.has_value();
+}
+
+template <typename T> void Throttler<T>::trigger(T payload)
+{
+   // Finish an interval that ended while nobody polled.
+   poll();
+
+   if (!m_isIntervalActive)
+   {
+      m_isIntervalActive = true;
+      m_intervalStart = m_clock.nowMs();
+      if (m_options.leading)
+      {
+         m_callback(payload);
+         return;
+      }
+   }
+
+   if (m_options.trailing)
+      m_pending = std::move(payload);
+}
+
+template <typename T> std::uint64_t Throttler<T>::nextDeadline() const
+{
+   return m_isIntervalActive ? m_intervalStart + m_options.intervalMs : NoDeadline;
+}
+
+template <typename T> bool Throttler<T>::poll()
+{
+   if (!m_isIntervalActive)
+      return false;
+
+   const std::uint64_t now = m_clock.nowMs();
+   if (now - m_intervalStart < m_options.intervalMs)
+      return false;
+
+   if (!m_pending)
+   {
+      m_isIntervalActive = false;
+      return false;
+   }
+
+   // The trailing call starts the next interval to keep the rate bounded.
+   m_intervalStart = now;
+   deliver();
+   return true;
+}
+
+template <typename T> bool Throttler<T>::flush()
+{
+   if (!m_pending)
+      return false;
+   deliver();
+   return true;
+}
+
+template <typename T> void Throttler<T>::cancel()
+{
+   m_pending.reset();
+   m_isIntervalActive = false;
+}
+
+template <typename T> void Throttler<T>::deliver()
+{
+   T payload = std::move(*m_pending);
+   m_pending.reset();
+   m_callback(payload);
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Drives a debouncer or throttler with a TimedCallback that is programmed for the
+// next deadline. Needs a message loop to work.
+template <typename Limiter> class TimedRateLimiter
+{
+ public:
+   using Payload = typename Limiter::Payload;
+   using Options = typename Limiter::Options;
+   using Callback_t = typename Limiter::Callback_t;
+
+ public:
+   TimedRateLimiter(const Options& options, Callback_t callback,
+                    const Clock& clock = steadyClock());
+   TimedRateLimiter(const TimedRateLimiter&) = delete;
+   TimedRateLimiter& operator=(const TimedRateLimiter&) = delete;
+
+   const Limiter& limiter() const;
+
+   void trigger(Payload payload = {});
+   bool flush();
+   void cancel();
+
+ private:
+   void onTimer();
+   void reprogram();
+
+ private:
+   const Clock& m_clock;
+   Limiter m_limiter;
+   TimedCallback m_timer;
+   bool m_isInTimer = false;
+};
+
+
+template <typename T = std::monostate>
+using TimedDebouncer = TimedRateLimiter<Debouncer<T>>;
+template <typename T = std::monostate>
+using TimedThrottler = TimedRateLimiter<Throttler<T>>;
+
+
+template <typename Limiter>
+TimedRateLimiter<Limiter>::TimedRateLimiter(const Options& options, Callback_t callback,
+                                            const Clock& clock)
+: m_clock{clock}, m_limiter{clock, options, std::move(callback)},
+  m_timer{[this](DWORD) { onTimer(); }}
+{
+}
+
+template <typename Limiter> const Limiter& TimedRateLimiter<Limiter>::limiter() const
+{
+   return m_limiter;
+}
+
+template <typename Limiter> void TimedRateLimiter<Limiter>::trigger(Payload payload)
+{
+   m_limiter.trigger(std::move(payload));
+   reprogram();
+}
+
+template <typename Limiter> bool TimedRateLimiter<Limiter>::flush()
+{
+   const bool res = m_limiter.flush();
+   reprogram();
+   return res;
+}
+
+template <typename Limiter> void TimedRateLimiter<Limiter>::cancel()
+{
+   m_limiter.cancel();
+   reprogram();
+}
+
+template <typename Limiter> void TimedRateLimiter<Limiter>::onTimer()
+{
+   m_isInTimer = true;
+   m_limiter.poll();
+   m_isInTimer = false;
+   reprogram();
+}
+
+template <typename Limiter> void TimedRateLimiter<Limiter>::reprogram()
+{
+   // Callbacks that trigger events are handled once after the timer call.
+   if (m_isInTimer)
+      return;
+
+   const std::uint64_t deadline = m_limiter.nextDeadline();
+   if (deadline == Limiter::NoDeadline)
+   {
+      m_timer.stop();
+      return;
+   }
+
+   const std::uint64_t now = m_clock.nowMs();
+   const std::uint64_t delay = (deadline > now) ? deadline - now : 0;
+   const auto timeOutMs = static_cast<unsigned int>(
+      std::clamp<std::uint64_t>(delay, USER_TIMER_MINIMUM, USER_TIMER_MAXIMUM));
+   m_timer.start(timeOutMs);
+}
+
+#endif //_WIN32
+
+} // namespace win32
@@ -5,10 +5,16 @@
 // Jun-2019, Michael Lindner
 // MIT license
 //
-#ifdef _WIN32
 #include "registry.h"
-#include "essentutils/string_util.h"
+#include "alloc_stats.h"
+#include "trace.h"
 #include <cassert>
+#include <cstring>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+using namespace win32;
 
 
 namespace
@@ -17,7 +23,8 @@ namespace
 
 // Reads value of integer type from given registry entry.
 template <typename Int>
-std::optional<Int> readInt(HKEY key, const std::wstring& entryName)
+std::optional<Int> readInt(RegBackend* backend, RegHandle key,
+                           const std::wstring& entryName)
 {
    static_assert(std::is_integral_v<Int> && (sizeof(Int) == 4 || sizeof(Int) == 8));
 
@@ -25,12 +32,12 @@ std::optional<Int> readInt(HKEY key, const std::wstring& entryName)
       return {};
 
    Int value = 0;
-   DWORD numBytes = sizeof(value);
-   DWORD entryType = REG_NONE;
-   const LSTATUS res = RegQueryValueExW(key, entryName.c_str(), nullptr, &entryType,
-                                        reinterpret_cast<BYTE*>(&value), &numBytes);
-   constexpr DWORD expectedEntryType = (sizeof(Int) == 4) ? REG_DWORD : REG_QWORD;
-   if (res != ERROR_SUCCESS || entryType != expectedEntryType)
+   std::size_t numBytes = sizeof(value);
+   RegValueType entryType = RegValueType::None;
+   const bool ok = backend->queryValue(key, entryName, &entryType, &value, &numBytes);
+   constexpr RegValueType expectedEntryType =
+      (sizeof(Int) == 4) ? RegValueType::Dword : RegValueType::Qword;
+   if (!ok || entryType != expectedEntryType)
       return {};
 
    assert(numBytes == sizeof(value));
@@ -39,17 +46,17 @@ std::optional<Int> readInt(HKEY key, const std::wstring& entryName)
 
 
 // Writes value of integer type to given registry entry.
-template <typename Int> bool writeInt(HKEY key, const std::wstring& entryName, Int val)
+template <typename Int>
+bool writeInt(RegBackend* backend, RegHandle key, const std::wstring& entryName, Int val)
 {
    static_assert(std::is_integral_v<Int> && (sizeof(Int) == 4 || sizeof(Int) == 8));
 
    if (!key)
       return false;
 
-   constexpr DWORD entryType = (sizeof(Int) == 4) ? REG_DWORD : REG_QWORD;
-   const LSTATUS res = RegSetValueExW(key, entryName.c_str(), 0, entryType,
-                                      reinterpret_cast<const BYTE*>(&val), sizeof(val));
-   return (res == ERROR_SUCCESS);
+   constexpr RegValueType entryType =
+      (sizeof(Int) == 4) ? RegValueType::Dword : RegValueType::Qword;
+   return backend->setValue(key, entryName, entryType, &val, sizeof(val));
 }
 
 } // namespace
@@ -59,10 +66,93 @@ namespace win32
 {
 ///////////////////
 
+RegSubkeyRange::iterator::iterator(RegBackend* backend, RegHandle key)
+: m_backend{backend}, m_key{key}
+{
+   read();
+}
+
+
+RegSubkeyRange::iterator& RegSubkeyRange::iterator::operator++()
+{
+   assert(m_state == RegEnumResult::Read);
+   ++m_idx;
+   read();
+   return *this;
+}
+
+
+void RegSubkeyRange::iterator::read()
+{
+   m_state = m_backend ? m_backend->enumSubkey(m_key, m_idx, m_name)
+                       : RegEnumResult::End;
+}
+
+
+RegSubkeyRange::RegSubkeyRange(RegBackend* backend, RegHandle key)
+: m_backend{backend}, m_key{key}
+{
+}
+
+
+RegSubkeyRange::iterator RegSubkeyRange::begin() const
+{
+   return iterator{m_backend, m_key};
+}
+
+
+///////////////////
+
+RegEntryRange::iterator::iterator(RegBackend* backend, RegHandle key)
+: m_backend{backend}, m_key{key}
+{
+   read();
+}
+
+
+RegEntryRange::iterator& RegEntryRange::iterator::operator++()
+{
+   assert(m_state == RegEnumResult::Read);
+   ++m_idx;
+   read();
+   return *this;
+}
+
+
+void RegEntryRange::iterator::read()
+{
+   m_state = m_backend ? m_backend->enumValue(m_key, m_idx, m_name, &m_type, &m_numBytes)
+                       : RegEnumResult::End;
+}
+
+
+RegEntryRange::RegEntryRange(RegBackend* backend, RegHandle key)
+: m_backend{backend}, m_key{key}
+{
+}
+
+
+RegEntryRange::iterator RegEntryRange::begin() const
+{
+   return iterator{m_backend, m_key};
+}
+
+
+///////////////////
+
+#ifdef _WIN32
 RegKey::RegKey(HKEY parent, const std::wstring& keyPath, REGSAM accessRights)
 {
    create(parent, keyPath, accessRights);
 }
+#endif
+
+
+RegKey::RegKey(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+               RegAccess accessRights)
+{
+   create(backend, parent, keyPath, accessRights);
+}
 
 
 RegKey::~RegKey()
@@ -81,10 +171,12 @@ RegKey& RegKey::operator=(RegKey&& other) noexcept
 {
    close();
 
+   m_backend = other.m_backend;
    m_key = other.m_key;
    m_created = other.m_created;
    // Make sure dtor of moved-from object does nothing.
-   other.m_key = NULL;
+   other.m_backend = nullptr;
+   other.m_key = 0;
    other.m_created = false;
    return *this;
 }
@@ -92,39 +184,56 @@ RegKey& RegKey::operator=(RegKey&& other) noexcept
 
 void swap(RegKey& a, RegKey& b) noexcept
 {
+   std::swap(a.m_backend, b.m_backend);
    std::swap(a.m_key, b.m_key);
    std::swap(a.m_created, b.m_created);
 }
 
 
+#ifdef _WIN32
 bool RegKey::create(HKEY parent, const std::wstring& keyPath, REGSAM accessRights)
 {
+   return create(win32RegBackend(), toRegHandle(parent), keyPath, accessRights);
+}
+
+
+bool RegKey::open(HKEY parent, const std::wstring& keyPath, REGSAM accessRights)
+{
+   return open(win32RegBackend(), toRegHandle(parent), keyPath, accessRights);
+}
+#endif
+
+
+bool RegKey::create(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+                    RegAccess accessRights)
+{
+   WIN32UTIL_TRACE_ZONE("RegKey::create", "registry");
+
    close();
 
-   DWORD disposition = 0;
-   const LSTATUS res = RegCreateKeyExW(parent, keyPath.c_str(), 0, nullptr, 0,
-                                       accessRights, nullptr, &m_key, &disposition);
-   if (res != ERROR_SUCCESS)
-   {
-      m_key = NULL;
+   bool created = false;
+   m_key = backend.createKey(parent, keyPath, accessRights, &created);
+   if (!m_key)
       return false;
-   }
 
-   m_created = (disposition == REG_CREATED_NEW_KEY);
+   m_backend = &backend;
+   m_created = created;
    return true;
 }
 
 
-bool RegKey::open(HKEY parent, const std::wstring& keyPath, REGSAM accessRights)
+bool RegKey::open(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+                  RegAccess accessRights)
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::open", "registry");
+
    close();
 
-   const LSTATUS res = RegOpenKeyExW(parent, keyPath.c_str(), 0, accessRights, &m_key);
-   if (res != ERROR_SUCCESS)
-   {
-      m_key = NULL;
+   m_key = backend.openKey(parent, keyPath, accessRights);
+   if (!m_key)
       return false;
-   }
+
+   m_backend = &backend;
    return true;
 }
 
@@ -133,289 +242,322 @@ void RegKey::close()
 {
    if (m_key)
    {
-      RegCloseKey(m_key);
-      m_key = NULL;
+      m_backend->closeKey(m_key);
+      m_key = 0;
    }
+   m_backend = nullptr;
 }
 
 
 void RegKey::clear()
 {
-   m_key = NULL;
+   m_backend = nullptr;
+   m_key = 0;
    m_created = false;
 }
 
 
+#ifdef _WIN32
 bool RegKey::keyExists(HKEY parent, const std::wstring& keyPath)
 {
-   RegKey key;
-   return key.open(parent, keyPath, KEY_READ);
+   return keyExists(win32RegBackend(), toRegHandle(parent), keyPath);
 }
 
 
 bool RegKey::removeKey(HKEY parent, const std::wstring& keyPath)
 {
-   const LSTATUS res = RegDeleteTreeW(parent, keyPath.c_str());
-   return (res == ERROR_SUCCESS);
+   return removeKey(win32RegBackend(), toRegHandle(parent), keyPath);
 }
+#endif
 
 
-std::optional<int32_t> RegKey::readInt32(const std::wstring& entryName) const
+bool RegKey::keyExists(RegBackend& backend, RegHandle parent,
+                       const std::wstring& keyPath)
 {
-   return readInt<int32_t>(m_key, entryName);
+   WIN32UTIL_TRACE_ZONE("RegKey::keyExists", "registry");
+
+   RegKey key;
+   return key.open(backend, parent, keyPath, RegAccessRead);
 }
 
 
-std::optional<int64_t> RegKey::readInt64(const std::wstring& entryName) const
+bool RegKey::removeKey(RegBackend& backend, RegHandle parent,
+                       const std::wstring& keyPath)
 {
-   return readInt<int64_t>(m_key, entryName);
+   WIN32UTIL_TRACE_ZONE("RegKey::removeKey", "registry");
+
+   return backend.removeKey(parent, keyPath);
 }
 
 
-std::optional<std::string> RegKey::readString(const std::wstring& entryName) const
+std::optional<int32_t> RegKey::readInt32(const std::wstring& entryName) const
 {
-   if (!m_key)
-      return {};
+   WIN32UTIL_TRACE_ZONE("RegKey::readInt32", "registry");
 
-   const std::string entryNameAnsi = sutil::utf8(entryName);
+   return readInt<int32_t>(m_backend, m_key, entryName);
+}
 
-   DWORD numBytes = 0;
-   DWORD entryType = REG_NONE;
-   LSTATUS res = RegQueryValueExA(m_key, entryNameAnsi.c_str(), nullptr, &entryType,
-                                  nullptr, &numBytes);
-   if (res != ERROR_SUCCESS || entryType != REG_SZ)
-      return {};
 
-   constexpr size_t charBytes = sizeof(char);
-   assert(numBytes % charBytes == 0);
-   const std::size_t strLen = numBytes / charBytes;
+std::optional<int64_t> RegKey::readInt64(const std::wstring& entryName) const
+{
+   WIN32UTIL_TRACE_ZONE("RegKey::readInt64", "registry");
+
+   return readInt<int64_t>(m_backend, m_key, entryName);
+}
+
+
+std::optional<std::string> RegKey::readString(const std::wstring& entryName) const
+{
+   WIN32UTIL_TRACE_ZONE("RegKey::readString", "registry");
 
-   // '+ 1' for additional zero terminator to make sure the string is well formed.
-   std::vector<char> buffer(strLen + 1, 0);
-   DWORD numReadBytes = static_cast<DWORD>(buffer.size());
-   res = RegQueryValueExA(m_key, entryNameAnsi.c_str(), nullptr, nullptr,
-                          reinterpret_cast<BYTE*>(buffer.data()), &numReadBytes);
-   if (res != ERROR_SUCCESS || numReadBytes != numBytes)
+   if (!m_key)
       return {};
 
-   assert(numReadBytes == numBytes);
-   *buffer.rbegin() = 0;
-   return buffer.data();
+   return m_backend->readString(m_key, entryName);
 }
 
 std::optional<std::wstring> RegKey::readWString(const std::wstring& entryName) const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::readWString", "registry");
+
+   // Most values fit into the buffer on the stack and are read with a single query.
+   wchar_t inlineBuffer[RegInlineReadBytes / sizeof(wchar_t)];
+   std::size_t requiredLength = 0;
+   if (const auto str = readWString(entryName, inlineBuffer, &requiredLength))
+      return std::wstring{*str};
+
+   // Repeat while the value keeps growing between the queries.
+   ScopedAllocSite site{"RegKey::readWString"};
+   std::pmr::vector<wchar_t> buffer(allocResource(AllocTag::Registry));
+   while (requiredLength > buffer.size())
+   {
+      buffer.resize(requiredLength);
+      requiredLength = 0;
+      if (const auto str = readWString(entryName, buffer, &requiredLength))
+         return std::wstring{*str};
+   }
+   return {};
+}
+
+
+std::optional<std::wstring_view> RegKey::readWString(const std::wstring& entryName,
+                                                     std::span<wchar_t> buffer,
+                                                     std::size_t* requiredLength) const
+{
+   if (requiredLength)
+      *requiredLength = 0;
    if (!m_key)
       return {};
 
-   DWORD numBytes = 0;
-   DWORD entryType = REG_NONE;
-   LSTATUS res =
-      RegQueryValueExW(m_key, entryName.c_str(), nullptr, &entryType, nullptr, &numBytes);
-   if (res != ERROR_SUCCESS || entryType != REG_SZ)
+   RegValueType entryType = RegValueType::None;
+   std::size_t numBytes = buffer.size_bytes();
+   const RegQueryResult res =
+      queryRegValue(*m_backend, m_key, entryName, &entryType, buffer.data(), &numBytes);
+   if (entryType != RegValueType::String)
       return {};
 
-   constexpr size_t charBytes = sizeof(wchar_t);
-   assert(numBytes % charBytes == 0);
-   const std::size_t strLen = numBytes / charBytes;
-
-   // '+ 1' for additional zero terminator to make sure the string is well formed.
-   std::vector<wchar_t> buffer(strLen + 1);
-   DWORD numReadBytes = static_cast<DWORD>(buffer.size()) * sizeof(wchar_t);
-   res = RegQueryValueExW(m_key, entryName.c_str(), nullptr, nullptr,
-                          reinterpret_cast<BYTE*>(buffer.data()), &numReadBytes);
-   if (res != ERROR_SUCCESS || numReadBytes != numBytes)
+   constexpr std::size_t charBytes = sizeof(wchar_t);
+   if (res == RegQueryResult::BufferTooSmall && requiredLength)
+      *requiredLength = (numBytes + charBytes - 1) / charBytes;
+   if (res != RegQueryResult::Read)
       return {};
 
-   assert(numReadBytes == numBytes);
-   *buffer.rbegin() = 0;
-   return buffer.data();
+   const std::wstring_view str{buffer.data(), numBytes / charBytes};
+   return str.substr(0, str.find(L'\0'));
 }
 
 
 std::size_t RegKey::readBinary(const std::wstring& entryName,
-                               std::function<BYTE*(std::size_t)> getBuffer) const
+                               std::function<unsigned char*(std::size_t)> getBuffer) const
 {
-   if (!m_key)
-      return 0;
+   WIN32UTIL_TRACE_ZONE("RegKey::readBinary", "registry");
 
-   DWORD numBytes = 0;
-   DWORD entryType = REG_NONE;
-   LSTATUS res =
-      RegQueryValueExW(m_key, entryName.c_str(), nullptr, &entryType, nullptr, &numBytes);
-   if (res != ERROR_SUCCESS || entryType != REG_BINARY)
+   // Small values are read into the buffer on the stack with a single query and then
+   // copied.
+   unsigned char inlineBuffer[RegInlineReadBytes];
+   std::size_t requiredBytes = 0;
+   if (const auto data = readBinary(entryName, inlineBuffer, &requiredBytes))
+   {
+      unsigned char* buffer = getBuffer(data->size());
+      if (!buffer)
+         return 0;
+      if (!data->empty())
+         std::memcpy(buffer, data->data(), data->size());
+      return data->size();
+   }
+   if (requiredBytes == 0)
       return 0;
 
-   BYTE* buffer = getBuffer(numBytes);
+   unsigned char* buffer = getBuffer(requiredBytes);
    if (!buffer)
       return 0;
-   DWORD numReadBytes = numBytes;
-   res =
-      RegQueryValueExW(m_key, entryName.c_str(), nullptr, nullptr, buffer, &numReadBytes);
-   if (res != ERROR_SUCCESS || numReadBytes != numBytes)
-      return 0;
+   const auto data = readBinary(entryName, {buffer, requiredBytes});
+   return data ? data->size() : 0;
+}
 
-   return numReadBytes;
+
+std::optional<std::span<unsigned char>>
+RegKey::readBinary(const std::wstring& entryName, std::span<unsigned char> buffer,
+                   std::size_t* requiredBytes) const
+{
+   if (requiredBytes)
+      *requiredBytes = 0;
+   if (!m_key)
+      return {};
+
+   RegValueType entryType = RegValueType::None;
+   std::size_t numBytes = buffer.size();
+   const RegQueryResult res =
+      queryRegValue(*m_backend, m_key, entryName, &entryType, buffer.data(), &numBytes);
+   if (entryType != RegValueType::Binary)
+      return {};
+
+   if (res == RegQueryResult::BufferTooSmall && requiredBytes)
+      *requiredBytes = numBytes;
+   if (res != RegQueryResult::Read)
+      return {};
+   return buffer.first(numBytes);
 }
 
 
 bool RegKey::writeInt32(const std::wstring& entryName, int32_t val) const
 {
-   return writeInt(m_key, entryName, val);
+   WIN32UTIL_TRACE_ZONE("RegKey::writeInt32", "registry");
+
+   return writeInt(m_backend, m_key, entryName, val);
 }
 
 
 bool RegKey::writeInt64(const std::wstring& entryName, int64_t val) const
 {
-   return writeInt(m_key, entryName, val);
+   WIN32UTIL_TRACE_ZONE("RegKey::writeInt64", "registry");
+
+   return writeInt(m_backend, m_key, entryName, val);
 }
 
 
 bool RegKey::writeString(const std::wstring& entryName, const std::string& val) const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::writeString", "registry");
+
    if (!m_key)
       return {};
 
-   const std::size_t numBytes = (val.size() + 1) * sizeof(char);
-   const LSTATUS res = RegSetValueExA(m_key, sutil::utf8(entryName).c_str(), 0, REG_SZ,
-                                      reinterpret_cast<const BYTE*>(val.c_str()),
-                                      static_cast<DWORD>(numBytes));
-   return (res == ERROR_SUCCESS);
+   return m_backend->writeString(m_key, entryName, val);
 }
 
 
 bool RegKey::writeWString(const std::wstring& entryName, const std::wstring& val) const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::writeWString", "registry");
+
    if (!m_key)
       return {};
 
    const std::size_t numBytes = (val.size() + 1) * sizeof(wchar_t);
-   const LSTATUS res = RegSetValueExW(m_key, entryName.c_str(), 0, REG_SZ,
-                                      reinterpret_cast<const BYTE*>(val.c_str()),
-                                      static_cast<DWORD>(numBytes));
-   return (res == ERROR_SUCCESS);
+   return m_backend->setValue(m_key, entryName, RegValueType::String, val.c_str(),
+                              numBytes);
 }
 
 
-bool RegKey::writeBinary(const std::wstring& entryName, const BYTE* data,
+bool RegKey::writeBinary(const std::wstring& entryName, const unsigned char* data,
                          std::size_t numBytes) const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::writeBinary", "registry");
+
    if (!m_key)
       return {};
 
-   const LSTATUS res = RegSetValueExW(m_key, entryName.c_str(), 0, REG_BINARY, data,
-                                      static_cast<DWORD>(numBytes));
-   return (res == ERROR_SUCCESS);
+   return m_backend->setValue(m_key, entryName, RegValueType::Binary, data, numBytes);
 }
 
 
 bool RegKey::removeEntry(const std::wstring& entryName) const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::removeEntry", "registry");
+
    if (!m_key)
       return {};
 
-   const LSTATUS res = RegDeleteValueW(m_key, entryName.c_str());
-   return (res == ERROR_SUCCESS);
+   return m_backend->removeValue(m_key, entryName);
 }
 
 
-std::size_t RegKey::countSubkeys() const
+std::optional<RegKeyInfo> RegKey::info() const
 {
+   WIN32UTIL_TRACE_ZONE("RegKey::info", "registry");
+
    if (!m_key)
-      return 0;
+      return {};
 
-   DWORD numSubkeys = 0;
-   const LSTATUS res =
-      RegQueryInfoKeyW(m_key, nullptr, nullptr, nullptr, &numSubkeys, nullptr, nullptr,
-                       nullptr, nullptr, nullptr, nullptr, nullptr);
-   if (res != ERROR_SUCCESS)
-      return 0;
-   return numSubkeys;
+   return m_backend->queryKeyInfo(m_key);
 }
 
 
-std::vector<std::wstring> RegKey::subkeyNames() const
+std::size_t RegKey::countSubkeys() const
 {
-   if (!m_key)
-      return {};
+   WIN32UTIL_TRACE_ZONE("RegKey::countSubkeys", "registry");
 
-   DWORD maxSubkeyNameLen = 0;
-   LSTATUS res =
-      RegQueryInfoKeyW(m_key, nullptr, nullptr, nullptr, nullptr, &maxSubkeyNameLen,
-                       nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
-   if (res != ERROR_SUCCESS)
-      return {};
+   const std::optional<RegKeyInfo> keyInfo = info();
+   return keyInfo ? keyInfo->numSubkeys : 0;
+}
 
-   maxSubkeyNameLen += 1;
-   std::vector<wchar_t> buffer(maxSubkeyNameLen, 0);
 
-   std::vector<std::wstring> subkeys;
-   DWORD idx = 0;
-   DWORD nameLen = maxSubkeyNameLen;
+std::vector<std::wstring> RegKey::subkeyNames() const
+{
+   WIN32UTIL_TRACE_ZONE("RegKey::subkeyNames", "registry");
+
+   std::vector<std::wstring> names;
+   const RegSubkeyRange range = subkeys();
+   auto it = range.begin();
+   for (; it != range.end(); ++it)
+      names.emplace_back(*it);
+   return it.hasFailed() ? std::vector<std::wstring>{} : names;
+}
 
-   while (res == ERROR_SUCCESS)
-   {
-      nameLen = maxSubkeyNameLen;
-      res = RegEnumKeyExW(m_key, idx++, buffer.data(), &nameLen, nullptr, nullptr,
-                          nullptr, nullptr);
-      if (res == ERROR_SUCCESS)
-         subkeys.push_back(buffer.data());
-   }
 
-   if (res == ERROR_SUCCESS || res == ERROR_NO_MORE_ITEMS)
-      return subkeys;
-   return {};
+RegSubkeyRange RegKey::subkeys() const
+{
+   return RegSubkeyRange{m_key ? m_backend : nullptr, m_key};
 }
 
 
 std::size_t RegKey::countEntries() const
 {
-   if (!m_key)
-      return 0;
+   WIN32UTIL_TRACE_ZONE("RegKey::countEntries", "registry");
 
-   DWORD numEntries = 0;
-   const LSTATUS res =
-      RegQueryInfoKeyW(m_key, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-                       &numEntries, nullptr, nullptr, nullptr, nullptr);
-   if (res != ERROR_SUCCESS)
-      return 0;
-   return numEntries;
+   const std::optional<RegKeyInfo> keyInfo = info();
+   return keyInfo ? keyInfo->numValues : 0;
 }
 
 
 std::vector<std::wstring> RegKey::entryNames() const
 {
-   if (!m_key)
-      return {};
+   WIN32UTIL_TRACE_ZONE("RegKey::entryNames", "registry");
+
+   std::vector<std::wstring> names;
+   const RegEntryRange range = entries();
+   auto it = range.begin();
+   for (; it != range.end(); ++it)
+      names.emplace_back((*it).name);
+   return it.hasFailed() ? std::vector<std::wstring>{} : names;
+}
 
-   DWORD maxEntryNameLen = 0;
-   LSTATUS res =
-      RegQueryInfoKeyW(m_key, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-                       nullptr, &maxEntryNameLen, nullptr, nullptr, nullptr);
-   if (res != ERROR_SUCCESS)
-      return {};
 
-   maxEntryNameLen += 1;
-   std::vector<wchar_t> buffer(maxEntryNameLen, 0);
+RegEntryRange RegKey::entries() const
+{
+   return RegEntryRange{m_key ? m_backend : nullptr, m_key};
+}
 
-   std::vector<std::wstring> entries;
-   DWORD idx = 0;
-   DWORD nameLen = maxEntryNameLen;
 
-   while (res == ERROR_SUCCESS)
-   {
-      nameLen = maxEntryNameLen;
-      res = RegEnumValueW(m_key, idx++, buffer.data(), &nameLen, nullptr, nullptr,
-                          nullptr, nullptr);
-      if (res == ERROR_SUCCESS)
-         entries.push_back(buffer.data());
-   }
+std::optional<RegSnapshot> RegKey::readAll() const
+{
+   WIN32UTIL_TRACE_ZONE("RegKey::readAll", "registry");
 
-   if (res == ERROR_SUCCESS || res == ERROR_NO_MORE_ITEMS)
-      return entries;
-   return {};
+   if (!m_key)
+      return {};
+
+   return m_backend->readAllValues(m_key);
 }
 
 } // namespace win32
-
-#endif //_WIN32
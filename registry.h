@@ -6,28 +6,146 @@
 // MIT license
 //
 #pragma once
-#ifdef _WIN32
+#include "registry_backend.h"
 #include "win32_util_api.h"
+#ifdef _WIN32
 #include "win32_windows.h"
+#endif
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 
 namespace win32
 {
 ///////////////////
 
+// Input range over the names of the subkeys of a key. Iterators reuse one name buffer,
+// so a name is only valid until its iterator is advanced. The enumeration ends after
+// the last subkey or at the first error. Subkeys added or removed while enumerating
+// can be missed, like with RegEnumKeyEx.
+class WIN32UTIL_API RegSubkeyRange
+{
+ public:
+   class WIN32UTIL_API iterator
+   {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = std::wstring_view;
+      using difference_type = std::ptrdiff_t;
+
+    public:
+      iterator() = default;
+      iterator(RegBackend* backend, RegHandle key);
+
+      std::wstring_view operator*() const;
+      iterator& operator++();
+      void operator++(int);
+      bool operator==(std::default_sentinel_t) const;
+      // Whether the enumeration ended because of an error.
+      bool hasFailed() const;
+
+    private:
+      void read();
+
+    private:
+      RegBackend* m_backend = nullptr;
+      RegHandle m_key = 0;
+      std::size_t m_idx = 0;
+      std::wstring m_name;
+      RegEnumResult m_state = RegEnumResult::End;
+   };
+
+ public:
+   RegSubkeyRange(RegBackend* backend, RegHandle key);
+
+   iterator begin() const;
+   std::default_sentinel_t end() const;
+
+ private:
+   RegBackend* m_backend = nullptr;
+   RegHandle m_key = 0;
+};
+
+
+// Name, type and size of a registry entry.
+struct RegEntryInfo
+{
+   std::wstring_view name;
+   RegValueType type = RegValueType::None;
+   std::size_t numBytes = 0;
+};
+
+
+// Input range over the entries of a key. Works like RegSubkeyRange but also yields
+// the type and size of each entry. Data is not read.
+class WIN32UTIL_API RegEntryRange
+{
+ public:
+   class WIN32UTIL_API iterator
+   {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = RegEntryInfo;
+      using difference_type = std::ptrdiff_t;
+
+    public:
+      iterator() = default;
+      iterator(RegBackend* backend, RegHandle key);
+
+      RegEntryInfo operator*() const;
+      iterator& operator++();
+      void operator++(int);
+      bool operator==(std::default_sentinel_t) const;
+      // Whether the enumeration ended because of an error.
+      bool hasFailed() const;
+
+    private:
+      void read();
+
+    private:
+      RegBackend* m_backend = nullptr;
+      RegHandle m_key = 0;
+      std::size_t m_idx = 0;
+      std::wstring m_name;
+      RegValueType m_type = RegValueType::None;
+      std::size_t m_numBytes = 0;
+      RegEnumResult m_state = RegEnumResult::End;
+   };
+
+ public:
+   RegEntryRange(RegBackend* backend, RegHandle key);
+
+   iterator begin() const;
+   std::default_sentinel_t end() const;
+
+ private:
+   RegBackend* m_backend = nullptr;
+   RegHandle m_key = 0;
+};
+
+
+///////////////////
+
 // Represents a registry key.
 // RAII for opening/closing key.
+// Keys are stored by a backend. The ones opened from HKEYs use the system registry.
 class WIN32UTIL_API RegKey
 {
  public:
    RegKey() = default;
+#ifdef _WIN32
    RegKey(HKEY parent, const std::wstring& keyPath, REGSAM accessRights = KEY_ALL_ACCESS);
+#endif
+   RegKey(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+          RegAccess accessRights = RegAccessAll);
    ~RegKey();
    RegKey(const RegKey&) = delete;
    RegKey(RegKey&& other) noexcept;
@@ -35,21 +153,38 @@ class WIN32UTIL_API RegKey
    RegKey& operator=(RegKey&& other) noexcept;
 
    explicit operator bool() const;
+#ifdef _WIN32
+   // Null for keys of other backends.
    operator HKEY() const;
    HKEY hkey() const;
+#endif
+   RegBackend* backend() const;
+   RegHandle handle() const;
    friend WIN32UTIL_API void swap(RegKey& a, RegKey& b) noexcept;
 
+#ifdef _WIN32
    bool create(HKEY parent, const std::wstring& keyPath,
                REGSAM accessRights = KEY_ALL_ACCESS);
    bool open(HKEY parent, const std::wstring& keyPath,
              REGSAM accessRights = KEY_ALL_ACCESS);
+#endif
+   bool create(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+               RegAccess accessRights = RegAccessAll);
+   bool open(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+             RegAccess accessRights = RegAccessAll);
    void close();
-   // Clears the stored HKEY handle without closing the key, if it is open.
+   // Clears the stored handle without closing the key, if it is open.
    void clear();
    bool wasCreated() const;
    bool wasOpened() const;
+#ifdef _WIN32
    static bool keyExists(HKEY parent, const std::wstring& keyPath);
    static bool removeKey(HKEY parent, const std::wstring& keyPath);
+#endif
+   static bool keyExists(RegBackend& backend, RegHandle parent,
+                         const std::wstring& keyPath);
+   static bool removeKey(RegBackend& backend, RegHandle parent,
+                         const std::wstring& keyPath);
 
    std::optional<int32_t> readInt32(const std::wstring& entryName) const;
    std::optional<int64_t> readInt64(const std::wstring& entryName) const;
@@ -58,37 +193,121 @@ class WIN32UTIL_API RegKey
    // Reads binary data from given entry. The function given as second argument has
    // to return a pointer to a buffer of given size in bytes or return null.
    std::size_t readBinary(const std::wstring& entryName,
-                          std::function<BYTE*(std::size_t)> getBuffer) const;
+                          std::function<unsigned char*(std::size_t)> getBuffer) const;
+   // Read directly into caller storage with a single query. If the storage is too
+   // small, they fail and report the needed size, so the caller can retry with a
+   // larger buffer. Strings end at the first terminator or at the end of the value.
+   std::optional<std::wstring_view>
+   readWString(const std::wstring& entryName, std::span<wchar_t> buffer,
+               std::size_t* requiredLength = nullptr) const;
+   std::optional<std::span<unsigned char>>
+   readBinary(const std::wstring& entryName, std::span<unsigned char> buffer,
+              std::size_t* requiredBytes = nullptr) const;
    bool writeInt32(const std::wstring& entryName, int32_t val) const;
    bool writeInt64(const std::wstring& entryName, int64_t val) const;
    bool writeString(const std::wstring& entryName, const std::string& val) const;
    bool writeWString(const std::wstring& entryName, const std::wstring& val) const;
-   bool writeBinary(const std::wstring& entryName, const BYTE* data,
+   bool writeBinary(const std::wstring& entryName, const unsigned char* data,
                     std::size_t numBytes) const;
 
    bool removeEntry(const std::wstring& entryName) const;
+   // Counts of subkeys and entries with a single query.
+   std::optional<RegKeyInfo> info() const;
    std::size_t countSubkeys() const;
    std::vector<std::wstring> subkeyNames() const;
+   // Enumerate without reading all names first. Stop early by leaving the loop.
+   RegSubkeyRange subkeys() const;
    std::size_t countEntries() const;
    std::vector<std::wstring> entryNames() const;
+   RegEntryRange entries() const;
+   // Reads all entries at once. Cheaper than reading the entries one by one since
+   // the system registry enumerates names and data together.
+   std::optional<RegSnapshot> readAll() const;
 
  private:
-   HKEY m_key = NULL;
+   RegBackend* m_backend = nullptr;
+   RegHandle m_key = 0;
    bool m_created = false;
 };
 
 
+inline std::wstring_view RegSubkeyRange::iterator::operator*() const
+{
+   return m_name;
+}
+
+inline void RegSubkeyRange::iterator::operator++(int)
+{
+   ++*this;
+}
+
+inline bool RegSubkeyRange::iterator::operator==(std::default_sentinel_t) const
+{
+   return m_state != RegEnumResult::Read;
+}
+
+inline bool RegSubkeyRange::iterator::hasFailed() const
+{
+   return m_state == RegEnumResult::Failed;
+}
+
+inline std::default_sentinel_t RegSubkeyRange::end() const
+{
+   return std::default_sentinel;
+}
+
+
+inline RegEntryInfo RegEntryRange::iterator::operator*() const
+{
+   return {m_name, m_type, m_numBytes};
+}
+
+inline void RegEntryRange::iterator::operator++(int)
+{
+   ++*this;
+}
+
+inline bool RegEntryRange::iterator::operator==(std::default_sentinel_t) const
+{
+   return m_state != RegEnumResult::Read;
+}
+
+inline bool RegEntryRange::iterator::hasFailed() const
+{
+   return m_state == RegEnumResult::Failed;
+}
+
+inline std::default_sentinel_t RegEntryRange::end() const
+{
+   return std::default_sentinel;
+}
+
+
+///////////////////
+
 inline RegKey::operator bool() const
 {
-   return (m_key != NULL);
+   return (m_key != 0);
 }
 
+#ifdef _WIN32
 inline RegKey::operator HKEY() const
 {
-   return m_key;
+   return hkey();
 }
 
 inline HKEY RegKey::hkey() const
+{
+   return (m_backend == &win32RegBackend()) ? toHkey(m_key) : NULL;
+}
+#endif
+
+inline RegBackend* RegKey::backend() const
+{
+   return m_backend;
+}
+
+inline RegHandle RegKey::handle() const
 {
    return m_key;
 }
@@ -104,5 +323,3 @@ inline bool RegKey::wasOpened() const
 }
 
 } // namespace win32
-
-#endif //_WIN32
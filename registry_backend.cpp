@@ -0,0 +1,868 @@
+//
+// Win32 utilities library
+// Storage backends for registry keys.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_backend.h"
+#include "alloc_stats.h"
+#include "essentutils/string_util.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <cwctype>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Returns the string in a buffer read from the registry. Stops at the first
+// terminator, if there is one.
+template <typename Char>
+std::basic_string<Char> toString(const Char* chars, std::size_t numBytes)
+{
+   const std::basic_string_view<Char> str{chars, numBytes / sizeof(Char)};
+   return std::basic_string<Char>{str.substr(0, str.find(Char{0}))};
+}
+
+
+template <typename Int> std::optional<Int> decodeInt(std::span<const std::byte> data)
+{
+   if (data.size() != sizeof(Int))
+      return {};
+
+   Int val = 0;
+   std::memcpy(&val, data.data(), sizeof(Int));
+   return val;
+}
+
+
+bool equalRegNames(std::wstring_view a, std::wstring_view b)
+{
+   auto fold = [](wchar_t ch) { return std::towupper(static_cast<std::wint_t>(ch)); };
+   return a.size() == b.size() &&
+          std::equal(a.begin(), a.end(), b.begin(),
+                     [&fold](wchar_t ca, wchar_t cb) { return fold(ca) == fold(cb); });
+}
+
+
+#ifdef _WIN32
+
+// Loaded at runtime so that the library does not depend on ktmw32.dll.
+using CreateTransaction_t = HANDLE(WINAPI*)(LPSECURITY_ATTRIBUTES, LPGUID, DWORD, DWORD,
+                                            DWORD, DWORD, LPWSTR);
+using CommitTransaction_t = BOOL(WINAPI*)(HANDLE);
+
+
+struct TransactionApi
+{
+   CreateTransaction_t createTransaction = nullptr;
+   CommitTransaction_t commitTransaction = nullptr;
+
+   TransactionApi();
+   bool isAvailable() const { return createTransaction && commitTransaction; }
+};
+
+
+TransactionApi::TransactionApi()
+{
+   HMODULE ktm = LoadLibraryW(L"ktmw32.dll");
+   if (ktm)
+   {
+      createTransaction =
+         reinterpret_cast<CreateTransaction_t>(GetProcAddress(ktm, "CreateTransaction"));
+      commitTransaction =
+         reinterpret_cast<CommitTransaction_t>(GetProcAddress(ktm, "CommitTransaction"));
+   }
+}
+
+
+const TransactionApi& transactionApi()
+{
+   static const TransactionApi api;
+   return api;
+}
+
+#endif //_WIN32
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+std::wstring foldRegName(const std::wstring& name)
+{
+   // Upper case like the system registry compares names.
+   std::wstring folded = name;
+   for (wchar_t& ch : folded)
+      ch = static_cast<wchar_t>(std::towupper(static_cast<std::wint_t>(ch)));
+   return folded;
+}
+
+
+///////////////////
+
+RegSnapshot::Value::Value(std::wstring_view name, RegValueType type,
+                          std::span<const std::byte> data)
+: m_name{name}, m_type{type}, m_data{data}
+{
+}
+
+
+std::optional<int32_t> RegSnapshot::Value::toInt32() const
+{
+   if (m_type != RegValueType::Dword)
+      return {};
+   return decodeInt<int32_t>(m_data);
+}
+
+
+std::optional<int64_t> RegSnapshot::Value::toInt64() const
+{
+   if (m_type != RegValueType::Qword)
+      return {};
+   return decodeInt<int64_t>(m_data);
+}
+
+
+std::optional<std::wstring_view> RegSnapshot::Value::toWString() const
+{
+   if (m_type != RegValueType::String)
+      return {};
+
+   // The arena aligns data for wchar_t.
+   const std::wstring_view str{reinterpret_cast<const wchar_t*>(m_data.data()),
+                               m_data.size() / sizeof(wchar_t)};
+   return str.substr(0, str.find(L'\0'));
+}
+
+
+RegSnapshot::Value RegSnapshot::operator[](std::size_t idx) const
+{
+   assert(idx < m_entries.size());
+
+   const Entry& entry = m_entries[idx];
+   const std::byte* arena = m_arena.data();
+   return Value{{reinterpret_cast<const wchar_t*>(arena + entry.nameOffset),
+                 entry.nameLength},
+                entry.type,
+                {arena + entry.dataOffset, entry.numBytes}};
+}
+
+
+std::optional<RegSnapshot::Value> RegSnapshot::find(std::wstring_view name) const
+{
+   for (std::size_t idx = 0; idx < m_entries.size(); ++idx)
+   {
+      const Value value = (*this)[idx];
+      if (equalRegNames(value.name(), name))
+         return value;
+   }
+   return {};
+}
+
+
+void RegSnapshot::reserve(std::size_t numValues, std::size_t numArenaBytes)
+{
+   m_entries.reserve(numValues);
+   m_arena.reserve(numArenaBytes);
+}
+
+
+void RegSnapshot::add(std::wstring_view name, RegValueType type, const void* data,
+                      std::size_t numBytes)
+{
+   Entry entry;
+   entry.type = type;
+   entry.nameLength = name.size();
+   entry.nameOffset = allocate(name.size() * sizeof(wchar_t));
+   if (!name.empty())
+      std::memcpy(m_arena.data() + entry.nameOffset, name.data(),
+                  name.size() * sizeof(wchar_t));
+   entry.numBytes = numBytes;
+   entry.dataOffset = allocate(numBytes);
+   if (numBytes > 0)
+      std::memcpy(m_arena.data() + entry.dataOffset, data, numBytes);
+   m_entries.push_back(entry);
+}
+
+
+void RegSnapshot::clear()
+{
+   m_arena.clear();
+   m_entries.clear();
+}
+
+
+std::size_t RegSnapshot::allocate(std::size_t numBytes)
+{
+   constexpr std::size_t Alignment = alignof(wchar_t);
+   const std::size_t offset = (m_arena.size() + Alignment - 1) / Alignment * Alignment;
+   m_arena.resize(offset + numBytes);
+   return offset;
+}
+
+
+///////////////////
+
+std::optional<std::string> RegBackend::readString(RegHandle key,
+                                                  const std::wstring& valueName)
+{
+   // Most values fit into the buffer on the stack and are read with a single query.
+   wchar_t inlineBuffer[RegInlineReadBytes / sizeof(wchar_t)];
+   wchar_t* chars = inlineBuffer;
+   std::size_t numBytes = sizeof(inlineBuffer);
+   RegValueType type = RegValueType::None;
+   RegQueryResult res = queryRegValue(*this, key, valueName, &type, chars, &numBytes);
+
+   // Repeat while the value keeps growing between the queries.
+   ScopedAllocSite site{"RegBackend::readString"};
+   std::pmr::vector<wchar_t> buffer(allocResource(AllocTag::Registry));
+   while (res == RegQueryResult::BufferTooSmall && type == RegValueType::String)
+   {
+      buffer.resize(numBytes / sizeof(wchar_t) + 1);
+      chars = buffer.data();
+      numBytes = buffer.size() * sizeof(wchar_t);
+      res = queryRegValue(*this, key, valueName, &type, chars, &numBytes);
+   }
+
+   if (res != RegQueryResult::Read || type != RegValueType::String)
+      return {};
+   return sutil::utf8(toString(chars, numBytes));
+}
+
+
+bool RegBackend::writeString(RegHandle key, const std::wstring& valueName,
+                             const std::string& val)
+{
+   const std::wstring wval = sutil::utf16(val);
+   return setValue(key, valueName, RegValueType::String, wval.c_str(),
+                   (wval.size() + 1) * sizeof(wchar_t));
+}
+
+
+RegEnumResult RegBackend::enumSubkey(RegHandle key, std::size_t idx, std::wstring& name)
+{
+   const std::optional<std::vector<std::wstring>> names = subkeyNames(key);
+   if (!names)
+      return RegEnumResult::Failed;
+   if (idx >= names->size())
+      return RegEnumResult::End;
+
+   name = (*names)[idx];
+   return RegEnumResult::Read;
+}
+
+
+RegEnumResult RegBackend::enumValue(RegHandle key, std::size_t idx, std::wstring& name,
+                                    RegValueType* type, std::size_t* numBytes)
+{
+   const std::optional<std::vector<std::wstring>> names = valueNames(key);
+   if (!names)
+      return RegEnumResult::Failed;
+   if (idx >= names->size())
+      return RegEnumResult::End;
+
+   name = (*names)[idx];
+   std::size_t size = 0;
+   if (!queryValue(key, name, type, nullptr, &size))
+      return RegEnumResult::Failed;
+   if (numBytes)
+      *numBytes = size;
+   return RegEnumResult::Read;
+}
+
+
+std::optional<RegSnapshot> RegBackend::readAllValues(RegHandle key)
+{
+   const std::optional<std::vector<std::wstring>> names = valueNames(key);
+   if (!names)
+      return {};
+
+   RegSnapshot snapshot;
+   snapshot.reserve(names->size(), 0);
+   std::byte inlineBuffer[RegInlineReadBytes];
+   std::vector<std::byte> buffer;
+   for (const std::wstring& name : *names)
+   {
+      std::byte* data = inlineBuffer;
+      std::size_t numBytes = sizeof(inlineBuffer);
+      RegValueType type = RegValueType::None;
+      RegQueryResult res = queryRegValue(*this, key, name, &type, data, &numBytes);
+      while (res == RegQueryResult::BufferTooSmall)
+      {
+         buffer.resize(numBytes);
+         data = buffer.data();
+         res = queryRegValue(*this, key, name, &type, data, &numBytes);
+      }
+
+      // Skips values that were removed after their names were read.
+      if (res == RegQueryResult::Read)
+         snapshot.add(name, type, data, numBytes);
+   }
+   return snapshot;
+}
+
+
+bool RegBackend::applyWrites(const std::vector<RegKeyWrites>& writes)
+{
+   for (const RegKeyWrites& keyWrites : writes)
+   {
+      const RegHandle key =
+         createKey(keyWrites.parent, keyWrites.keyPath,
+                   RegAccessQueryValue | RegAccessSetValue, nullptr);
+      if (!key)
+         return false;
+
+      bool ok = true;
+      for (const RegValueWrite& value : keyWrites.values)
+      {
+         if (value.isRemoval)
+         {
+            ok = removeValue(key, value.name) ||
+                 !queryValue(key, value.name, nullptr, nullptr, nullptr);
+         }
+         else
+         {
+            ok = setValue(key, value.name, value.type, value.data.data(),
+                          value.data.size());
+         }
+         if (!ok)
+            break;
+      }
+
+      closeKey(key);
+      if (!ok)
+         return false;
+   }
+   return true;
+}
+
+
+RegBackend::WatchId RegBackend::watchKey(RegHandle /*key*/,
+                                         ChangeCallback_t /*onChange*/)
+{
+   return 0;
+}
+
+
+void RegBackend::unwatchKey(WatchId /*id*/)
+{
+}
+
+
+///////////////////
+
+RegQueryResult queryRegValue(RegBackend& backend, RegHandle key,
+                             const std::wstring& valueName, RegValueType* type,
+                             void* data, std::size_t* numBytes)
+{
+   assert(type && numBytes);
+
+   // Without buffer the backends would only query the size.
+   unsigned char noData = 0;
+   const std::size_t bufferSize = *numBytes;
+   *type = RegValueType::None;
+   if (backend.queryValue(key, valueName, type, data ? data : &noData, numBytes))
+      return RegQueryResult::Read;
+   // Backends report the needed size if the buffer is too small.
+   return (*numBytes > bufferSize) ? RegQueryResult::BufferTooSmall
+                                   : RegQueryResult::Failed;
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+struct Win32RegBackend::Watch
+{
+   HKEY key = NULL;
+   // Signaled by the registry. Auto-reset.
+   HANDLE event = NULL;
+   PTP_WAIT wait = nullptr;
+   ChangeCallback_t callback;
+   std::atomic<bool> isClosing = false;
+
+   // Notifications are one-shot and have to be requested again after each change.
+   bool arm();
+};
+
+
+bool Win32RegBackend::Watch::arm()
+{
+   constexpr DWORD filter = REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET |
+                            REG_NOTIFY_THREAD_AGNOSTIC;
+   if (RegNotifyChangeKeyValue(key, FALSE, filter, event, TRUE) != ERROR_SUCCESS)
+      return false;
+   SetThreadpoolWait(wait, event, nullptr);
+   return true;
+}
+
+
+Win32RegBackend::~Win32RegBackend()
+{
+   std::vector<WatchId> ids;
+   {
+      std::scoped_lock lock{m_watchGuard};
+      for (const auto& [id, watch] : m_watches)
+         ids.push_back(id);
+   }
+   for (WatchId id : ids)
+      unwatchKey(id);
+}
+
+
+RegHandle Win32RegBackend::createKey(RegHandle parent, const std::wstring& keyPath,
+                                     RegAccess accessRights, bool* created)
+{
+   HKEY key = NULL;
+   DWORD disposition = 0;
+   const LSTATUS res = RegCreateKeyExW(toHkey(parent), keyPath.c_str(), 0, nullptr, 0,
+                                       accessRights, nullptr, &key, &disposition);
+   if (res != ERROR_SUCCESS)
+      return 0;
+
+   if (created)
+      *created = (disposition == REG_CREATED_NEW_KEY);
+   return toRegHandle(key);
+}
+
+
+RegHandle Win32RegBackend::openKey(RegHandle parent, const std::wstring& keyPath,
+                                   RegAccess accessRights)
+{
+   HKEY key = NULL;
+   const LSTATUS res =
+      RegOpenKeyExW(toHkey(parent), keyPath.c_str(), 0, accessRights, &key);
+   if (res != ERROR_SUCCESS)
+      return 0;
+   return toRegHandle(key);
+}
+
+
+void Win32RegBackend::closeKey(RegHandle key)
+{
+   RegCloseKey(toHkey(key));
+}
+
+
+bool Win32RegBackend::removeKey(RegHandle parent, const std::wstring& keyPath)
+{
+   const LSTATUS res = RegDeleteTreeW(toHkey(parent), keyPath.c_str());
+   return (res == ERROR_SUCCESS);
+}
+
+
+bool Win32RegBackend::queryValue(RegHandle key, const std::wstring& valueName,
+                                 RegValueType* type, void* data, std::size_t* numBytes)
+{
+   DWORD entryType = REG_NONE;
+   DWORD size = numBytes ? static_cast<DWORD>(*numBytes) : 0;
+   const LSTATUS res =
+      RegQueryValueExW(toHkey(key), valueName.c_str(), nullptr, &entryType,
+                       static_cast<BYTE*>(data), numBytes ? &size : nullptr);
+   if (res != ERROR_SUCCESS && res != ERROR_MORE_DATA)
+      return false;
+
+   if (type)
+      *type = static_cast<RegValueType>(entryType);
+   if (numBytes)
+      *numBytes = size;
+   return (res == ERROR_SUCCESS);
+}
+
+
+bool Win32RegBackend::setValue(RegHandle key, const std::wstring& valueName,
+                               RegValueType type, const void* data, std::size_t numBytes)
+{
+   const LSTATUS res = RegSetValueExW(toHkey(key), valueName.c_str(), 0,
+                                      static_cast<DWORD>(type),
+                                      static_cast<const BYTE*>(data),
+                                      static_cast<DWORD>(numBytes));
+   return (res == ERROR_SUCCESS);
+}
+
+
+bool Win32RegBackend::removeValue(RegHandle key, const std::wstring& valueName)
+{
+   const LSTATUS res = RegDeleteValueW(toHkey(key), valueName.c_str());
+   return (res == ERROR_SUCCESS);
+}
+
+
+std::optional<RegKeyInfo> Win32RegBackend::queryKeyInfo(RegHandle key)
+{
+   DWORD numSubkeys = 0;
+   DWORD maxSubkeyNameLen = 0;
+   DWORD numValues = 0;
+   DWORD maxValueNameLen = 0;
+   const LSTATUS res = RegQueryInfoKeyW(toHkey(key), nullptr, nullptr, nullptr,
+                                        &numSubkeys, &maxSubkeyNameLen, nullptr,
+                                        &numValues, &maxValueNameLen, nullptr, nullptr,
+                                        nullptr);
+   if (res != ERROR_SUCCESS)
+      return {};
+
+   RegKeyInfo info;
+   info.numSubkeys = numSubkeys;
+   info.maxSubkeyNameLength = maxSubkeyNameLen;
+   info.numValues = numValues;
+   info.maxValueNameLength = maxValueNameLen;
+   return info;
+}
+
+
+std::optional<std::vector<std::wstring>> Win32RegBackend::subkeyNames(RegHandle key)
+{
+   DWORD maxSubkeyNameLen = 0;
+   LSTATUS res =
+      RegQueryInfoKeyW(toHkey(key), nullptr, nullptr, nullptr, nullptr,
+                       &maxSubkeyNameLen, nullptr, nullptr, nullptr, nullptr, nullptr,
+                       nullptr);
+   if (res != ERROR_SUCCESS)
+      return {};
+
+   maxSubkeyNameLen += 1;
+   ScopedAllocSite site{"RegKey::subkeyNames"};
+   std::pmr::vector<wchar_t> buffer(maxSubkeyNameLen, 0,
+                                    allocResource(AllocTag::Registry));
+
+   std::vector<std::wstring> subkeys;
+   DWORD idx = 0;
+   DWORD nameLen = maxSubkeyNameLen;
+
+   while (res == ERROR_SUCCESS)
+   {
+      nameLen = maxSubkeyNameLen;
+      res = RegEnumKeyExW(toHkey(key), idx++, buffer.data(), &nameLen, nullptr, nullptr,
+                          nullptr, nullptr);
+      if (res == ERROR_SUCCESS)
+         subkeys.push_back(buffer.data());
+   }
+
+   if (res == ERROR_SUCCESS || res == ERROR_NO_MORE_ITEMS)
+      return subkeys;
+   return {};
+}
+
+
+std::optional<std::vector<std::wstring>> Win32RegBackend::valueNames(RegHandle key)
+{
+   DWORD maxEntryNameLen = 0;
+   LSTATUS res =
+      RegQueryInfoKeyW(toHkey(key), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                       nullptr, &maxEntryNameLen, nullptr, nullptr, nullptr);
+   if (res != ERROR_SUCCESS)
+      return {};
+
+   maxEntryNameLen += 1;
+   ScopedAllocSite site{"RegKey::entryNames"};
+   std::pmr::vector<wchar_t> buffer(maxEntryNameLen, 0,
+                                    allocResource(AllocTag::Registry));
+
+   std::vector<std::wstring> entries;
+   DWORD idx = 0;
+   DWORD nameLen = maxEntryNameLen;
+
+   while (res == ERROR_SUCCESS)
+   {
+      nameLen = maxEntryNameLen;
+      res = RegEnumValueW(toHkey(key), idx++, buffer.data(), &nameLen, nullptr, nullptr,
+                          nullptr, nullptr);
+      if (res == ERROR_SUCCESS)
+         entries.push_back(buffer.data());
+   }
+
+   if (res == ERROR_SUCCESS || res == ERROR_NO_MORE_ITEMS)
+      return entries;
+   return {};
+}
+
+
+RegEnumResult Win32RegBackend::enumSubkey(RegHandle key, std::size_t idx,
+                                          std::wstring& name)
+{
+   // Key names are limited to 255 characters.
+   constexpr std::size_t MaxNameLen = 255;
+   name.resize(MaxNameLen + 1);
+   DWORD nameLen = static_cast<DWORD>(name.size());
+   const LSTATUS res = RegEnumKeyExW(toHkey(key), static_cast<DWORD>(idx), name.data(),
+                                     &nameLen, nullptr, nullptr, nullptr, nullptr);
+   if (res != ERROR_SUCCESS)
+   {
+      name.clear();
+      return (res == ERROR_NO_MORE_ITEMS) ? RegEnumResult::End : RegEnumResult::Failed;
+   }
+
+   name.resize(nameLen);
+   return RegEnumResult::Read;
+}
+
+
+RegEnumResult Win32RegBackend::enumValue(RegHandle key, std::size_t idx,
+                                         std::wstring& name, RegValueType* type,
+                                         std::size_t* numBytes)
+{
+   // Value names are limited to 16383 characters but are usually short. Start with
+   // a buffer that fits most names.
+   constexpr std::size_t MaxNameLen = 16383;
+   name.resize(std::max<std::size_t>(name.capacity(), 256));
+
+   LSTATUS res = ERROR_MORE_DATA;
+   DWORD nameLen = 0;
+   DWORD entryType = REG_NONE;
+   DWORD size = 0;
+   while (res == ERROR_MORE_DATA)
+   {
+      nameLen = static_cast<DWORD>(name.size());
+      res = RegEnumValueW(toHkey(key), static_cast<DWORD>(idx), name.data(), &nameLen,
+                          nullptr, &entryType, nullptr, &size);
+      if (res == ERROR_MORE_DATA)
+      {
+         if (name.size() > MaxNameLen)
+            break;
+         name.resize(MaxNameLen + 1);
+      }
+   }
+   if (res != ERROR_SUCCESS)
+   {
+      name.clear();
+      return (res == ERROR_NO_MORE_ITEMS) ? RegEnumResult::End : RegEnumResult::Failed;
+   }
+
+   name.resize(nameLen);
+   if (type)
+      *type = static_cast<RegValueType>(entryType);
+   if (numBytes)
+      *numBytes = size;
+   return RegEnumResult::Read;
+}
+
+
+std::optional<RegSnapshot> Win32RegBackend::readAllValues(RegHandle key)
+{
+   DWORD numValues = 0;
+   DWORD maxNameLen = 0;
+   DWORD maxDataBytes = 0;
+   LSTATUS res = RegQueryInfoKeyW(toHkey(key), nullptr, nullptr, nullptr, nullptr,
+                                  nullptr, nullptr, &numValues, &maxNameLen,
+                                  &maxDataBytes, nullptr, nullptr);
+   if (res != ERROR_SUCCESS)
+      return {};
+
+   ScopedAllocSite site{"RegKey::readAll"};
+   std::pmr::vector<wchar_t> name(maxNameLen + 1, 0, allocResource(AllocTag::Registry));
+   // Without data buffer values would be enumerated without their data.
+   std::pmr::vector<BYTE> data(std::max<DWORD>(maxDataBytes, 1), 0,
+                               allocResource(AllocTag::Registry));
+
+   RegSnapshot snapshot;
+   snapshot.reserve(numValues, 0);
+   DWORD idx = 0;
+   while (true)
+   {
+      DWORD nameLen = static_cast<DWORD>(name.size());
+      DWORD numBytes = static_cast<DWORD>(data.size());
+      DWORD type = REG_NONE;
+      res = RegEnumValueW(toHkey(key), idx, name.data(), &nameLen, nullptr, &type,
+                          data.data(), &numBytes);
+      if (res == ERROR_MORE_DATA)
+      {
+         // A value was added or grew after the key info was queried.
+         constexpr std::size_t MaxNameLen = 16383;
+         name.resize(MaxNameLen + 1);
+         data.resize(std::max<std::size_t>(numBytes, data.size() * 2));
+         continue;
+      }
+      if (res == ERROR_NO_MORE_ITEMS)
+         break;
+      if (res != ERROR_SUCCESS)
+         return {};
+
+      snapshot.add({name.data(), nameLen}, static_cast<RegValueType>(type), data.data(),
+                   numBytes);
+      ++idx;
+   }
+   return snapshot;
+}
+
+
+bool Win32RegBackend::applyWrites(const std::vector<RegKeyWrites>& writes)
+{
+   const TransactionApi& api = transactionApi();
+   if (!api.isAvailable())
+      return RegBackend::applyWrites(writes);
+
+   HANDLE transaction = api.createTransaction(nullptr, nullptr, 0, 0, 0, 0, nullptr);
+   if (transaction == INVALID_HANDLE_VALUE)
+      return false;
+
+   bool ok = true;
+   for (const RegKeyWrites& keyWrites : writes)
+   {
+      HKEY key = NULL;
+      ok = (RegCreateKeyTransactedW(toHkey(keyWrites.parent), keyWrites.keyPath.c_str(),
+                                    0, nullptr, REG_OPTION_NON_VOLATILE, KEY_SET_VALUE,
+                                    nullptr, &key, nullptr, transaction,
+                                    nullptr) == ERROR_SUCCESS);
+      if (!ok)
+         break;
+
+      for (const RegValueWrite& value : keyWrites.values)
+      {
+         LSTATUS res = ERROR_SUCCESS;
+         if (value.isRemoval)
+         {
+            res = RegDeleteValueW(key, value.name.c_str());
+            if (res == ERROR_FILE_NOT_FOUND)
+               res = ERROR_SUCCESS;
+         }
+         else
+         {
+            res = RegSetValueExW(key, value.name.c_str(), 0,
+                                 static_cast<DWORD>(value.type),
+                                 reinterpret_cast<const BYTE*>(value.data.data()),
+                                 static_cast<DWORD>(value.data.size()));
+         }
+         ok = (res == ERROR_SUCCESS);
+         if (!ok)
+            break;
+      }
+
+      RegCloseKey(key);
+      if (!ok)
+         break;
+   }
+
+   // Closing a transaction that was not committed rolls it back.
+   if (ok)
+      ok = (api.commitTransaction(transaction) != FALSE);
+   CloseHandle(transaction);
+   return ok;
+}
+
+
+std::optional<std::string> Win32RegBackend::readString(RegHandle key,
+                                                       const std::wstring& valueName)
+{
+   const std::string entryNameAnsi = sutil::utf8(valueName);
+
+   // Most values fit into the buffer on the stack and are read with a single query.
+   char inlineBuffer[RegInlineReadBytes];
+   char* chars = inlineBuffer;
+   DWORD numBytes = sizeof(inlineBuffer);
+   DWORD entryType = REG_NONE;
+   LSTATUS res = RegQueryValueExA(toHkey(key), entryNameAnsi.c_str(), nullptr,
+                                  &entryType, reinterpret_cast<BYTE*>(chars), &numBytes);
+
+   // Repeat while the value keeps growing between the queries.
+   ScopedAllocSite site{"RegKey::readString"};
+   std::pmr::vector<char> buffer(allocResource(AllocTag::Registry));
+   while (res == ERROR_MORE_DATA && entryType == REG_SZ)
+   {
+      buffer.resize(numBytes + 1);
+      chars = buffer.data();
+      numBytes = static_cast<DWORD>(buffer.size());
+      res = RegQueryValueExA(toHkey(key), entryNameAnsi.c_str(), nullptr, &entryType,
+                             reinterpret_cast<BYTE*>(chars), &numBytes);
+   }
+
+   if (res != ERROR_SUCCESS || entryType != REG_SZ)
+      return {};
+   return toString(chars, numBytes);
+}
+
+
+bool Win32RegBackend::writeString(RegHandle key, const std::wstring& valueName,
+                                  const std::string& val)
+{
+   const std::size_t numBytes = (val.size() + 1) * sizeof(char);
+   const LSTATUS res = RegSetValueExA(toHkey(key), sutil::utf8(valueName).c_str(), 0,
+                                      REG_SZ, reinterpret_cast<const BYTE*>(val.c_str()),
+                                      static_cast<DWORD>(numBytes));
+   return (res == ERROR_SUCCESS);
+}
+
+
+RegBackend::WatchId Win32RegBackend::watchKey(RegHandle key, ChangeCallback_t onChange)
+{
+   auto watch = std::make_unique<Watch>();
+   watch->key = toHkey(key);
+   watch->callback = std::move(onChange);
+   watch->event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+   if (!watch->event)
+      return 0;
+   watch->wait = CreateThreadpoolWait(onKeyChanged, watch.get(), nullptr);
+   if (!watch->wait || !watch->arm())
+   {
+      if (watch->wait)
+         CloseThreadpoolWait(watch->wait);
+      CloseHandle(watch->event);
+      return 0;
+   }
+
+   std::scoped_lock lock{m_watchGuard};
+   const WatchId id = m_nextWatchId++;
+   m_watches[id] = std::move(watch);
+   return id;
+}
+
+
+void Win32RegBackend::unwatchKey(WatchId id)
+{
+   std::unique_ptr<Watch> watch;
+   {
+      std::scoped_lock lock{m_watchGuard};
+      auto pos = m_watches.find(id);
+      if (pos == m_watches.end())
+         return;
+      watch = std::move(pos->second);
+      m_watches.erase(pos);
+   }
+
+   watch->isClosing = true;
+   // A running callback can rearm the wait before it sees the flag, so cancel twice.
+   for (int i = 0; i < 2; ++i)
+   {
+      SetThreadpoolWait(watch->wait, NULL, nullptr);
+      WaitForThreadpoolWaitCallbacks(watch->wait, TRUE);
+   }
+   CloseThreadpoolWait(watch->wait);
+   CloseHandle(watch->event);
+}
+
+
+void CALLBACK Win32RegBackend::onKeyChanged(PTP_CALLBACK_INSTANCE /*instance*/,
+                                            PVOID context, PTP_WAIT /*wait*/,
+                                            TP_WAIT_RESULT /*waitResult*/)
+{
+   auto* watch = static_cast<Watch*>(context);
+   if (watch->isClosing)
+      return;
+
+   // Rearm first to not miss changes made while the callback runs.
+   watch->arm();
+   watch->callback();
+}
+
+
+Win32RegBackend& win32RegBackend()
+{
+   static Win32RegBackend backend;
+   return backend;
+}
+
+#endif //_WIN32
+
+} // namespace win32
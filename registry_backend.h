@@ -0,0 +1,373 @@
+//
+// Win32 utilities library
+// Storage backends for registry keys.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Handle of an open key. Zero is invalid. Handles of the Win32 backend are HKEYs.
+using RegHandle = std::uintptr_t;
+
+// Predefined root keys. Have the same values as the Win32 HKEY_* constants and
+// never have to be closed.
+constexpr RegHandle predefinedRegKey(std::uint32_t id)
+{
+   // Win32 sign-extends the ids.
+   const auto signedId = static_cast<std::intptr_t>(static_cast<std::int32_t>(id));
+   return static_cast<RegHandle>(signedId);
+}
+
+inline constexpr RegHandle RegClassesRoot = predefinedRegKey(0x80000000);
+inline constexpr RegHandle RegCurrentUser = predefinedRegKey(0x80000001);
+inline constexpr RegHandle RegLocalMachine = predefinedRegKey(0x80000002);
+inline constexpr RegHandle RegUsers = predefinedRegKey(0x80000003);
+inline constexpr RegHandle RegCurrentConfig = predefinedRegKey(0x80000005);
+
+// Access rights with the values of the Win32 KEY_* flags.
+using RegAccess = std::uint32_t;
+inline constexpr RegAccess RegAccessQueryValue = 0x0001;
+inline constexpr RegAccess RegAccessSetValue = 0x0002;
+inline constexpr RegAccess RegAccessCreateSubkey = 0x0004;
+inline constexpr RegAccess RegAccessEnumerateSubkeys = 0x0008;
+inline constexpr RegAccess RegAccessNotify = 0x0010;
+inline constexpr RegAccess RegAccessRead = 0x20019;
+inline constexpr RegAccess RegAccessWrite = 0x20006;
+inline constexpr RegAccess RegAccessAll = 0xF003F;
+
+// Value types with the values of the Win32 REG_* constants.
+enum class RegValueType : std::uint32_t
+{
+   None = 0,
+   String = 1,
+   Binary = 3,
+   Dword = 4,
+   Qword = 11
+};
+
+
+struct RegKeyInfo
+{
+   std::size_t numSubkeys = 0;
+   // In characters without terminator.
+   std::size_t maxSubkeyNameLength = 0;
+   std::size_t numValues = 0;
+   std::size_t maxValueNameLength = 0;
+};
+
+
+enum class RegEnumResult
+{
+   Read,
+   // No more subkeys or values.
+   End,
+   Failed
+};
+
+
+// Write or removal of a value.
+struct RegValueWrite
+{
+   std::wstring name;
+   bool isRemoval = false;
+   RegValueType type = RegValueType::None;
+   std::vector<std::byte> data;
+};
+
+
+// Writes to the values of a key. The key is created if it does not exist.
+struct RegKeyWrites
+{
+   RegHandle parent = 0;
+   std::wstring keyPath;
+   std::vector<RegValueWrite> values;
+};
+
+
+// Returns the form in which key and value names are compared case-insensitively.
+WIN32UTIL_API std::wstring foldRegName(const std::wstring& name);
+
+
+///////////////////
+
+// Names, types and data of all values of a key, packed into a single buffer. Values
+// are only decoded when they are accessed.
+class WIN32UTIL_API RegSnapshot
+{
+ public:
+   // View of a value. Valid as long as the snapshot is not changed or destroyed.
+   class WIN32UTIL_API Value
+   {
+    public:
+      std::wstring_view name() const;
+      RegValueType type() const;
+      std::span<const std::byte> data() const;
+
+      // Empty for values of other types.
+      std::optional<int32_t> toInt32() const;
+      std::optional<int64_t> toInt64() const;
+      // Ends at the first terminator or at the end of the data.
+      std::optional<std::wstring_view> toWString() const;
+
+    private:
+      friend class RegSnapshot;
+      Value(std::wstring_view name, RegValueType type, std::span<const std::byte> data);
+
+    private:
+      std::wstring_view m_name;
+      RegValueType m_type = RegValueType::None;
+      std::span<const std::byte> m_data;
+   };
+
+ public:
+   std::size_t size() const;
+   bool empty() const;
+   Value operator[](std::size_t idx) const;
+   // Compares names case-insensitively. Linear in the number of values.
+   std::optional<Value> find(std::wstring_view name) const;
+   // Bytes taken by names and data.
+   std::size_t arenaBytes() const;
+
+   // For backends to fill the snapshot.
+   void reserve(std::size_t numValues, std::size_t numArenaBytes);
+   void add(std::wstring_view name, RegValueType type, const void* data,
+            std::size_t numBytes);
+   void clear();
+
+ private:
+   struct Entry
+   {
+      std::size_t nameOffset = 0;
+      std::size_t nameLength = 0;
+      std::size_t dataOffset = 0;
+      std::size_t numBytes = 0;
+      RegValueType type = RegValueType::None;
+   };
+
+   // Makes room for the given number of bytes aligned for wchar_t. Returns the offset.
+   std::size_t allocate(std::size_t numBytes);
+
+ private:
+   std::vector<std::byte> m_arena;
+   std::vector<Entry> m_entries;
+};
+
+
+inline std::wstring_view RegSnapshot::Value::name() const
+{
+   return m_name;
+}
+
+inline RegValueType RegSnapshot::Value::type() const
+{
+   return m_type;
+}
+
+inline std::span<const std::byte> RegSnapshot::Value::data() const
+{
+   return m_data;
+}
+
+inline std::size_t RegSnapshot::size() const
+{
+   return m_entries.size();
+}
+
+inline bool RegSnapshot::empty() const
+{
+   return m_entries.empty();
+}
+
+inline std::size_t RegSnapshot::arenaBytes() const
+{
+   return m_arena.size();
+}
+
+
+///////////////////
+
+// Storage that RegKey reads and writes through. Strings are stored as zero-terminated
+// wchar_t sequences like REG_SZ values. Implementations have to be thread-safe.
+class WIN32UTIL_API RegBackend
+{
+ public:
+   using ChangeCallback_t = std::function<void()>;
+   // Zero is invalid.
+   using WatchId = std::uint64_t;
+
+ public:
+   virtual ~RegBackend() = default;
+
+   // Returns zero on failure. Reports whether the key did not exist before.
+   virtual RegHandle createKey(RegHandle parent, const std::wstring& keyPath,
+                               RegAccess accessRights, bool* created) = 0;
+   virtual RegHandle openKey(RegHandle parent, const std::wstring& keyPath,
+                             RegAccess accessRights) = 0;
+   virtual void closeKey(RegHandle key) = 0;
+   // Removes the key with all its subkeys and values. An empty path removes the
+   // contents of the parent.
+   virtual bool removeKey(RegHandle parent, const std::wstring& keyPath) = 0;
+
+   // Works like RegQueryValueEx. Without data buffer only the type and size are
+   // returned. Fails if the buffer is too small but still reports the type and the
+   // needed size.
+   virtual bool queryValue(RegHandle key, const std::wstring& valueName,
+                           RegValueType* type, void* data, std::size_t* numBytes) = 0;
+   virtual bool setValue(RegHandle key, const std::wstring& valueName, RegValueType type,
+                         const void* data, std::size_t numBytes) = 0;
+   virtual bool removeValue(RegHandle key, const std::wstring& valueName) = 0;
+
+   virtual std::optional<RegKeyInfo> queryKeyInfo(RegHandle key) = 0;
+   virtual std::optional<std::vector<std::wstring>> subkeyNames(RegHandle key) = 0;
+   virtual std::optional<std::vector<std::wstring>> valueNames(RegHandle key) = 0;
+   // Read the name of the subkey or value at the given index. When enumerating in
+   // order, the name holds the previous name on input, which backends can use to
+   // continue from there. The buffer of the name is reused. By default all names are
+   // read for each index, so backends should override them.
+   virtual RegEnumResult enumSubkey(RegHandle key, std::size_t idx, std::wstring& name);
+   virtual RegEnumResult enumValue(RegHandle key, std::size_t idx, std::wstring& name,
+                                   RegValueType* type, std::size_t* numBytes);
+   // Reads names, types and data of all values. By default each value is queried
+   // separately, backends that can enumerate them together should override it.
+   virtual std::optional<RegSnapshot> readAllValues(RegHandle key);
+
+   // Creates the keys and applies the writes. Removing values that do not exist
+   // succeeds. Backends that can apply all writes or none should override it, by
+   // default the writes are applied one by one and stop at the first failure.
+   virtual bool applyWrites(const std::vector<RegKeyWrites>& writes);
+
+   // Strings of char are converted from and to UTF-8 unless the backend stores them
+   // differently.
+   virtual std::optional<std::string> readString(RegHandle key,
+                                                 const std::wstring& valueName);
+   virtual bool writeString(RegHandle key, const std::wstring& valueName,
+                            const std::string& val);
+
+   // Calls back on an arbitrary thread after values or direct subkeys of the key
+   // changed or the key was removed. The key has to stay open while it is watched.
+   // Returns zero if the backend cannot report changes. A callback that already
+   // started can still be running when unwatchKey returns.
+   virtual WatchId watchKey(RegHandle key, ChangeCallback_t onChange);
+   virtual void unwatchKey(WatchId id);
+};
+
+
+// Size of the buffers on the stack that values are first read into. Larger values
+// need a second query.
+inline constexpr std::size_t RegInlineReadBytes = 256;
+
+enum class RegQueryResult
+{
+   Read,
+   // The value exists but does not fit into the buffer.
+   BufferTooSmall,
+   Failed
+};
+
+// Reads a value into the given buffer with a single query. Also reports the type and
+// the needed size of values that do not fit. The buffer can be empty.
+WIN32UTIL_API RegQueryResult queryRegValue(RegBackend& backend, RegHandle key,
+                                           const std::wstring& valueName,
+                                           RegValueType* type, void* data,
+                                           std::size_t* numBytes);
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Backend for the system registry.
+class WIN32UTIL_API Win32RegBackend : public RegBackend
+{
+ public:
+   Win32RegBackend() = default;
+   ~Win32RegBackend() override;
+   Win32RegBackend(const Win32RegBackend&) = delete;
+   Win32RegBackend& operator=(const Win32RegBackend&) = delete;
+
+   RegHandle createKey(RegHandle parent, const std::wstring& keyPath,
+                       RegAccess accessRights, bool* created) override;
+   RegHandle openKey(RegHandle parent, const std::wstring& keyPath,
+                     RegAccess accessRights) override;
+   void closeKey(RegHandle key) override;
+   bool removeKey(RegHandle parent, const std::wstring& keyPath) override;
+
+   bool queryValue(RegHandle key, const std::wstring& valueName, RegValueType* type,
+                   void* data, std::size_t* numBytes) override;
+   bool setValue(RegHandle key, const std::wstring& valueName, RegValueType type,
+                 const void* data, std::size_t numBytes) override;
+   bool removeValue(RegHandle key, const std::wstring& valueName) override;
+
+   std::optional<RegKeyInfo> queryKeyInfo(RegHandle key) override;
+   std::optional<std::vector<std::wstring>> subkeyNames(RegHandle key) override;
+   std::optional<std::vector<std::wstring>> valueNames(RegHandle key) override;
+   RegEnumResult enumSubkey(RegHandle key, std::size_t idx, std::wstring& name) override;
+   RegEnumResult enumValue(RegHandle key, std::size_t idx, std::wstring& name,
+                           RegValueType* type, std::size_t* numBytes) override;
+   // Enumerates names and data together with RegEnumValue.
+   std::optional<RegSnapshot> readAllValues(RegHandle key) override;
+   // Applies the writes in a registry transaction if the Kernel Transaction Manager
+   // is available. Parents should be predefined keys, since keys opened outside of
+   // the transaction cannot be used in it.
+   bool applyWrites(const std::vector<RegKeyWrites>& writes) override;
+
+   // Uses the ANSI functions that convert with the system code page.
+   std::optional<std::string> readString(RegHandle key,
+                                         const std::wstring& valueName) override;
+   bool writeString(RegHandle key, const std::wstring& valueName,
+                    const std::string& val) override;
+
+   // Uses RegNotifyChangeKeyValue. Needs keys opened with KEY_NOTIFY access.
+   WatchId watchKey(RegHandle key, ChangeCallback_t onChange) override;
+   void unwatchKey(WatchId id) override;
+
+ private:
+   struct Watch;
+   static void CALLBACK onKeyChanged(PTP_CALLBACK_INSTANCE instance, PVOID context,
+                                     PTP_WAIT wait, TP_WAIT_RESULT waitResult);
+
+ private:
+   std::mutex m_watchGuard;
+   std::unordered_map<WatchId, std::unique_ptr<Watch>> m_watches;
+   WatchId m_nextWatchId = 1;
+};
+
+
+// Shared instance that RegKeys opened from HKEYs use.
+WIN32UTIL_API Win32RegBackend& win32RegBackend();
+
+
+inline RegHandle toRegHandle(HKEY key)
+{
+   return reinterpret_cast<RegHandle>(key);
+}
+
+inline HKEY toHkey(RegHandle key)
+{
+   return reinterpret_cast<HKEY>(key);
+}
+
+#endif //_WIN32
+
+} // namespace win32
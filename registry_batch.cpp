@@ -0,0 +1,171 @@
+//
+// Win32 utilities library
+// Batched registry writes.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_batch.h"
+#include "trace.h"
+#include <cassert>
+#include <utility>
+
+using namespace win32;
+
+
+namespace win32
+{
+///////////////////
+
+#ifdef _WIN32
+RegWriteBatch::RegWriteBatch() : RegWriteBatch{win32RegBackend()}
+{
+}
+#endif
+
+
+RegWriteBatch::RegWriteBatch(RegBackend& backend) : m_backend{&backend}
+{
+}
+
+
+#ifdef _WIN32
+RegWriteBatch::KeyId RegWriteBatch::key(HKEY parent, const std::wstring& keyPath)
+{
+   return key(toRegHandle(parent), keyPath);
+}
+#endif
+
+
+RegWriteBatch::KeyId RegWriteBatch::key(RegHandle parent, const std::wstring& keyPath)
+{
+   auto [pos, isNew] =
+      m_keyIds.try_emplace({parent, foldRegName(keyPath)}, m_keys.size());
+   if (isNew)
+   {
+      m_keys.push_back({parent, keyPath, {}});
+      m_isCommitted.push_back(false);
+      m_valueIndices.emplace_back();
+   }
+   return pos->second;
+}
+
+
+void RegWriteBatch::writeInt32(KeyId key, const std::wstring& entryName, int32_t val)
+{
+   write(key, entryName, RegValueType::Dword, &val, sizeof(val));
+}
+
+
+void RegWriteBatch::writeInt64(KeyId key, const std::wstring& entryName, int64_t val)
+{
+   write(key, entryName, RegValueType::Qword, &val, sizeof(val));
+}
+
+
+void RegWriteBatch::writeWString(KeyId key, const std::wstring& entryName,
+                                 const std::wstring& val)
+{
+   write(key, entryName, RegValueType::String, val.c_str(),
+         (val.size() + 1) * sizeof(wchar_t));
+}
+
+
+void RegWriteBatch::writeBinary(KeyId key, const std::wstring& entryName,
+                                const unsigned char* data, std::size_t numBytes)
+{
+   write(key, entryName, RegValueType::Binary, data, numBytes);
+}
+
+
+void RegWriteBatch::removeEntry(KeyId key, const std::wstring& entryName)
+{
+   RegValueWrite& value = entry(key, entryName);
+   value.isRemoval = true;
+   value.type = RegValueType::None;
+   value.data.clear();
+}
+
+
+void RegWriteBatch::clear()
+{
+   m_keys.clear();
+   m_isCommitted.clear();
+   m_keyIds.clear();
+   m_valueIndices.clear();
+   m_numValues = 0;
+}
+
+
+bool RegWriteBatch::commit()
+{
+   WIN32UTIL_TRACE_ZONE("RegWriteBatch::commit", "registry");
+
+   // Keys that were committed before are only sent again if they have writes.
+   // Otherwise they would be recreated after being removed elsewhere.
+   std::vector<KeyId> pendingIds;
+   std::vector<RegKeyWrites> pending;
+   for (KeyId id = 0; id < m_keys.size(); ++id)
+   {
+      if (!m_isCommitted[id] || !m_keys[id].values.empty())
+      {
+         pendingIds.push_back(id);
+         pending.push_back(std::move(m_keys[id]));
+      }
+   }
+
+   const Clock::time_point start = Clock::now();
+   const bool ok = pending.empty() || m_backend->applyWrites(pending);
+   m_lastCommitDuration = Clock::now() - start;
+
+   for (std::size_t i = 0; i < pendingIds.size(); ++i)
+      m_keys[pendingIds[i]] = std::move(pending[i]);
+
+   if (m_latency)
+   {
+      m_latency->record(static_cast<std::uint64_t>(
+         std::chrono::duration_cast<std::chrono::microseconds>(m_lastCommitDuration)
+            .count()));
+   }
+
+   if (ok)
+   {
+      // Keep the keys so that their ids stay valid.
+      for (RegKeyWrites& keyWrites : m_keys)
+         keyWrites.values.clear();
+      m_isCommitted.assign(m_keys.size(), true);
+      for (auto& indices : m_valueIndices)
+         indices.clear();
+      m_numValues = 0;
+   }
+   return ok;
+}
+
+
+RegValueWrite& RegWriteBatch::entry(KeyId key, const std::wstring& entryName)
+{
+   assert(key < m_keys.size());
+
+   std::vector<RegValueWrite>& values = m_keys[key].values;
+   auto [pos, isNew] = m_valueIndices[key].try_emplace(foldRegName(entryName),
+                                                        values.size());
+   if (isNew)
+   {
+      values.push_back({entryName, false, RegValueType::None, {}});
+      ++m_numValues;
+   }
+   return values[pos->second];
+}
+
+
+void RegWriteBatch::write(KeyId key, const std::wstring& entryName, RegValueType type,
+                          const void* data, std::size_t numBytes)
+{
+   RegValueWrite& value = entry(key, entryName);
+   value.isRemoval = false;
+   value.type = type;
+   const auto* bytes = static_cast<const std::byte*>(data);
+   value.data.assign(bytes, bytes + numBytes);
+}
+
+} // namespace win32
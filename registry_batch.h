@@ -0,0 +1,121 @@
+//
+// Win32 utilities library
+// Batched registry writes.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "latency_histogram.h"
+#include "registry_backend.h"
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Collects writes and removals of values in multiple keys and applies them together
+// on commit. Only the last write of a value is kept. Backends that support it apply
+// the writes of a commit all or nothing, so that a failure or crash never leaves a
+// key half-written. Not thread-safe.
+class WIN32UTIL_API RegWriteBatch
+{
+ public:
+   using Clock = std::chrono::steady_clock;
+   // Identifies a key of the batch. Valid until the batch is cleared.
+   using KeyId = std::size_t;
+
+ public:
+#ifdef _WIN32
+   // Writes to the system registry.
+   RegWriteBatch();
+#endif
+   explicit RegWriteBatch(RegBackend& backend);
+
+   RegBackend& backend() const;
+   // Adds a key that is created on commit if it does not exist. Adding the same key
+   // again returns the same id. After a commit, the key is only created again once
+   // there are new writes for it.
+#ifdef _WIN32
+   KeyId key(HKEY parent, const std::wstring& keyPath);
+#endif
+   KeyId key(RegHandle parent, const std::wstring& keyPath);
+
+   void writeInt32(KeyId key, const std::wstring& entryName, int32_t val);
+   void writeInt64(KeyId key, const std::wstring& entryName, int64_t val);
+   void writeWString(KeyId key, const std::wstring& entryName, const std::wstring& val);
+   void writeBinary(KeyId key, const std::wstring& entryName, const unsigned char* data,
+                    std::size_t numBytes);
+   void removeEntry(KeyId key, const std::wstring& entryName);
+
+   // Number of values that will be written or removed.
+   std::size_t size() const;
+   bool empty() const;
+   // Drops all writes and keys.
+   void clear();
+
+   // Applies the writes. They are dropped if the commit succeeds and kept otherwise.
+   bool commit();
+   // Time that the last commit took.
+   Clock::duration lastCommitDuration() const;
+   // Records the duration of each commit in microseconds. Pass null to stop.
+   void setLatencyHistogram(LatencyHistogram* histogram);
+
+ private:
+   RegValueWrite& entry(KeyId key, const std::wstring& entryName);
+   void write(KeyId key, const std::wstring& entryName, RegValueType type,
+              const void* data, std::size_t numBytes);
+
+ private:
+   RegBackend* m_backend = nullptr;
+   std::vector<RegKeyWrites> m_keys;
+   // Per key, whether it was committed. Committed keys without writes are skipped.
+   std::vector<bool> m_isCommitted;
+   // Key ids by parent and folded path.
+   std::map<std::pair<RegHandle, std::wstring>, KeyId> m_keyIds;
+   // Per key, indices of the values by folded name.
+   std::vector<std::unordered_map<std::wstring, std::size_t>> m_valueIndices;
+   std::size_t m_numValues = 0;
+   Clock::duration m_lastCommitDuration{0};
+   LatencyHistogram* m_latency = nullptr;
+};
+
+
+inline RegBackend& RegWriteBatch::backend() const
+{
+   return *m_backend;
+}
+
+inline std::size_t RegWriteBatch::size() const
+{
+   return m_numValues;
+}
+
+inline bool RegWriteBatch::empty() const
+{
+   return m_numValues == 0;
+}
+
+inline RegWriteBatch::Clock::duration RegWriteBatch::lastCommitDuration() const
+{
+   return m_lastCommitDuration;
+}
+
+inline void RegWriteBatch::setLatencyHistogram(LatencyHistogram* histogram)
+{
+   m_latency = histogram;
+}
+
+} // namespace win32
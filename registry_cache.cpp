@@ -0,0 +1,326 @@
+//
+// Win32 utilities library
+// Cache for registry values.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_cache.h"
+#include <cstring>
+#include <cwchar>
+#include <type_traits>
+#include <utility>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+template <typename Int, typename Entry>
+std::optional<Int> decodeInt(const Entry& entry, RegValueType expectedType)
+{
+   static_assert(std::is_integral_v<Int>);
+
+   if (!entry.exists || entry.type != expectedType || entry.data.size() != sizeof(Int))
+      return {};
+
+   Int val = 0;
+   std::memcpy(&val, entry.data.data(), sizeof(Int));
+   return val;
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+RegCache::RegCache(RegKey key, WriteMode writeMode)
+: m_key{std::move(key)}, m_writeMode{writeMode},
+  m_numChanges{std::make_shared<std::atomic<std::uint64_t>>(0)}
+{
+   if (m_key)
+   {
+      m_watchId = m_key.backend()->watchKey(
+         m_key.handle(), [numChanges = m_numChanges]()
+         { numChanges->fetch_add(1, std::memory_order_release); });
+   }
+}
+
+
+RegCache::~RegCache()
+{
+   flush();
+   if (m_watchId != 0)
+      m_key.backend()->unwatchKey(m_watchId);
+}
+
+
+std::optional<int32_t> RegCache::readInt32(const std::wstring& entryName)
+{
+   return read<int32_t>(entryName, [](const Entry& entry)
+                        { return decodeInt<int32_t>(entry, RegValueType::Dword); });
+}
+
+
+std::optional<int64_t> RegCache::readInt64(const std::wstring& entryName)
+{
+   return read<int64_t>(entryName, [](const Entry& entry)
+                        { return decodeInt<int64_t>(entry, RegValueType::Qword); });
+}
+
+
+std::optional<std::wstring> RegCache::readWString(const std::wstring& entryName)
+{
+   return read<std::wstring>(
+      entryName,
+      [](const Entry& entry) -> std::optional<std::wstring>
+      {
+         if (!entry.exists || entry.type != RegValueType::String ||
+             entry.data.size() % sizeof(wchar_t) != 0)
+         {
+            return {};
+         }
+
+         std::wstring str(entry.data.size() / sizeof(wchar_t), 0);
+         if (!str.empty())
+            std::memcpy(str.data(), entry.data.data(), entry.data.size());
+         // Like RegKey, stop at the first terminator.
+         str.resize(std::wcslen(str.c_str()));
+         return str;
+      });
+}
+
+
+std::optional<std::vector<unsigned char>>
+RegCache::readBinary(const std::wstring& entryName)
+{
+   return read<std::vector<unsigned char>>(
+      entryName,
+      [](const Entry& entry) -> std::optional<std::vector<unsigned char>>
+      {
+         if (!entry.exists || entry.type != RegValueType::Binary)
+            return {};
+
+         const auto* first = reinterpret_cast<const unsigned char*>(entry.data.data());
+         return std::vector<unsigned char>(first, first + entry.data.size());
+      });
+}
+
+
+bool RegCache::writeInt32(const std::wstring& entryName, int32_t val)
+{
+   return write(entryName, RegValueType::Dword, &val, sizeof(val));
+}
+
+
+bool RegCache::writeInt64(const std::wstring& entryName, int64_t val)
+{
+   return write(entryName, RegValueType::Qword, &val, sizeof(val));
+}
+
+
+bool RegCache::writeWString(const std::wstring& entryName, const std::wstring& val)
+{
+   return write(entryName, RegValueType::String, val.c_str(),
+                (val.size() + 1) * sizeof(wchar_t));
+}
+
+
+bool RegCache::writeBinary(const std::wstring& entryName, const unsigned char* data,
+                           std::size_t numBytes)
+{
+   return write(entryName, RegValueType::Binary, data, numBytes);
+}
+
+
+bool RegCache::removeEntry(const std::wstring& entryName)
+{
+   return write(entryName, RegValueType::None, nullptr, 0);
+}
+
+
+bool RegCache::flush()
+{
+   std::scoped_lock lock{m_guard};
+
+   bool allWritten = true;
+   for (auto& [foldedName, entry] : m_entries)
+   {
+      if (!entry.isPending)
+         continue;
+
+      // Removing a value that does not exist is not a failure. Only an intact key
+      // tells that the value is absent.
+      const bool isWritten =
+         writeToKey(entry) ||
+         (!entry.exists && m_key.backend()->queryKeyInfo(m_key.handle()) &&
+          !m_key.backend()->queryValue(m_key.handle(), entry.name, nullptr, nullptr,
+                                       nullptr));
+      if (isWritten)
+      {
+         entry.isPending = false;
+         --m_numPending;
+      }
+      else
+      {
+         allWritten = false;
+      }
+   }
+   return allWritten;
+}
+
+
+std::size_t RegCache::numPendingWrites() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_numPending;
+}
+
+
+void RegCache::invalidate()
+{
+   std::scoped_lock lock{m_guard};
+   dropCachedValues();
+}
+
+
+RegCache::Stats RegCache::stats() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_stats;
+}
+
+
+void RegCache::resetStats()
+{
+   std::scoped_lock lock{m_guard};
+   m_stats = {};
+}
+
+
+template <typename T, typename Decode>
+std::optional<T> RegCache::read(const std::wstring& entryName, Decode decode)
+{
+   std::scoped_lock lock{m_guard};
+
+   if (!m_key)
+      return {};
+   syncWithKey();
+
+   const std::wstring foldedName = foldRegName(entryName);
+   auto pos = m_entries.find(foldedName);
+   if (pos != m_entries.end())
+   {
+      ++m_stats.hits;
+      return decode(pos->second);
+   }
+
+   ++m_stats.misses;
+   Entry entry;
+   entry.name = entryName;
+   // Most values fit into the buffer on the stack and are read with a single query.
+   std::byte inlineBuffer[RegInlineReadBytes];
+   std::size_t numBytes = sizeof(inlineBuffer);
+   RegQueryResult res = queryRegValue(*m_key.backend(), m_key.handle(), entryName,
+                                      &entry.type, inlineBuffer, &numBytes);
+   if (res == RegQueryResult::Read)
+      entry.data.assign(inlineBuffer, inlineBuffer + numBytes);
+
+   // Repeat while the value keeps growing between the queries.
+   while (res == RegQueryResult::BufferTooSmall)
+   {
+      entry.data.resize(numBytes);
+      res = queryRegValue(*m_key.backend(), m_key.handle(), entryName, &entry.type,
+                          entry.data.data(), &numBytes);
+   }
+   if (res == RegQueryResult::Read)
+      entry.data.resize(numBytes);
+   entry.exists = (res == RegQueryResult::Read);
+
+   // Values that might have changed while they were read are not cached.
+   if (m_numChanges->load(std::memory_order_acquire) != m_numSeenChanges)
+      return decode(entry);
+   return decode(m_entries.emplace(foldedName, std::move(entry)).first->second);
+}
+
+
+bool RegCache::write(const std::wstring& entryName, RegValueType type, const void* data,
+                     std::size_t numBytes)
+{
+   std::scoped_lock lock{m_guard};
+
+   if (!m_key)
+      return false;
+   syncWithKey();
+
+   const std::wstring foldedName = foldRegName(entryName);
+   auto [pos, isNew] = m_entries.try_emplace(foldedName);
+   Entry& entry = pos->second;
+   if (isNew)
+      entry.name = entryName;
+   const bool wasPending = entry.isPending;
+
+   // Removals are written as entries that do not exist.
+   entry.exists = (type != RegValueType::None);
+   entry.type = type;
+   const auto* bytes = static_cast<const std::byte*>(data);
+   entry.data.assign(bytes, bytes + numBytes);
+
+   if (m_writeMode == WriteMode::WriteBack)
+   {
+      entry.isPending = true;
+      if (!wasPending)
+         ++m_numPending;
+      return true;
+   }
+
+   const bool isWritten = writeToKey(entry);
+   // The value is unknown if the write failed.
+   if (!isWritten)
+      m_entries.erase(pos);
+   return isWritten;
+}
+
+
+bool RegCache::writeToKey(const Entry& entry)
+{
+   ++m_stats.keyWrites;
+
+   RegBackend& backend = *m_key.backend();
+   if (!entry.exists)
+      return backend.removeValue(m_key.handle(), entry.name);
+   return backend.setValue(m_key.handle(), entry.name, entry.type, entry.data.data(),
+                           entry.data.size());
+}
+
+
+void RegCache::syncWithKey()
+{
+   const std::uint64_t numChanges = m_numChanges->load(std::memory_order_acquire);
+   if (numChanges != m_numSeenChanges)
+   {
+      m_numSeenChanges = numChanges;
+      dropCachedValues();
+   }
+}
+
+
+void RegCache::dropCachedValues()
+{
+   ++m_stats.invalidations;
+
+   // Pending writes are newer than the key's values.
+   for (auto pos = m_entries.begin(); pos != m_entries.end();)
+   {
+      if (pos->second.isPending)
+         ++pos;
+      else
+         pos = m_entries.erase(pos);
+   }
+}
+
+} // namespace win32
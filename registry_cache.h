@@ -0,0 +1,145 @@
+//
+// Win32 utilities library
+// Cache for registry values.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "registry.h"
+#include "registry_backend.h"
+#include "win32_util_api.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Keeps the values of a registry key in memory. Values are read from the key on first
+// access and served from memory afterwards, including the fact that a value does not
+// exist. Changes to the key that the backend reports drop all cached values, so the
+// next reads go to the key again. Thread-safe.
+class WIN32UTIL_API RegCache
+{
+ public:
+   enum class WriteMode
+   {
+      // Writes go to the key right away.
+      WriteThrough,
+      // Writes are kept in memory until flush() is called or the cache is destroyed.
+      WriteBack
+   };
+
+   struct Stats
+   {
+      std::uint64_t hits = 0;
+      std::uint64_t misses = 0;
+      // Number of times cached values were dropped.
+      std::uint64_t invalidations = 0;
+      // Number of writes and removals that went to the key.
+      std::uint64_t keyWrites = 0;
+
+      double hitRate() const;
+   };
+
+ public:
+   // On Windows the key needs KEY_NOTIFY access to be watched for changes.
+   explicit RegCache(RegKey key, WriteMode writeMode = WriteMode::WriteThrough);
+   // Flushes pending writes.
+   ~RegCache();
+   RegCache(const RegCache&) = delete;
+   RegCache& operator=(const RegCache&) = delete;
+
+   const RegKey& key() const;
+   WriteMode writeMode() const;
+   // Without change notifications values stay cached until invalidate() is called.
+   bool isWatched() const;
+
+   std::optional<int32_t> readInt32(const std::wstring& entryName);
+   std::optional<int64_t> readInt64(const std::wstring& entryName);
+   std::optional<std::wstring> readWString(const std::wstring& entryName);
+   std::optional<std::vector<unsigned char>> readBinary(const std::wstring& entryName);
+   bool writeInt32(const std::wstring& entryName, int32_t val);
+   bool writeInt64(const std::wstring& entryName, int64_t val);
+   bool writeWString(const std::wstring& entryName, const std::wstring& val);
+   bool writeBinary(const std::wstring& entryName, const unsigned char* data,
+                    std::size_t numBytes);
+   bool removeEntry(const std::wstring& entryName);
+
+   // Writes pending changes to the key. Changes that fail to be written stay pending.
+   bool flush();
+   std::size_t numPendingWrites() const;
+   // Drops all cached values that are not pending.
+   void invalidate();
+
+   Stats stats() const;
+   void resetStats();
+
+ private:
+   struct Entry
+   {
+      // Name as it was first accessed.
+      std::wstring name;
+      bool exists = false;
+      RegValueType type = RegValueType::None;
+      std::vector<std::byte> data;
+      // Not written to the key yet.
+      bool isPending = false;
+   };
+
+   template <typename T, typename Decode>
+   std::optional<T> read(const std::wstring& entryName, Decode decode);
+   bool write(const std::wstring& entryName, RegValueType type, const void* data,
+              std::size_t numBytes);
+   bool writeToKey(const Entry& entry);
+   // Drops cached values if the key changed since the last access.
+   void syncWithKey();
+   void dropCachedValues();
+
+ private:
+   mutable std::mutex m_guard;
+   RegKey m_key;
+   WriteMode m_writeMode = WriteMode::WriteThrough;
+   // By folded entry name.
+   std::unordered_map<std::wstring, Entry> m_entries;
+   std::size_t m_numPending = 0;
+   // Counts change notifications. Shared with the notification callback because it
+   // can still run while the watch is removed.
+   std::shared_ptr<std::atomic<std::uint64_t>> m_numChanges;
+   std::uint64_t m_numSeenChanges = 0;
+   RegBackend::WatchId m_watchId = 0;
+   Stats m_stats;
+};
+
+
+inline double RegCache::Stats::hitRate() const
+{
+   const std::uint64_t numReads = hits + misses;
+   return numReads > 0 ? static_cast<double>(hits) / static_cast<double>(numReads) : 0.;
+}
+
+inline const RegKey& RegCache::key() const
+{
+   return m_key;
+}
+
+inline RegCache::WriteMode RegCache::writeMode() const
+{
+   return m_writeMode;
+}
+
+inline bool RegCache::isWatched() const
+{
+   return m_watchId != 0;
+}
+
+} // namespace win32
@@ -0,0 +1,244 @@
+//
+// Win32 utilities library
+// Cache for open registry keys.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_key_cache.h"
+#include "trace.h"
+#include <cassert>
+#include <utility>
+
+using namespace win32;
+
+
+namespace win32
+{
+///////////////////
+
+#ifdef _WIN32
+RegKeyCache::RegKeyCache(std::size_t maxOpenKeys)
+: RegKeyCache{win32RegBackend(), maxOpenKeys}
+{
+}
+#endif
+
+
+RegKeyCache::RegKeyCache(RegBackend& backend, std::size_t maxOpenKeys)
+: m_backend{&backend}, m_maxOpenKeys{maxOpenKeys}
+{
+   assert(maxOpenKeys > 0);
+}
+
+
+std::size_t RegKeyCache::size() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_entries.size();
+}
+
+
+#ifdef _WIN32
+std::shared_ptr<const RegKey> RegKeyCache::open(HKEY parent, const std::wstring& keyPath,
+                                                REGSAM accessRights)
+{
+   return open(toRegHandle(parent), keyPath, accessRights);
+}
+
+
+std::shared_ptr<const RegKey>
+RegKeyCache::create(HKEY parent, const std::wstring& keyPath, REGSAM accessRights)
+{
+   return create(toRegHandle(parent), keyPath, accessRights);
+}
+
+
+bool RegKeyCache::keyExists(HKEY parent, const std::wstring& keyPath)
+{
+   return keyExists(toRegHandle(parent), keyPath);
+}
+
+
+bool RegKeyCache::removeKey(HKEY parent, const std::wstring& keyPath)
+{
+   return removeKey(toRegHandle(parent), keyPath);
+}
+
+
+void RegKeyCache::invalidate(HKEY parent, const std::wstring& keyPath)
+{
+   invalidate(toRegHandle(parent), keyPath);
+}
+#endif
+
+
+std::shared_ptr<const RegKey> RegKeyCache::open(RegHandle parent,
+                                                const std::wstring& keyPath,
+                                                RegAccess accessRights)
+{
+   WIN32UTIL_TRACE_ZONE("RegKeyCache::open", "registry");
+
+   const CacheKey id{parent, foldRegName(keyPath), accessRights};
+   if (auto cached = lookup(id))
+      return cached;
+
+   // Open without holding the lock, so that other keys can be served meanwhile.
+   auto key = std::make_shared<RegKey>();
+   if (!key->open(*m_backend, parent, keyPath, accessRights))
+      return {};
+   return insert(id, std::move(key));
+}
+
+
+std::shared_ptr<const RegKey> RegKeyCache::create(RegHandle parent,
+                                                  const std::wstring& keyPath,
+                                                  RegAccess accessRights)
+{
+   WIN32UTIL_TRACE_ZONE("RegKeyCache::create", "registry");
+
+   // A cached key exists already.
+   const CacheKey id{parent, foldRegName(keyPath), accessRights};
+   if (auto cached = lookup(id))
+      return cached;
+
+   auto key = std::make_shared<RegKey>();
+   if (!key->create(*m_backend, parent, keyPath, accessRights))
+      return {};
+   return insert(id, std::move(key));
+}
+
+
+bool RegKeyCache::keyExists(RegHandle parent, const std::wstring& keyPath)
+{
+   WIN32UTIL_TRACE_ZONE("RegKeyCache::keyExists", "registry");
+
+   const std::wstring foldedPath = foldRegName(keyPath);
+   {
+      std::scoped_lock lock{m_guard};
+      // Any access rights will do.
+      auto pos = m_index.lower_bound({parent, foldedPath, 0});
+      if (pos != m_index.end() && std::get<0>(pos->first) == parent &&
+          std::get<1>(pos->first) == foldedPath)
+      {
+         ++m_stats.hits;
+         m_entries.splice(m_entries.begin(), m_entries, pos->second);
+         return true;
+      }
+   }
+
+   // Keep the key that is opened to check for it instead of closing it again.
+   return open(parent, keyPath, RegAccessRead) != nullptr;
+}
+
+
+bool RegKeyCache::removeKey(RegHandle parent, const std::wstring& keyPath)
+{
+   invalidate(parent, keyPath);
+   return RegKey::removeKey(*m_backend, parent, keyPath);
+}
+
+
+void RegKeyCache::invalidate(RegHandle parent, const std::wstring& keyPath)
+{
+   std::scoped_lock lock{m_guard};
+   dropSubtree(parent, foldRegName(keyPath));
+}
+
+
+void RegKeyCache::clear()
+{
+   std::scoped_lock lock{m_guard};
+   m_index.clear();
+   m_entries.clear();
+}
+
+
+RegKeyCache::Stats RegKeyCache::stats() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_stats;
+}
+
+
+void RegKeyCache::resetStats()
+{
+   std::scoped_lock lock{m_guard};
+   m_stats = {};
+}
+
+
+std::shared_ptr<const RegKey> RegKeyCache::lookup(const CacheKey& id)
+{
+   std::scoped_lock lock{m_guard};
+
+   auto pos = m_index.find(id);
+   if (pos == m_index.end())
+   {
+      ++m_stats.misses;
+      return {};
+   }
+
+   ++m_stats.hits;
+   m_entries.splice(m_entries.begin(), m_entries, pos->second);
+   return pos->second->key;
+}
+
+
+std::shared_ptr<const RegKey> RegKeyCache::insert(const CacheKey& id,
+                                                  std::shared_ptr<const RegKey> key)
+{
+   std::scoped_lock lock{m_guard};
+
+   auto [pos, isNew] = m_index.try_emplace(id);
+   if (!isNew)
+   {
+      // Use the key that another thread opened meanwhile and close this one.
+      m_entries.splice(m_entries.begin(), m_entries, pos->second);
+      return pos->second->key;
+   }
+
+   m_entries.push_front({id, std::move(key)});
+   pos->second = m_entries.begin();
+
+   while (m_entries.size() > m_maxOpenKeys)
+   {
+      m_index.erase(m_entries.back().id);
+      m_entries.pop_back();
+      ++m_stats.evictions;
+   }
+   return m_entries.front().key;
+}
+
+
+void RegKeyCache::dropSubtree(RegHandle parent, const std::wstring& foldedPath)
+{
+   auto drop = [this, parent](const std::wstring& prefix, bool isExact)
+   {
+      auto pos = m_index.lower_bound({parent, prefix, 0});
+      while (pos != m_index.end() && std::get<0>(pos->first) == parent)
+      {
+         const std::wstring& path = std::get<1>(pos->first);
+         const bool matches = isExact ? (path == prefix)
+                                      : (path.compare(0, prefix.size(), prefix) == 0);
+         if (!matches)
+            break;
+
+         m_entries.erase(pos->second);
+         pos = m_index.erase(pos);
+      }
+   };
+
+   // An empty path stands for the parent's contents, i.e. all its subkeys.
+   if (foldedPath.empty())
+   {
+      drop(foldedPath, false);
+      return;
+   }
+
+   // Paths of other keys can sort between a key and its subkeys.
+   drop(foldedPath, true);
+   drop(foldedPath + L'\\', false);
+}
+
+} // namespace win32
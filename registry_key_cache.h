@@ -0,0 +1,136 @@
+//
+// Win32 utilities library
+// Cache for open registry keys.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "registry.h"
+#include "registry_backend.h"
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+
+namespace win32
+{
+///////////////////
+
+// Keeps keys open for repeated access. Keys are looked up by parent, case-insensitive
+// path and access rights. When more keys are cached than allowed, the least recently
+// used one is dropped. Keys are shared with the callers, so a dropped key stays open
+// until its last user releases it. Keys that are removed other than through the cache
+// stay cached until they are invalidated. Thread-safe.
+class WIN32UTIL_API RegKeyCache
+{
+ public:
+   static constexpr std::size_t DefaultMaxOpenKeys = 64;
+
+   struct Stats
+   {
+      std::uint64_t hits = 0;
+      std::uint64_t misses = 0;
+      // Number of keys dropped to stay within the limit.
+      std::uint64_t evictions = 0;
+
+      double hitRate() const;
+   };
+
+ public:
+#ifdef _WIN32
+   // Opens keys of the system registry.
+   explicit RegKeyCache(std::size_t maxOpenKeys = DefaultMaxOpenKeys);
+#endif
+   explicit RegKeyCache(RegBackend& backend,
+                        std::size_t maxOpenKeys = DefaultMaxOpenKeys);
+   RegKeyCache(const RegKeyCache&) = delete;
+   RegKeyCache& operator=(const RegKeyCache&) = delete;
+
+   RegBackend& backend() const;
+   std::size_t maxOpenKeys() const;
+   // Number of cached keys.
+   std::size_t size() const;
+
+   // Return null if the key cannot be opened or created.
+#ifdef _WIN32
+   std::shared_ptr<const RegKey> open(HKEY parent, const std::wstring& keyPath,
+                                      REGSAM accessRights = KEY_ALL_ACCESS);
+   std::shared_ptr<const RegKey> create(HKEY parent, const std::wstring& keyPath,
+                                        REGSAM accessRights = KEY_ALL_ACCESS);
+   bool keyExists(HKEY parent, const std::wstring& keyPath);
+   bool removeKey(HKEY parent, const std::wstring& keyPath);
+   void invalidate(HKEY parent, const std::wstring& keyPath);
+#endif
+   std::shared_ptr<const RegKey> open(RegHandle parent, const std::wstring& keyPath,
+                                      RegAccess accessRights = RegAccessAll);
+   std::shared_ptr<const RegKey> create(RegHandle parent, const std::wstring& keyPath,
+                                        RegAccess accessRights = RegAccessAll);
+   // Answered from the cache if the key is cached with any access rights. Otherwise
+   // the key is opened for reading and kept.
+   bool keyExists(RegHandle parent, const std::wstring& keyPath);
+   // Drops the key and its subkeys from the cache before removing them.
+   bool removeKey(RegHandle parent, const std::wstring& keyPath);
+   // Drops the key and its subkeys from the cache.
+   void invalidate(RegHandle parent, const std::wstring& keyPath);
+   void clear();
+
+   Stats stats() const;
+   void resetStats();
+
+ private:
+   // Parent, folded path, access rights. Ordered so that the entries of a key with
+   // different access rights are adjacent.
+   using CacheKey = std::tuple<RegHandle, std::wstring, RegAccess>;
+   struct Entry
+   {
+      CacheKey id;
+      std::shared_ptr<const RegKey> key;
+   };
+   using EntryList = std::list<Entry>;
+
+   // Returns null for keys that are not cached. Counts the lookup.
+   std::shared_ptr<const RegKey> lookup(const CacheKey& id);
+   // Returns the cached key if another thread inserted it first.
+   std::shared_ptr<const RegKey> insert(const CacheKey& id,
+                                        std::shared_ptr<const RegKey> key);
+   void dropSubtree(RegHandle parent, const std::wstring& foldedPath);
+
+ private:
+   RegBackend* m_backend = nullptr;
+   std::size_t m_maxOpenKeys = DefaultMaxOpenKeys;
+   mutable std::mutex m_guard;
+   // Most recently used first.
+   EntryList m_entries;
+   std::map<CacheKey, EntryList::iterator> m_index;
+   Stats m_stats;
+};
+
+
+inline double RegKeyCache::Stats::hitRate() const
+{
+   const std::uint64_t numLookups = hits + misses;
+   return numLookups > 0 ? static_cast<double>(hits) / static_cast<double>(numLookups)
+                         : 0.;
+}
+
+inline RegBackend& RegKeyCache::backend() const
+{
+   return *m_backend;
+}
+
+inline std::size_t RegKeyCache::maxOpenKeys() const
+{
+   return m_maxOpenKeys;
+}
+
+} // namespace win32
@@ -0,0 +1,329 @@
+//
+// Win32 utilities library
+// Traversal of registry trees.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_walker.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+struct WalkTask
+{
+   // Kept open until the subkey is opened from it.
+   std::shared_ptr<const RegKey> parent;
+   std::wstring name;
+   // Relative to the root of the walk.
+   std::wstring path;
+   std::size_t depth = 0;
+};
+
+
+// State of a walk that is shared by its threads. Each thread has a deque of pending
+// subkeys. It takes its own work from the end given by the walk order and steals
+// from the front of other deques, which holds the keys closest to the root and
+// therefore usually the largest subtrees.
+class TreeWalk
+{
+ public:
+   TreeWalk(RegBackend& backend, RegWalkVisitor& visitor, const RegWalkOptions& options,
+            std::size_t numThreads);
+
+   RegWalkStats run(std::shared_ptr<const RegKey> root);
+
+ private:
+   struct Worker
+   {
+      std::mutex guard;
+      std::deque<WalkTask> tasks;
+      RegWalkStats stats;
+   };
+
+   void work(std::size_t workerIdx);
+   // Parks an idle thread until tasks are pushed after it last looked for one or the
+   // walk is finished.
+   void waitForWork(std::uint64_t seenPushes);
+   void push(Worker& worker, std::vector<WalkTask>& tasks);
+   void finishTask();
+   std::optional<WalkTask> pop(Worker& worker);
+   std::optional<WalkTask> steal(std::size_t thiefIdx);
+   void runTask(Worker& worker, WalkTask& task);
+   void visit(Worker& worker, const std::shared_ptr<const RegKey>& key,
+              const std::wstring& path, std::size_t depth);
+
+ private:
+   RegBackend& m_backend;
+   RegWalkVisitor& m_visitor;
+   RegWalkOptions m_options;
+   std::vector<std::unique_ptr<Worker>> m_workers;
+   // Tasks that were pushed but not finished yet.
+   std::atomic<std::size_t> m_numPending = 0;
+   // Idle threads wait for pushes or the end of the walk.
+   std::mutex m_idleGuard;
+   std::condition_variable m_workAvailable;
+   // Only changed while holding the idle guard, so that waiting threads cannot miss a
+   // push.
+   std::atomic<std::uint64_t> m_numPushes = 0;
+};
+
+
+TreeWalk::TreeWalk(RegBackend& backend, RegWalkVisitor& visitor,
+                   const RegWalkOptions& options, std::size_t numThreads)
+: m_backend{backend}, m_visitor{visitor}, m_options{options}
+{
+   m_workers.reserve(numThreads);
+   for (std::size_t i = 0; i < numThreads; ++i)
+      m_workers.push_back(std::make_unique<Worker>());
+}
+
+
+RegWalkStats TreeWalk::run(std::shared_ptr<const RegKey> root)
+{
+   // The root's subkeys are the first tasks for the other threads to steal.
+   visit(*m_workers[0], root, L"", 0);
+   root.reset();
+
+   std::vector<std::thread> threads;
+   threads.reserve(m_workers.size() - 1);
+   for (std::size_t i = 1; i < m_workers.size(); ++i)
+      threads.emplace_back([this, i]() { work(i); });
+   work(0);
+   for (std::thread& th : threads)
+      th.join();
+
+   RegWalkStats stats;
+   for (const auto& worker : m_workers)
+      stats += worker->stats;
+   return stats;
+}
+
+
+void TreeWalk::work(std::size_t workerIdx)
+{
+   Worker& worker = *m_workers[workerIdx];
+   while (m_numPending.load(std::memory_order_acquire) > 0)
+   {
+      // Read before looking for tasks, so that pushes made meanwhile wake the thread.
+      const std::uint64_t seenPushes = m_numPushes.load(std::memory_order_acquire);
+      std::optional<WalkTask> task = pop(worker);
+      if (!task)
+         task = steal(workerIdx);
+      if (!task)
+      {
+         // Other threads are still visiting keys that might have subkeys.
+         waitForWork(seenPushes);
+         continue;
+      }
+
+      runTask(worker, *task);
+      finishTask();
+   }
+}
+
+
+void TreeWalk::waitForWork(std::uint64_t seenPushes)
+{
+   std::unique_lock lock{m_idleGuard};
+   m_workAvailable.wait(lock,
+                        [this, seenPushes]()
+                        {
+                           return m_numPending.load(std::memory_order_acquire) == 0 ||
+                                  m_numPushes.load(std::memory_order_acquire) !=
+                                     seenPushes;
+                        });
+}
+
+
+void TreeWalk::push(Worker& worker, std::vector<WalkTask>& tasks)
+{
+   if (tasks.empty())
+      return;
+
+   m_numPending.fetch_add(tasks.size(), std::memory_order_acq_rel);
+   {
+      std::scoped_lock lock{worker.guard};
+      for (WalkTask& task : tasks)
+         worker.tasks.push_back(std::move(task));
+   }
+   {
+      std::scoped_lock lock{m_idleGuard};
+      m_numPushes.fetch_add(1, std::memory_order_acq_rel);
+   }
+   m_workAvailable.notify_all();
+}
+
+
+void TreeWalk::finishTask()
+{
+   if (m_numPending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+
+   // Taking the guard makes sure that threads that are about to wait see the end of
+   // the walk.
+   {
+      std::scoped_lock lock{m_idleGuard};
+   }
+   m_workAvailable.notify_all();
+}
+
+
+std::optional<WalkTask> TreeWalk::pop(Worker& worker)
+{
+   std::scoped_lock lock{worker.guard};
+   if (worker.tasks.empty())
+      return {};
+
+   const bool isDepthFirst = (m_options.order == RegWalkOrder::DepthFirst);
+   WalkTask& next = isDepthFirst ? worker.tasks.back() : worker.tasks.front();
+   WalkTask task = std::move(next);
+   if (isDepthFirst)
+      worker.tasks.pop_back();
+   else
+      worker.tasks.pop_front();
+   return task;
+}
+
+
+std::optional<WalkTask> TreeWalk::steal(std::size_t thiefIdx)
+{
+   for (std::size_t i = 1; i < m_workers.size(); ++i)
+   {
+      Worker& victim = *m_workers[(thiefIdx + i) % m_workers.size()];
+      std::scoped_lock lock{victim.guard};
+      if (!victim.tasks.empty())
+      {
+         WalkTask task = std::move(victim.tasks.front());
+         victim.tasks.pop_front();
+         ++m_workers[thiefIdx]->stats.numStolenKeys;
+         return task;
+      }
+   }
+   return {};
+}
+
+
+void TreeWalk::runTask(Worker& worker, WalkTask& task)
+{
+   auto key = std::make_shared<RegKey>();
+   const bool isOpen =
+      key->open(m_backend, task.parent->handle(), task.name, RegAccessRead);
+   // Close the parent as soon as its last subkey is open.
+   task.parent.reset();
+
+   if (isOpen)
+      visit(worker, key, task.path, task.depth);
+   else
+      ++worker.stats.numFailedKeys;
+}
+
+
+void TreeWalk::visit(Worker& worker, const std::shared_ptr<const RegKey>& key,
+                     const std::wstring& path, std::size_t depth)
+{
+   WIN32UTIL_TRACE_ZONE("walkRegistry visit", "registry");
+
+   ++worker.stats.numKeys;
+   const bool walkSubkeys =
+      m_visitor.visitKey(*key, path, depth) && depth < m_options.maxDepth;
+
+   const RegEntryRange entries = key->entries();
+   auto entry = entries.begin();
+   for (; entry != entries.end(); ++entry)
+   {
+      const RegEntryInfo info = *entry;
+      ++worker.stats.numEntries;
+      worker.stats.numEntryBytes += info.numBytes;
+      m_visitor.visitEntry(*key, path, info);
+   }
+   bool hasFailed = entry.hasFailed();
+
+   if (walkSubkeys)
+   {
+      std::vector<WalkTask> tasks;
+      const RegSubkeyRange subkeys = key->subkeys();
+      auto subkey = subkeys.begin();
+      for (; subkey != subkeys.end(); ++subkey)
+      {
+         std::wstring name{*subkey};
+         std::wstring subkeyPath = path.empty() ? name : path + L'\\' + name;
+         tasks.push_back({key, std::move(name), std::move(subkeyPath), depth + 1});
+      }
+      hasFailed = hasFailed || subkey.hasFailed();
+
+      // Depth-first takes tasks from the back, so push them in reverse to visit the
+      // subkeys in the order they are enumerated.
+      if (m_options.order == RegWalkOrder::DepthFirst)
+         std::reverse(tasks.begin(), tasks.end());
+      push(worker, tasks);
+   }
+
+   if (hasFailed)
+      ++worker.stats.numFailedKeys;
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+RegWalkStats& RegWalkStats::operator+=(const RegWalkStats& other)
+{
+   numKeys += other.numKeys;
+   numEntries += other.numEntries;
+   numEntryBytes += other.numEntryBytes;
+   numFailedKeys += other.numFailedKeys;
+   numStolenKeys += other.numStolenKeys;
+   return *this;
+}
+
+
+#ifdef _WIN32
+std::optional<RegWalkStats> walkRegistry(HKEY parent, const std::wstring& keyPath,
+                                         RegWalkVisitor& visitor,
+                                         const RegWalkOptions& options)
+{
+   return walkRegistry(win32RegBackend(), toRegHandle(parent), keyPath, visitor,
+                       options);
+}
+#endif
+
+
+std::optional<RegWalkStats> walkRegistry(RegBackend& backend, RegHandle parent,
+                                         const std::wstring& keyPath,
+                                         RegWalkVisitor& visitor,
+                                         const RegWalkOptions& options)
+{
+   WIN32UTIL_TRACE_ZONE("walkRegistry", "registry");
+
+   auto root = std::make_shared<RegKey>();
+   if (!root->open(backend, parent, keyPath, RegAccessRead))
+      return {};
+
+   std::size_t numThreads = options.numThreads;
+   if (numThreads == 0)
+      numThreads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+   TreeWalk walk{backend, visitor, options, numThreads};
+   return walk.run(std::move(root));
+}
+
+} // namespace win32
@@ -0,0 +1,97 @@
+//
+// Win32 utilities library
+// Traversal of registry trees.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "registry.h"
+#include "registry_backend.h"
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+
+
+namespace win32
+{
+///////////////////
+
+enum class RegWalkOrder
+{
+   DepthFirst,
+   BreadthFirst
+};
+
+
+struct RegWalkOptions
+{
+   // Visiting order on each thread. Keys visited on different threads have no order.
+   RegWalkOrder order = RegWalkOrder::DepthFirst;
+   // Threads that visit keys. Zero uses one per core. With a single thread the walk
+   // runs on the calling thread.
+   std::size_t numThreads = 1;
+   // Subkeys deeper than this are not visited. The root has depth zero.
+   std::size_t maxDepth = std::numeric_limits<std::size_t>::max();
+};
+
+
+struct RegWalkStats
+{
+   std::uint64_t numKeys = 0;
+   std::uint64_t numEntries = 0;
+   // Size of the data of all entries.
+   std::uint64_t numEntryBytes = 0;
+   // Keys that could not be opened or enumerated completely.
+   std::uint64_t numFailedKeys = 0;
+   // Keys that were taken over by idle threads.
+   std::uint64_t numStolenKeys = 0;
+
+   RegWalkStats& operator+=(const RegWalkStats& other);
+};
+
+
+// Receives the keys and entries of a walk. With multiple threads the functions are
+// called concurrently for different keys, while the entries of a key are visited on
+// the thread that visited the key.
+class WIN32UTIL_API RegWalkVisitor
+{
+ public:
+   virtual ~RegWalkVisitor() = default;
+
+   // Called before the entries of a key are visited. The path is relative to the root
+   // of the walk, which has an empty path. Returns whether to walk the subkeys.
+   virtual bool visitKey(const RegKey& key, const std::wstring& path,
+                         std::size_t depth) = 0;
+   virtual void visitEntry(const RegKey& key, const std::wstring& path,
+                           const RegEntryInfo& entry);
+};
+
+
+// Visits the key at the given path and its subtree. Subkeys are opened from their
+// parent's handle, so the parent stays open until all its subkeys are opened. Idle
+// threads steal pending subtrees from other threads. Fails if the root cannot be
+// opened.
+#ifdef _WIN32
+WIN32UTIL_API std::optional<RegWalkStats>
+walkRegistry(HKEY parent, const std::wstring& keyPath, RegWalkVisitor& visitor,
+             const RegWalkOptions& options = {});
+#endif
+WIN32UTIL_API std::optional<RegWalkStats>
+walkRegistry(RegBackend& backend, RegHandle parent, const std::wstring& keyPath,
+             RegWalkVisitor& visitor, const RegWalkOptions& options = {});
+
+
+inline void RegWalkVisitor::visitEntry(const RegKey& /*key*/,
+                                       const std::wstring& /*path*/,
+                                       const RegEntryInfo& /*entry*/)
+{
+}
+
+} // namespace win32
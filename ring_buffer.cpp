@@ -0,0 +1,403 @@
+//
+// Win32 utilities library
+// Ring buffers over mirrored memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "ring_buffer.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+std::size_t roundUp(std::size_t numBytes, std::size_t granularity)
+{
+   return (numBytes + granularity - 1) / granularity * granularity;
+}
+
+
+std::size_t roundUpToPowerOfTwo(std::size_t n)
+{
+   std::size_t pow2 = 1;
+   while (pow2 < n)
+      pow2 *= 2;
+   return pow2;
+}
+
+
+#ifdef _WIN32
+
+// Placeholder functions are only available from Windows 10 1803 on.
+using VirtualAlloc2_t = PVOID(WINAPI*)(HANDLE, PVOID, SIZE_T, ULONG, ULONG,
+                                       MEM_EXTENDED_PARAMETER*, ULONG);
+using MapViewOfFile3_t = PVOID(WINAPI*)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG,
+                                        ULONG, MEM_EXTENDED_PARAMETER*, ULONG);
+
+
+struct PlaceholderApi
+{
+   VirtualAlloc2_t virtualAlloc2 = nullptr;
+   MapViewOfFile3_t mapViewOfFile3 = nullptr;
+
+   PlaceholderApi();
+   bool isAvailable() const { return virtualAlloc2 && mapViewOfFile3; }
+};
+
+
+PlaceholderApi::PlaceholderApi()
+{
+   HMODULE kernelBase = GetModuleHandleW(L"kernelbase.dll");
+   if (kernelBase)
+   {
+      virtualAlloc2 =
+         reinterpret_cast<VirtualAlloc2_t>(GetProcAddress(kernelBase, "VirtualAlloc2"));
+      mapViewOfFile3 =
+         reinterpret_cast<MapViewOfFile3_t>(GetProcAddress(kernelBase, "MapViewOfFile3"));
+   }
+}
+
+
+const PlaceholderApi& placeholderApi()
+{
+   static const PlaceholderApi api;
+   return api;
+}
+
+
+std::size_t allocationGranularity()
+{
+   static const std::size_t granularity = []() {
+      SYSTEM_INFO info;
+      GetSystemInfo(&info);
+      return static_cast<std::size_t>(info.dwAllocationGranularity);
+   }();
+   return granularity;
+}
+
+
+std::byte* mapMirrored(std::size_t size)
+{
+   const PlaceholderApi& api = placeholderApi();
+   if (!api.isAvailable())
+      return nullptr;
+
+   const auto size64 = static_cast<std::uint64_t>(size);
+   HANDLE section = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                       static_cast<DWORD>(size64 >> 32),
+                                       static_cast<DWORD>(size64 & 0xFFFFFFFF), NULL);
+   if (section == NULL)
+      return nullptr;
+
+   // Reserve both halves as one placeholder and split it, so that each half can be
+   // replaced by a view of the section.
+   HANDLE process = GetCurrentProcess();
+   auto* first = static_cast<std::byte*>(
+      api.virtualAlloc2(process, NULL, 2 * size, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER,
+                        PAGE_NOACCESS, NULL, 0));
+   if (!first)
+   {
+      CloseHandle(section);
+      return nullptr;
+   }
+   std::byte* second = first + size;
+   VirtualFree(first, size, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+
+   void* firstView = api.mapViewOfFile3(section, process, first, 0, size,
+                                        MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, NULL, 0);
+   void* secondView = firstView ? api.mapViewOfFile3(section, process, second, 0, size,
+                                                     MEM_REPLACE_PLACEHOLDER,
+                                                     PAGE_READWRITE, NULL, 0)
+                                : nullptr;
+   // The views keep the section alive.
+   CloseHandle(section);
+
+   if (!secondView)
+   {
+      if (firstView)
+         UnmapViewOfFile(firstView);
+      else
+         VirtualFree(first, 0, MEM_RELEASE);
+      VirtualFree(second, 0, MEM_RELEASE);
+      return nullptr;
+   }
+
+   return first;
+}
+
+
+void unmapMirrored(std::byte* p, std::size_t size)
+{
+   UnmapViewOfFile(p);
+   UnmapViewOfFile(p + size);
+}
+
+#else
+
+std::size_t allocationGranularity()
+{
+   static const auto granularity = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+   return granularity;
+}
+
+
+std::byte* mapMirrored(std::size_t size)
+{
+#ifdef __linux__
+   const int fd = memfd_create("win32util_ring_buffer", MFD_CLOEXEC);
+   if (fd == -1)
+      return nullptr;
+
+   std::byte* first = nullptr;
+   if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+   {
+      // Reserve both halves and replace them with mappings of the same file.
+      void* p = mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p != MAP_FAILED)
+      {
+         first = static_cast<std::byte*>(p);
+         const int prot = PROT_READ | PROT_WRITE;
+         if (mmap(first, size, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+             mmap(first + size, size, prot, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+         {
+            munmap(first, 2 * size);
+            first = nullptr;
+         }
+      }
+   }
+
+   // The mappings keep the file alive.
+   close(fd);
+   return first;
+#else
+   return nullptr;
+#endif
+}
+
+
+void unmapMirrored(std::byte* p, std::size_t size)
+{
+   munmap(p, 2 * size);
+}
+
+#endif //_WIN32
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+bool MirroredMem::isSupported()
+{
+#ifdef _WIN32
+   return placeholderApi().isAvailable();
+#elif defined(__linux__)
+   return true;
+#else
+   return false;
+#endif
+}
+
+
+std::size_t MirroredMem::granularity()
+{
+   return allocationGranularity();
+}
+
+
+bool MirroredMem::allocate(std::size_t numBytes)
+{
+   release();
+   if (numBytes == 0)
+      return false;
+
+   const std::size_t size = roundUp(numBytes, granularity());
+   m_ptr = mapMirrored(size);
+   if (m_ptr)
+      m_size = size;
+   return m_ptr != nullptr;
+}
+
+
+void MirroredMem::release()
+{
+   if (m_ptr)
+      unmapMirrored(m_ptr, m_size);
+   m_ptr = nullptr;
+   m_size = 0;
+}
+
+
+///////////////////
+
+RingBufferBase::RingBufferBase(std::size_t capacity)
+{
+   const std::size_t minSize = std::max<std::size_t>(capacity, 1);
+   const std::size_t size =
+      roundUpToPowerOfTwo(roundUp(minSize, MirroredMem::granularity()));
+   if (m_mem.allocate(size))
+      m_mask = m_mem.size() - 1;
+}
+
+
+std::size_t RingBufferBase::readableSize() const
+{
+   const std::uint64_t readPos = m_read.pos.load(std::memory_order_acquire);
+   const std::uint64_t writePos = m_write.pos.load(std::memory_order_acquire);
+   return static_cast<std::size_t>(writePos - readPos);
+}
+
+
+std::span<const std::byte> RingBufferBase::beginRead()
+{
+   const std::uint64_t readPos = m_read.pos.load(std::memory_order_relaxed);
+   const std::uint64_t writePos = m_write.pos.load(std::memory_order_acquire);
+   return {at(readPos), static_cast<std::size_t>(writePos - readPos)};
+}
+
+
+void RingBufferBase::endRead(std::size_t numBytes)
+{
+   const std::uint64_t readPos = m_read.pos.load(std::memory_order_relaxed);
+   m_read.pos.store(readPos + numBytes, std::memory_order_release);
+}
+
+
+std::size_t RingBufferBase::read(std::span<std::byte> dest)
+{
+   const std::span<const std::byte> readable = beginRead();
+   const std::size_t numBytes = std::min(readable.size(), dest.size());
+   if (numBytes > 0)
+   {
+      std::memcpy(dest.data(), readable.data(), numBytes);
+      endRead(numBytes);
+   }
+   return numBytes;
+}
+
+
+std::size_t RingBufferBase::writableSize(std::uint64_t writePos,
+                                         std::uint64_t& cachedReadPos,
+                                         std::size_t required) const
+{
+   std::size_t writable = capacity() - static_cast<std::size_t>(writePos - cachedReadPos);
+   if (writable < required)
+   {
+      cachedReadPos = m_read.pos.load(std::memory_order_acquire);
+      writable = capacity() - static_cast<std::size_t>(writePos - cachedReadPos);
+   }
+   return writable;
+}
+
+
+///////////////////
+
+SpscRingBuffer::SpscRingBuffer(std::size_t capacity) : RingBufferBase{capacity}
+{
+}
+
+
+std::span<std::byte> SpscRingBuffer::beginWrite(std::size_t numBytes)
+{
+   if (!*this || numBytes == 0)
+      return {};
+
+   const std::uint64_t writePos = m_write.pos.load(std::memory_order_relaxed);
+   if (writableSize(writePos, m_write.cachedOtherPos, numBytes) < numBytes)
+      return {};
+   return {at(writePos), numBytes};
+}
+
+
+void SpscRingBuffer::endWrite(std::size_t numBytes)
+{
+   const std::uint64_t writePos = m_write.pos.load(std::memory_order_relaxed);
+   m_write.pos.store(writePos + numBytes, std::memory_order_release);
+}
+
+
+bool SpscRingBuffer::write(std::span<const std::byte> data)
+{
+   const std::span<std::byte> dest = beginWrite(data.size());
+   if (dest.empty())
+      return data.empty();
+
+   std::memcpy(dest.data(), data.data(), data.size());
+   endWrite(data.size());
+   return true;
+}
+
+
+///////////////////
+
+MpscRingBuffer::MpscRingBuffer(std::size_t capacity) : RingBufferBase{capacity}
+{
+}
+
+
+RingReservation MpscRingBuffer::beginWrite(std::size_t numBytes)
+{
+   if (!*this || numBytes == 0)
+      return {};
+
+   std::uint64_t reservePos = m_reserve.pos.load(std::memory_order_relaxed);
+   for (;;)
+   {
+      // The cached read position is shared by producers, so always reload it.
+      const std::uint64_t readPos = m_read.pos.load(std::memory_order_acquire);
+      if (capacity() - static_cast<std::size_t>(reservePos - readPos) < numBytes)
+         return {};
+
+      if (m_reserve.pos.compare_exchange_weak(reservePos, reservePos + numBytes,
+                                              std::memory_order_relaxed))
+      {
+         return {{at(reservePos), numBytes}, reservePos};
+      }
+   }
+}
+
+
+void MpscRingBuffer::endWrite(const RingReservation& reservation)
+{
+   if (!reservation)
+      return;
+
+   // Publish in reservation order. Earlier producers are usually close to done.
+   std::size_t numSpins = 0;
+   while (m_write.pos.load(std::memory_order_acquire) != reservation.pos)
+   {
+      if (++numSpins % 64 == 0)
+         std::this_thread::yield();
+   }
+
+   m_write.pos.store(reservation.pos + reservation.data.size(),
+                     std::memory_order_release);
+}
+
+
+bool MpscRingBuffer::write(std::span<const std::byte> data)
+{
+   const RingReservation reservation = beginWrite(data.size());
+   if (!reservation)
+      return data.empty();
+
+   std::memcpy(reservation.data.data(), data.data(), data.size());
+   endWrite(reservation);
+   return true;
+}
+
+} // namespace win32
@@ -0,0 +1,238 @@
+//
+// Win32 utilities library
+// Ring buffers over mirrored memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+// RAII class for memory whose pages are mapped twice back to back. Accesses that run
+// past the end of the first mapping continue at its start, so ranges that wrap
+// around are contiguous.
+// Uses placeholder mappings on Windows (requires Windows 10 1803) and memfd on Linux.
+class WIN32UTIL_API MirroredMem
+{
+ public:
+   MirroredMem() = default;
+   ~MirroredMem();
+   MirroredMem(const MirroredMem&) = delete;
+   MirroredMem(MirroredMem&& other) noexcept;
+   MirroredMem& operator=(const MirroredMem&) = delete;
+   MirroredMem& operator=(MirroredMem&& other) noexcept;
+
+   explicit operator bool() const;
+   friend void swap(MirroredMem& a, MirroredMem& b) noexcept;
+
+   static bool isSupported();
+   // Size that mirrored memory has to be a multiple of.
+   static std::size_t granularity();
+
+   // Start of the first mapping. The second mapping follows at data() + size().
+   std::byte* data();
+   const std::byte* data() const;
+   // Size of one mapping.
+   std::size_t size() const;
+
+   // The size gets rounded up to the granularity.
+   bool allocate(std::size_t numBytes);
+   void release();
+
+ private:
+   std::byte* m_ptr = nullptr;
+   std::size_t m_size = 0;
+};
+
+
+inline MirroredMem::~MirroredMem()
+{
+   release();
+}
+
+inline MirroredMem::MirroredMem(MirroredMem&& other) noexcept
+{
+   swap(*this, other);
+}
+
+inline MirroredMem& MirroredMem::operator=(MirroredMem&& other) noexcept
+{
+   release();
+   swap(*this, other);
+   return *this;
+}
+
+inline MirroredMem::operator bool() const
+{
+   return m_ptr != nullptr;
+}
+
+inline void swap(MirroredMem& a, MirroredMem& b) noexcept
+{
+   std::swap(a.m_ptr, b.m_ptr);
+   std::swap(a.m_size, b.m_size);
+}
+
+inline std::byte* MirroredMem::data()
+{
+   return m_ptr;
+}
+
+inline const std::byte* MirroredMem::data() const
+{
+   return m_ptr;
+}
+
+inline std::size_t MirroredMem::size() const
+{
+   return m_size;
+}
+
+
+namespace detail
+{
+///////////////////
+
+constexpr std::size_t CacheLineSize = 64;
+
+// Position that is written by one side of a ring buffer. Padded to keep the
+// positions of producers and consumer on separate cache lines.
+struct RingPosition
+{
+   std::atomic<std::uint64_t> pos = 0;
+   // Last seen position of the other side. Only accessed by the owning side.
+   std::uint64_t cachedOtherPos = 0;
+   std::byte padding[CacheLineSize - sizeof(std::atomic<std::uint64_t>) -
+                     sizeof(std::uint64_t)];
+};
+
+} // namespace detail
+
+
+///////////////////
+
+// Byte ring buffer with a single consumer. Reads and writes never have to be split
+// at the end of the buffer.
+// Positions count the bytes that were ever written and read, so they never wrap.
+class WIN32UTIL_API RingBufferBase
+{
+ public:
+   RingBufferBase(const RingBufferBase&) = delete;
+   RingBufferBase& operator=(const RingBufferBase&) = delete;
+
+   explicit operator bool() const;
+   std::size_t capacity() const;
+   // Number of bytes that are ready to be read. Only a snapshot if called by a
+   // producer.
+   std::size_t readableSize() const;
+
+   // Consumer functions.
+   // Returns all bytes that are ready to be read as one contiguous range.
+   std::span<const std::byte> beginRead();
+   // Frees the given number of bytes at the start of the readable range.
+   void endRead(std::size_t numBytes);
+   // Copies up to the size of the destination. Returns the number of copied bytes.
+   std::size_t read(std::span<std::byte> dest);
+
+ protected:
+   // The capacity gets rounded up to a power of two that is a multiple of the
+   // granularity of mirrored memory.
+   explicit RingBufferBase(std::size_t capacity);
+   ~RingBufferBase() = default;
+
+   std::byte* at(std::uint64_t pos);
+   // Number of bytes that can be written at the given write position. Reloads the
+   // read position of the consumer when the cached one shows too little space.
+   std::size_t writableSize(std::uint64_t writePos, std::uint64_t& cachedReadPos,
+                            std::size_t required) const;
+
+ protected:
+   MirroredMem m_mem;
+   std::uint64_t m_mask = 0;
+   // Position up to which bytes were published by producers.
+   detail::RingPosition m_write;
+   detail::RingPosition m_read;
+};
+
+
+inline RingBufferBase::operator bool() const
+{
+   return m_mem.operator bool();
+}
+
+inline std::size_t RingBufferBase::capacity() const
+{
+   return m_mem.size();
+}
+
+inline std::byte* RingBufferBase::at(std::uint64_t pos)
+{
+   return m_mem.data() + (pos & m_mask);
+}
+
+
+///////////////////
+
+// Ring buffer for a single producer and a single consumer.
+class WIN32UTIL_API SpscRingBuffer : public RingBufferBase
+{
+ public:
+   explicit SpscRingBuffer(std::size_t capacity);
+
+   // Producer functions.
+   // Returns a contiguous range of the given size to write to or an empty range if
+   // the buffer does not have enough free space.
+   std::span<std::byte> beginWrite(std::size_t numBytes);
+   // Publishes the given number of bytes at the start of the range that was
+   // returned by the last call to beginWrite.
+   void endWrite(std::size_t numBytes);
+   // Writes all or nothing.
+   bool write(std::span<const std::byte> data);
+};
+
+
+///////////////////
+
+// Range of a multi-producer ring buffer that is reserved for one producer.
+struct RingReservation
+{
+   std::span<std::byte> data;
+   std::uint64_t pos = 0;
+
+   explicit operator bool() const { return !data.empty(); }
+};
+
+
+// Ring buffer for multiple producers and a single consumer.
+// Producers reserve ranges concurrently but publish them in reservation order.
+class WIN32UTIL_API MpscRingBuffer : public RingBufferBase
+{
+ public:
+   explicit MpscRingBuffer(std::size_t capacity);
+
+   // Producer functions. Thread-safe.
+   // Reserves a contiguous range of the given size. Returns an empty reservation if
+   // the buffer does not have enough free space.
+   RingReservation beginWrite(std::size_t numBytes);
+   // Publishes a reservation. Waits until all earlier reservations are published,
+   // so every reservation has to be published eventually.
+   void endWrite(const RingReservation& reservation);
+   // Writes all or nothing.
+   bool write(std::span<const std::byte> data);
+
+ private:
+   // Position up to which ranges were reserved.
+   detail::RingPosition m_reserve;
+};
+
+} // namespace win32
@@ -0,0 +1,136 @@
+//
+// Win32 utilities library
+// Timer scheduler that runs on virtual time.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "simulated_scheduler.h"
+#include <utility>
+
+using namespace win32;
+
+
+namespace win32
+{
+///////////////////
+
+SimulatedScheduler::SimulatedScheduler(std::uint64_t nowMs) : m_clock{nowMs}
+{
+}
+
+
+SimulatedScheduler::TimerId SimulatedScheduler::start(std::uint64_t delayMs,
+                                                      Callback_t callback,
+                                                      std::uint64_t periodMs)
+{
+   if (!callback)
+      return 0;
+
+   const TimerId id = m_nextId++;
+   Entry& entry = m_timers[id];
+   entry.callback = std::move(callback);
+   entry.due = now() + delayMs;
+   entry.period = periodMs;
+   schedule(id, entry);
+   return id;
+}
+
+
+bool SimulatedScheduler::stop(TimerId id)
+{
+   // The queue entry becomes stale.
+   return m_timers.erase(id) > 0;
+}
+
+
+std::uint64_t SimulatedScheduler::nextDueTime() const
+{
+   dropStale();
+   return m_dueTimes.empty() ? NoDueTime : m_dueTimes.top().due;
+}
+
+
+std::size_t SimulatedScheduler::advanceTo(std::uint64_t timeMs)
+{
+   std::size_t numExpired = 0;
+   while (expireNext(timeMs))
+      ++numExpired;
+
+   if (timeMs > now())
+      m_clock.set(timeMs);
+   return numExpired;
+}
+
+
+std::size_t SimulatedScheduler::advanceToNext()
+{
+   const std::uint64_t due = nextDueTime();
+   if (due == NoDueTime)
+      return 0;
+   return advanceTo(due);
+}
+
+
+void SimulatedScheduler::schedule(TimerId id, Entry& entry)
+{
+   entry.seq = m_nextSeq++;
+   m_dueTimes.push({entry.due, entry.seq, id});
+}
+
+
+void SimulatedScheduler::dropStale() const
+{
+   while (!m_dueTimes.empty())
+   {
+      const Due& next = m_dueTimes.top();
+      auto pos = m_timers.find(next.id);
+      if (pos != m_timers.end() && pos->second.seq == next.seq)
+         return;
+      m_dueTimes.pop();
+   }
+}
+
+
+bool SimulatedScheduler::expireNext(std::uint64_t limitMs)
+{
+   dropStale();
+   if (m_dueTimes.empty() || m_dueTimes.top().due > limitMs)
+      return false;
+
+   const Due next = m_dueTimes.top();
+   m_dueTimes.pop();
+
+   // Time never runs backwards, even for timers that were due in the past.
+   if (next.due > now())
+      m_clock.set(next.due);
+
+   auto pos = m_timers.find(next.id);
+   Entry& entry = pos->second;
+   const bool isPeriodic = (entry.period > 0);
+
+   // Callbacks can stop their own timer, so call a moved-out callback.
+   Callback_t callback = std::move(entry.callback);
+   if (isPeriodic)
+   {
+      entry.due += entry.period;
+      schedule(next.id, entry);
+   }
+   else
+   {
+      m_timers.erase(pos);
+   }
+
+   ++m_numExpirations;
+   callback(next.id);
+
+   if (isPeriodic)
+   {
+      pos = m_timers.find(next.id);
+      if (pos != m_timers.end())
+         pos->second.callback = std::move(callback);
+   }
+   return true;
+}
+
+} // namespace win32
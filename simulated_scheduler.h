@@ -0,0 +1,135 @@
+//
+// Win32 utilities library
+// Timer scheduler that runs on virtual time.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "clock.h"
+#include "timer_scheduler.h"
+#include "win32_util_api.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Scheduler whose time only passes when the owner advances it. Timers expire in
+// order of their due times and, for equal due times, in the order they were
+// scheduled. While a callback runs the clock reads the timer's due time, so latency
+// and ordering are reproducible and no real time passes.
+// Not thread-safe.
+class WIN32UTIL_API SimulatedScheduler : public TimerScheduler
+{
+ public:
+   static constexpr std::uint64_t NoDueTime = std::numeric_limits<std::uint64_t>::max();
+
+ public:
+   explicit SimulatedScheduler(std::uint64_t nowMs = 0);
+   SimulatedScheduler(const SimulatedScheduler&) = delete;
+   SimulatedScheduler& operator=(const SimulatedScheduler&) = delete;
+
+   const Clock& clock() const override;
+   std::uint64_t now() const;
+   std::size_t size() const;
+   bool empty() const;
+   // Number of callbacks called since construction.
+   std::uint64_t numExpirations() const;
+
+   TimerId start(std::uint64_t delayMs, Callback_t callback,
+                 std::uint64_t periodMs = 0) override;
+   bool stop(TimerId id) override;
+   bool isActive(TimerId id) const override;
+
+   // Due time of the next timer. NoDueTime if no timers are active.
+   std::uint64_t nextDueTime() const;
+   // Expires all timers that are due up to the given time, including timers that
+   // callbacks start on the way, and leaves the clock at that time. Returns the
+   // number of expirations.
+   std::size_t advanceTo(std::uint64_t timeMs);
+   std::size_t advanceBy(std::uint64_t deltaMs);
+   // Advances to the next due time and expires the timers that are due then.
+   std::size_t advanceToNext();
+
+ private:
+   struct Entry
+   {
+      Callback_t callback;
+      std::uint64_t due = 0;
+      std::uint64_t period = 0;
+      // Identifies the current entry in the due queue.
+      std::uint64_t seq = 0;
+   };
+
+   struct Due
+   {
+      std::uint64_t due = 0;
+      std::uint64_t seq = 0;
+      TimerId id = 0;
+
+      // Makes the priority queue return the earliest due time first.
+      friend bool operator<(const Due& a, const Due& b)
+      {
+         return a.due != b.due ? a.due > b.due : a.seq > b.seq;
+      }
+   };
+
+   void schedule(TimerId id, Entry& entry);
+   // Removes queue entries of stopped or rescheduled timers from the top.
+   void dropStale() const;
+   bool expireNext(std::uint64_t limitMs);
+
+ private:
+   ManualClock m_clock;
+   std::unordered_map<TimerId, Entry> m_timers;
+   // Can hold stale entries, which are identified by their sequence number.
+   mutable std::priority_queue<Due> m_dueTimes;
+   TimerId m_nextId = 1;
+   std::uint64_t m_nextSeq = 0;
+   std::uint64_t m_numExpirations = 0;
+};
+
+
+inline const Clock& SimulatedScheduler::clock() const
+{
+   return m_clock;
+}
+
+inline std::uint64_t SimulatedScheduler::now() const
+{
+   return m_clock.nowMs();
+}
+
+inline std::size_t SimulatedScheduler::size() const
+{
+   return m_timers.size();
+}
+
+inline bool SimulatedScheduler::empty() const
+{
+   return m_timers.empty();
+}
+
+inline std::uint64_t SimulatedScheduler::numExpirations() const
+{
+   return m_numExpirations;
+}
+
+inline bool SimulatedScheduler::isActive(TimerId id) const
+{
+   return m_timers.find(id) != m_timers.end();
+}
+
+inline std::size_t SimulatedScheduler::advanceBy(std::uint64_t deltaMs)
+{
+   return advanceTo(now() + deltaMs);
+}
+
+} // namespace win32
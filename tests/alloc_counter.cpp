@@ -0,0 +1,266 @@
+//
+// Win32 utilities library
+// Allocation counting for tests.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "alloc_counter.h"
+#include <cstdlib>
+#include <new>
+#include <utility>
+#ifdef _WIN32
+#include <crtdbg.h>
+#include <malloc.h>
+#endif
+
+
+namespace
+{
+///////////////////
+
+// Only counted while at least one counter of the thread is active.
+thread_local std::size_t t_numCounters = 0;
+thread_local std::size_t t_numAllocs = 0;
+thread_local std::size_t t_numBytes = 0;
+// Prevents counting allocations twice when operator new calls malloc.
+thread_local bool t_isInOperatorNew = false;
+
+
+void countAllocation(std::size_t numBytes)
+{
+   if (t_numCounters > 0)
+   {
+      ++t_numAllocs;
+      t_numBytes += numBytes;
+   }
+}
+
+
+void* allocate(std::size_t numBytes)
+{
+   countAllocation(numBytes);
+
+   if (numBytes == 0)
+      numBytes = 1;
+
+   t_isInOperatorNew = true;
+   void* p = std::malloc(numBytes);
+   t_isInOperatorNew = false;
+   return p;
+}
+
+
+void* allocateAligned(std::size_t numBytes, std::size_t alignment)
+{
+   countAllocation(numBytes);
+
+   if (numBytes == 0)
+      numBytes = 1;
+
+   t_isInOperatorNew = true;
+#ifdef _WIN32
+   void* p = _aligned_malloc(numBytes, alignment);
+#else
+   // Size has to be a multiple of the alignment.
+   const std::size_t alignedSize = (numBytes + alignment - 1) / alignment * alignment;
+   void* p = std::aligned_alloc(alignment, alignedSize);
+#endif
+   t_isInOperatorNew = false;
+   return p;
+}
+
+
+void freeAligned(void* p)
+{
+#ifdef _WIN32
+   _aligned_free(p);
+#else
+   std::free(p);
+#endif
+}
+
+
+// Calls the new-handler until the allocation succeeds.
+template <typename AllocFn> void* allocateOrThrow(AllocFn alloc)
+{
+   for (;;)
+   {
+      if (void* p = alloc())
+         return p;
+
+      std::new_handler handler = std::get_new_handler();
+      if (!handler)
+         throw std::bad_alloc{};
+      handler();
+   }
+}
+
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+int crtAllocHook(int allocType, void* /*userData*/, std::size_t numBytes, int blockType,
+                 long /*requestNum*/, const unsigned char* /*fileName*/, int /*lineNum*/)
+{
+   if (allocType == _HOOK_ALLOC && blockType != _CRT_BLOCK && !t_isInOperatorNew)
+      countAllocation(numBytes);
+   return TRUE;
+}
+
+const _CRT_ALLOC_HOOK s_prevHook = _CrtSetAllocHook(crtAllocHook);
+#endif
+
+
+std::vector<AllocReportEntry>& reportEntries()
+{
+   static std::vector<AllocReportEntry> entries;
+   return entries;
+}
+
+} // namespace
+
+
+///////////////////
+
+// Replacements of the global allocation functions. The array forms forward to these
+// by default. The nothrow forms are replaced as well, because the standard library
+// allocates with them and frees with the plain forms, e.g. in std::stable_sort.
+
+void* operator new(std::size_t numBytes)
+{
+   return allocateOrThrow([numBytes]() { return allocate(numBytes); });
+}
+
+
+void* operator new(std::size_t numBytes, std::align_val_t alignment)
+{
+   return allocateOrThrow([numBytes, alignment]() {
+      return allocateAligned(numBytes, static_cast<std::size_t>(alignment));
+   });
+}
+
+
+void* operator new(std::size_t numBytes, const std::nothrow_t&) noexcept
+{
+   try
+   {
+      return operator new(numBytes);
+   }
+   catch (const std::bad_alloc&)
+   {
+      return nullptr;
+   }
+}
+
+
+void* operator new(std::size_t numBytes, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept
+{
+   try
+   {
+      return operator new(numBytes, alignment);
+   }
+   catch (const std::bad_alloc&)
+   {
+      return nullptr;
+   }
+}
+
+
+void operator delete(void* p) noexcept
+{
+   std::free(p);
+}
+
+
+void operator delete(void* p, std::size_t) noexcept
+{
+   std::free(p);
+}
+
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+   freeAligned(p);
+}
+
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+   freeAligned(p);
+}
+
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+   std::free(p);
+}
+
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+   freeAligned(p);
+}
+
+
+///////////////////
+
+AllocCounter::AllocCounter() : m_startAllocs{t_numAllocs}, m_startBytes{t_numBytes}
+{
+   ++t_numCounters;
+}
+
+
+AllocCounter::~AllocCounter()
+{
+   --t_numCounters;
+}
+
+
+std::size_t AllocCounter::allocations() const
+{
+   return t_numAllocs - m_startAllocs;
+}
+
+
+std::size_t AllocCounter::bytes() const
+{
+   return t_numBytes - m_startBytes;
+}
+
+
+///////////////////
+
+ScopedAllocReport::ScopedAllocReport(std::string testName)
+: m_testName{std::move(testName)}
+{
+}
+
+
+ScopedAllocReport::~ScopedAllocReport()
+{
+   const std::size_t numAllocs = m_counter.allocations();
+   const std::size_t numBytes = m_counter.bytes();
+   reportEntries().push_back({std::move(m_testName), numAllocs, numBytes});
+}
+
+
+const std::vector<AllocReportEntry>& allocReport()
+{
+   return reportEntries();
+}
+
+
+std::string formatAllocReport()
+{
+   std::string report;
+   for (const AllocReportEntry& entry : reportEntries())
+   {
+      report += entry.testName;
+      report += ": ";
+      report += std::to_string(entry.allocations);
+      report += " allocations, ";
+      report += std::to_string(entry.bytes);
+      report += " bytes\n";
+   }
+   return report;
+}
@@ -0,0 +1,80 @@
+//
+// Win32 utilities library
+// Allocation counting for tests.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "test_util.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+///////////////////
+
+// Counts the allocations of the current thread while in scope.
+// Counts calls to the global operator new (replaced by the test binary) and, for
+// debug builds of the MSVC runtime, calls to malloc. Scopes can be nested.
+class AllocCounter
+{
+ public:
+   AllocCounter();
+   ~AllocCounter();
+   AllocCounter(const AllocCounter&) = delete;
+   AllocCounter& operator=(const AllocCounter&) = delete;
+
+   std::size_t allocations() const;
+   std::size_t bytes() const;
+
+ private:
+   std::size_t m_startAllocs = 0;
+   std::size_t m_startBytes = 0;
+};
+
+
+// Verifies that a statement does not allocate on the current thread.
+#define EXPECT_NO_ALLOC(stmt, label)                                                   \
+   do                                                                                  \
+   {                                                                                   \
+      std::size_t numAllocs_ = 0;                                                      \
+      {                                                                                \
+         const AllocCounter allocCounter_;                                             \
+         stmt;                                                                         \
+         numAllocs_ = allocCounter_.allocations();                                     \
+      }                                                                                \
+      verify(numAllocs_ == 0, label, "no allocations in '" #stmt "'", __FILE__,        \
+             __LINE__);                                                                \
+   } while (false)
+
+
+///////////////////
+
+// Allocations of one test.
+struct AllocReportEntry
+{
+   std::string testName;
+   std::size_t allocations = 0;
+   std::size_t bytes = 0;
+};
+
+
+// Records the allocations of the current thread under a test name while in scope.
+class ScopedAllocReport
+{
+ public:
+   explicit ScopedAllocReport(std::string testName);
+   ~ScopedAllocReport();
+   ScopedAllocReport(const ScopedAllocReport&) = delete;
+   ScopedAllocReport& operator=(const ScopedAllocReport&) = delete;
+
+ private:
+   std::string m_testName;
+   AllocCounter m_counter;
+};
+
+
+const std::vector<AllocReportEntry>& allocReport();
+// One line per test.
+std::string formatAllocReport();
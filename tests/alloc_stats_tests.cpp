@@ -0,0 +1,260 @@
+//
+// Win32 utilities library
+// Tests for allocation statistics.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "alloc_stats_tests.h"
+#include "alloc_stats.h"
+#include "test_util.h"
+#include <cstring>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Enables collection for the lifetime of the object and restores a clean state
+// afterwards.
+struct AllocStatsScope
+{
+   AllocStatsScope()
+   {
+      resetAllocStats();
+      enableAllocStats(true);
+   }
+   ~AllocStatsScope()
+   {
+      enableAllocStats(false);
+      setAllocSampleRate(0);
+      resetAllocStats();
+   }
+};
+
+
+///////////////////
+
+void testAllocSizeClass()
+{
+   {
+      const std::string caseLabel{"allocSizeClass"};
+      VERIFY(allocSizeClass(0) == 0, caseLabel);
+      VERIFY(allocSizeClass(16) == 0, caseLabel);
+      VERIFY(allocSizeClass(17) == 1, caseLabel);
+      VERIFY(allocSizeClass(32) == 1, caseLabel);
+      VERIFY(allocSizeClass(33) == 2, caseLabel);
+      VERIFY(allocSizeClass(1024 * 1024) == NumAllocSizeClasses - 2, caseLabel);
+      VERIFY(allocSizeClass(1024 * 1024 + 1) == NumAllocSizeClasses - 1, caseLabel);
+      VERIFY(allocSizeClass(std::size_t(-1)) == NumAllocSizeClasses - 1, caseLabel);
+   }
+}
+
+
+void testAllocTagName()
+{
+   {
+      const std::string caseLabel{"allocTagName"};
+      VERIFY(std::strcmp(allocTagName(AllocTag::Registry), "registry") == 0, caseLabel);
+      VERIFY(std::strcmp(allocTagName(AllocTag::Timer), "timer") == 0, caseLabel);
+      VERIFY(std::strcmp(allocTagName(AllocTag::Count), "unknown") == 0, caseLabel);
+   }
+}
+
+
+void testRecordAllocation()
+{
+   {
+      const std::string caseLabel{"recordAllocation"};
+      AllocStatsScope scope;
+      recordAllocation(AllocTag::User, 10);
+      recordAllocation(AllocTag::User, 100);
+      recordDeallocation(AllocTag::User, 10);
+
+      const AllocStatsSnapshot snapshot = allocStatsSnapshot();
+      const AllocTagStats& stats = snapshot[AllocTag::User];
+      VERIFY(stats.allocations == 2, caseLabel);
+      VERIFY(stats.deallocations == 1, caseLabel);
+      VERIFY(stats.allocatedBytes == 110, caseLabel);
+      VERIFY(stats.deallocatedBytes == 10, caseLabel);
+      VERIFY(stats.liveBytes() == 100, caseLabel);
+      VERIFY(stats.highWaterBytes == 110, caseLabel);
+      VERIFY(stats.sizeClasses[allocSizeClass(10)] == 1, caseLabel);
+      VERIFY(stats.sizeClasses[allocSizeClass(100)] == 1, caseLabel);
+      VERIFY(snapshot[AllocTag::Timer].allocations == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"recordAllocation when disabled"};
+      AllocStatsScope scope;
+      enableAllocStats(false);
+      recordAllocation(AllocTag::User, 10);
+      VERIFY(allocStatsSnapshot()[AllocTag::User].allocations == 0, caseLabel);
+   }
+}
+
+
+void testResetAllocStats()
+{
+   {
+      const std::string caseLabel{"resetAllocStats"};
+      AllocStatsScope scope;
+      recordAllocation(AllocTag::User, 10);
+      resetAllocStats();
+      VERIFY(allocStatsSnapshot()[AllocTag::User].allocations == 0, caseLabel);
+      VERIFY(allocStatsSnapshot()[AllocTag::User].highWaterBytes == 0, caseLabel);
+
+      recordAllocation(AllocTag::User, 20);
+      VERIFY(allocStatsSnapshot()[AllocTag::User].allocatedBytes == 20, caseLabel);
+   }
+}
+
+
+void testAllocStatsThreads()
+{
+   {
+      const std::string caseLabel{"allocation stats of multiple threads"};
+      AllocStatsScope scope;
+      constexpr std::size_t numThreads = 4;
+      constexpr std::size_t numAllocs = 1000;
+
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < numThreads; ++i)
+      {
+         threads.emplace_back([]() {
+            for (std::size_t j = 0; j < numAllocs; ++j)
+               recordAllocation(AllocTag::User, 8);
+         });
+      }
+      for (auto& th : threads)
+         th.join();
+
+      // Stats of exited threads are retained.
+      const AllocStatsSnapshot snapshot = allocStatsSnapshot();
+      const AllocTagStats& stats = snapshot[AllocTag::User];
+      VERIFY(stats.allocations == numThreads * numAllocs, caseLabel);
+      VERIFY(stats.allocatedBytes == numThreads * numAllocs * 8, caseLabel);
+   }
+}
+
+
+void testAllocSamples()
+{
+   {
+      const std::string caseLabel{"allocation samples"};
+      AllocStatsScope scope;
+      setAllocSampleRate(2);
+      {
+         ScopedAllocSite site{"outer"};
+         recordAllocation(AllocTag::User, 1);
+         recordAllocation(AllocTag::User, 2);
+         {
+            ScopedAllocSite innerSite{"inner"};
+            recordAllocation(AllocTag::User, 3);
+            recordAllocation(AllocTag::User, 4);
+         }
+         recordAllocation(AllocTag::User, 5);
+         recordAllocation(AllocTag::User, 6);
+      }
+
+      const std::vector<AllocSample> samples = allocStatsSnapshot().samples;
+      VERIFY(samples.size() == 3, caseLabel);
+      VERIFY(samples[0].numBytes == 2 && std::strcmp(samples[0].site, "outer") == 0,
+             caseLabel);
+      VERIFY(samples[1].numBytes == 4 && std::strcmp(samples[1].site, "inner") == 0,
+             caseLabel);
+      VERIFY(samples[2].numBytes == 6 && std::strcmp(samples[2].site, "outer") == 0,
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"allocation samples turned off"};
+      AllocStatsScope scope;
+      recordAllocation(AllocTag::User, 1);
+      VERIFY(allocStatsSnapshot().samples.empty(), caseLabel);
+   }
+}
+
+
+void testInstrumentedResource()
+{
+   {
+      const std::string caseLabel{"InstrumentedResource"};
+      AllocStatsScope scope;
+      InstrumentedResource resource{AllocTag::User};
+      {
+         std::pmr::vector<int> v{&resource};
+         v.reserve(10);
+         VERIFY(allocStatsSnapshot()[AllocTag::User].allocations == 1, caseLabel);
+         VERIFY(allocStatsSnapshot()[AllocTag::User].liveBytes() ==
+                   static_cast<std::int64_t>(10 * sizeof(int)),
+                caseLabel);
+      }
+      VERIFY(allocStatsSnapshot()[AllocTag::User].deallocations == 1, caseLabel);
+      VERIFY(allocStatsSnapshot()[AllocTag::User].liveBytes() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InstrumentedResource with upstream"};
+      AllocStatsScope scope;
+      std::pmr::monotonic_buffer_resource upstream;
+      InstrumentedResource resource{AllocTag::User, &upstream};
+      VERIFY(resource.upstream() == &upstream, caseLabel);
+      VERIFY(resource.tag() == AllocTag::User, caseLabel);
+      void* p = resource.allocate(32);
+      VERIFY(p != nullptr, caseLabel);
+      resource.deallocate(p, 32);
+      VERIFY(allocStatsSnapshot()[AllocTag::User].allocatedBytes == 32, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InstrumentedResource::is_equal"};
+      InstrumentedResource a{AllocTag::User};
+      InstrumentedResource b{AllocTag::User};
+      InstrumentedResource c{AllocTag::Timer};
+      VERIFY(a.is_equal(b), caseLabel);
+      VERIFY(!a.is_equal(c), caseLabel);
+      VERIFY(!a.is_equal(*std::pmr::new_delete_resource()), caseLabel);
+   }
+}
+
+
+void testAllocResource()
+{
+   {
+      const std::string caseLabel{"allocResource"};
+      AllocStatsScope scope;
+      std::pmr::memory_resource* resource = allocResource(AllocTag::Registry);
+      VERIFY(resource == allocResource(AllocTag::Registry), caseLabel);
+      VERIFY(resource != allocResource(AllocTag::Timer), caseLabel);
+
+      std::pmr::vector<char> v(100, 0, resource);
+      VERIFY(allocStatsSnapshot()[AllocTag::Registry].allocatedBytes >= 100, caseLabel);
+   }
+   {
+      const std::string caseLabel{"AllocStatsSnapshot::total"};
+      AllocStatsScope scope;
+      recordAllocation(AllocTag::User, 10);
+      recordAllocation(AllocTag::Timer, 20);
+      VERIFY(allocStatsSnapshot().total().allocatedBytes == 30, caseLabel);
+      VERIFY(allocStatsSnapshot().total().allocations == 2, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testAllocStats()
+{
+   testAllocSizeClass();
+   testAllocTagName();
+   testRecordAllocation();
+   testResetAllocStats();
+   testAllocStatsThreads();
+   testAllocSamples();
+   testInstrumentedResource();
+   testAllocResource();
+}
@@ -0,0 +1,188 @@
+//
+// Win32 utilities library
+// Tests for the coalescing scheduler.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "coalescing_scheduler_tests.h"
+#include "coalescing_scheduler.h"
+#include "test_util.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Advances a scheduler from wakeup to wakeup until the given time.
+void runUntil(CoalescingScheduler& scheduler, std::uint64_t endMs)
+{
+   for (;;)
+   {
+      const std::uint64_t wakeup = scheduler.nextWakeup();
+      if (wakeup > endMs)
+         break;
+      scheduler.advance(wakeup);
+   }
+   scheduler.advance(endMs);
+}
+
+
+///////////////////
+
+void testCoalescingSchedulerStart()
+{
+   {
+      const std::string caseLabel{"CoalescingScheduler::start"};
+      CoalescingScheduler scheduler{100};
+      std::uint64_t firedAt = 0;
+      const CoalescingScheduler::TimerId id = scheduler.start(
+         50, 10, [&](CoalescingScheduler::TimerId) { firedAt = scheduler.now(); });
+      VERIFY(id != 0, caseLabel);
+      VERIFY(scheduler.isActive(id), caseLabel);
+      VERIFY(scheduler.nextWakeup() == 160, caseLabel);
+
+      VERIFY(scheduler.advance(149) == 0, caseLabel);
+      VERIFY(scheduler.advance(160) == 1, caseLabel);
+      VERIFY(firedAt == 160, caseLabel);
+      VERIFY(!scheduler.isActive(id), caseLabel);
+      VERIFY(scheduler.nextWakeup() == CoalescingScheduler::NoWakeup, caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler::start without callback"};
+      CoalescingScheduler scheduler;
+      VERIFY(scheduler.start(10, 0, nullptr) == 0, caseLabel);
+      VERIFY(scheduler.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler::stop"};
+      CoalescingScheduler scheduler;
+      bool hasFired = false;
+      const CoalescingScheduler::TimerId id =
+         scheduler.start(10, 0, [&](CoalescingScheduler::TimerId) { hasFired = true; });
+      VERIFY(scheduler.stop(id), caseLabel);
+      VERIFY(!scheduler.stop(id), caseLabel);
+      scheduler.advance(100);
+      VERIFY(!hasFired, caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler stop own periodic timer"};
+      CoalescingScheduler scheduler;
+      int numFired = 0;
+      scheduler.start(
+         10, 0,
+         [&](CoalescingScheduler::TimerId id)
+         {
+            ++numFired;
+            scheduler.stop(id);
+         },
+         10);
+      runUntil(scheduler, 100);
+      VERIFY(numFired == 1, caseLabel);
+      VERIFY(scheduler.empty(), caseLabel);
+   }
+}
+
+
+void testCoalescingSchedulerCoalescing()
+{
+   {
+      const std::string caseLabel{
+         "CoalescingScheduler expires overlapping windows together"};
+      CoalescingScheduler scheduler;
+      std::vector<std::uint64_t> firedAt;
+      auto record = [&](CoalescingScheduler::TimerId)
+      { firedAt.push_back(scheduler.now()); };
+      scheduler.start(100, 50, record);
+      scheduler.start(120, 50, record);
+      scheduler.start(140, 0, record);
+      // Does not overlap with the window of the first timer.
+      scheduler.start(200, 10, record);
+
+      runUntil(scheduler, 1000);
+      VERIFY((firedAt == std::vector<std::uint64_t>{140, 140, 140, 210}), caseLabel);
+      VERIFY(scheduler.stats().numWakeups == 2, caseLabel);
+      VERIFY(scheduler.stats().numExpirations == 4, caseLabel);
+      VERIFY(scheduler.stats().savedWakeups() == 2, caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler never expires timers late"};
+      CoalescingScheduler scheduler;
+      bool isInWindow = true;
+      for (std::uint64_t i = 0; i < 200; ++i)
+      {
+         const std::uint64_t period = 100 + (i * 37) % 900;
+         const std::uint64_t tolerance = period / 4;
+         std::uint64_t due = period;
+         scheduler.start(
+            period, tolerance,
+            [&scheduler, &isInWindow, due, period, tolerance](
+               CoalescingScheduler::TimerId) mutable
+            {
+               isInWindow = isInWindow && scheduler.now() >= due &&
+                            scheduler.now() <= due + tolerance;
+               due += period;
+            },
+            period);
+      }
+      runUntil(scheduler, 60000);
+      VERIFY(isInWindow, caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler saves wakeups"};
+      // Hundreds of low-priority periodic timers with generous tolerances.
+      CoalescingScheduler scheduler;
+      for (std::uint64_t i = 0; i < 300; ++i)
+      {
+         const std::uint64_t period = 1000 + (i * 97) % 9000;
+         scheduler.start(period, period / 2, [](CoalescingScheduler::TimerId) {}, period);
+      }
+      runUntil(scheduler, 600000);
+
+      const CoalescingScheduler::Stats stats = scheduler.stats();
+      VERIFY(stats.elapsedMs == 600000, caseLabel);
+      VERIFY(stats.numWakeups * 4 < stats.numExpirations, caseLabel);
+      VERIFY(stats.savedWakeupsPerSecond() > 0., caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler periodic timers do not drift"};
+      CoalescingScheduler scheduler;
+      std::vector<std::uint64_t> firedAt;
+      scheduler.start(
+         100, 0,
+         [&](CoalescingScheduler::TimerId) { firedAt.push_back(scheduler.now()); }, 100);
+      // Late wakeups skip the due times that passed.
+      scheduler.advance(100);
+      scheduler.advance(350);
+      scheduler.advance(400);
+      VERIFY((firedAt == std::vector<std::uint64_t>{100, 350, 400}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"CoalescingScheduler::resetStats"};
+      CoalescingScheduler scheduler;
+      scheduler.start(10, 0, [](CoalescingScheduler::TimerId) {});
+      scheduler.advance(10);
+      scheduler.resetStats();
+      scheduler.advance(20);
+      const CoalescingScheduler::Stats stats = scheduler.stats();
+      VERIFY(stats.numWakeups == 0, caseLabel);
+      VERIFY(stats.numExpirations == 0, caseLabel);
+      VERIFY(stats.elapsedMs == 10, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testCoalescingScheduler()
+{
+   testCoalescingSchedulerStart();
+   testCoalescingSchedulerCoalescing();
+}
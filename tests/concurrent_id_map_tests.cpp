@@ -0,0 +1,175 @@
+//
+// Win32 utilities library
+// Tests for the concurrent id map.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "concurrent_id_map_tests.h"
+#include "concurrent_id_map.h"
+#include "test_util.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+void testConcurrentIdMapSingleThreaded()
+{
+   {
+      const std::string caseLabel{"ConcurrentIdMap::insert"};
+      ConcurrentIdMap<int> map;
+      int a = 1;
+      VERIFY(map.insert(10, &a), caseLabel);
+      VERIFY(map.find(10) == &a, caseLabel);
+      VERIFY(map.size() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap::insert invalid entries"};
+      ConcurrentIdMap<int> map;
+      int a = 1;
+      VERIFY(!map.insert(0, &a), caseLabel);
+      VERIFY(!map.insert(10, nullptr), caseLabel);
+      VERIFY(map.size() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap::insert for existing id"};
+      ConcurrentIdMap<int> map;
+      int a = 1;
+      int b = 2;
+      map.insert(10, &a);
+      VERIFY(map.insert(10, &b), caseLabel);
+      VERIFY(map.find(10) == &b, caseLabel);
+      VERIFY(map.size() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap::erase"};
+      ConcurrentIdMap<int> map;
+      int a = 1;
+      map.insert(10, &a);
+      VERIFY(map.erase(10), caseLabel);
+      VERIFY(map.find(10) == nullptr, caseLabel);
+      VERIFY(map.size() == 0, caseLabel);
+      VERIFY(!map.erase(10), caseLabel);
+      VERIFY(!map.erase(11), caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap::find for missing id"};
+      ConcurrentIdMap<int> map;
+      VERIFY(map.find(10) == nullptr, caseLabel);
+      VERIFY(map.find(0) == nullptr, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap growth"};
+      ConcurrentIdMap<int> map;
+      std::vector<int> values(5000);
+      for (std::size_t i = 0; i < values.size(); ++i)
+         map.insert(i + 1, &values[i]);
+      VERIFY(map.size() == values.size(), caseLabel);
+
+      bool isFound = true;
+      for (std::size_t i = 0; i < values.size(); ++i)
+         isFound = isFound && map.find(i + 1) == &values[i];
+      VERIFY(isFound, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ConcurrentIdMap with many erased ids"};
+      ConcurrentIdMap<int> map;
+      int a = 1;
+      // Ids that are always new fill the table with erased entries.
+      for (ConcurrentIdMap<int>::Id id = 1; id < 100000; ++id)
+      {
+         map.insert(id, &a);
+         map.erase(id);
+      }
+      map.insert(7, &a);
+      VERIFY(map.size() == 1, caseLabel);
+      VERIFY(map.find(7) == &a, caseLabel);
+      VERIFY(map.find(99999) == nullptr, caseLabel);
+   }
+}
+
+
+void testConcurrentIdMapMultiThreaded()
+{
+   {
+      const std::string caseLabel{"ConcurrentIdMap lookups during concurrent writes"};
+      constexpr std::size_t NumWriters = 4;
+      constexpr std::size_t NumIdsPerWriter = 2000;
+      ConcurrentIdMap<std::size_t> map;
+
+      // Ids that stay in the map the whole time.
+      std::vector<std::size_t> stable(100);
+      for (std::size_t i = 0; i < stable.size(); ++i)
+      {
+         stable[i] = i;
+         map.insert(1000000 + i, &stable[i]);
+      }
+
+      std::atomic<bool> isDone = false;
+      std::atomic<bool> isConsistent = true;
+      std::vector<std::thread> readers;
+      for (std::size_t r = 0; r < 2; ++r)
+      {
+         readers.emplace_back(
+            [&]()
+            {
+               while (!isDone.load())
+               {
+                  for (std::size_t i = 0; i < stable.size(); ++i)
+                  {
+                     const std::size_t* value = map.find(1000000 + i);
+                     if (!value || *value != i)
+                        isConsistent = false;
+                  }
+               }
+            });
+      }
+
+      std::vector<std::size_t> values(NumWriters * NumIdsPerWriter);
+      std::vector<std::thread> writers;
+      for (std::size_t w = 0; w < NumWriters; ++w)
+      {
+         writers.emplace_back(
+            [&, w]()
+            {
+               for (std::size_t i = 0; i < NumIdsPerWriter; ++i)
+               {
+                  const std::size_t idx = w * NumIdsPerWriter + i;
+                  values[idx] = idx;
+                  map.insert(idx + 1, &values[idx]);
+                  const std::size_t* value = map.find(idx + 1);
+                  if (!value || *value != idx)
+                     isConsistent = false;
+                  if (i % 2 == 0)
+                     map.erase(idx + 1);
+               }
+            });
+      }
+      for (auto& th : writers)
+         th.join();
+      isDone = true;
+      for (auto& th : readers)
+         th.join();
+
+      VERIFY(isConsistent.load(), caseLabel);
+      VERIFY(map.size() == stable.size() + values.size() / 2, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testConcurrentIdMap()
+{
+   testConcurrentIdMapSingleThreaded();
+   testConcurrentIdMapMultiThreaded();
+}
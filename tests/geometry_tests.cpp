@@ -7,6 +7,7 @@
 //
 #include "geometry_tests.h"
 #include "geometry.h"
+#include "alloc_counter.h"
 #include "test_util.h"
 
 using namespace win32;
@@ -641,6 +642,33 @@ void testRectUnite()
    }
 }
 
+
+void testRectNoAlloc()
+{
+   {
+      const std::string caseLabel{"Rect operations do not allocate"};
+      Rect a{10, 20, 30, 40};
+      Rect b{15, 25, 35, 45};
+      long width = 0;
+      long height = 0;
+      bool isEqual = true;
+      std::pair<bool, Rect> intersection;
+      Rect united;
+      EXPECT_NO_ALLOC(width = a.width(), caseLabel);
+      EXPECT_NO_ALLOC(height = a.height(), caseLabel);
+      EXPECT_NO_ALLOC(isEqual = (a == b), caseLabel);
+      EXPECT_NO_ALLOC(intersection = intersect(a, b), caseLabel);
+      EXPECT_NO_ALLOC(united = unite(a, b), caseLabel);
+      EXPECT_NO_ALLOC(a.offset(1, 1), caseLabel);
+      EXPECT_NO_ALLOC(swap(a, b), caseLabel);
+
+      VERIFY(width == 20 && height == 20, caseLabel);
+      VERIFY(!isEqual, caseLabel);
+      VERIFY(intersection.first, caseLabel);
+      VERIFY(united == Rect(10, 20, 35, 45), caseLabel);
+   }
+}
+
 } // namespace
 
 
@@ -672,4 +700,5 @@ void testGeometry(HWND testRunnerWnd)
    testRectInequality();
    testRectIntersect();
    testRectUnite();
+   testRectNoAlloc();
 }
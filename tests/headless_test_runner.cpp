@@ -0,0 +1,107 @@
+//
+// Win32 utilities library
+// Console entry point that runs the tests that need no window or system registry.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "alloc_counter.h"
+#include "alloc_stats_tests.h"
+#include "coalescing_scheduler_tests.h"
+#include "concurrent_id_map_tests.h"
+#include "inplace_function_tests.h"
+#include "latency_histogram_tests.h"
+#include "mapped_file_tests.h"
+#include "mem_util_tests.h"
+#include "memory_registry_tests.h"
+#include "object_pool_tests.h"
+#include "precision_timer_tests.h"
+#include "rate_limiter_tests.h"
+#include "registry_batch_tests.h"
+#include "registry_cache_tests.h"
+#include "registry_key_cache_tests.h"
+#include "registry_walker_tests.h"
+#include "ring_buffer_tests.h"
+#include "simulated_scheduler_tests.h"
+#include "test_util.h"
+#include "timer_queue_tests.h"
+#include "timer_wheel_tests.h"
+#include "trace_tests.h"
+#include "virtual_mem_tests.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+///////////////////
+
+struct TestSuite
+{
+   const char* name = "";
+   void (*run)() = nullptr;
+};
+
+const TestSuite TestSuites[] = {
+   {"AllocStats", testAllocStats},
+   {"CoalescingScheduler", testCoalescingScheduler},
+   {"ConcurrentIdMap", testConcurrentIdMap},
+   {"InplaceFunction", testInplaceFunction},
+   {"LatencyHistogram", testLatencyHistogram},
+   {"MappedFile", testMappedFile},
+   {"MemUtil", testMemUtil},
+   {"MemoryRegistry", testMemoryRegistry},
+   {"ObjectPool", testObjectPool},
+   {"PrecisionTimer", testPrecisionTimer},
+   {"RateLimiter", testRateLimiter},
+   {"RegistryBatch", testRegistryBatch},
+   {"RegistryCache", testRegistryCache},
+   {"RegistryKeyCache", testRegistryKeyCache},
+   {"RegistryWalker", testRegistryWalker},
+   {"RingBuffer", testRingBuffer},
+   {"SimulatedScheduler", testSimulatedScheduler},
+   {"TimerQueue", testTimerQueue},
+   {"TimerWheel", testTimerWheel},
+   {"Trace", testTrace},
+   {"VirtualMem", testVirtualMem},
+};
+
+
+// Suites are selected by names given on the command line. Without names all suites
+// run.
+bool isSelected(const char* name, int argc, char* argv[])
+{
+   if (argc <= 1)
+      return true;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (std::strcmp(name, argv[i]) == 0)
+         return true;
+   }
+   return false;
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+   for (const TestSuite& suite : TestSuites)
+   {
+      if (!isSelected(suite.name, argc, argv))
+         continue;
+
+      const int prevFailures = numFailedVerifications();
+      {
+         ScopedAllocReport report{suite.name};
+         suite.run();
+      }
+      std::printf("%s: %s\n", suite.name,
+                  numFailedVerifications() == prevFailures ? "passed" : "FAILED");
+   }
+
+   std::printf("\n%s", formatAllocReport().c_str());
+   std::printf("%d failed verifications\n", numFailedVerifications());
+   return numFailedVerifications() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+//
+// Win32 utilities library
+// Tests for move-only function wrappers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "inplace_function_tests.h"
+#include "alloc_counter.h"
+#include "inplace_function.h"
+#include "test_util.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+int addOne(int val)
+{
+   return val + 1;
+}
+
+
+// Counts live instances to check that wrappers destroy their callables.
+struct CountedCallable
+{
+   static int numAlive;
+
+   CountedCallable() { ++numAlive; }
+   CountedCallable(const CountedCallable&) { ++numAlive; }
+   CountedCallable(CountedCallable&&) noexcept { ++numAlive; }
+   ~CountedCallable() { --numAlive; }
+   int operator()() const { return 7; }
+};
+
+int CountedCallable::numAlive = 0;
+
+
+///////////////////
+
+void testInplaceFunctionCtor()
+{
+   {
+      const std::string caseLabel{"InplaceFunction default ctor"};
+      InplaceFunction<void()> fn;
+      VERIFY(!fn, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor for nullptr"};
+      InplaceFunction<void()> fn{nullptr};
+      VERIFY(!fn, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor for lambda"};
+      int a = 1;
+      int b = 2;
+      InplaceFunction<int(int)> fn{[&a, &b](int c) { return a + b + c; }};
+      VERIFY(static_cast<bool>(fn), caseLabel);
+      VERIFY(fn(3) == 6, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor for function pointer"};
+      InplaceFunction<int(int)> fn{&addOne};
+      VERIFY(fn(1) == 2, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor for null function pointer"};
+      int (*nullFn)(int) = nullptr;
+      InplaceFunction<int(int)> fn{nullFn};
+      VERIFY(!fn, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor for move-only callable"};
+      InplaceFunction<int()> fn{[p = std::make_unique<int>(5)]() { return *p; }};
+      VERIFY(fn() == 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor with capacity"};
+      std::array<int, 16> values{};
+      values[15] = 3;
+      InplaceFunction<int(), sizeof(values)> fn{[values]() { return values[15]; }};
+      VERIFY(fn() == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction ctor without allocation"};
+      int a = 1;
+      int b = 2;
+      int c = 3;
+      EXPECT_NO_ALLOC(
+         (InplaceFunction<int()>{[&a, &b, &c]() { return a + b + c; }}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction dtor"};
+      {
+         InplaceFunction<int()> fn{CountedCallable{}};
+         VERIFY(CountedCallable::numAlive == 1, caseLabel);
+      }
+      VERIFY(CountedCallable::numAlive == 0, caseLabel);
+   }
+}
+
+
+void testInplaceFunctionMove()
+{
+   {
+      const std::string caseLabel{"InplaceFunction move ctor"};
+      InplaceFunction<int(int)> a{[](int val) { return val * 2; }};
+      InplaceFunction<int(int)> b{std::move(a)};
+      VERIFY(!a, caseLabel);
+      VERIFY(b(2) == 4, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction move assignment"};
+      InplaceFunction<int()> a{CountedCallable{}};
+      InplaceFunction<int()> b{CountedCallable{}};
+      b = std::move(a);
+      VERIFY(!a, caseLabel);
+      VERIFY(b() == 7, caseLabel);
+      VERIFY(CountedCallable::numAlive == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction assignment of nullptr"};
+      InplaceFunction<int()> fn{CountedCallable{}};
+      fn = nullptr;
+      VERIFY(!fn, caseLabel);
+      VERIFY(CountedCallable::numAlive == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction swap"};
+      InplaceFunction<int()> a{[]() { return 1; }};
+      InplaceFunction<int()> b;
+      swap(a, b);
+      VERIFY(!a, caseLabel);
+      VERIFY(b() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"InplaceFunction move without allocation"};
+      int a = 1;
+      InplaceFunction<int()> src{[&a]() { return a; }};
+      InplaceFunction<int()> dest;
+      EXPECT_NO_ALLOC(dest = std::move(src), caseLabel);
+      VERIFY(dest() == 1, caseLabel);
+   }
+}
+
+
+void testUniqueFunction()
+{
+   {
+      const std::string caseLabel{"UniqueFunction default ctor"};
+      UniqueFunction<void()> fn;
+      VERIFY(!fn, caseLabel);
+   }
+   {
+      const std::string caseLabel{"UniqueFunction ctor for small callable"};
+      int a = 1;
+      UniqueFunction<int(int)> fn{[&a](int b) { return a + b; }};
+      VERIFY(fn(2) == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"UniqueFunction ctor for large callable"};
+      std::array<int, 64> values{};
+      values[63] = 9;
+      UniqueFunction<int()> fn{[values]() { return values[63]; }};
+      VERIFY(fn() == 9, caseLabel);
+
+      UniqueFunction<int()> moved{std::move(fn)};
+      VERIFY(!fn, caseLabel);
+      VERIFY(moved() == 9, caseLabel);
+   }
+   {
+      const std::string caseLabel{"UniqueFunction ctor for empty std::function"};
+      UniqueFunction<void()> fn{std::function<void()>{}};
+      VERIFY(!fn, caseLabel);
+   }
+   {
+      const std::string caseLabel{"UniqueFunction swap"};
+      UniqueFunction<int()> a{[]() { return 1; }};
+      UniqueFunction<int()> b{[]() { return 2; }};
+      swap(a, b);
+      VERIFY(a() == 2, caseLabel);
+      VERIFY(b() == 1, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testInplaceFunction()
+{
+   testInplaceFunctionCtor();
+   testInplaceFunctionMove();
+   testUniqueFunction();
+}
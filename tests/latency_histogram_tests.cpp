@@ -0,0 +1,219 @@
+//
+// Win32 utilities library
+// Tests for latency histograms and timer statistics.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "latency_histogram_tests.h"
+#include "latency_histogram.h"
+#include "test_util.h"
+#include "timer_stats.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+void testHistogramBuckets()
+{
+   {
+      const std::string caseLabel{"histogramBucket for small values"};
+      bool isExact = true;
+      for (std::uint64_t val = 0; val < 2 * HistogramSubBuckets; ++val)
+      {
+         const std::size_t bucket = histogramBucket(val);
+         isExact = isExact && histogramBucketLowerBound(bucket) == val &&
+                   histogramBucketUpperBound(bucket) == val;
+      }
+      VERIFY(isExact, caseLabel);
+   }
+   {
+      const std::string caseLabel{"histogramBucket bounds contain value"};
+      bool isContained = true;
+      bool isPrecise = true;
+      for (std::uint64_t val = 1; val < HistogramMaxValue; val = val * 3 + 1)
+      {
+         const std::size_t bucket = histogramBucket(val);
+         const std::uint64_t lower = histogramBucketLowerBound(bucket);
+         const std::uint64_t upper = histogramBucketUpperBound(bucket);
+         isContained = isContained && lower <= val && val <= upper;
+         isPrecise = isPrecise && (upper - lower) * HistogramSubBuckets <= lower;
+      }
+      VERIFY(isContained, caseLabel);
+      VERIFY(isPrecise, caseLabel);
+   }
+   {
+      const std::string caseLabel{"histogramBucket buckets are contiguous"};
+      bool isContiguous = true;
+      for (std::size_t bucket = 1; bucket < HistogramNumBuckets; ++bucket)
+      {
+         isContiguous = isContiguous && histogramBucketLowerBound(bucket) ==
+                                           histogramBucketUpperBound(bucket - 1) + 1;
+      }
+      VERIFY(isContiguous, caseLabel);
+   }
+   {
+      const std::string caseLabel{"histogramBucket clamps large values"};
+      VERIFY(histogramBucket(HistogramMaxValue) == HistogramNumBuckets - 1, caseLabel);
+      VERIFY(histogramBucket(~std::uint64_t(0)) == HistogramNumBuckets - 1, caseLabel);
+   }
+}
+
+
+void testLatencyHistogramRecord()
+{
+   {
+      const std::string caseLabel{"LatencyHistogram snapshot of empty histogram"};
+      LatencyHistogram histogram;
+      const HistogramSnapshot snapshot = histogram.snapshot();
+      VERIFY(snapshot.count == 0, caseLabel);
+      VERIFY(snapshot.buckets.empty(), caseLabel);
+      VERIFY(snapshot.percentile(50.) == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"LatencyHistogram::record"};
+      LatencyHistogram histogram;
+      for (std::uint64_t val = 1; val <= 100; ++val)
+         histogram.record(val);
+
+      const HistogramSnapshot snapshot = histogram.snapshot();
+      VERIFY(snapshot.count == 100, caseLabel);
+      VERIFY(snapshot.sum == 5050, caseLabel);
+      VERIFY(snapshot.min == 1, caseLabel);
+      VERIFY(snapshot.max == 100, caseLabel);
+      VERIFY(snapshot.mean() == 50.5, caseLabel);
+   }
+   {
+      const std::string caseLabel{"LatencyHistogram::reset"};
+      LatencyHistogram histogram;
+      histogram.record(10);
+      histogram.reset();
+      histogram.record(20);
+      const HistogramSnapshot snapshot = histogram.snapshot();
+      VERIFY(snapshot.count == 1, caseLabel);
+      VERIFY(snapshot.min == 20, caseLabel);
+   }
+   {
+      const std::string caseLabel{"LatencyHistogram concurrent recording"};
+      constexpr int NumThreads = 4;
+      constexpr std::uint64_t NumValues = 100000;
+      LatencyHistogram histogram;
+      std::vector<std::thread> threads;
+      for (int i = 0; i < NumThreads; ++i)
+      {
+         threads.emplace_back(
+            [&histogram]()
+            {
+               for (std::uint64_t val = 1; val <= NumValues; ++val)
+                  histogram.record(val);
+            });
+      }
+      for (std::thread& th : threads)
+         th.join();
+
+      const HistogramSnapshot snapshot = histogram.snapshot();
+      VERIFY(snapshot.count == NumThreads * NumValues, caseLabel);
+      VERIFY(snapshot.sum == NumThreads * NumValues * (NumValues + 1) / 2, caseLabel);
+      VERIFY(snapshot.min == 1, caseLabel);
+      VERIFY(snapshot.max == NumValues, caseLabel);
+   }
+}
+
+
+void testHistogramSnapshot()
+{
+   {
+      const std::string caseLabel{"HistogramSnapshot::percentile"};
+      LatencyHistogram histogram;
+      for (std::uint64_t val = 1; val <= 1000; ++val)
+         histogram.record(val);
+
+      const HistogramSnapshot snapshot = histogram.snapshot();
+      auto isNear = [](std::uint64_t actual, std::uint64_t expected)
+      { return actual >= expected && actual - expected <= expected / 32 + 1; };
+      VERIFY(snapshot.percentile(0.) == 1, caseLabel);
+      VERIFY(isNear(snapshot.percentile(50.), 500), caseLabel);
+      VERIFY(isNear(snapshot.percentile(99.), 990), caseLabel);
+      VERIFY(snapshot.percentile(100.) == 1000, caseLabel);
+   }
+   {
+      const std::string caseLabel{"HistogramSnapshot merging"};
+      LatencyHistogram a;
+      LatencyHistogram b;
+      a.record(5);
+      a.record(7);
+      b.record(3);
+      b.record(5000);
+
+      HistogramSnapshot merged = a.snapshot();
+      merged += b.snapshot();
+      VERIFY(merged.count == 4, caseLabel);
+      VERIFY(merged.min == 3, caseLabel);
+      VERIFY(merged.max == 5000, caseLabel);
+      VERIFY(merged.sum == 5015, caseLabel);
+      VERIFY(merged.buckets[histogramBucket(5000)] == 1, caseLabel);
+
+      HistogramSnapshot empty;
+      empty += a.snapshot();
+      VERIFY(empty.min == 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{"HistogramSnapshot::toCsv"};
+      LatencyHistogram histogram;
+      histogram.record(3);
+      histogram.record(3);
+      histogram.record(100);
+
+      const std::string csv = histogram.snapshot().toCsv();
+      VERIFY(csv == "lower,upper,count\n3,3,2\n100,101,1\n", caseLabel);
+   }
+}
+
+
+void testTimerStats()
+{
+   {
+      const std::string caseLabel{"TimerStats::record"};
+      TimerStats stats;
+      const auto deadline = TimerStats::Clock::now();
+      stats.record(deadline, deadline + 1500us, deadline + 2ms);
+      // Early expiries count as on time.
+      stats.record(deadline, deadline - 1ms, deadline);
+
+      const TimerStatsSnapshot snapshot = stats.snapshot();
+      VERIFY(snapshot.lateness.count == 2, caseLabel);
+      VERIFY(snapshot.lateness.min == 0, caseLabel);
+      VERIFY(snapshot.lateness.max == 1500, caseLabel);
+      VERIFY(snapshot.callbackDuration.max == 1000, caseLabel);
+   }
+   {
+      const std::string caseLabel{"enableTimerStats"};
+      VERIFY(!isTimerStatsEnabled(), caseLabel);
+      enableTimerStats(true);
+      VERIFY(isTimerStatsEnabled(), caseLabel);
+      enableTimerStats(false);
+      VERIFY(!isTimerStatsEnabled(), caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testLatencyHistogram()
+{
+   testHistogramBuckets();
+   testLatencyHistogramRecord();
+   testHistogramSnapshot();
+   testTimerStats();
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for latency histograms and timer statistics.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testLatencyHistogram();
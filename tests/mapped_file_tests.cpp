@@ -0,0 +1,256 @@
+//
+// Win32 utilities library
+// Tests for memory-mapped files.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "mapped_file_tests.h"
+#include "mapped_file.h"
+#include "test_util.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Temporary file with given content. Removed when going out of scope.
+class TempFile
+{
+ public:
+   TempFile(const std::string& name, const std::vector<char>& content);
+   ~TempFile();
+
+   const std::filesystem::path& path() const { return m_path; }
+
+ private:
+   std::filesystem::path m_path;
+};
+
+
+TempFile::TempFile(const std::string& name, const std::vector<char>& content)
+: m_path{std::filesystem::temp_directory_path() / name}
+{
+   std::ofstream out{m_path, std::ios::binary | std::ios::trunc};
+   out.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+
+TempFile::~TempFile()
+{
+   std::error_code ec;
+   std::filesystem::remove(m_path, ec);
+}
+
+
+std::vector<char> makeContent(std::size_t size)
+{
+   std::vector<char> content(size);
+   for (std::size_t i = 0; i < size; ++i)
+      content[i] = static_cast<char>(i % 251);
+   return content;
+}
+
+
+bool equals(const MappedView& view, const std::vector<char>& content, std::size_t offset)
+{
+   return view.size() <= content.size() - offset &&
+          std::memcmp(view.data(), content.data() + offset, view.size()) == 0;
+}
+
+
+///////////////////
+
+void testMappedFileOpen()
+{
+   {
+      const std::string caseLabel{"MappedFile::open"};
+      const TempFile file{"win32util_mapped_open.bin", makeContent(1000)};
+      MappedFile mf;
+      VERIFY(mf.open(file.path()), caseLabel);
+      VERIFY(mf.operator bool(), caseLabel);
+      VERIFY(mf.size() == 1000, caseLabel);
+      VERIFY(mf.mode() == MapMode::ReadOnly, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::open for not existing file"};
+      MappedFile mf;
+      VERIFY(!mf.open(std::filesystem::temp_directory_path() / "win32util_not_there"),
+             caseLabel);
+      VERIFY(!mf, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::open for empty file"};
+      const TempFile file{"win32util_mapped_empty.bin", {}};
+      MappedFile mf;
+      VERIFY(mf.open(file.path()), caseLabel);
+      VERIFY(mf.size() == 0, caseLabel);
+      VERIFY(!mf.map(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::close"};
+      const TempFile file{"win32util_mapped_close.bin", makeContent(10)};
+      MappedFile mf;
+      mf.open(file.path());
+      mf.close();
+      VERIFY(!mf, caseLabel);
+      VERIFY(mf.size() == 0, caseLabel);
+   }
+}
+
+
+void testMappedFileMap()
+{
+   {
+      const std::string caseLabel{"MappedFile::map whole file"};
+      const std::vector<char> content = makeContent(5000);
+      const TempFile file{"win32util_mapped_whole.bin", content};
+      MappedFile mf;
+      mf.open(file.path());
+      const MappedView view = mf.map();
+      VERIFY(view.operator bool(), caseLabel);
+      VERIFY(view.size() == content.size(), caseLabel);
+      VERIFY(view.offset() == 0, caseLabel);
+      VERIFY(equals(view, content, 0), caseLabel);
+      VERIFY(!view.isWritable(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::map unaligned window"};
+      const std::vector<char> content = makeContent(300000);
+      const TempFile file{"win32util_mapped_window.bin", content};
+      MappedFile mf;
+      mf.open(file.path());
+      const MappedView view = mf.map(70001, 1234);
+      VERIFY(view.size() == 1234, caseLabel);
+      VERIFY(view.offset() == 70001, caseLabel);
+      VERIFY(equals(view, content, 70001), caseLabel);
+      VERIFY(view.span().size() == 1234, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::map clips to file size"};
+      const std::vector<char> content = makeContent(100);
+      const TempFile file{"win32util_mapped_clip.bin", content};
+      MappedFile mf;
+      mf.open(file.path());
+      const MappedView view = mf.map(90, 50);
+      VERIFY(view.size() == 10, caseLabel);
+      VERIFY(equals(view, content, 90), caseLabel);
+      VERIFY(!mf.map(100), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile::map views outlive file"};
+      const std::vector<char> content = makeContent(100);
+      const TempFile file{"win32util_mapped_outlive.bin", content};
+      MappedView view;
+      {
+         MappedFile mf;
+         mf.open(file.path());
+         view = mf.map();
+      }
+      VERIFY(equals(view, content, 0), caseLabel);
+   }
+}
+
+
+void testMappedFileCopyOnWrite()
+{
+   {
+      const std::string caseLabel{"MappedFile copy-on-write view"};
+      const std::vector<char> content = makeContent(100);
+      const TempFile file{"win32util_mapped_cow.bin", content};
+      {
+         MappedFile mf;
+         mf.open(file.path(), MapMode::CopyOnWrite);
+         MappedView view = mf.map();
+         VERIFY(view.isWritable(), caseLabel);
+         VERIFY(view.writableSpan().size() == 100, caseLabel);
+         view.writableSpan()[0] = std::byte{0xFF};
+         VERIFY(view.data()[0] == std::byte{0xFF}, caseLabel);
+      }
+
+      // The file is unchanged.
+      MappedFile mf;
+      mf.open(file.path());
+      VERIFY(equals(mf.map(), content, 0), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedView::writableSpan for read-only view"};
+      const TempFile file{"win32util_mapped_ro.bin", makeContent(100)};
+      MappedFile mf;
+      mf.open(file.path());
+      MappedView view = mf.map();
+      VERIFY(view.writableSpan().empty(), caseLabel);
+   }
+}
+
+
+void testMappedViewHints()
+{
+   {
+      const std::string caseLabel{"MappedView::advise and prefetch"};
+      const TempFile file{"win32util_mapped_hints.bin", makeContent(100000)};
+      MappedFile mf;
+      mf.open(file.path());
+      const MappedView view = mf.map();
+      VERIFY(view.advise(AccessHint::Sequential), caseLabel);
+      VERIFY(view.advise(AccessHint::Random), caseLabel);
+      VERIFY(view.advise(AccessHint::WillNeed), caseLabel);
+      VERIFY(view.prefetch(), caseLabel);
+      VERIFY(!MappedView{}.prefetch(), caseLabel);
+   }
+}
+
+
+void testMappedViewMove()
+{
+   {
+      const std::string caseLabel{"MappedView move ctor"};
+      const TempFile file{"win32util_mapped_move.bin", makeContent(100)};
+      MappedFile mf;
+      mf.open(file.path());
+      MappedView src = mf.map();
+      const std::byte* data = src.data();
+      MappedView dest{std::move(src)};
+      VERIFY(dest.data() == data, caseLabel);
+      VERIFY(!src, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedFile move ctor"};
+      const TempFile file{"win32util_mapped_filemove.bin", makeContent(100)};
+      MappedFile src;
+      src.open(file.path());
+      MappedFile dest{std::move(src)};
+      VERIFY(dest.operator bool() && dest.size() == 100, caseLabel);
+      VERIFY(!src, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MappedView::unmap"};
+      const TempFile file{"win32util_mapped_unmap.bin", makeContent(100)};
+      MappedFile mf;
+      mf.open(file.path());
+      MappedView view = mf.map();
+      view.unmap();
+      VERIFY(!view && view.size() == 0, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testMappedFile()
+{
+   testMappedFileOpen();
+   testMappedFileMap();
+   testMappedFileCopyOnWrite();
+   testMappedViewHints();
+   testMappedViewMove();
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for memory-mapped files.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testMappedFile();
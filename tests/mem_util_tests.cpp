@@ -8,12 +8,16 @@
 #include "mem_util_tests.h"
 #include "mem_util.h"
 #include "test_util.h"
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
 
 using namespace win32;
 
 
 namespace
 {
+#ifdef _WIN32
 ///////////////////
 
 void testCoTaskMemDefaultCtor()
@@ -615,12 +619,329 @@ void testHeapMemFree()
       VERIFY(mem.ptr() == nullptr, caseLabel);
    }
 }
+#endif //_WIN32
+
+
+///////////////////
+
+// Element type of a given array memory class.
+template <typename ArrayMem>
+using Elem_t = std::remove_pointer_t<decltype(std::declval<ArrayMem>().ptr())>;
+
+
+// Allocates memory for an array of given size through the tested memory class and
+// populates it with the element indices.
+template <typename ArrayMem> ArrayMem allocateArray(std::size_t size)
+{
+   ArrayMem mem;
+   mem.resize(size);
+   for (std::size_t i = 0; i < size; ++i)
+      mem[i] = static_cast<Elem_t<ArrayMem>>(i);
+   return mem;
+}
+
+
+template <typename ArrayMem> void testArrayMemResize(const std::string& typeLabel)
+{
+   {
+      const std::string caseLabel{typeLabel + "::resize for empty object"};
+      ArrayMem mem;
+      const bool res = mem.resize(5);
+      VERIFY(res, caseLabel);
+      VERIFY(mem.ptr() != nullptr, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() >= 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::resize growing preserves elements"};
+      ArrayMem mem = allocateArray<ArrayMem>(10);
+      const bool res = mem.resize(1000);
+      VERIFY(res, caseLabel);
+      VERIFY(mem.size() == 1000, caseLabel);
+      bool preserved = true;
+      for (std::size_t i = 0; i < 10; ++i)
+         preserved = preserved && (mem[i] == static_cast<Elem_t<ArrayMem>>(i));
+      VERIFY(preserved, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::resize grows geometrically"};
+      ArrayMem mem = allocateArray<ArrayMem>(100);
+      const std::size_t prevCapacity = mem.capacity();
+      mem.resize(prevCapacity + 1);
+      VERIFY(mem.capacity() >= prevCapacity + prevCapacity / 2, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::resize shrinking keeps capacity"};
+      ArrayMem mem = allocateArray<ArrayMem>(100);
+      const std::size_t prevCapacity = mem.capacity();
+      const bool res = mem.resize(10);
+      VERIFY(res, caseLabel);
+      VERIFY(mem.size() == 10, caseLabel);
+      VERIFY(mem.capacity() == prevCapacity, caseLabel);
+   }
+}
+
+
+template <typename ArrayMem> void testArrayMemReserve(const std::string& typeLabel)
+{
+   {
+      const std::string caseLabel{typeLabel + "::reserve"};
+      ArrayMem mem = allocateArray<ArrayMem>(3);
+      const bool res = mem.reserve(50);
+      VERIFY(res, caseLabel);
+      VERIFY(mem.size() == 3, caseLabel);
+      VERIFY(mem.capacity() == 50, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::reserve for smaller capacity"};
+      ArrayMem mem = allocateArray<ArrayMem>(30);
+      const std::size_t prevCapacity = mem.capacity();
+      const bool res = mem.reserve(5);
+      VERIFY(res, caseLabel);
+      VERIFY(mem.capacity() == prevCapacity, caseLabel);
+   }
+}
+
+
+template <typename ArrayMem> void testArrayMemShrinkToFit(const std::string& typeLabel)
+{
+   {
+      const std::string caseLabel{typeLabel + "::shrinkToFit"};
+      ArrayMem mem = allocateArray<ArrayMem>(20);
+      mem.resize(4);
+      const bool res = mem.shrinkToFit();
+      VERIFY(res, caseLabel);
+      VERIFY(mem.size() == 4, caseLabel);
+      VERIFY(mem.capacity() == 4, caseLabel);
+      VERIFY(mem[3] == static_cast<Elem_t<ArrayMem>>(3), caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::shrinkToFit for zero elements"};
+      ArrayMem mem = allocateArray<ArrayMem>(20);
+      mem.resize(0);
+      mem.shrinkToFit();
+      VERIFY(!mem, caseLabel);
+      VERIFY(mem.capacity() == 0, caseLabel);
+   }
+}
+
+
+template <typename ArrayMem> void testArrayMemSpan(const std::string& typeLabel)
+{
+   {
+      const std::string caseLabel{typeLabel + "::span"};
+      ArrayMem mem = allocateArray<ArrayMem>(7);
+      const auto span = mem.span();
+      VERIFY(span.data() == mem.ptr(), caseLabel);
+      VERIFY(span.size() == 7, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::span const"};
+      const ArrayMem mem = allocateArray<ArrayMem>(7);
+      const auto span = mem.span();
+      VERIFY(span.data() == mem.ptr(), caseLabel);
+      VERIFY(span.size() == 7, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + "::span for empty object"};
+      ArrayMem mem;
+      VERIFY(mem.span().empty(), caseLabel);
+   }
+}
+
+
+template <typename ArrayMem> void testArrayMemMoveAndSwap(const std::string& typeLabel)
+{
+   {
+      const std::string caseLabel{typeLabel + " move ctor"};
+      ArrayMem memA = allocateArray<ArrayMem>(5);
+      const auto* p = memA.ptr();
+      ArrayMem memB{std::move(memA)};
+      VERIFY(memA.ptr() == nullptr, caseLabel);
+      VERIFY(memA.size() == 0, caseLabel);
+      VERIFY(memB.ptr() == p, caseLabel);
+      VERIFY(memB.size() == 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + " move assignment"};
+      ArrayMem memA = allocateArray<ArrayMem>(5);
+      const auto* p = memA.ptr();
+      ArrayMem memB = allocateArray<ArrayMem>(2);
+      memB = std::move(memA);
+      VERIFY(memA.ptr() == nullptr, caseLabel);
+      VERIFY(memB.ptr() == p, caseLabel);
+      VERIFY(memB.size() == 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{typeLabel + " swap"};
+      ArrayMem memA = allocateArray<ArrayMem>(5);
+      const auto* pA = memA.ptr();
+      ArrayMem memB = allocateArray<ArrayMem>(2);
+      const auto* pB = memB.ptr();
+      swap(memA, memB);
+      VERIFY(memA.ptr() == pB && memA.size() == 2, caseLabel);
+      VERIFY(memB.ptr() == pA && memB.size() == 5, caseLabel);
+   }
+}
+
+
+template <typename ArrayMem> void testArrayMem(const std::string& typeLabel)
+{
+   testArrayMemResize<ArrayMem>(typeLabel);
+   testArrayMemReserve<ArrayMem>(typeLabel);
+   testArrayMemShrinkToFit<ArrayMem>(typeLabel);
+   testArrayMemSpan<ArrayMem>(typeLabel);
+   testArrayMemMoveAndSwap<ArrayMem>(typeLabel);
+}
+
+
+#ifdef _WIN32
+void testCoTaskMemArrayCtorWithPointer()
+{
+   {
+      const std::string caseLabel{"CoTaskMem<T[]> pointer and size ctor"};
+      int* p = static_cast<int*>(CoTaskMemAlloc(5 * sizeof(int)));
+      CoTaskMem<int[]> mem{p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() == 5, caseLabel);
+   }
+}
+
+
+void testGlobalMemArrayCtorWithPointer()
+{
+   {
+      const std::string caseLabel{"GlobalMem<T[]> pointer and size ctor"};
+      float* p = static_cast<float*>(GlobalAlloc(GMEM_FIXED, 5 * sizeof(float)));
+      GlobalMem<float[]> mem{p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() == 5, caseLabel);
+   }
+}
+
+
+void testLocalMemArrayCtorWithPointer()
+{
+   {
+      const std::string caseLabel{"LocalMem<T[]> pointer and size ctor"};
+      char* p = static_cast<char*>(LocalAlloc(LMEM_FIXED, 5 * sizeof(char)));
+      LocalMem<char[]> mem{p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() == 5, caseLabel);
+   }
+}
+
+
+void testHeapMemArrayCtorWithPointer()
+{
+   {
+      const std::string caseLabel{"HeapMem<T[]> pointer and size ctor"};
+      wchar_t* p =
+         static_cast<wchar_t*>(HeapAlloc(GetProcessHeap(), 0, 5 * sizeof(wchar_t)));
+      HeapMem<wchar_t[]> mem{p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() == 5, caseLabel);
+   }
+   {
+      const std::string caseLabel{"HeapMem<T[]> ctor with all parameters"};
+      const HANDLE heap = GetProcessHeap();
+      wchar_t* p = static_cast<wchar_t*>(HeapAlloc(heap, 0, 5 * sizeof(wchar_t)));
+      HeapMem<wchar_t[]> mem{heap, HEAP_ZERO_MEMORY, p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+   }
+}
+
+
+void testHeapMemArrayResizeWithFlags()
+{
+   {
+      const std::string caseLabel{"HeapMem<T[]>::resize uses heap flags"};
+      HeapMem<int[]> mem{GetProcessHeap(), HEAP_ZERO_MEMORY};
+      mem.resize(3);
+      mem.resize(200);
+      bool zeroed = true;
+      for (int val : mem.span())
+         zeroed = zeroed && (val == 0);
+      VERIFY(zeroed, caseLabel);
+   }
+   {
+      const std::string caseLabel{
+         "HeapMem<T[]>::resize after shrinking to zero keeps heap and flags"};
+      const HANDLE heap = HeapCreate(0, 0, 0);
+      {
+         HeapMem<int[]> mem{heap, HEAP_ZERO_MEMORY};
+         mem.resize(10);
+         mem.resize(0);
+         mem.shrinkToFit();
+         VERIFY(!mem, caseLabel);
+
+         mem.resize(100);
+         VERIFY(HeapValidate(heap, 0, mem.ptr()), caseLabel);
+         bool zeroed = true;
+         for (int val : mem.span())
+            zeroed = zeroed && (val == 0);
+         VERIFY(zeroed, caseLabel);
+      }
+      HeapDestroy(heap);
+   }
+   {
+      const std::string caseLabel{"HeapMem<T[]>::free keeps heap and flags"};
+      const HANDLE heap = HeapCreate(0, 0, 0);
+      {
+         HeapMem<int[]> mem{heap, HEAP_ZERO_MEMORY};
+         mem.resize(10);
+         mem.free();
+         mem.resize(20);
+         VERIFY(HeapValidate(heap, 0, mem.ptr()), caseLabel);
+         VERIFY(mem[19] == 0, caseLabel);
+      }
+      HeapDestroy(heap);
+   }
+}
+#endif //_WIN32
+
+
+void testCrtMemArrayCtorWithPointer()
+{
+   {
+      const std::string caseLabel{"CrtMem<T[]> pointer and size ctor"};
+      double* p = static_cast<double*>(std::malloc(5 * sizeof(double)));
+      CrtMem<double[]> mem{p, 5};
+      VERIFY(mem.ptr() == p, caseLabel);
+      VERIFY(mem.size() == 5, caseLabel);
+      VERIFY(mem.capacity() == 5, caseLabel);
+   }
+}
+
+
+void testGeometricGrowth()
+{
+   {
+      const std::string caseLabel{"GeometricGrowth::nextCapacity from zero"};
+      VERIFY(GeometricGrowth::nextCapacity(0, 1) == GeometricGrowth::MinCapacity,
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"GeometricGrowth::nextCapacity grows by half"};
+      VERIFY(GeometricGrowth::nextCapacity(100, 101) == 150, caseLabel);
+   }
+   {
+      const std::string caseLabel{"GeometricGrowth::nextCapacity for large requirement"};
+      VERIFY(GeometricGrowth::nextCapacity(100, 1000) == 1000, caseLabel);
+   }
+}
 
 } // namespace
 
 
 void testMemUtil()
 {
+#ifdef _WIN32
    testCoTaskMemDefaultCtor();
    testCoTaskMemCtorWithPointer();
    testCoTaskMemDtor();
@@ -672,4 +993,20 @@ void testMemUtil()
    testHeapMemConstPtr();
    testHeapMemClear();
    testHeapMemFree();
+#endif //_WIN32
+
+   testGeometricGrowth();
+#ifdef _WIN32
+   testCoTaskMemArrayCtorWithPointer();
+   testArrayMem<CoTaskMem<int[]>>("CoTaskMem<T[]>");
+   testGlobalMemArrayCtorWithPointer();
+   testArrayMem<GlobalMem<float[]>>("GlobalMem<T[]>");
+   testLocalMemArrayCtorWithPointer();
+   testArrayMem<LocalMem<char[]>>("LocalMem<T[]>");
+   testHeapMemArrayCtorWithPointer();
+   testHeapMemArrayResizeWithFlags();
+   testArrayMem<HeapMem<wchar_t[]>>("HeapMem<T[]>");
+#endif //_WIN32
+   testCrtMemArrayCtorWithPointer();
+   testArrayMem<CrtMem<double[]>>("CrtMem<T[]>");
 }
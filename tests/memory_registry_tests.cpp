@@ -0,0 +1,829 @@
+//
+// Win32 utilities library
+// Tests for in-memory registry backends.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "memory_registry_tests.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring TestsKeyPath = L"Software\\Projects\\win32_util\\tests";
+
+
+std::filesystem::path tempHivePath()
+{
+   return std::filesystem::temp_directory_path() / "win32_util_registry_tests.hive";
+}
+
+
+// Counts the round trips that reads make to the backend.
+class QueryCountingBackend : public MemoryRegBackend
+{
+ public:
+   bool queryValue(RegHandle key, const std::wstring& valueName, RegValueType* type,
+                   void* data, std::size_t* numBytes) override
+   {
+      ++numQueries;
+      return MemoryRegBackend::queryValue(key, valueName, type, data, numBytes);
+   }
+
+   std::size_t numQueries = 0;
+};
+
+
+// Counts the steps of enumerations.
+class EnumCountingBackend : public MemoryRegBackend
+{
+ public:
+   RegEnumResult enumSubkey(RegHandle key, std::size_t idx, std::wstring& name) override
+   {
+      ++numSteps;
+      return MemoryRegBackend::enumSubkey(key, idx, name);
+   }
+
+   std::size_t numSteps = 0;
+};
+
+
+// Enumerates with the default implementation that reads all names for each step.
+class EnumAllNamesBackend : public MemoryRegBackend
+{
+ public:
+   RegEnumResult enumSubkey(RegHandle key, std::size_t idx, std::wstring& name) override
+   {
+      return RegBackend::enumSubkey(key, idx, name);
+   }
+
+   RegEnumResult enumValue(RegHandle key, std::size_t idx, std::wstring& name,
+                           RegValueType* type, std::size_t* numBytes) override
+   {
+      return RegBackend::enumValue(key, idx, name, type, numBytes);
+   }
+};
+
+
+// Reads snapshots by querying each value separately.
+class QueryEachValueBackend : public QueryCountingBackend
+{
+ public:
+   std::optional<RegSnapshot> readAllValues(RegHandle key) override
+   {
+      return RegBackend::readAllValues(key);
+   }
+};
+
+
+void writeSnapshotValues(const RegKey& rk)
+{
+   const std::vector<unsigned char> bytes{1, 2, 3};
+   rk.writeBinary(L"bin", bytes.data(), bytes.size());
+   rk.writeInt32(L"int32", 32);
+   rk.writeInt64(L"int64", 64);
+   rk.writeWString(L"str", L"text");
+   rk.writeWString(L"long", std::wstring(1000, L'x'));
+}
+
+
+bool verifySnapshotValues(const RegSnapshot& snapshot)
+{
+   const auto bin = snapshot.find(L"BIN");
+   const auto int32 = snapshot.find(L"int32");
+   const auto int64 = snapshot.find(L"int64");
+   const auto str = snapshot.find(L"Str");
+   const auto longStr = snapshot.find(L"long");
+   return snapshot.size() == 5 && bin && bin->name() == L"bin" &&
+          bin->type() == RegValueType::Binary && bin->data().size() == 3 &&
+          bin->data()[2] == std::byte{3} && int32 && int32->toInt32() == 32 &&
+          !int32->toInt64() && !int32->toWString() && int64 && int64->toInt64() == 64 &&
+          str && str->toWString() == L"text" && longStr &&
+          longStr->toWString() == std::wstring(1000, L'x') && !snapshot.find(L"none");
+}
+
+
+///////////////////
+
+void testMemoryRegKeys()
+{
+   {
+      const std::string caseLabel{"MemoryRegBackend create and open key"};
+      MemoryRegBackend backend;
+      const std::wstring keyPath = TestsKeyPath + L"\\CreateAndOpen";
+
+      VERIFY(!RegKey::keyExists(backend, RegCurrentUser, keyPath), caseLabel);
+      RegKey created{backend, RegCurrentUser, keyPath};
+      VERIFY(created && created.wasCreated(), caseLabel);
+      VERIFY(created.backend() == &backend, caseLabel);
+
+      RegKey opened;
+      VERIFY(opened.open(backend, RegCurrentUser, keyPath), caseLabel);
+      VERIFY(opened.wasOpened(), caseLabel);
+      VERIFY(RegKey::keyExists(backend, RegCurrentUser, keyPath), caseLabel);
+      // Other roots are separate.
+      VERIFY(!RegKey::keyExists(backend, RegLocalMachine, keyPath), caseLabel);
+
+      RegKey recreated{backend, RegCurrentUser, keyPath};
+      VERIFY(recreated && !recreated.wasCreated(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend names are case-insensitive"};
+      MemoryRegBackend backend;
+      RegKey created{backend, RegCurrentUser, L"Software\\MixedCase"};
+      created.writeInt32(L"Value", 1);
+
+      RegKey opened;
+      VERIFY(opened.open(backend, RegCurrentUser, L"SOFTWARE\\mixedcase"), caseLabel);
+      VERIFY(opened.readInt32(L"VALUE") == 1, caseLabel);
+      opened.writeInt32(L"value", 2);
+      VERIFY(created.readInt32(L"Value") == 2, caseLabel);
+      // Names keep the spelling with which they were created.
+      VERIFY(opened.entryNames() == std::vector<std::wstring>{L"Value"}, caseLabel);
+
+      RegKey parent{backend, RegCurrentUser, L"software"};
+      VERIFY(parent.subkeyNames() == std::vector<std::wstring>{L"MixedCase"},
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend open not existing key"};
+      MemoryRegBackend backend;
+      RegKey rk;
+      VERIFY(!rk.open(backend, RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(!rk, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend closes handles"};
+      MemoryRegBackend backend;
+      {
+         RegKey a{backend, RegCurrentUser, TestsKeyPath};
+         RegKey b{backend, RegCurrentUser, TestsKeyPath};
+         VERIFY(backend.numOpenHandles() == 2, caseLabel);
+
+         RegKey moved{std::move(a)};
+         VERIFY(backend.numOpenHandles() == 2, caseLabel);
+      }
+      VERIFY(backend.numOpenHandles() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend remove key tree"};
+      MemoryRegBackend backend;
+      RegKey parent{backend, RegCurrentUser, TestsKeyPath};
+      RegKey child{backend, RegCurrentUser, TestsKeyPath + L"\\a\\b"};
+      const std::size_t numKeysBefore = backend.numKeys();
+
+      VERIFY(RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath + L"\\A"),
+             caseLabel);
+      VERIFY(backend.numKeys() == numKeysBefore - 2, caseLabel);
+      VERIFY(parent.countSubkeys() == 0, caseLabel);
+      // Handles of removed keys fail.
+      VERIFY(!child.writeInt32(L"val", 1), caseLabel);
+      VERIFY(!child.readInt32(L"val"), caseLabel);
+      VERIFY(!RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath + L"\\a"),
+             caseLabel);
+
+      // Recreated keys are new keys.
+      RegKey recreated{backend, RegCurrentUser, TestsKeyPath + L"\\a\\b"};
+      VERIFY(recreated.wasCreated(), caseLabel);
+      VERIFY(!child.readInt32(L"val"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend remove key contents"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      RegKey child{backend, RegCurrentUser, TestsKeyPath + L"\\child"};
+      rk.writeInt32(L"val", 1);
+
+      VERIFY(RegKey::removeKey(backend, rk.handle(), L""), caseLabel);
+      VERIFY(rk.countSubkeys() == 0 && rk.countEntries() == 0, caseLabel);
+      VERIFY(rk.writeInt32(L"val", 2), caseLabel);
+      VERIFY(!child.readInt32(L"val"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend access rights"};
+      MemoryRegBackend backend;
+      RegKey writable{backend, RegCurrentUser, TestsKeyPath};
+      writable.writeInt32(L"val", 1);
+
+      RegKey readOnly;
+      readOnly.open(backend, RegCurrentUser, TestsKeyPath, RegAccessRead);
+      VERIFY(readOnly.readInt32(L"val") == 1, caseLabel);
+      VERIFY(!readOnly.writeInt32(L"val", 2), caseLabel);
+      VERIFY(!readOnly.removeEntry(L"val"), caseLabel);
+      VERIFY(!RegKey(backend, readOnly.handle(), L"child"), caseLabel);
+      VERIFY(readOnly.countEntries() == 1, caseLabel);
+
+      RegKey writeOnly;
+      writeOnly.open(backend, RegCurrentUser, TestsKeyPath, RegAccessWrite);
+      VERIFY(writeOnly.writeInt32(L"val", 3), caseLabel);
+      VERIFY(!writeOnly.readInt32(L"val"), caseLabel);
+   }
+}
+
+
+void testMemoryRegValues()
+{
+   {
+      const std::string caseLabel{"MemoryRegBackend typed values"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+
+      VERIFY(rk.writeInt32(L"int32", -32), caseLabel);
+      VERIFY(rk.writeInt64(L"int64", -64000000000), caseLabel);
+      VERIFY(rk.writeString(L"string", "narrow"), caseLabel);
+      VERIFY(rk.writeWString(L"wstring", L"wide"), caseLabel);
+      const std::vector<unsigned char> bytes{1, 2, 3, 4, 5};
+      VERIFY(rk.writeBinary(L"binary", bytes.data(), bytes.size()), caseLabel);
+
+      VERIFY(rk.readInt32(L"int32") == -32, caseLabel);
+      VERIFY(rk.readInt64(L"int64") == -64000000000, caseLabel);
+      VERIFY(rk.readString(L"string") == "narrow", caseLabel);
+      VERIFY(rk.readWString(L"wstring") == L"wide", caseLabel);
+      // Narrow and wide strings are both REG_SZ values.
+      VERIFY(rk.readWString(L"string") == L"narrow", caseLabel);
+      VERIFY(rk.readString(L"wstring") == "wide", caseLabel);
+
+      std::vector<unsigned char> readBytes;
+      const std::size_t numRead = rk.readBinary(L"binary",
+                                                [&readBytes](std::size_t numBytes)
+                                                {
+                                                   readBytes.resize(numBytes);
+                                                   return readBytes.data();
+                                                });
+      VERIFY(numRead == bytes.size() && readBytes == bytes, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend values of other type"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt32(L"int32", 1);
+      rk.writeInt64(L"int64", 1);
+      rk.writeWString(L"string", L"1");
+
+      VERIFY(!rk.readInt64(L"int32"), caseLabel);
+      VERIFY(!rk.readInt32(L"int64"), caseLabel);
+      VERIFY(!rk.readInt32(L"string"), caseLabel);
+      VERIFY(!rk.readWString(L"int32"), caseLabel);
+      VERIFY(!rk.readString(L"int64"), caseLabel);
+      VERIFY(rk.readBinary(L"string", [](std::size_t) { return nullptr; }) == 0,
+             caseLabel);
+
+      // Writing replaces the type.
+      rk.writeWString(L"int32", L"now a string");
+      VERIFY(rk.readWString(L"int32") == L"now a string", caseLabel);
+      VERIFY(!rk.readInt32(L"int32"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend empty values"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      VERIFY(rk.writeWString(L"", L""), caseLabel);
+      VERIFY(rk.readWString(L"") == L"", caseLabel);
+      VERIFY(rk.writeBinary(L"binary", nullptr, 0), caseLabel);
+      VERIFY(rk.readBinary(L"binary", [](std::size_t) { return nullptr; }) == 0,
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend queryValue with small buffer"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt64(L"val", 1);
+
+      std::int32_t buffer = 0;
+      std::size_t numBytes = sizeof(buffer);
+      RegValueType type = RegValueType::None;
+      VERIFY(!backend.queryValue(rk.handle(), L"val", &type, &buffer, &numBytes),
+             caseLabel);
+      VERIFY(numBytes == sizeof(std::int64_t) && type == RegValueType::Qword, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend remove and enumerate entries"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt32(L"c", 1);
+      rk.writeInt32(L"a", 1);
+      rk.writeInt32(L"b", 1);
+      RegKey{backend, rk.handle(), L"z"};
+      RegKey{backend, rk.handle(), L"y"};
+
+      VERIFY(rk.removeEntry(L"B"), caseLabel);
+      VERIFY(!rk.removeEntry(L"b"), caseLabel);
+      VERIFY(rk.countEntries() == 2, caseLabel);
+      VERIFY((rk.entryNames() == std::vector<std::wstring>{L"a", L"c"}), caseLabel);
+      VERIFY(rk.countSubkeys() == 2, caseLabel);
+      VERIFY((rk.subkeyNames() == std::vector<std::wstring>{L"y", L"z"}), caseLabel);
+
+      const std::optional<RegKeyInfo> info = backend.queryKeyInfo(rk.handle());
+      VERIFY(info && info->maxValueNameLength == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend counts changes"};
+      MemoryRegBackend backend;
+      const std::uint64_t initial = backend.changeCount();
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt32(L"val", 1);
+      rk.readInt32(L"val");
+      VERIFY(backend.changeCount() == initial + 2, caseLabel);
+   }
+}
+
+
+void testMemoryRegReadQueries()
+{
+   {
+      const std::string caseLabel{"RegKey reads small values with a single query"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      const std::vector<unsigned char> bytes{1, 2, 3};
+      rk.writeWString(L"str", L"text");
+      rk.writeString(L"narrow", "text");
+      rk.writeBinary(L"bin", bytes.data(), bytes.size());
+
+      VERIFY(rk.readWString(L"str") == L"text", caseLabel);
+      VERIFY(rk.readString(L"narrow") == "text", caseLabel);
+      std::vector<unsigned char> out;
+      const std::size_t numRead = rk.readBinary(L"bin", [&out](std::size_t numBytes)
+                                                {
+                                                   out.resize(numBytes);
+                                                   return out.data();
+                                                });
+      VERIFY(numRead == bytes.size() && out == bytes, caseLabel);
+      VERIFY(backend.numQueries == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey reads large values with two queries"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      const std::wstring str(1000, L'x');
+      const std::vector<unsigned char> bytes(1000, 7);
+      rk.writeWString(L"str", str);
+      rk.writeString(L"narrow", std::string(1000, 'x'));
+      rk.writeBinary(L"bin", bytes.data(), bytes.size());
+
+      VERIFY(rk.readWString(L"str") == str, caseLabel);
+      VERIFY(rk.readString(L"narrow") == std::string(1000, 'x'), caseLabel);
+      std::vector<unsigned char> out;
+      const std::size_t numRead = rk.readBinary(L"bin", [&out](std::size_t numBytes)
+                                                {
+                                                   out.resize(numBytes);
+                                                   return out.data();
+                                                });
+      VERIFY(numRead == bytes.size() && out == bytes, caseLabel);
+      VERIFY(backend.numQueries == 6, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey reads missing values with a single query"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt32(L"int32", 1);
+
+      VERIFY(!rk.readWString(L"missing"), caseLabel);
+      VERIFY(!rk.readWString(L"int32"), caseLabel);
+      VERIFY(backend.numQueries == 2, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::readWString into caller buffer"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeWString(L"str", L"text");
+
+      wchar_t buffer[5];
+      std::size_t requiredLength = 0;
+      VERIFY(rk.readWString(L"str", buffer, &requiredLength) == L"text", caseLabel);
+      VERIFY(requiredLength == 0, caseLabel);
+
+      wchar_t smallBuffer[3];
+      VERIFY(!rk.readWString(L"str", smallBuffer, &requiredLength), caseLabel);
+      VERIFY(requiredLength == 5, caseLabel);
+      VERIFY(!rk.readWString(L"str", {}, &requiredLength), caseLabel);
+      VERIFY(requiredLength == 5, caseLabel);
+      VERIFY(!rk.readWString(L"missing", buffer, &requiredLength), caseLabel);
+      VERIFY(requiredLength == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::readBinary into caller buffer"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      const std::vector<unsigned char> bytes{1, 2, 3};
+      rk.writeBinary(L"bin", bytes.data(), bytes.size());
+      rk.writeBinary(L"empty", nullptr, 0);
+
+      unsigned char buffer[8];
+      std::size_t requiredBytes = 0;
+      const auto data = rk.readBinary(L"bin", buffer, &requiredBytes);
+      VERIFY(data && data->data() == buffer && data->size() == 3, caseLabel);
+      VERIFY(std::equal(data->begin(), data->end(), bytes.begin()), caseLabel);
+
+      unsigned char smallBuffer[2];
+      VERIFY(!rk.readBinary(L"bin", smallBuffer, &requiredBytes), caseLabel);
+      VERIFY(requiredBytes == 3, caseLabel);
+      const auto empty = rk.readBinary(L"empty", std::span<unsigned char>{});
+      VERIFY(empty && empty->empty(), caseLabel);
+      VERIFY(backend.numQueries == 3, caseLabel);
+   }
+}
+
+
+void testMemoryRegSnapshot()
+{
+   {
+      const std::string caseLabel{"RegKey::readAll"};
+      QueryCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      writeSnapshotValues(rk);
+
+      const std::optional<RegSnapshot> snapshot = rk.readAll();
+      VERIFY(snapshot && verifySnapshotValues(*snapshot), caseLabel);
+      // All values are copied at once.
+      VERIFY(backend.numQueries == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::readAll with values queried one by one"};
+      QueryEachValueBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      writeSnapshotValues(rk);
+
+      const std::optional<RegSnapshot> snapshot = rk.readAll();
+      VERIFY(snapshot && verifySnapshotValues(*snapshot), caseLabel);
+      // Only the long string needs a second query.
+      VERIFY(backend.numQueries == 6, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::readAll for key without values"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+
+      const std::optional<RegSnapshot> snapshot = rk.readAll();
+      VERIFY(snapshot && snapshot->empty() && snapshot->arenaBytes() == 0, caseLabel);
+      VERIFY(!RegKey{}.readAll(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::readAll without query access"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKey rk;
+      rk.open(backend, RegCurrentUser, TestsKeyPath, RegAccessSetValue);
+
+      VERIFY(!rk.readAll(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegSnapshot aligns strings"};
+      RegSnapshot snapshot;
+      const unsigned char odd[3] = {1, 2, 3};
+      const std::wstring str = L"text";
+      snapshot.add(L"odd", RegValueType::Binary, odd, sizeof(odd));
+      snapshot.add(L"str", RegValueType::String, str.c_str(),
+                   (str.size() + 1) * sizeof(wchar_t));
+      snapshot.add(L"", RegValueType::String, nullptr, 0);
+
+      const RegSnapshot copy = snapshot;
+      VERIFY(copy.size() == 3, caseLabel);
+      VERIFY(copy[1].toWString() == L"text", caseLabel);
+      const auto data = reinterpret_cast<std::uintptr_t>(copy[1].data().data());
+      VERIFY(data % alignof(wchar_t) == 0, caseLabel);
+      VERIFY(copy[2].name().empty() && copy[2].toWString() == L"", caseLabel);
+
+      snapshot.clear();
+      VERIFY(snapshot.empty() && copy.size() == 3, caseLabel);
+   }
+}
+
+
+void testMemoryRegEnumeration()
+{
+   static_assert(std::ranges::input_range<RegSubkeyRange>);
+   static_assert(std::ranges::input_range<RegEntryRange>);
+
+   {
+      const std::string caseLabel{"RegKey::subkeys"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      for (const wchar_t* name : {L"c", L"A", L"b"})
+         RegKey{backend, rk.handle(), name};
+
+      std::vector<std::wstring> names;
+      for (std::wstring_view name : rk.subkeys())
+         names.emplace_back(name);
+      VERIFY((names == std::vector<std::wstring>{L"A", L"b", L"c"}), caseLabel);
+      VERIFY(rk.subkeyNames() == names, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::subkeys stops early"};
+      EnumCountingBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      for (int i = 0; i < 100; ++i)
+         RegKey{backend, rk.handle(), L"key" + std::to_wstring(i + 100)};
+
+      const RegSubkeyRange range = rk.subkeys();
+      auto pos = std::ranges::find_if(range, [](std::wstring_view name)
+                                      { return name == L"key102"; });
+      VERIFY(pos != range.end() && *pos == L"key102", caseLabel);
+      VERIFY(backend.numSteps == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::subkeys continues after removed subkey"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      for (const wchar_t* name : {L"a", L"b", L"c"})
+         RegKey{backend, rk.handle(), name};
+
+      std::vector<std::wstring> names;
+      for (std::wstring_view name : rk.subkeys())
+      {
+         names.emplace_back(name);
+         RegKey::removeKey(backend, rk.handle(), names.back());
+      }
+      VERIFY((names == std::vector<std::wstring>{L"a", L"b", L"c"}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::entries"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt64(L"int64", 64);
+      rk.writeWString(L"Str", L"text");
+      rk.writeInt32(L"int32", 32);
+
+      std::vector<std::wstring> names;
+      std::size_t numBytes = 0;
+      for (const RegEntryInfo& entry : rk.entries())
+      {
+         names.emplace_back(entry.name);
+         numBytes += entry.numBytes;
+         if (entry.name == L"Str")
+            VERIFY(entry.type == RegValueType::String, caseLabel);
+      }
+      VERIFY((names == std::vector<std::wstring>{L"int32", L"int64", L"Str"}),
+             caseLabel);
+      VERIFY(numBytes == 4 + 8 + 5 * sizeof(wchar_t), caseLabel);
+      VERIFY(rk.entryNames() == names, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey enumeration without access rights"};
+      MemoryRegBackend backend;
+      RegKey setup{backend, RegCurrentUser, TestsKeyPath};
+      RegKey{backend, setup.handle(), L"sub"};
+      setup.writeInt32(L"int32", 32);
+      RegKey rk;
+      rk.open(backend, RegCurrentUser, TestsKeyPath, RegAccessSetValue);
+
+      VERIFY(rk.subkeys().begin().hasFailed(), caseLabel);
+      VERIFY(rk.entries().begin().hasFailed(), caseLabel);
+      VERIFY(rk.subkeyNames().empty() && rk.entryNames().empty(), caseLabel);
+      VERIFY(RegKey{}.subkeys().begin() == std::default_sentinel, caseLabel);
+      VERIFY(!RegKey{}.entries().begin().hasFailed(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey enumeration with default backend functions"};
+      EnumAllNamesBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      RegKey{backend, rk.handle(), L"sub"};
+      rk.writeInt32(L"int32", 32);
+
+      VERIFY(rk.subkeyNames() == std::vector<std::wstring>{L"sub"}, caseLabel);
+      const RegEntryRange entries = rk.entries();
+      auto it = entries.begin();
+      VERIFY(it != entries.end() && (*it).name == L"int32", caseLabel);
+      VERIFY((*it).type == RegValueType::Dword && (*it).numBytes == 4, caseLabel);
+      VERIFY(++it == entries.end() && !it.hasFailed(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKey::info"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      RegKey{backend, rk.handle(), L"sub"};
+      rk.writeInt32(L"a", 1);
+      rk.writeInt32(L"b", 2);
+
+      const std::optional<RegKeyInfo> info = rk.info();
+      VERIFY(info && info->numSubkeys == 1 && info->numValues == 2, caseLabel);
+      VERIFY(!RegKey{}.info(), caseLabel);
+   }
+}
+
+
+void testMemoryRegWatch()
+{
+   {
+      const std::string caseLabel{"MemoryRegBackend watch key"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      RegKey other{backend, RegCurrentUser, L"Other"};
+
+      int numChanges = 0;
+      const RegBackend::WatchId id =
+         backend.watchKey(rk.handle(), [&numChanges]() { ++numChanges; });
+      VERIFY(id != 0, caseLabel);
+
+      rk.writeInt32(L"val", 1);
+      VERIFY(numChanges == 1, caseLabel);
+      rk.removeEntry(L"val");
+      VERIFY(numChanges == 2, caseLabel);
+      RegKey child{backend, rk.handle(), L"child\\grandchild"};
+      VERIFY(numChanges == 3, caseLabel);
+      // Changes of subkeys and other keys are not reported.
+      child.writeInt32(L"val", 1);
+      other.writeInt32(L"val", 1);
+      VERIFY(numChanges == 3, caseLabel);
+      RegKey::removeKey(backend, rk.handle(), L"child");
+      VERIFY(numChanges == 4, caseLabel);
+
+      backend.unwatchKey(id);
+      rk.writeInt32(L"val", 2);
+      VERIFY(numChanges == 4, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend watch removed key"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+
+      int numChanges = 0;
+      const RegBackend::WatchId id =
+         backend.watchKey(rk.handle(), [&numChanges]() { ++numChanges; });
+      RegKey::removeKey(backend, RegCurrentUser, L"Software");
+      VERIFY(numChanges == 1, caseLabel);
+      VERIFY(backend.watchKey(rk.handle(), []() {}) == 0, caseLabel);
+      backend.unwatchKey(id);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend callback can access the backend"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+
+      std::optional<int32_t> seen;
+      const RegBackend::WatchId id =
+         backend.watchKey(rk.handle(), [&rk, &seen]() { seen = rk.readInt32(L"val"); });
+      rk.writeInt32(L"val", 5);
+      VERIFY(seen == 5, caseLabel);
+      backend.unwatchKey(id);
+   }
+}
+
+
+void testMemoryRegHive()
+{
+   {
+      const std::string caseLabel{"MemoryRegBackend export and import hive"};
+      MemoryRegBackend source;
+      {
+         RegKey rk{source, RegCurrentUser, TestsKeyPath};
+         rk.writeInt32(L"Int", 42);
+         rk.writeWString(L"Str", L"value");
+         RegKey child{source, rk.handle(), L"Child"};
+         child.writeInt64(L"Int64", 64);
+         RegKey machine{source, RegLocalMachine, L"Software"};
+      }
+
+      MemoryRegBackend target;
+      VERIFY(target.importHive(source.exportHive()), caseLabel);
+      VERIFY(target.numKeys() == source.numKeys(), caseLabel);
+
+      RegKey rk;
+      VERIFY(rk.open(target, RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(rk.readInt32(L"int") == 42, caseLabel);
+      VERIFY(rk.readWString(L"str") == L"value", caseLabel);
+      VERIFY(rk.subkeyNames() == std::vector<std::wstring>{L"Child"}, caseLabel);
+      VERIFY(RegKey(target, rk.handle(), L"child").readInt64(L"Int64") == 64, caseLabel);
+      VERIFY(RegKey::keyExists(target, RegLocalMachine, L"software"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend import invalidates handles"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      rk.writeInt32(L"val", 1);
+
+      VERIFY(backend.importHive(MemoryRegBackend{}.exportHive()), caseLabel);
+      VERIFY(!rk.readInt32(L"val"), caseLabel);
+      VERIFY(!RegKey::keyExists(backend, RegCurrentUser, TestsKeyPath), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MemoryRegBackend import invalid data"};
+      MemoryRegBackend source;
+      RegKey{source, RegCurrentUser, TestsKeyPath}.writeInt32(L"val", 1);
+      std::vector<std::byte> data = source.exportHive();
+
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, L"Existing"};
+      VERIFY(!backend.importHive({}), caseLabel);
+      std::vector<std::byte> truncated{data.begin(), data.end() - 1};
+      VERIFY(!backend.importHive(truncated), caseLabel);
+      data[0] = std::byte{0};
+      VERIFY(!backend.importHive(data), caseLabel);
+      // Hive is unchanged.
+      VERIFY(RegKey::keyExists(backend, RegCurrentUser, L"Existing"), caseLabel);
+   }
+}
+
+
+void testFileRegBackend()
+{
+   {
+      const std::string caseLabel{"FileRegBackend persists keys"};
+      const std::filesystem::path path = tempHivePath();
+      std::filesystem::remove(path);
+      {
+         FileRegBackend backend{path};
+         VERIFY(!backend.wasLoaded(), caseLabel);
+         RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+         rk.writeInt32(L"val", 7);
+         VERIFY(backend.hasUnsavedChanges(), caseLabel);
+      }
+      VERIFY(std::filesystem::exists(path), caseLabel);
+      {
+         FileRegBackend backend{path};
+         VERIFY(backend.wasLoaded() && !backend.hasUnsavedChanges(), caseLabel);
+         RegKey rk;
+         VERIFY(rk.open(backend, RegCurrentUser, TestsKeyPath), caseLabel);
+         VERIFY(rk.readInt32(L"val") == 7, caseLabel);
+
+         rk.writeInt32(L"val", 8);
+         VERIFY(backend.save() && !backend.hasUnsavedChanges(), caseLabel);
+      }
+      {
+         FileRegBackend backend{path};
+         VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath).readInt32(L"val") == 8,
+                caseLabel);
+      }
+      std::filesystem::remove(path);
+   }
+   {
+      const std::string caseLabel{"FileRegBackend for invalid file"};
+      const std::filesystem::path path = tempHivePath();
+      {
+         std::ofstream out{path, std::ios::binary | std::ios::trunc};
+         out << "not a hive";
+      }
+      {
+         FileRegBackend backend{path};
+         VERIFY(!backend.wasLoaded(), caseLabel);
+      }
+      // The file is kept if nothing changed.
+      VERIFY(std::filesystem::file_size(path) == 10, caseLabel);
+      std::filesystem::remove(path);
+   }
+   {
+      const std::string caseLabel{"FileRegBackend concurrent saves"};
+      const std::filesystem::path path = tempHivePath();
+      std::filesystem::remove(path);
+      {
+         FileRegBackend backend{path};
+         constexpr int NumThreads = 8;
+         std::vector<char> saved(NumThreads, false);
+         std::vector<std::thread> threads;
+         for (int i = 0; i < NumThreads; ++i)
+         {
+            threads.emplace_back(
+               [&backend, &saved, i]()
+               {
+                  RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+                  rk.writeInt32(L"val" + std::to_wstring(i), i);
+                  saved[i] = backend.save();
+               });
+         }
+         for (auto& th : threads)
+            th.join();
+
+         VERIFY(std::ranges::all_of(saved, [](char ok) { return ok != 0; }), caseLabel);
+         VERIFY(!backend.hasUnsavedChanges(), caseLabel);
+      }
+      {
+         FileRegBackend backend{path};
+         RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+         VERIFY(rk.readInt32(L"val0") == 0 && rk.readInt32(L"val7") == 7, caseLabel);
+      }
+      std::filesystem::remove(path);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testMemoryRegistry()
+{
+   testMemoryRegKeys();
+   testMemoryRegValues();
+   testMemoryRegReadQueries();
+   testMemoryRegSnapshot();
+   testMemoryRegEnumeration();
+   testMemoryRegWatch();
+   testMemoryRegHive();
+   testFileRegBackend();
+}
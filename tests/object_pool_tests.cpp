@@ -0,0 +1,266 @@
+//
+// Win32 utilities library
+// Tests for object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "object_pool_tests.h"
+#include "object_pool.h"
+#include "test_util.h"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+struct Payload
+{
+   Payload(int i, double d) : id{i}, val{d} {}
+   ~Payload() { ++destructed; }
+
+   int id = 0;
+   double val = 0.0;
+   inline static int destructed = 0;
+};
+
+
+///////////////////
+
+void testObjectPoolCreate()
+{
+   {
+      const std::string caseLabel{"ObjectPool::create"};
+      ObjectPool<Payload> pool;
+      Payload* obj = pool.create(1, 2.0);
+      VERIFY(obj != nullptr, caseLabel);
+      VERIFY(obj->id == 1, caseLabel);
+      VERIFY(obj->val == 2.0, caseLabel);
+      pool.destroy(obj);
+   }
+   {
+      const std::string caseLabel{"ObjectPool::create for exhausted pool"};
+      constexpr std::size_t objectsPerSlab = 4;
+      ObjectPool<int> pool{objectsPerSlab, 2, 1};
+      std::array<int*, objectsPerSlab> objs;
+      for (std::size_t i = 0; i < objs.size(); ++i)
+         objs[i] = pool.create(static_cast<int>(i));
+      VERIFY(pool.create(100) == nullptr, caseLabel);
+      for (int* obj : objs)
+         pool.destroy(obj);
+   }
+   {
+      const std::string caseLabel{"ObjectPool::create for small objects"};
+      ObjectPool<char> pool;
+      char* a = pool.create('a');
+      char* b = pool.create('b');
+      VERIFY(*a == 'a' && *b == 'b', caseLabel);
+      VERIFY(static_cast<std::size_t>(std::abs(b - a)) >= pool.slotSize(), caseLabel);
+      pool.destroy(a);
+      pool.destroy(b);
+   }
+}
+
+
+void testObjectPoolDestroy()
+{
+   {
+      const std::string caseLabel{"ObjectPool::destroy calls dtor"};
+      ObjectPool<Payload> pool;
+      Payload* obj = pool.create(1, 2.0);
+      const int prevDestructed = Payload::destructed;
+      pool.destroy(obj);
+      VERIFY(Payload::destructed == prevDestructed + 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ObjectPool::destroy reuses memory"};
+      ObjectPool<Payload> pool;
+      Payload* first = pool.create(1, 2.0);
+      pool.destroy(first);
+      Payload* second = pool.create(3, 4.0);
+      VERIFY(first == second, caseLabel);
+      pool.destroy(second);
+   }
+   {
+      const std::string caseLabel{"ObjectPool::destroy for null"};
+      ObjectPool<Payload> pool;
+      pool.destroy(nullptr);
+      VERIFY(pool.stats().frees == 0, caseLabel);
+   }
+}
+
+
+void testObjectPoolStats()
+{
+   {
+      const std::string caseLabel{"ObjectPool::stats"};
+      constexpr std::size_t objectsPerSlab = 16;
+      constexpr std::size_t batchSize = 4;
+      ObjectPool<Payload> pool{objectsPerSlab, batchSize};
+
+      std::vector<Payload*> objs;
+      for (int i = 0; i < 20; ++i)
+         objs.push_back(pool.create(i, 0.0));
+      for (std::size_t i = 0; i < 5; ++i)
+         pool.destroy(objs[i]);
+
+      const ObjectPoolStats stats = pool.stats();
+      VERIFY(stats.slabs == 2, caseLabel);
+      VERIFY(stats.capacity == 2 * objectsPerSlab, caseLabel);
+      VERIFY(stats.allocations == 20, caseLabel);
+      VERIFY(stats.frees == 5, caseLabel);
+      VERIFY(stats.liveObjects() == 15, caseLabel);
+      VERIFY(stats.threadCaches == 1, caseLabel);
+
+      for (std::size_t i = 5; i < objs.size(); ++i)
+         pool.destroy(objs[i]);
+   }
+   {
+      const std::string caseLabel{"ObjectPool::stats for overflowing cache"};
+      constexpr std::size_t batchSize = 4;
+      ObjectPool<Payload> pool{64, batchSize};
+
+      std::vector<Payload*> objs;
+      for (int i = 0; i < 32; ++i)
+         objs.push_back(pool.create(i, 0.0));
+      for (Payload* obj : objs)
+         pool.destroy(obj);
+
+      // Frees beyond two batches get returned to the depot.
+      const ObjectPoolStats stats = pool.stats();
+      VERIFY(stats.depotPushes > 0, caseLabel);
+   }
+}
+
+
+void testObjectPoolThreadExit()
+{
+   {
+      const std::string caseLabel{"ObjectPool returns cache of exited thread to depot"};
+      constexpr std::size_t objectsPerSlab = 64;
+      ObjectPool<Payload> pool{objectsPerSlab, 8};
+
+      std::thread worker{[&pool]() {
+         std::vector<Payload*> objs;
+         for (int i = 0; i < 64; ++i)
+            objs.push_back(pool.create(i, 0.0));
+         for (Payload* obj : objs)
+            pool.destroy(obj);
+      }};
+      worker.join();
+
+      // All objects of the slab should be available to this thread without allocating
+      // another slab.
+      std::vector<Payload*> objs;
+      for (int i = 0; i < 64; ++i)
+         objs.push_back(pool.create(i, 0.0));
+
+      const ObjectPoolStats stats = pool.stats();
+      VERIFY(stats.slabs == 1, caseLabel);
+      VERIFY(stats.depotPops > 0, caseLabel);
+      VERIFY(stats.threadCaches == 1, caseLabel);
+
+      for (Payload* obj : objs)
+         pool.destroy(obj);
+   }
+}
+
+
+void testObjectPoolCrossThreadFrees()
+{
+   {
+      const std::string caseLabel{"ObjectPool with producer and consumer threads"};
+      ObjectPool<Payload> pool{128, 16};
+
+      constexpr std::size_t numObjs = 100000;
+      std::array<std::atomic<Payload*>, 64> mailbox{};
+
+      std::thread producer{[&]() {
+         for (std::size_t i = 0; i < numObjs; ++i)
+         {
+            Payload* obj = pool.create(static_cast<int>(i), 0.0);
+            bool isDelivered = false;
+            while (!isDelivered)
+            {
+               for (auto& slot : mailbox)
+               {
+                  Payload* expected = nullptr;
+                  if (slot.compare_exchange_strong(expected, obj))
+                  {
+                     isDelivered = true;
+                     break;
+                  }
+               }
+            }
+         }
+      }};
+
+      std::thread consumer{[&]() {
+         std::size_t numReceived = 0;
+         while (numReceived < numObjs)
+         {
+            for (auto& slot : mailbox)
+            {
+               Payload* obj = slot.exchange(nullptr);
+               if (obj)
+               {
+                  pool.destroy(obj);
+                  ++numReceived;
+               }
+            }
+         }
+      }};
+
+      producer.join();
+      consumer.join();
+
+      const ObjectPoolStats stats = pool.stats();
+      VERIFY(stats.allocations == numObjs, caseLabel);
+      VERIFY(stats.frees == numObjs, caseLabel);
+      VERIFY(stats.liveObjects() == 0, caseLabel);
+      // Objects freed by the consumer get recycled through the depot, so the pool
+      // should not grow beyond what is in flight.
+      VERIFY(stats.capacity < numObjs / 10, caseLabel);
+   }
+}
+
+
+void testObjectPoolWithSlabMem()
+{
+   {
+      const std::string caseLabel{"ObjectPool with CrtMem slabs"};
+      ObjectPool<Payload, CrtMem> pool;
+      Payload* obj = pool.create(5, 6.0);
+      VERIFY(obj != nullptr && obj->id == 5, caseLabel);
+      pool.destroy(obj);
+   }
+#ifdef _WIN32
+   {
+      const std::string caseLabel{"ObjectPool with GlobalMem slabs"};
+      ObjectPool<Payload, GlobalMem> pool;
+      Payload* obj = pool.create(5, 6.0);
+      VERIFY(obj != nullptr && obj->id == 5, caseLabel);
+      pool.destroy(obj);
+   }
+#endif //_WIN32
+}
+
+} // namespace
+
+
+void testObjectPool()
+{
+   testObjectPoolCreate();
+   testObjectPoolDestroy();
+   testObjectPoolStats();
+   testObjectPoolThreadExit();
+   testObjectPoolCrossThreadFrees();
+   testObjectPoolWithSlabMem();
+}
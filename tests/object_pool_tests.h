@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for object pool.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testObjectPool();
@@ -0,0 +1,227 @@
+//
+// Win32 utilities library
+// Tests for the high-resolution timer.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "precision_timer_tests.h"
+#include "precision_timer.h"
+#include "test_util.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Collects ticks until a given number was received.
+class TickRecorder
+{
+ public:
+   explicit TickRecorder(std::size_t numExpected) : m_numExpected{numExpected} {}
+
+   void record(const PrecisionTimer::Tick& tick);
+   // Returns false on time-out.
+   bool wait(std::chrono::milliseconds timeOut);
+   std::vector<PrecisionTimer::Tick> ticks() const;
+
+ private:
+   mutable std::mutex m_guard;
+   std::condition_variable m_cond;
+   std::vector<PrecisionTimer::Tick> m_ticks;
+   std::size_t m_numExpected = 0;
+};
+
+
+void TickRecorder::record(const PrecisionTimer::Tick& tick)
+{
+   std::scoped_lock lock{m_guard};
+   m_ticks.push_back(tick);
+   if (m_ticks.size() >= m_numExpected)
+      m_cond.notify_all();
+}
+
+
+bool TickRecorder::wait(std::chrono::milliseconds timeOut)
+{
+   std::unique_lock lock{m_guard};
+   return m_cond.wait_for(lock, timeOut,
+                          [this]() { return m_ticks.size() >= m_numExpected; });
+}
+
+
+std::vector<PrecisionTimer::Tick> TickRecorder::ticks() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_ticks;
+}
+
+
+///////////////////
+
+void testPrecisionTimerStart()
+{
+   {
+      const std::string caseLabel{"PrecisionTimer::startOnce"};
+      TickRecorder recorder{1};
+      PrecisionTimer timer{
+         [&](const PrecisionTimer::Tick& tick) { recorder.record(tick); }};
+      const auto started = PrecisionTimer::Clock::now();
+      VERIFY(timer.startOnce(2ms), caseLabel);
+      VERIFY(recorder.wait(5s), caseLabel);
+      const auto ticks = recorder.ticks();
+      VERIFY(ticks.size() == 1, caseLabel);
+      VERIFY(ticks[0].firedAt >= started + 2ms, caseLabel);
+      VERIFY(ticks[0].firedAt >= ticks[0].deadline, caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer::start without callback"};
+      PrecisionTimer timer;
+      VERIFY(!timer.start(1ms), caseLabel);
+      VERIFY(!timer.isRunning(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer::start with invalid period"};
+      PrecisionTimer timer{[](const PrecisionTimer::Tick&) {}};
+      VERIFY(!timer.start(0ms), caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer::stop"};
+      std::atomic<int> numTicks = 0;
+      PrecisionTimer timer{[&](const PrecisionTimer::Tick&) { ++numTicks; }};
+      timer.start(1h);
+      VERIFY(timer.isRunning(), caseLabel);
+      timer.stop();
+      VERIFY(!timer.isRunning(), caseLabel);
+      VERIFY(numTicks == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer::stop from callback"};
+      TickRecorder recorder{1};
+      std::atomic<int> numTicks = 0;
+      PrecisionTimer selfStopping{[&](const PrecisionTimer::Tick& tick)
+                                  {
+                                     ++numTicks;
+                                     selfStopping.stop();
+                                     recorder.record(tick);
+                                  }};
+      selfStopping.start(1ms);
+      VERIFY(recorder.wait(5s), caseLabel);
+      std::this_thread::sleep_for(20ms);
+      VERIFY(numTicks == 1, caseLabel);
+      VERIFY(!selfStopping.isRunning(), caseLabel);
+   }
+}
+
+
+void testPrecisionTimerPeriodic()
+{
+   {
+      const std::string caseLabel{"PrecisionTimer periodic deadlines do not drift"};
+      constexpr std::size_t NumTicks = 50;
+      constexpr auto Period = 2ms;
+      TickRecorder recorder{NumTicks};
+      PrecisionTimer timer{
+         [&](const PrecisionTimer::Tick& tick) { recorder.record(tick); }};
+      timer.start(Period, PrecisionTimer::MissedTicks::CatchUp);
+      VERIFY(recorder.wait(10s), caseLabel);
+      timer.stop();
+
+      const auto ticks = recorder.ticks();
+      bool isOnGrid = true;
+      bool isNotEarly = true;
+      for (std::size_t i = 1; i < ticks.size(); ++i)
+      {
+         isOnGrid = isOnGrid && ticks[i].deadline - ticks[0].deadline == Period * i;
+         isNotEarly = isNotEarly && ticks[i].firedAt >= ticks[i].deadline;
+      }
+      VERIFY(isOnGrid, caseLabel);
+      VERIFY(isNotEarly, caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer jitter"};
+      constexpr std::size_t NumTicks = 100;
+      TickRecorder recorder{NumTicks};
+      PrecisionTimer timer{
+         [&](const PrecisionTimer::Tick& tick) { recorder.record(tick); }};
+      timer.start(1ms);
+      VERIFY(recorder.wait(10s), caseLabel);
+      timer.stop();
+
+      std::vector<PrecisionTimer::Duration> lateness;
+      for (const PrecisionTimer::Tick& tick : recorder.ticks())
+         lateness.push_back(tick.firedAt - tick.deadline);
+      std::sort(lateness.begin(), lateness.end());
+      // Generous bound because test machines can be busy. Timers with a resolution
+      // of a scheduler quantum would fail it.
+      const PrecisionTimer::Duration median = lateness[lateness.size() / 2];
+      VERIFY(median < 5ms, caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer skips missed ticks"};
+      TickRecorder recorder{3};
+      PrecisionTimer timer{[&](const PrecisionTimer::Tick& tick)
+                           {
+                              recorder.record(tick);
+                              if (recorder.ticks().size() == 1)
+                                 std::this_thread::sleep_for(35ms);
+                           }};
+      timer.start(10ms, PrecisionTimer::MissedTicks::Skip);
+      VERIFY(recorder.wait(5s), caseLabel);
+      timer.stop();
+
+      const auto ticks = recorder.ticks();
+      // The second tick was late by more than two periods.
+      VERIFY(ticks[1].deadline - ticks[0].deadline == 10ms, caseLabel);
+      VERIFY(ticks[1].numSkipped >= 2, caseLabel);
+      const auto skippedPeriods = static_cast<int>(ticks[1].numSkipped + 1);
+      VERIFY(ticks[2].deadline - ticks[1].deadline == 10ms * skippedPeriods, caseLabel);
+   }
+   {
+      const std::string caseLabel{"PrecisionTimer catches up with missed ticks"};
+      TickRecorder recorder{4};
+      PrecisionTimer timer{[&](const PrecisionTimer::Tick& tick)
+                           {
+                              recorder.record(tick);
+                              if (recorder.ticks().size() == 1)
+                                 std::this_thread::sleep_for(35ms);
+                           }};
+      timer.start(10ms, PrecisionTimer::MissedTicks::CatchUp);
+      VERIFY(recorder.wait(5s), caseLabel);
+      timer.stop();
+
+      const auto ticks = recorder.ticks();
+      bool isConsecutive = true;
+      for (std::size_t i = 1; i < 4; ++i)
+      {
+         isConsecutive =
+            isConsecutive && ticks[i].deadline - ticks[i - 1].deadline == 10ms &&
+            ticks[i].numSkipped == 0;
+      }
+      VERIFY(isConsecutive, caseLabel);
+      // The missed ticks were fired back to back after the slow callback.
+      VERIFY(ticks[2].firedAt - ticks[1].firedAt < 10ms, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testPrecisionTimer()
+{
+   testPrecisionTimerStart();
+   testPrecisionTimerPeriodic();
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for the high-resolution timer.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testPrecisionTimer();
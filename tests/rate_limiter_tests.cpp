@@ -0,0 +1,271 @@
+//
+// Win32 utilities library
+// Tests for debouncing and throttling.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "rate_limiter_tests.h"
+#include "clock.h"
+#include "rate_limiter.h"
+#include "test_util.h"
+#ifdef _WIN32
+#include "message_util.h"
+#endif
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+void testDebouncer()
+{
+   {
+      const std::string caseLabel{"Debouncer trailing edge"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      for (int i = 1; i <= 5; ++i)
+      {
+         debouncer.trigger(i);
+         clock.advance(3);
+         VERIFY(!debouncer.poll(), caseLabel);
+      }
+      VERIFY(calls.empty(), caseLabel);
+      VERIFY(debouncer.nextDeadline() == 12 + 10, caseLabel);
+
+      clock.set(22);
+      VERIFY(debouncer.poll(), caseLabel);
+      VERIFY(calls == std::vector<int>{5}, caseLabel);
+      VERIFY(!debouncer.isBurstActive(), caseLabel);
+      VERIFY(debouncer.nextDeadline() == Debouncer<int>::NoDeadline, caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer leading edge"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{
+         clock, {10, true, false}, [&](int val) { calls.push_back(val); }};
+
+      debouncer.trigger(1);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+      clock.advance(5);
+      debouncer.trigger(2);
+      clock.advance(10);
+      VERIFY(!debouncer.poll(), caseLabel);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+
+      // Next burst.
+      debouncer.trigger(3);
+      VERIFY((calls == std::vector<int>{1, 3}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer leading and trailing edges"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{
+         clock, {10, true, true}, [&](int val) { calls.push_back(val); }};
+
+      debouncer.trigger(1);
+      clock.advance(10);
+      VERIFY(!debouncer.poll(), caseLabel);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+
+      debouncer.trigger(2);
+      clock.advance(2);
+      debouncer.trigger(3);
+      clock.advance(10);
+      VERIFY(debouncer.poll(), caseLabel);
+      VERIFY((calls == std::vector<int>{1, 2, 3}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer max wait"};
+      ManualClock clock;
+      std::vector<std::uint64_t> callTimes;
+      Debouncer<> debouncer{clock, {10, false, true, 25},
+                            [&](std::monostate) { callTimes.push_back(clock.nowMs()); }};
+
+      // A burst that never pauses long enough.
+      for (int i = 0; i < 30; ++i)
+      {
+         debouncer.trigger();
+         if (clock.nowMs() >= debouncer.nextDeadline())
+            debouncer.poll();
+         clock.advance(2);
+         if (clock.nowMs() >= debouncer.nextDeadline())
+            debouncer.poll();
+      }
+      VERIFY((callTimes == std::vector<std::uint64_t>{26, 52}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer polled late"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      debouncer.trigger(1);
+      clock.advance(50);
+      // Ends the previous burst before starting a new one.
+      debouncer.trigger(2);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+      VERIFY(debouncer.hasPendingEvent(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer::flush"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      VERIFY(!debouncer.flush(), caseLabel);
+      debouncer.trigger(1);
+      VERIFY(debouncer.flush(), caseLabel);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+      clock.advance(10);
+      VERIFY(!debouncer.poll(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Debouncer::cancel"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Debouncer<int> debouncer{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      debouncer.trigger(1);
+      debouncer.cancel();
+      clock.advance(10);
+      VERIFY(!debouncer.poll(), caseLabel);
+      VERIFY(calls.empty(), caseLabel);
+      VERIFY(!debouncer.isBurstActive(), caseLabel);
+   }
+}
+
+
+void testThrottler()
+{
+   {
+      const std::string caseLabel{"Throttler leading and trailing edges"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Throttler<int> throttler{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      throttler.trigger(1);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+      clock.advance(3);
+      throttler.trigger(2);
+      clock.advance(3);
+      throttler.trigger(3);
+      VERIFY(throttler.nextDeadline() == 10, caseLabel);
+
+      clock.set(10);
+      VERIFY(throttler.poll(), caseLabel);
+      VERIFY((calls == std::vector<int>{1, 3}), caseLabel);
+      // The trailing call started a new interval.
+      VERIFY(throttler.isIntervalActive(), caseLabel);
+      VERIFY(throttler.nextDeadline() == 20, caseLabel);
+
+      clock.set(20);
+      VERIFY(!throttler.poll(), caseLabel);
+      VERIFY(!throttler.isIntervalActive(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Throttler bounds the call rate"};
+      ManualClock clock;
+      int numCalls = 0;
+      Throttler<> throttler{clock, {16}, [&](std::monostate) { ++numCalls; }};
+
+      // An event every millisecond for one second.
+      for (int i = 0; i < 1000; ++i)
+      {
+         throttler.trigger();
+         clock.advance(1);
+         if (clock.nowMs() >= throttler.nextDeadline())
+            throttler.poll();
+      }
+      VERIFY(numCalls <= 1000 / 16 + 1, caseLabel);
+      VERIFY(numCalls >= 1000 / 16 - 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"Throttler trailing edge only"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Throttler<int> throttler{
+         clock, {10, false, true}, [&](int val) { calls.push_back(val); }};
+
+      throttler.trigger(1);
+      throttler.trigger(2);
+      VERIFY(calls.empty(), caseLabel);
+      clock.advance(10);
+      VERIFY(throttler.poll(), caseLabel);
+      VERIFY(calls == std::vector<int>{2}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"Throttler leading edge only"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Throttler<int> throttler{
+         clock, {10, true, false}, [&](int val) { calls.push_back(val); }};
+
+      throttler.trigger(1);
+      throttler.trigger(2);
+      clock.advance(10);
+      VERIFY(!throttler.poll(), caseLabel);
+      throttler.trigger(3);
+      VERIFY((calls == std::vector<int>{1, 3}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"Throttler::cancel"};
+      ManualClock clock;
+      std::vector<int> calls;
+      Throttler<int> throttler{clock, {10}, [&](int val) { calls.push_back(val); }};
+
+      throttler.trigger(1);
+      throttler.trigger(2);
+      throttler.cancel();
+      clock.advance(10);
+      VERIFY(!throttler.poll(), caseLabel);
+      VERIFY(calls == std::vector<int>{1}, caseLabel);
+   }
+}
+
+
+#ifdef _WIN32
+void testTimedDebouncer()
+{
+   {
+      const std::string caseLabel{"TimedDebouncer calls back after burst"};
+      bool stopMsgLoop = false;
+      std::vector<int> calls;
+      TimedDebouncer<int> debouncer{{20},
+                                    [&](int val)
+                                    {
+                                       calls.push_back(val);
+                                       stopMsgLoop = true;
+                                    }};
+      for (int i = 1; i <= 5; ++i)
+         debouncer.trigger(i);
+
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+      VERIFY(calls == std::vector<int>{5}, caseLabel);
+      VERIFY(!debouncer.limiter().isBurstActive(), caseLabel);
+   }
+}
+#endif //_WIN32
+
+} // namespace
+
+
+///////////////////
+
+void testRateLimiter()
+{
+   testDebouncer();
+   testThrottler();
+#ifdef _WIN32
+   testTimedDebouncer();
+#endif
+}
@@ -0,0 +1,267 @@
+//
+// Win32 utilities library
+// Tests for batched registry writes.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_batch_tests.h"
+#include "latency_histogram.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "registry_batch.h"
+#include "test_util.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring TestsKeyPath = L"Software\\Projects\\win32_util\\tests";
+
+
+// Applies batches with the default implementation that writes value by value.
+class ValueByValueBackend : public MemoryRegBackend
+{
+ public:
+   bool applyWrites(const std::vector<RegKeyWrites>& writes) override
+   {
+      return RegBackend::applyWrites(writes);
+   }
+};
+
+
+///////////////////
+
+void testRegWriteBatchCoalescing()
+{
+   {
+      const std::string caseLabel{"RegWriteBatch coalesces keys"};
+      MemoryRegBackend backend;
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId a = batch.key(RegCurrentUser, TestsKeyPath + L"\\a");
+      const RegWriteBatch::KeyId b = batch.key(RegCurrentUser, TestsKeyPath + L"\\b");
+      VERIFY(a != b, caseLabel);
+      VERIFY(batch.key(RegCurrentUser, TestsKeyPath + L"\\A") == a, caseLabel);
+      VERIFY(batch.key(RegLocalMachine, TestsKeyPath + L"\\a") != a, caseLabel);
+      VERIFY(batch.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch coalesces writes of the same value"};
+      MemoryRegBackend backend;
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId key = batch.key(RegCurrentUser, TestsKeyPath);
+      batch.writeInt32(key, L"val", 1);
+      batch.writeInt32(key, L"VAL", 2);
+      batch.writeWString(key, L"str", L"text");
+      batch.removeEntry(key, L"str");
+      batch.writeInt64(key, L"removed", 3);
+      batch.removeEntry(key, L"removed");
+      batch.removeEntry(key, L"other");
+      batch.writeWString(key, L"other", L"text");
+      VERIFY(batch.size() == 4, caseLabel);
+
+      VERIFY(batch.commit(), caseLabel);
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      VERIFY(rk.readInt32(L"val") == 2, caseLabel);
+      VERIFY(!rk.readWString(L"str"), caseLabel);
+      VERIFY(!rk.readInt64(L"removed"), caseLabel);
+      VERIFY(rk.readWString(L"other") == L"text", caseLabel);
+      VERIFY(rk.entryNames().size() == 2, caseLabel);
+   }
+}
+
+
+void testRegWriteBatchCommit()
+{
+   {
+      const std::string caseLabel{"RegWriteBatch::commit writes all keys"};
+      MemoryRegBackend backend;
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId a = batch.key(RegCurrentUser, TestsKeyPath + L"\\a");
+      const RegWriteBatch::KeyId b = batch.key(RegCurrentUser, TestsKeyPath + L"\\b");
+      const RegWriteBatch::KeyId empty =
+         batch.key(RegCurrentUser, TestsKeyPath + L"\\empty");
+      const std::vector<unsigned char> bytes{1, 2, 3};
+      batch.writeInt32(a, L"int32", 32);
+      batch.writeBinary(a, L"bin", bytes.data(), bytes.size());
+      batch.writeInt64(b, L"int64", 64);
+
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(batch.empty(), caseLabel);
+      RegKey rka{backend, RegCurrentUser, TestsKeyPath + L"\\a"};
+      RegKey rkb{backend, RegCurrentUser, TestsKeyPath + L"\\b"};
+      VERIFY(rka.readInt32(L"int32") == 32, caseLabel);
+      VERIFY(rkb.readInt64(L"int64") == 64, caseLabel);
+      std::vector<unsigned char> out(3);
+      VERIFY(rka.readBinary(L"bin", [&out](std::size_t) { return out.data(); }) == 3,
+             caseLabel);
+      VERIFY(out == bytes, caseLabel);
+      VERIFY(RegKey::keyExists(backend, RegCurrentUser, TestsKeyPath + L"\\empty"),
+             caseLabel);
+
+      // Ids stay valid after a commit.
+      batch.writeInt32(empty, L"int32", 1);
+      VERIFY(batch.commit(), caseLabel);
+      RegKey rke{backend, RegCurrentUser, TestsKeyPath + L"\\empty"};
+      VERIFY(rke.readInt32(L"int32") == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch::commit applies nothing on failure"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKey readOnly;
+      readOnly.open(backend, RegCurrentUser, TestsKeyPath, RegAccessRead);
+
+      RegWriteBatch batch{backend};
+      batch.writeInt32(batch.key(RegCurrentUser, TestsKeyPath), L"val", 1);
+      // Creating the subkey needs access rights that the parent does not have.
+      batch.writeInt32(batch.key(readOnly.handle(), L"sub"), L"val", 1);
+      const std::uint64_t changeCount = backend.changeCount();
+
+      VERIFY(!batch.commit(), caseLabel);
+      VERIFY(batch.size() == 2, caseLabel);
+      VERIFY(backend.changeCount() == changeCount, caseLabel);
+      VERIFY(!RegKey(backend, RegCurrentUser, TestsKeyPath).readInt32(L"val"),
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch::commit notifies once per key"};
+      MemoryRegBackend backend;
+      RegKey rk{backend, RegCurrentUser, TestsKeyPath};
+      int numChanges = 0;
+      const RegBackend::WatchId id =
+         backend.watchKey(rk.handle(), [&numChanges]() { ++numChanges; });
+
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId key = batch.key(RegCurrentUser, TestsKeyPath);
+      for (int i = 0; i < 10; ++i)
+         batch.writeInt32(key, L"val" + std::to_wstring(i), i);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(numChanges == 1, caseLabel);
+
+      // Removing values that do not exist changes nothing.
+      batch.removeEntry(key, L"missing");
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(numChanges == 1, caseLabel);
+      backend.unwatchKey(id);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch::commit writing value by value"};
+      ValueByValueBackend backend;
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId key = batch.key(RegCurrentUser, TestsKeyPath);
+      batch.writeInt32(key, L"val", 1);
+      batch.removeEntry(key, L"missing");
+
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath).readInt32(L"val") == 1,
+             caseLabel);
+      VERIFY(backend.numOpenHandles() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch::clear"};
+      MemoryRegBackend backend;
+      RegWriteBatch batch{backend};
+      batch.writeInt32(batch.key(RegCurrentUser, TestsKeyPath), L"val", 1);
+      batch.clear();
+
+      VERIFY(batch.empty(), caseLabel);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(!RegKey::keyExists(backend, RegCurrentUser, TestsKeyPath), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegWriteBatch::commit skips committed keys"};
+      MemoryRegBackend backend;
+      RegWriteBatch batch{backend};
+      const RegWriteBatch::KeyId a = batch.key(RegCurrentUser, TestsKeyPath + L"\\a");
+      const RegWriteBatch::KeyId b = batch.key(RegCurrentUser, TestsKeyPath + L"\\b");
+      batch.writeInt32(a, L"val", 1);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath + L"\\a"),
+             caseLabel);
+
+      batch.writeInt32(b, L"val", 2);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(!RegKey::keyExists(backend, RegCurrentUser, TestsKeyPath + L"\\a"),
+             caseLabel);
+      VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath + L"\\b").readInt32(L"val") ==
+                2,
+             caseLabel);
+
+      // Writing to the removed key again creates it.
+      batch.writeInt32(a, L"val", 3);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath + L"\\a").readInt32(L"val") ==
+                3,
+             caseLabel);
+   }
+}
+
+
+void testRegWriteBatchLatency()
+{
+   {
+      const std::string caseLabel{"RegWriteBatch records commit latency"};
+      MemoryRegBackend backend;
+      LatencyHistogram latency;
+      RegWriteBatch batch{backend};
+      batch.setLatencyHistogram(&latency);
+      batch.writeInt32(batch.key(RegCurrentUser, TestsKeyPath), L"val", 1);
+
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(latency.snapshot().count == 2, caseLabel);
+      VERIFY(batch.lastCommitDuration() >= RegWriteBatch::Clock::duration::zero(),
+             caseLabel);
+
+      batch.setLatencyHistogram(nullptr);
+      VERIFY(batch.commit(), caseLabel);
+      VERIFY(latency.snapshot().count == 2, caseLabel);
+   }
+}
+
+
+void testRegWriteBatchFile()
+{
+   {
+      const std::string caseLabel{"RegWriteBatch::commit saves file backends"};
+      const std::filesystem::path path =
+         std::filesystem::temp_directory_path() / "win32_util_batch_tests.hive";
+      std::filesystem::remove(path);
+      {
+         FileRegBackend backend{path};
+         RegWriteBatch batch{backend};
+         batch.writeInt32(batch.key(RegCurrentUser, TestsKeyPath), L"val", 1);
+
+         VERIFY(batch.commit(), caseLabel);
+         VERIFY(!backend.hasUnsavedChanges(), caseLabel);
+         VERIFY(!std::filesystem::exists(path.wstring() + L".tmp"), caseLabel);
+      }
+      {
+         FileRegBackend backend{path};
+         VERIFY(backend.wasLoaded(), caseLabel);
+         VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath).readInt32(L"val") == 1,
+                caseLabel);
+      }
+      std::filesystem::remove(path);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testRegistryBatch()
+{
+   testRegWriteBatchCoalescing();
+   testRegWriteBatchCommit();
+   testRegWriteBatchLatency();
+   testRegWriteBatchFile();
+}
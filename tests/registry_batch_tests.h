@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for batched registry writes.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testRegistryBatch();
@@ -0,0 +1,236 @@
+//
+// Win32 utilities library
+// Tests for the registry value cache.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_cache_tests.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "registry_cache.h"
+#include "test_util.h"
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring TestsKeyPath = L"Software\\Projects\\win32_util\\tests";
+
+
+///////////////////
+
+void testRegCacheReads()
+{
+   {
+      const std::string caseLabel{"RegCache read-through"};
+      MemoryRegBackend backend;
+      RegKey setup{backend, RegCurrentUser, TestsKeyPath};
+      setup.writeInt32(L"int32", 32);
+      setup.writeInt64(L"int64", 64);
+      setup.writeWString(L"str", L"text");
+      const std::vector<unsigned char> bytes{1, 2, 3};
+      setup.writeBinary(L"bin", bytes.data(), bytes.size());
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      VERIFY(cache.isWatched(), caseLabel);
+      for (int i = 0; i < 3; ++i)
+      {
+         VERIFY(cache.readInt32(L"int32") == 32, caseLabel);
+         VERIFY(cache.readInt64(L"int64") == 64, caseLabel);
+         VERIFY(cache.readWString(L"str") == L"text", caseLabel);
+         VERIFY(cache.readBinary(L"bin") == bytes, caseLabel);
+      }
+
+      const RegCache::Stats stats = cache.stats();
+      VERIFY(stats.misses == 4 && stats.hits == 8, caseLabel);
+      VERIFY(stats.hitRate() > 0.66 && stats.hitRate() < 0.67, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache caches missing values"};
+      MemoryRegBackend backend;
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+
+      VERIFY(!cache.readInt32(L"missing"), caseLabel);
+      VERIFY(!cache.readInt32(L"missing"), caseLabel);
+      VERIFY(cache.stats().misses == 1 && cache.stats().hits == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache for values of other type"};
+      MemoryRegBackend backend;
+      RegKey setup{backend, RegCurrentUser, TestsKeyPath};
+      setup.writeInt32(L"int32", 32);
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      VERIFY(!cache.readInt64(L"int32"), caseLabel);
+      VERIFY(!cache.readWString(L"int32"), caseLabel);
+      VERIFY(!cache.readBinary(L"int32"), caseLabel);
+      VERIFY(cache.readInt32(L"INT32") == 32, caseLabel);
+      VERIFY(cache.stats().misses == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache for invalid key"};
+      RegCache cache{RegKey{}};
+      VERIFY(!cache.isWatched(), caseLabel);
+      VERIFY(!cache.readInt32(L"val"), caseLabel);
+      VERIFY(!cache.writeInt32(L"val", 1), caseLabel);
+   }
+}
+
+
+void testRegCacheInvalidation()
+{
+   {
+      const std::string caseLabel{"RegCache invalidates on changes of the key"};
+      MemoryRegBackend backend;
+      RegKey other{backend, RegCurrentUser, TestsKeyPath};
+      other.writeInt32(L"val", 1);
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      VERIFY(cache.readInt32(L"val") == 1, caseLabel);
+
+      other.writeInt32(L"val", 2);
+      VERIFY(cache.readInt32(L"val") == 2, caseLabel);
+      VERIFY(cache.stats().invalidations == 1, caseLabel);
+
+      other.removeEntry(L"val");
+      VERIFY(!cache.readInt32(L"val"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache ignores changes of other keys"};
+      MemoryRegBackend backend;
+      RegKey other{backend, RegCurrentUser, TestsKeyPath + L"\\child"};
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      cache.readInt32(L"val");
+      other.writeInt32(L"val", 1);
+      cache.readInt32(L"val");
+      VERIFY(cache.stats().hits == 1 && cache.stats().invalidations == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache::invalidate"};
+      MemoryRegBackend backend;
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      cache.readInt32(L"val");
+      cache.invalidate();
+      cache.readInt32(L"val");
+      VERIFY(cache.stats().misses == 2, caseLabel);
+   }
+}
+
+
+void testRegCacheWrites()
+{
+   {
+      const std::string caseLabel{"RegCache write-through"};
+      MemoryRegBackend backend;
+      RegKey other{backend, RegCurrentUser, TestsKeyPath};
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath}};
+      VERIFY(cache.writeInt32(L"int32", 1), caseLabel);
+      VERIFY(cache.writeWString(L"str", L"text"), caseLabel);
+      VERIFY(cache.numPendingWrites() == 0, caseLabel);
+      VERIFY(other.readInt32(L"int32") == 1, caseLabel);
+      VERIFY(other.readWString(L"str") == L"text", caseLabel);
+      VERIFY(cache.readInt32(L"int32") == 1, caseLabel);
+      VERIFY(cache.stats().keyWrites == 2, caseLabel);
+
+      VERIFY(cache.removeEntry(L"int32"), caseLabel);
+      VERIFY(!other.readInt32(L"int32"), caseLabel);
+      VERIFY(!cache.readInt32(L"int32"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache write-back"};
+      MemoryRegBackend backend;
+      RegKey other{backend, RegCurrentUser, TestsKeyPath};
+      other.writeInt32(L"removed", 1);
+
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath},
+                     RegCache::WriteMode::WriteBack};
+      cache.writeInt32(L"val", 1);
+      cache.writeInt32(L"VAL", 2);
+      cache.writeInt64(L"int64", 64);
+      cache.removeEntry(L"removed");
+      VERIFY(cache.numPendingWrites() == 3, caseLabel);
+      VERIFY(cache.readInt32(L"val") == 2, caseLabel);
+      VERIFY(!cache.readInt32(L"removed"), caseLabel);
+      VERIFY(!other.readInt32(L"val"), caseLabel);
+      VERIFY(other.readInt32(L"removed") == 1, caseLabel);
+
+      // Pending writes survive changes of the key.
+      other.writeInt32(L"unrelated", 1);
+      VERIFY(cache.readInt32(L"val") == 2, caseLabel);
+
+      VERIFY(cache.flush(), caseLabel);
+      VERIFY(cache.numPendingWrites() == 0, caseLabel);
+      VERIFY(cache.stats().keyWrites == 3, caseLabel);
+      VERIFY(other.readInt32(L"val") == 2, caseLabel);
+      VERIFY(other.readInt64(L"int64") == 64, caseLabel);
+      VERIFY(!other.readInt32(L"removed"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache flushes when destroyed"};
+      MemoryRegBackend backend;
+      {
+         RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath},
+                        RegCache::WriteMode::WriteBack};
+         cache.writeInt32(L"val", 1);
+      }
+      VERIFY(RegKey(backend, RegCurrentUser, TestsKeyPath).readInt32(L"val") == 1,
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache keeps failed writes pending"};
+      MemoryRegBackend backend;
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath},
+                     RegCache::WriteMode::WriteBack};
+      cache.writeInt32(L"val", 1);
+      RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath);
+
+      VERIFY(!cache.flush(), caseLabel);
+      VERIFY(cache.numPendingWrites() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache keeps failed removals pending"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath}.writeInt32(L"val", 1);
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath, RegAccessRead},
+                     RegCache::WriteMode::WriteBack};
+      cache.removeEntry(L"val");
+
+      // No access.
+      VERIFY(!cache.flush(), caseLabel);
+      VERIFY(cache.numPendingWrites() == 1, caseLabel);
+
+      // Removed key.
+      RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath);
+      VERIFY(!cache.flush(), caseLabel);
+      VERIFY(cache.numPendingWrites() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegCache removal of missing value"};
+      MemoryRegBackend backend;
+      RegCache cache{RegKey{backend, RegCurrentUser, TestsKeyPath},
+                     RegCache::WriteMode::WriteBack};
+      cache.removeEntry(L"missing");
+      VERIFY(cache.flush(), caseLabel);
+      VERIFY(cache.numPendingWrites() == 0, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testRegistryCache()
+{
+   testRegCacheReads();
+   testRegCacheInvalidation();
+   testRegCacheWrites();
+}
@@ -0,0 +1,316 @@
+//
+// Win32 utilities library
+// Tests for caching open registry keys.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_key_cache_tests.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "registry_key_cache.h"
+#include "test_util.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring TestsKeyPath = L"Software\\Projects\\win32_util\\tests";
+
+
+// Counts the keys that are opened or created.
+class OpenCountingBackend : public MemoryRegBackend
+{
+ public:
+   RegHandle createKey(RegHandle parent, const std::wstring& keyPath,
+                       RegAccess accessRights, bool* created) override
+   {
+      ++numOpens;
+      return MemoryRegBackend::createKey(parent, keyPath, accessRights, created);
+   }
+
+   RegHandle openKey(RegHandle parent, const std::wstring& keyPath,
+                     RegAccess accessRights) override
+   {
+      ++numOpens;
+      return MemoryRegBackend::openKey(parent, keyPath, accessRights);
+   }
+
+   std::atomic<std::size_t> numOpens = 0;
+};
+
+
+///////////////////
+
+void testRegKeyCacheLookup()
+{
+   {
+      const std::string caseLabel{"RegKeyCache::open reuses open keys"};
+      OpenCountingBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath}.writeInt32(L"val", 1);
+      RegKeyCache cache{backend};
+      backend.numOpens = 0;
+
+      auto key = cache.open(RegCurrentUser, TestsKeyPath);
+      VERIFY(key && key->readInt32(L"val") == 1, caseLabel);
+      for (int i = 0; i < 10; ++i)
+         VERIFY(cache.open(RegCurrentUser, TestsKeyPath) == key, caseLabel);
+      VERIFY(backend.numOpens == 1, caseLabel);
+      VERIFY(cache.stats().hits == 10, caseLabel);
+      VERIFY(cache.stats().misses == 1, caseLabel);
+      VERIFY(cache.stats().hitRate() > 0.9, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache compares paths case-insensitively"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKeyCache cache{backend};
+
+      auto key = cache.open(RegCurrentUser, TestsKeyPath);
+      VERIFY(cache.open(RegCurrentUser, L"SOFTWARE\\projects\\WIN32_UTIL\\tests") == key,
+             caseLabel);
+      VERIFY(cache.size() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache separates parents and access rights"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKey{backend, RegLocalMachine, TestsKeyPath};
+      RegKeyCache cache{backend};
+
+      auto key = cache.open(RegCurrentUser, TestsKeyPath);
+      VERIFY(cache.open(RegLocalMachine, TestsKeyPath) != key, caseLabel);
+      auto readOnly = cache.open(RegCurrentUser, TestsKeyPath, RegAccessRead);
+      VERIFY(readOnly && readOnly != key, caseLabel);
+      VERIFY(!readOnly->writeInt32(L"val", 1), caseLabel);
+      VERIFY(cache.size() == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache::open for missing key"};
+      MemoryRegBackend backend;
+      RegKeyCache cache{backend};
+
+      VERIFY(!cache.open(RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(cache.size() == 0, caseLabel);
+      // Missing keys are not cached.
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      VERIFY(cache.open(RegCurrentUser, TestsKeyPath) != nullptr, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache::create"};
+      OpenCountingBackend backend;
+      RegKeyCache cache{backend};
+
+      auto key = cache.create(RegCurrentUser, TestsKeyPath);
+      VERIFY(key && key->wasCreated(), caseLabel);
+      VERIFY(cache.create(RegCurrentUser, TestsKeyPath) == key, caseLabel);
+      VERIFY(cache.open(RegCurrentUser, TestsKeyPath) == key, caseLabel);
+      VERIFY(backend.numOpens == 1, caseLabel);
+   }
+}
+
+
+void testRegKeyCacheKeyExists()
+{
+   {
+      const std::string caseLabel{"RegKeyCache::keyExists keeps the key open"};
+      OpenCountingBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKeyCache cache{backend};
+      backend.numOpens = 0;
+
+      for (int i = 0; i < 5; ++i)
+         VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(backend.numOpens == 1, caseLabel);
+      VERIFY(!cache.keyExists(RegCurrentUser, TestsKeyPath + L"\\missing"), caseLabel);
+      VERIFY(cache.size() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache::keyExists uses keys with any access"};
+      OpenCountingBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath};
+      RegKeyCache cache{backend};
+      cache.open(RegCurrentUser, TestsKeyPath, RegAccessWrite);
+      backend.numOpens = 0;
+
+      VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(backend.numOpens == 0, caseLabel);
+   }
+}
+
+
+void testRegKeyCacheEviction()
+{
+   {
+      const std::string caseLabel{"RegKeyCache evicts least recently used keys"};
+      MemoryRegBackend backend;
+      for (int i = 0; i < 4; ++i)
+         RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\" + std::to_wstring(i)};
+      RegKeyCache cache{backend, 3};
+      auto path = [](int i) { return TestsKeyPath + L"\\" + std::to_wstring(i); };
+
+      auto key0 = cache.open(RegCurrentUser, path(0));
+      cache.open(RegCurrentUser, path(1));
+      cache.open(RegCurrentUser, path(2));
+      // Makes key 1 the least recently used.
+      cache.open(RegCurrentUser, path(0));
+      cache.open(RegCurrentUser, path(3));
+
+      VERIFY(cache.size() == 3, caseLabel);
+      VERIFY(cache.stats().evictions == 1, caseLabel);
+      cache.resetStats();
+      VERIFY(cache.open(RegCurrentUser, path(0)) == key0, caseLabel);
+      cache.open(RegCurrentUser, path(3));
+      VERIFY(cache.stats().hits == 2, caseLabel);
+      cache.open(RegCurrentUser, path(1));
+      VERIFY(cache.stats().misses == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache limits open handles"};
+      MemoryRegBackend backend;
+      for (int i = 0; i < 20; ++i)
+         RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\" + std::to_wstring(i)};
+      RegKeyCache cache{backend, 5};
+
+      for (int i = 0; i < 20; ++i)
+         cache.open(RegCurrentUser, TestsKeyPath + L"\\" + std::to_wstring(i));
+      VERIFY(cache.size() == 5, caseLabel);
+      VERIFY(backend.numOpenHandles() == 5, caseLabel);
+      cache.clear();
+      VERIFY(backend.numOpenHandles() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache evicted keys stay open while used"};
+      MemoryRegBackend backend;
+      RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\a"}.writeInt32(L"val", 1);
+      RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\b"};
+      RegKeyCache cache{backend, 1};
+
+      auto key = cache.open(RegCurrentUser, TestsKeyPath + L"\\a");
+      cache.open(RegCurrentUser, TestsKeyPath + L"\\b");
+      VERIFY(cache.stats().evictions == 1, caseLabel);
+      VERIFY(backend.numOpenHandles() == 2, caseLabel);
+      VERIFY(key->readInt32(L"val") == 1, caseLabel);
+      key.reset();
+      VERIFY(backend.numOpenHandles() == 1, caseLabel);
+   }
+}
+
+
+void testRegKeyCacheInvalidation()
+{
+   {
+      const std::string caseLabel{"RegKeyCache::removeKey drops the subtree"};
+      MemoryRegBackend backend;
+      RegKeyCache cache{backend};
+      cache.create(RegCurrentUser, TestsKeyPath);
+      cache.create(RegCurrentUser, TestsKeyPath + L"\\sub");
+      cache.create(RegCurrentUser, TestsKeyPath + L"\\sub\\deeper");
+      // Sorts between the key and its subkeys.
+      cache.create(RegCurrentUser, TestsKeyPath + L" other");
+      cache.create(RegCurrentUser, TestsKeyPath + L"_other");
+
+      VERIFY(cache.removeKey(RegCurrentUser, TestsKeyPath + L"\\sub"), caseLabel);
+      VERIFY(cache.size() == 3, caseLabel);
+      VERIFY(!cache.keyExists(RegCurrentUser, TestsKeyPath + L"\\sub"), caseLabel);
+      VERIFY(!cache.keyExists(RegCurrentUser, TestsKeyPath + L"\\sub\\deeper"),
+             caseLabel);
+
+      VERIFY(cache.removeKey(RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(cache.size() == 2, caseLabel);
+      VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath + L" other"), caseLabel);
+      VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath + L"_other"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache::removeKey for empty path"};
+      MemoryRegBackend backend;
+      RegKeyCache cache{backend};
+      const auto parent = cache.create(RegCurrentUser, TestsKeyPath);
+      cache.create(parent->handle(), L"A");
+      cache.create(parent->handle(), L"A\\B");
+      cache.create(parent->handle(), L"C");
+
+      VERIFY(cache.removeKey(parent->handle(), L""), caseLabel);
+      VERIFY(cache.size() == 1, caseLabel);
+      VERIFY(!cache.keyExists(parent->handle(), L"A"), caseLabel);
+      VERIFY(!cache.keyExists(parent->handle(), L"A\\B"), caseLabel);
+      VERIFY(!cache.keyExists(parent->handle(), L"C"), caseLabel);
+      VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath), caseLabel);
+   }
+   {
+      const std::string caseLabel{"RegKeyCache::invalidate"};
+      MemoryRegBackend backend;
+      RegKeyCache cache{backend};
+      cache.create(RegCurrentUser, TestsKeyPath);
+      RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath);
+
+      // Keys removed behind the cache's back stay cached.
+      VERIFY(cache.keyExists(RegCurrentUser, TestsKeyPath), caseLabel);
+      cache.invalidate(RegCurrentUser, TestsKeyPath);
+      VERIFY(!cache.keyExists(RegCurrentUser, TestsKeyPath), caseLabel);
+      VERIFY(backend.numOpenHandles() == 0, caseLabel);
+   }
+}
+
+
+void testRegKeyCacheThreads()
+{
+   {
+      const std::string caseLabel{"RegKeyCache shared by threads"};
+      OpenCountingBackend backend;
+      const int numKeys = 8;
+      for (int i = 0; i < numKeys; ++i)
+         RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\" + std::to_wstring(i)}
+            .writeInt32(L"val", i);
+      RegKeyCache cache{backend, 4};
+
+      std::atomic<int> numFailed = 0;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t)
+      {
+         threads.emplace_back(
+            [&cache, &numFailed, t]()
+            {
+               for (int i = 0; i < 200; ++i)
+               {
+                  const int keyIdx = (i + t) % numKeys;
+                  auto key =
+                     cache.open(RegCurrentUser,
+                                TestsKeyPath + L"\\" + std::to_wstring(keyIdx));
+                  if (!key || key->readInt32(L"val") != keyIdx)
+                     ++numFailed;
+               }
+            });
+      }
+      for (std::thread& th : threads)
+         th.join();
+
+      VERIFY(numFailed == 0, caseLabel);
+      const RegKeyCache::Stats stats = cache.stats();
+      VERIFY(stats.hits + stats.misses == 800, caseLabel);
+      VERIFY(cache.size() <= 4, caseLabel);
+      VERIFY(backend.numOpenHandles() == cache.size(), caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testRegistryKeyCache()
+{
+   testRegKeyCacheLookup();
+   testRegKeyCacheKeyExists();
+   testRegKeyCacheEviction();
+   testRegKeyCacheInvalidation();
+   testRegKeyCacheThreads();
+}
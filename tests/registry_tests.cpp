@@ -7,7 +7,9 @@
 //
 #include "registry_tests.h"
 #include "registry.h"
+#include "alloc_counter.h"
 #include "test_util.h"
+#include <algorithm>
 
 using namespace win32;
 
@@ -567,6 +569,34 @@ void testRegKeyReadInt64()
 }
 
 
+void testRegKeyReadIntNoAlloc()
+{
+   {
+      const std::string caseLabel{"RegKey::readInt32/readInt64 do not allocate"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadIntNoAlloc";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName32 = L"Int32";
+      const std::wstring entryName64 = L"Int64";
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeInt32(entryName32, 42);
+         setup.writeInt64(entryName64, 42);
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      std::optional<int32_t> res32;
+      std::optional<int64_t> res64;
+      EXPECT_NO_ALLOC(res32 = rk.readInt32(entryName32), caseLabel);
+      EXPECT_NO_ALLOC(res64 = rk.readInt64(entryName64), caseLabel);
+      VERIFY(res32.value_or(0) == 42, caseLabel);
+      VERIFY(res64.value_or(0) == 42, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+}
+
+
 void testRegKeyReadString()
 {
    {
@@ -619,6 +649,25 @@ void testRegKeyReadString()
 
       deleteKey(HKEY_CURRENT_USER, keyPath);
    }
+   {
+      const std::string caseLabel{"RegKey::readString for long value"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadString";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName = L"String";
+      const std::string val(1000, 'a');
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeString(entryName, val);
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const std::optional<std::string> res = rk.readString(entryName);
+      VERIFY(res.has_value(), caseLabel);
+      VERIFY(res.value() == val, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
    {
       const std::string caseLabel{"RegKey::readString for value of other type"};
       const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadString";
@@ -691,6 +740,25 @@ void testRegKeyReadWString()
 
       deleteKey(HKEY_CURRENT_USER, keyPath);
    }
+   {
+      const std::string caseLabel{"RegKey::readWString for long value"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadWString";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName = L"String";
+      const std::wstring val(1000, L'a');
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeWString(entryName, val);
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const std::optional<std::wstring> res = rk.readWString(entryName);
+      VERIFY(res.has_value(), caseLabel);
+      VERIFY(res.value() == val, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
    {
       const std::string caseLabel{"RegKey::readWString for value of other type"};
       const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadWString";
@@ -805,6 +873,31 @@ void testRegKeyReadBinary()
 
       deleteKey(HKEY_CURRENT_USER, keyPath);
    }
+   {
+      const std::string caseLabel{"RegKey::readBinary for large value"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadBinary";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName = L"Bin";
+      const std::vector<BYTE> val(1000, 7);
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeBinary(entryName, val.data(), val.size());
+      }
+
+      std::vector<BYTE> outBuffer;
+      auto getOutBuffer = [&outBuffer](size_t numBytes) -> BYTE* {
+         outBuffer.resize(numBytes);
+         return outBuffer.data();
+      };
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const size_t bytesRead = rk.readBinary(entryName, getOutBuffer);
+      VERIFY(bytesRead == val.size(), caseLabel);
+      VERIFY(outBuffer == val, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
    {
       const std::string caseLabel{"RegKey::readBinary for value of other type"};
       const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadBinary";
@@ -832,6 +925,64 @@ void testRegKeyReadBinary()
 }
 
 
+void testRegKeyReadIntoBuffer()
+{
+   {
+      const std::string caseLabel{"RegKey::readWString into caller buffer"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadIntoBuffer";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName = L"String";
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeWString(entryName, L"test");
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      wchar_t buffer[8];
+      std::size_t requiredLength = 0;
+      std::optional<std::wstring_view> res;
+      EXPECT_NO_ALLOC(res = rk.readWString(entryName, buffer, &requiredLength),
+                      caseLabel);
+      VERIFY(res == L"test", caseLabel);
+      VERIFY(res->data() == buffer, caseLabel);
+
+      wchar_t smallBuffer[2];
+      VERIFY(!rk.readWString(entryName, smallBuffer, &requiredLength), caseLabel);
+      VERIFY(requiredLength == 5, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+   {
+      const std::string caseLabel{"RegKey::readBinary into caller buffer"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadIntoBuffer";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring entryName = L"Bin";
+      const std::vector<BYTE> val{1, 2, 3, 4, 5, 6};
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeBinary(entryName, val.data(), val.size());
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      BYTE buffer[8];
+      std::size_t requiredBytes = 0;
+      std::optional<std::span<BYTE>> res;
+      EXPECT_NO_ALLOC(res = rk.readBinary(entryName, buffer, &requiredBytes),
+                      caseLabel);
+      VERIFY(res && res->size() == val.size(), caseLabel);
+      VERIFY(std::equal(val.begin(), val.end(), buffer), caseLabel);
+
+      BYTE smallBuffer[2];
+      VERIFY(!rk.readBinary(entryName, smallBuffer, &requiredBytes), caseLabel);
+      VERIFY(requiredBytes == val.size(), caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+}
+
+
 void testRegKeyWriteInt32()
 {
    {
@@ -1215,6 +1366,142 @@ void testRegKeyEntryNames()
    }
 }
 
+
+void testRegKeySubkeys()
+{
+   {
+      const std::string caseLabel{"RegKey::subkeys for multiple subkeys"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeySubkeys";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::vector<std::wstring> subkeys{L"sub1", L"sub2", L"sub3"};
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         for (const std::wstring& keyName : subkeys)
+         {
+            RegKey subkey;
+            subkey.create(setup, keyName);
+         }
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      std::vector<std::wstring> res;
+      for (std::wstring_view name : rk.subkeys())
+         res.emplace_back(name);
+      VERIFY(res == subkeys, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+   {
+      const std::string caseLabel{"RegKey::subkeys for no subkeys"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeySubkeys";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const RegSubkeyRange range = rk.subkeys();
+      VERIFY(range.begin() == range.end(), caseLabel);
+      VERIFY(!range.begin().hasFailed(), caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+}
+
+
+void testRegKeyEntries()
+{
+   {
+      const std::string caseLabel{"RegKey::entries for multiple entries"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyEntries";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring longName(1000, L'a');
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeInt32(L"Int32", 1);
+         setup.writeWString(L"String", L"test");
+         setup.writeInt64(longName, 1);
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      std::vector<std::wstring> names;
+      std::size_t numBytes = 0;
+      for (const RegEntryInfo& entry : rk.entries())
+      {
+         names.emplace_back(entry.name);
+         numBytes += entry.numBytes;
+      }
+      VERIFY(names.size() == 3, caseLabel);
+      VERIFY(std::find(names.begin(), names.end(), longName) != names.end(), caseLabel);
+      VERIFY(numBytes == 4 + 5 * sizeof(wchar_t) + 8, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+   {
+      const std::string caseLabel{"RegKey::entries stops early"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyEntries";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         for (int i = 0; i < 10; ++i)
+            setup.writeInt32(L"Entry" + std::to_wstring(i), i);
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const RegEntryRange range = rk.entries();
+      auto it = range.begin();
+      VERIFY(it != range.end(), caseLabel);
+      VERIFY((*it).type == RegValueType::Dword && (*it).numBytes == 4, caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+}
+
+
+void testRegKeyReadAll()
+{
+   {
+      const std::string caseLabel{"RegKey::readAll"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadAll";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      const std::wstring longStr(1000, L'a');
+      {
+         RegKey setup{HKEY_CURRENT_USER, keyPath};
+         setup.writeInt32(L"Int32", 32);
+         setup.writeInt64(L"Int64", 64);
+         setup.writeWString(L"String", L"test");
+         setup.writeWString(L"Long", longStr);
+         const std::vector<BYTE> bin{1, 2, 3};
+         setup.writeBinary(L"Bin", bin.data(), bin.size());
+      }
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const std::optional<RegSnapshot> res = rk.readAll();
+      VERIFY(res.has_value(), caseLabel);
+      VERIFY(res->size() == 5, caseLabel);
+      VERIFY(res->find(L"int32")->toInt32() == 32, caseLabel);
+      VERIFY(res->find(L"Int64")->toInt64() == 64, caseLabel);
+      VERIFY(res->find(L"String")->toWString() == L"test", caseLabel);
+      VERIFY(res->find(L"Long")->toWString() == longStr, caseLabel);
+      VERIFY(res->find(L"Bin")->data().size() == 3, caseLabel);
+      VERIFY(!res->find(L"Other"), caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+   {
+      const std::string caseLabel{"RegKey::readAll for no entries"};
+      const std::wstring keyPath = TestsKeyPath + L"\\RegKeyReadAll";
+      createKey(HKEY_CURRENT_USER, keyPath);
+
+      RegKey rk{HKEY_CURRENT_USER, keyPath};
+      const std::optional<RegSnapshot> res = rk.readAll();
+      VERIFY(res.has_value() && res->empty(), caseLabel);
+
+      deleteKey(HKEY_CURRENT_USER, keyPath);
+   }
+}
+
 } // namespace
 
 
@@ -1239,9 +1526,11 @@ void testRegistry()
    testRegKeyRemoveKey();
    testRegKeyReadInt32();
    testRegKeyReadInt64();
+   testRegKeyReadIntNoAlloc();
    testRegKeyReadString();
    testRegKeyReadWString();
    testRegKeyReadBinary();
+   testRegKeyReadIntoBuffer();
    testRegKeyWriteInt32();
    testRegKeyWriteInt64();
    testRegKeyWriteString();
@@ -1252,4 +1541,7 @@ void testRegistry()
    testRegKeySubkeyNames();
    testRegKeyCountEntries();
    testRegKeyEntryNames();
+   testRegKeySubkeys();
+   testRegKeyEntries();
+   testRegKeyReadAll();
 }
@@ -0,0 +1,330 @@
+//
+// Win32 utilities library
+// Tests for registry tree traversal.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "registry_walker_tests.h"
+#include "memory_registry.h"
+#include "registry.h"
+#include "registry_walker.h"
+#include "test_util.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+const std::wstring TestsKeyPath = L"Software\\Projects\\win32_util\\tests";
+
+
+// Records the visited keys.
+class RecordingVisitor : public RegWalkVisitor
+{
+ public:
+   std::function<bool(const std::wstring&)> descend = [](const std::wstring&)
+   { return true; };
+   std::chrono::milliseconds delay{0};
+
+   bool visitKey(const RegKey& /*key*/, const std::wstring& path,
+                 std::size_t depth) override
+   {
+      if (delay.count() > 0)
+         std::this_thread::sleep_for(delay);
+
+      std::scoped_lock lock{m_guard};
+      m_paths.push_back(path);
+      m_depths.push_back(depth);
+      m_threads.insert(std::this_thread::get_id());
+      return descend(path);
+   }
+
+   void visitEntry(const RegKey& /*key*/, const std::wstring& path,
+                   const RegEntryInfo& entry) override
+   {
+      std::scoped_lock lock{m_guard};
+      m_entries.push_back(path + L':' + std::wstring{entry.name});
+   }
+
+   const std::vector<std::wstring>& paths() const { return m_paths; }
+   const std::vector<std::size_t>& depths() const { return m_depths; }
+   const std::vector<std::wstring>& entries() const { return m_entries; }
+   std::size_t numThreads() const { return m_threads.size(); }
+
+ private:
+   std::mutex m_guard;
+   std::vector<std::wstring> m_paths;
+   std::vector<std::size_t> m_depths;
+   std::vector<std::wstring> m_entries;
+   std::set<std::thread::id> m_threads;
+};
+
+
+// Creates the tree
+//   tests: val
+//   tests\a: int32, str
+//   tests\a\x
+//   tests\a\y: bin
+//   tests\b
+//   tests\b\z: int64
+void makeSmallTree(MemoryRegBackend& backend)
+{
+   RegKey{backend, RegCurrentUser, TestsKeyPath}.writeInt32(L"val", 1);
+   RegKey a{backend, RegCurrentUser, TestsKeyPath + L"\\a"};
+   a.writeInt32(L"int32", 2);
+   a.writeWString(L"str", L"abc");
+   RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\a\\x"};
+   const unsigned char bytes[]{1, 2, 3, 4, 5};
+   RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\a\\y"}.writeBinary(L"bin", bytes,
+                                                                        sizeof(bytes));
+   RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\b"};
+   RegKey{backend, RegCurrentUser, TestsKeyPath + L"\\b\\z"}.writeInt64(L"int64", 3);
+}
+
+
+// Creates a tree with the given number of subkeys per key and two values per key.
+void makeWideTree(MemoryRegBackend& backend, const std::wstring& keyPath,
+                  std::size_t numSubkeys, std::size_t depth)
+{
+   RegKey key{backend, RegCurrentUser, keyPath};
+   key.writeInt32(L"int32", 1);
+   key.writeWString(L"str", keyPath);
+   if (depth == 0)
+      return;
+
+   for (std::size_t i = 0; i < numSubkeys; ++i)
+      makeWideTree(backend, keyPath + L"\\key" + std::to_wstring(i), numSubkeys,
+                   depth - 1);
+}
+
+
+///////////////////
+
+void testWalkRegistryOrder()
+{
+   {
+      const std::string caseLabel{"walkRegistry depth-first"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(stats.has_value(), caseLabel);
+      const std::vector<std::wstring> expected{L"",   L"a",    L"a\\x",
+                                               L"a\\y", L"b", L"b\\z"};
+      VERIFY(visitor.paths() == expected, caseLabel);
+      VERIFY((visitor.depths() == std::vector<std::size_t>{0, 1, 2, 2, 1, 2}),
+             caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry breadth-first"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+      RegWalkOptions options;
+      options.order = RegWalkOrder::BreadthFirst;
+
+      const auto stats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+      VERIFY(stats.has_value(), caseLabel);
+      const std::vector<std::wstring> expected{L"",     L"a",    L"b",
+                                               L"a\\x", L"a\\y", L"b\\z"};
+      VERIFY(visitor.paths() == expected, caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry visits entries"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(stats.has_value(), caseLabel);
+      const std::vector<std::wstring> expected{L":val", L"a:int32", L"a:str",
+                                               L"a\\y:bin", L"b\\z:int64"};
+      VERIFY(visitor.entries() == expected, caseLabel);
+   }
+}
+
+
+void testWalkRegistryPruning()
+{
+   {
+      const std::string caseLabel{"walkRegistry with max depth"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+      RegWalkOptions options;
+      options.maxDepth = 1;
+
+      const auto stats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY((visitor.paths() == std::vector<std::wstring>{L"", L"a", L"b"}),
+             caseLabel);
+      VERIFY(stats->numKeys == 3, caseLabel);
+      // Entries of keys at the max depth are visited.
+      VERIFY(stats->numEntries == 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry skips subtrees rejected by visitor"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+      visitor.descend = [](const std::wstring& path) { return path != L"a"; };
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY((visitor.paths() == std::vector<std::wstring>{L"", L"a", L"b", L"b\\z"}),
+             caseLabel);
+   }
+}
+
+
+void testWalkRegistryStats()
+{
+   {
+      const std::string caseLabel{"walkRegistry stats"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY(stats->numKeys == 6, caseLabel);
+      VERIFY(stats->numEntries == 5, caseLabel);
+      VERIFY(stats->numEntryBytes == 4 + 4 + 4 * sizeof(wchar_t) + 5 + 8, caseLabel);
+      VERIFY(stats->numFailedKeys == 0, caseLabel);
+      VERIFY(stats->numStolenKeys == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry counts keys that fail to open"};
+      MemoryRegBackend backend;
+      makeSmallTree(backend);
+      RecordingVisitor visitor;
+      // Key 'b' is enumerated with the root and removed before it is opened.
+      visitor.descend = [&backend](const std::wstring& path)
+      {
+         if (path == L"a")
+            RegKey::removeKey(backend, RegCurrentUser, TestsKeyPath + L"\\b");
+         return true;
+      };
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY(stats->numKeys == 4, caseLabel);
+      VERIFY(stats->numFailedKeys == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry for missing root"};
+      MemoryRegBackend backend;
+      RecordingVisitor visitor;
+
+      const auto stats = walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor);
+      VERIFY(!stats.has_value(), caseLabel);
+      VERIFY(visitor.paths().empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry closes all keys"};
+      MemoryRegBackend backend;
+      makeWideTree(backend, TestsKeyPath, 3, 3);
+      RecordingVisitor visitor;
+      RegWalkOptions options;
+      options.numThreads = 4;
+
+      const auto stats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY(backend.numOpenHandles() == 0, caseLabel);
+   }
+}
+
+
+void testWalkRegistryParallel()
+{
+   {
+      const std::string caseLabel{"walkRegistry on multiple threads visits all keys"};
+      MemoryRegBackend backend;
+      makeWideTree(backend, TestsKeyPath, 6, 3);
+
+      RecordingVisitor serialVisitor;
+      const auto serialStats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, serialVisitor);
+
+      for (RegWalkOrder order : {RegWalkOrder::DepthFirst, RegWalkOrder::BreadthFirst})
+      {
+         RecordingVisitor visitor;
+         RegWalkOptions options;
+         options.order = order;
+         options.numThreads = 4;
+         const auto stats =
+            walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+
+         VERIFY(stats.has_value() && serialStats.has_value(), caseLabel);
+         VERIFY(stats->numKeys == 1 + 6 + 36 + 216, caseLabel);
+         VERIFY(stats->numKeys == serialStats->numKeys, caseLabel);
+         VERIFY(stats->numEntries == serialStats->numEntries, caseLabel);
+         VERIFY(stats->numEntryBytes == serialStats->numEntryBytes, caseLabel);
+         VERIFY(stats->numFailedKeys == 0, caseLabel);
+
+         std::vector<std::wstring> paths = visitor.paths();
+         std::vector<std::wstring> serialPaths = serialVisitor.paths();
+         std::sort(paths.begin(), paths.end());
+         std::sort(serialPaths.begin(), serialPaths.end());
+         VERIFY(paths == serialPaths, caseLabel);
+      }
+   }
+   {
+      const std::string caseLabel{"walkRegistry steals subtrees for idle threads"};
+      MemoryRegBackend backend;
+      makeWideTree(backend, TestsKeyPath, 4, 2);
+      RecordingVisitor visitor;
+      // Slow visits keep the first thread busy while the others steal.
+      visitor.delay = std::chrono::milliseconds{1};
+      RegWalkOptions options;
+      options.numThreads = 4;
+
+      const auto stats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY(stats->numKeys == 1 + 4 + 16, caseLabel);
+      VERIFY(stats->numStolenKeys > 0, caseLabel);
+      VERIFY(visitor.numThreads() > 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"walkRegistry with one thread per core"};
+      MemoryRegBackend backend;
+      makeWideTree(backend, TestsKeyPath, 3, 2);
+      RecordingVisitor visitor;
+      RegWalkOptions options;
+      options.numThreads = 0;
+
+      const auto stats =
+         walkRegistry(backend, RegCurrentUser, TestsKeyPath, visitor, options);
+      VERIFY(stats.has_value(), caseLabel);
+      VERIFY(stats->numKeys == 1 + 3 + 9, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testRegistryWalker()
+{
+   testWalkRegistryOrder();
+   testWalkRegistryPruning();
+   testWalkRegistryStats();
+   testWalkRegistryParallel();
+}
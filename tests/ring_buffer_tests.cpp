@@ -0,0 +1,252 @@
+//
+// Win32 utilities library
+// Tests for ring buffers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "ring_buffer_tests.h"
+#include "ring_buffer.h"
+#include "test_util.h"
+#include <array>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+std::span<const std::byte> asBytes(const std::string& s)
+{
+   return std::as_bytes(std::span<const char>{s.data(), s.size()});
+}
+
+
+std::string asString(std::span<const std::byte> bytes)
+{
+   return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+
+///////////////////
+
+void testMirroredMem()
+{
+   {
+      const std::string caseLabel{"MirroredMem::allocate"};
+      MirroredMem mem;
+      VERIFY(mem.allocate(1), caseLabel);
+      VERIFY(mem.operator bool(), caseLabel);
+      VERIFY(mem.size() == MirroredMem::granularity(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"MirroredMem mirrors content"};
+      MirroredMem mem;
+      mem.allocate(MirroredMem::granularity());
+      mem.data()[0] = std::byte{1};
+      VERIFY(mem.data()[mem.size()] == std::byte{1}, caseLabel);
+      mem.data()[2 * mem.size() - 1] = std::byte{2};
+      VERIFY(mem.data()[mem.size() - 1] == std::byte{2}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"MirroredMem move ctor"};
+      MirroredMem src;
+      src.allocate(1);
+      const std::byte* data = src.data();
+      MirroredMem dest{std::move(src)};
+      VERIFY(dest.data() == data, caseLabel);
+      VERIFY(!src, caseLabel);
+   }
+}
+
+
+void testSpscRingBuffer()
+{
+   {
+      const std::string caseLabel{"SpscRingBuffer ctor"};
+      SpscRingBuffer rb{1000};
+      VERIFY(rb.operator bool(), caseLabel);
+      VERIFY(rb.capacity() >= 1000, caseLabel);
+      VERIFY((rb.capacity() & (rb.capacity() - 1)) == 0, caseLabel);
+      VERIFY(rb.readableSize() == 0, caseLabel);
+      VERIFY(rb.beginRead().empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer write and read"};
+      SpscRingBuffer rb{1000};
+      VERIFY(rb.write(asBytes("hello")), caseLabel);
+      VERIFY(rb.write(asBytes(" world")), caseLabel);
+      VERIFY(rb.readableSize() == 11, caseLabel);
+      VERIFY(asString(rb.beginRead()) == "hello world", caseLabel);
+      rb.endRead(6);
+      VERIFY(asString(rb.beginRead()) == "world", caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer ranges across the end are contiguous"};
+      SpscRingBuffer rb{1};
+      const std::size_t capacity = rb.capacity();
+      rb.beginWrite(capacity - 3);
+      rb.endWrite(capacity - 3);
+      rb.endRead(capacity - 3);
+
+      const std::span<std::byte> dest = rb.beginWrite(8);
+      VERIFY(dest.size() == 8, caseLabel);
+      std::memcpy(dest.data(), "abcdefgh", 8);
+      rb.endWrite(8);
+      VERIFY(asString(rb.beginRead()) == "abcdefgh", caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer full buffer"};
+      SpscRingBuffer rb{1};
+      const std::size_t capacity = rb.capacity();
+      VERIFY(!rb.beginWrite(capacity).empty(), caseLabel);
+      rb.endWrite(capacity);
+      VERIFY(rb.beginWrite(1).empty(), caseLabel);
+      VERIFY(!rb.write(asBytes("x")), caseLabel);
+      rb.endRead(1);
+      VERIFY(rb.write(asBytes("x")), caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer partial commit"};
+      SpscRingBuffer rb{1};
+      const std::span<std::byte> dest = rb.beginWrite(10);
+      std::memcpy(dest.data(), "abc", 3);
+      rb.endWrite(3);
+      VERIFY(asString(rb.beginRead()) == "abc", caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer::read"};
+      SpscRingBuffer rb{1};
+      rb.write(asBytes("abcdef"));
+      std::array<std::byte, 4> dest;
+      VERIFY(rb.read(dest) == 4, caseLabel);
+      VERIFY(asString(dest) == "abcd", caseLabel);
+      VERIFY(rb.read(dest) == 2, caseLabel);
+      VERIFY(rb.read(dest) == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"SpscRingBuffer with producer and consumer threads"};
+      SpscRingBuffer rb{1};
+      constexpr std::uint32_t numValues = 1000000;
+
+      std::thread producer{[&rb]() {
+         for (std::uint32_t i = 0; i < numValues;)
+         {
+            const std::span<std::byte> dest = rb.beginWrite(sizeof(i));
+            if (!dest.empty())
+            {
+               std::memcpy(dest.data(), &i, sizeof(i));
+               rb.endWrite(sizeof(i));
+               ++i;
+            }
+         }
+      }};
+
+      bool isInOrder = true;
+      for (std::uint32_t expected = 0; expected < numValues;)
+      {
+         const std::span<const std::byte> src = rb.beginRead();
+         const std::size_t numRead = src.size() / sizeof(std::uint32_t);
+         for (std::size_t i = 0; i < numRead; ++i)
+         {
+            std::uint32_t val = 0;
+            std::memcpy(&val, src.data() + i * sizeof(val), sizeof(val));
+            isInOrder = isInOrder && (val == expected);
+            ++expected;
+         }
+         rb.endRead(numRead * sizeof(std::uint32_t));
+      }
+      producer.join();
+
+      VERIFY(isInOrder, caseLabel);
+      VERIFY(rb.readableSize() == 0, caseLabel);
+   }
+}
+
+
+void testMpscRingBuffer()
+{
+   {
+      const std::string caseLabel{"MpscRingBuffer reservations"};
+      MpscRingBuffer rb{1};
+      const RingReservation first = rb.beginWrite(3);
+      const RingReservation second = rb.beginWrite(3);
+      VERIFY(first && second, caseLabel);
+      VERIFY(second.pos == first.pos + 3, caseLabel);
+      std::memcpy(first.data.data(), "abc", 3);
+      std::memcpy(second.data.data(), "def", 3);
+      rb.endWrite(first);
+      VERIFY(asString(rb.beginRead()) == "abc", caseLabel);
+      rb.endWrite(second);
+      VERIFY(asString(rb.beginRead()) == "abcdef", caseLabel);
+   }
+   {
+      const std::string caseLabel{"MpscRingBuffer full buffer"};
+      MpscRingBuffer rb{1};
+      VERIFY(rb.beginWrite(rb.capacity() + 1).data.empty(), caseLabel);
+      const RingReservation all = rb.beginWrite(rb.capacity());
+      VERIFY(all.data.size() == rb.capacity(), caseLabel);
+      VERIFY(!rb.beginWrite(1), caseLabel);
+      rb.endWrite(all);
+   }
+   {
+      const std::string caseLabel{"MpscRingBuffer with multiple producer threads"};
+      MpscRingBuffer rb{1};
+      constexpr std::uint32_t numProducers = 4;
+      constexpr std::uint32_t numValues = 100000;
+
+      // Each record holds the producer index and a running number.
+      std::vector<std::thread> producers;
+      for (std::uint32_t p = 0; p < numProducers; ++p)
+      {
+         producers.emplace_back([&rb, p]() {
+            for (std::uint32_t i = 0; i < numValues;)
+            {
+               const std::array<std::uint32_t, 2> record{p, i};
+               if (rb.write(std::as_bytes(std::span{record})))
+                  ++i;
+            }
+         });
+      }
+
+      std::array<std::uint32_t, numProducers> expected{};
+      bool isInOrder = true;
+      constexpr std::size_t recordSize = 2 * sizeof(std::uint32_t);
+      for (std::uint32_t numReceived = 0; numReceived < numProducers * numValues;)
+      {
+         const std::span<const std::byte> src = rb.beginRead();
+         const std::size_t numRecords = src.size() / recordSize;
+         for (std::size_t i = 0; i < numRecords; ++i)
+         {
+            std::array<std::uint32_t, 2> record;
+            std::memcpy(record.data(), src.data() + i * recordSize, recordSize);
+            isInOrder = isInOrder && record[0] < numProducers &&
+                        record[1] == expected[record[0]]++;
+            ++numReceived;
+         }
+         rb.endRead(numRecords * recordSize);
+      }
+      for (auto& th : producers)
+         th.join();
+
+      VERIFY(isInOrder, caseLabel);
+      VERIFY(rb.readableSize() == 0, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testRingBuffer()
+{
+   testMirroredMem();
+   testSpscRingBuffer();
+   testMpscRingBuffer();
+}
@@ -0,0 +1,240 @@
+//
+// Win32 utilities library
+// Tests for the virtual time scheduler.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "simulated_scheduler_tests.h"
+#include "rate_limiter.h"
+#include "simulated_scheduler.h"
+#include "test_util.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Records ids and virtual times of expirations.
+struct Expiration
+{
+   SimulatedScheduler::TimerId id = 0;
+   std::uint64_t time = 0;
+
+   friend bool operator==(const Expiration& a, const Expiration& b)
+   {
+      return a.id == b.id && a.time == b.time;
+   }
+};
+
+
+///////////////////
+
+void testSimulatedSchedulerStart()
+{
+   {
+      const std::string caseLabel{"SimulatedScheduler::start one-shot timer"};
+      SimulatedScheduler scheduler{100};
+      std::vector<Expiration> expirations;
+      const auto id = scheduler.start(
+         10, [&](SimulatedScheduler::TimerId id)
+         { expirations.push_back({id, scheduler.clock().nowMs()}); });
+      VERIFY(id != 0, caseLabel);
+      VERIFY(scheduler.nextDueTime() == 110, caseLabel);
+
+      VERIFY(scheduler.advanceBy(9) == 0, caseLabel);
+      VERIFY(scheduler.now() == 109, caseLabel);
+      VERIFY(scheduler.advanceBy(1) == 1, caseLabel);
+      VERIFY((expirations == std::vector<Expiration>{{id, 110}}), caseLabel);
+      VERIFY(!scheduler.isActive(id), caseLabel);
+      VERIFY(scheduler.empty(), caseLabel);
+      VERIFY(scheduler.nextDueTime() == SimulatedScheduler::NoDueTime, caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler::start without callback"};
+      SimulatedScheduler scheduler;
+      VERIFY(scheduler.start(10, nullptr) == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler periodic timer"};
+      SimulatedScheduler scheduler;
+      std::vector<Expiration> expirations;
+      const auto id = scheduler.start(
+         5, [&](SimulatedScheduler::TimerId id)
+         { expirations.push_back({id, scheduler.now()}); }, 10);
+
+      VERIFY(scheduler.advanceTo(40) == 4, caseLabel);
+      const std::vector<Expiration> expected{{id, 5}, {id, 15}, {id, 25}, {id, 35}};
+      VERIFY(expirations == expected, caseLabel);
+      VERIFY(scheduler.now() == 40, caseLabel);
+      VERIFY(scheduler.nextDueTime() == 45, caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler::advanceToNext"};
+      SimulatedScheduler scheduler;
+      int numCalls = 0;
+      scheduler.start(30, [&](SimulatedScheduler::TimerId) { ++numCalls; });
+      scheduler.start(30, [&](SimulatedScheduler::TimerId) { ++numCalls; });
+      scheduler.start(50, [&](SimulatedScheduler::TimerId) { ++numCalls; });
+
+      VERIFY(scheduler.advanceToNext() == 2, caseLabel);
+      VERIFY(scheduler.now() == 30, caseLabel);
+      VERIFY(scheduler.advanceToNext() == 1, caseLabel);
+      VERIFY(scheduler.now() == 50, caseLabel);
+      VERIFY(scheduler.advanceToNext() == 0, caseLabel);
+      VERIFY(numCalls == 3, caseLabel);
+   }
+}
+
+
+void testSimulatedSchedulerOrdering()
+{
+   {
+      const std::string caseLabel{"SimulatedScheduler expiration order"};
+      SimulatedScheduler scheduler;
+      std::vector<int> order;
+      scheduler.start(20, [&](SimulatedScheduler::TimerId) { order.push_back(1); });
+      scheduler.start(10, [&](SimulatedScheduler::TimerId) { order.push_back(2); });
+      scheduler.start(20, [&](SimulatedScheduler::TimerId) { order.push_back(3); });
+      scheduler.start(10, [&](SimulatedScheduler::TimerId) { order.push_back(4); });
+
+      scheduler.advanceBy(100);
+      VERIFY((order == std::vector<int>{2, 4, 1, 3}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler timers started from callbacks"};
+      SimulatedScheduler scheduler;
+      std::vector<std::uint64_t> times;
+      scheduler.start(10,
+                      [&](SimulatedScheduler::TimerId)
+                      {
+                         times.push_back(scheduler.now());
+                         scheduler.start(5,
+                                         [&](SimulatedScheduler::TimerId)
+                                         { times.push_back(scheduler.now()); });
+                      });
+
+      // The nested timer is due within the advanced range.
+      VERIFY(scheduler.advanceBy(20) == 2, caseLabel);
+      VERIFY((times == std::vector<std::uint64_t>{10, 15}), caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler::stop from callback"};
+      SimulatedScheduler scheduler;
+      int numCalls = 0;
+      SimulatedScheduler::TimerId other = 0;
+      const auto id = scheduler.start(
+         10,
+         [&](SimulatedScheduler::TimerId id)
+         {
+            ++numCalls;
+            scheduler.stop(id);
+            scheduler.stop(other);
+         },
+         10);
+      other = scheduler.start(15, [&](SimulatedScheduler::TimerId) { ++numCalls; });
+
+      scheduler.advanceBy(100);
+      VERIFY(numCalls == 1, caseLabel);
+      VERIFY(!scheduler.isActive(id), caseLabel);
+      VERIFY(scheduler.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"SimulatedScheduler::stop"};
+      SimulatedScheduler scheduler;
+      int numCalls = 0;
+      const auto id =
+         scheduler.start(10, [&](SimulatedScheduler::TimerId) { ++numCalls; });
+      VERIFY(scheduler.stop(id), caseLabel);
+      VERIFY(!scheduler.stop(id), caseLabel);
+      scheduler.advanceBy(100);
+      VERIFY(numCalls == 0, caseLabel);
+   }
+}
+
+
+void testSimulatedSchedulerScale()
+{
+   {
+      const std::string caseLabel{"SimulatedScheduler with a million expirations"};
+      constexpr int NumTimers = 1000;
+      constexpr std::uint64_t Period = 10;
+      SimulatedScheduler scheduler;
+      std::uint64_t numLate = 0;
+      for (int i = 0; i < NumTimers; ++i)
+      {
+         const std::uint64_t first = static_cast<std::uint64_t>(i % Period) + 1;
+         auto expected = std::make_shared<std::uint64_t>(first);
+         scheduler.start(
+            first,
+            [&scheduler, &numLate, expected](SimulatedScheduler::TimerId)
+            {
+               if (scheduler.now() != *expected)
+                  ++numLate;
+               *expected += Period;
+            },
+            Period);
+      }
+
+      const std::size_t numExpired = scheduler.advanceTo(1000 * Period);
+      VERIFY(numExpired == NumTimers * 1000, caseLabel);
+      VERIFY(scheduler.numExpirations() == numExpired, caseLabel);
+      VERIFY(numLate == 0, caseLabel);
+   }
+}
+
+
+void testSimulatedSchedulerDrivingClockUsers()
+{
+   {
+      const std::string caseLabel{"SimulatedScheduler drives a debouncer"};
+      SimulatedScheduler scheduler;
+      std::vector<std::uint64_t> callTimes;
+      Debouncer<> debouncer{scheduler.clock(), {50}, [&](std::monostate)
+                            { callTimes.push_back(scheduler.now()); }};
+
+      // Input every 10ms for 200ms, then silence.
+      SimulatedScheduler::TimerId pollTimer = 0;
+      auto poll = [&](SimulatedScheduler::TimerId)
+      {
+         debouncer.poll();
+         pollTimer = 0;
+      };
+      scheduler.start(
+         0,
+         [&](SimulatedScheduler::TimerId id)
+         {
+            debouncer.trigger();
+            if (scheduler.now() >= 200)
+               scheduler.stop(id);
+            if (pollTimer != 0)
+               scheduler.stop(pollTimer);
+            pollTimer =
+               scheduler.start(debouncer.nextDeadline() - scheduler.now(), poll);
+         },
+         10);
+
+      scheduler.advanceBy(1000);
+      VERIFY((callTimes == std::vector<std::uint64_t>{250}), caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testSimulatedScheduler()
+{
+   testSimulatedSchedulerStart();
+   testSimulatedSchedulerOrdering();
+   testSimulatedSchedulerScale();
+   testSimulatedSchedulerDrivingClockUsers();
+}
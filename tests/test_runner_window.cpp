@@ -6,19 +6,53 @@
 // MIT license
 //
 #include "test_runner_window.h"
+#include "alloc_counter.h"
+#include "alloc_stats_tests.h"
+#include "coalescing_scheduler_tests.h"
+#include "concurrent_id_map_tests.h"
 #include "device_context_tests.h"
 #include "err_util_tests.h"
 #include "gdi_object_tests.h"
 #include "geometry_tests.h"
+#include "inplace_function_tests.h"
+#include "latency_histogram_tests.h"
+#include "mapped_file_tests.h"
 #include "mem_util_tests.h"
+#include "memory_registry_tests.h"
 #include "message_util_tests.h"
+#include "object_pool_tests.h"
+#include "precision_timer_tests.h"
+#include "rate_limiter_tests.h"
+#include "registry_batch_tests.h"
+#include "registry_cache_tests.h"
+#include "registry_key_cache_tests.h"
 #include "registry_tests.h"
+#include "registry_walker_tests.h"
+#include "ring_buffer_tests.h"
 #include "screen_tests.h"
+#include "simulated_scheduler_tests.h"
+#include "timer_queue_tests.h"
 #include "timer_tests.h"
+#include "timer_wheel_tests.h"
+#include "trace_tests.h"
 #include "tstring_tests.h"
+#include "virtual_mem_tests.h"
 #include "window_tests.h"
 
 
+namespace
+{
+///////////////////
+
+// Runs a test and records its allocations.
+template <typename TestFn> void runTest(const char* name, TestFn test)
+{
+   ScopedAllocReport report{name};
+   test();
+}
+
+} // namespace
+
 
 LRESULT TestRunnerWindow::handleMessage(HWND hwnd, UINT msgId, WPARAM wParam, LPARAM lParam)
 {
@@ -36,17 +70,38 @@ LRESULT TestRunnerWindow::handleMessage(HWND hwnd, UINT msgId, WPARAM wParam, LP
 void TestRunnerWindow::onRunTests()
 {
    HWND runnerWnd = hwnd();
-   testDeviceContext(runnerWnd);
-   testErrUtil();
-   testGdiObject(runnerWnd);
-   testGeometry(runnerWnd);
-   testMemUtil();
-   testMessageUtil(runnerWnd);
-   testRegistry();
-   testScreen();
-   testTString(runnerWnd);
-   testTimer(runnerWnd);
-   testWindow(runnerWnd);
+   runTest("AllocStats", []() { testAllocStats(); });
+   runTest("CoalescingScheduler", []() { testCoalescingScheduler(); });
+   runTest("ConcurrentIdMap", []() { testConcurrentIdMap(); });
+   runTest("DeviceContext", [runnerWnd]() { testDeviceContext(runnerWnd); });
+   runTest("ErrUtil", []() { testErrUtil(); });
+   runTest("GdiObject", [runnerWnd]() { testGdiObject(runnerWnd); });
+   runTest("Geometry", [runnerWnd]() { testGeometry(runnerWnd); });
+   runTest("InplaceFunction", []() { testInplaceFunction(); });
+   runTest("LatencyHistogram", []() { testLatencyHistogram(); });
+   runTest("MappedFile", []() { testMappedFile(); });
+   runTest("MemUtil", []() { testMemUtil(); });
+   runTest("MemoryRegistry", []() { testMemoryRegistry(); });
+   runTest("MessageUtil", [runnerWnd]() { testMessageUtil(runnerWnd); });
+   runTest("ObjectPool", []() { testObjectPool(); });
+   runTest("PrecisionTimer", []() { testPrecisionTimer(); });
+   runTest("RateLimiter", []() { testRateLimiter(); });
+   runTest("Registry", []() { testRegistry(); });
+   runTest("RegistryBatch", []() { testRegistryBatch(); });
+   runTest("RegistryCache", []() { testRegistryCache(); });
+   runTest("RegistryKeyCache", []() { testRegistryKeyCache(); });
+   runTest("RegistryWalker", []() { testRegistryWalker(); });
+   runTest("RingBuffer", []() { testRingBuffer(); });
+   runTest("Screen", []() { testScreen(); });
+   runTest("SimulatedScheduler", []() { testSimulatedScheduler(); });
+   runTest("TString", [runnerWnd]() { testTString(runnerWnd); });
+   runTest("Timer", [runnerWnd]() { testTimer(runnerWnd); });
+   runTest("TimerQueue", []() { testTimerQueue(); });
+   runTest("TimerWheel", []() { testTimerWheel(); });
+   runTest("Trace", []() { testTrace(); });
+   runTest("VirtualMem", []() { testVirtualMem(); });
+   runTest("Window", [runnerWnd]() { testWindow(runnerWnd); });
 
+   OutputDebugStringA(formatAllocReport().c_str());
    PostQuitMessage(EXIT_SUCCESS);
 }
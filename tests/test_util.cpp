@@ -6,10 +6,17 @@
 // MIT license
 //
 #include "test_util.h"
+#ifdef _WIN32
 #include "win32_windows.h"
+#endif
+#include <atomic>
+#include <cstdio>
 #include <string>
 
 
+static std::atomic<int> s_numFailures = 0;
+
+
 static std::string composeErrorMessage(const std::string& label,
                                        const std::string& condStr,
                                        const std::string& fileName, int lineNum)
@@ -33,7 +40,21 @@ bool verify(bool cond, const std::string& label, const std::string& condStr,
             const std::string& fileName, int lineNum)
 {
    if (!cond)
+   {
+      ++s_numFailures;
+#ifdef _WIN32
       MessageBoxA(NULL, composeErrorMessage(label, condStr, fileName, lineNum).c_str(),
                   "Test failure", MB_OK);
+#else
+      std::fprintf(stderr, "%s\n",
+                   composeErrorMessage(label, condStr, fileName, lineNum).c_str());
+#endif
+   }
    return cond;
 }
+
+
+int numFailedVerifications()
+{
+   return s_numFailures;
+}
@@ -11,5 +11,7 @@
 
 bool verify(bool cond, const std::string& label, const std::string& condStr,
             const std::string& fileName, int lineNum);
+// Number of failed verifications since the program started.
+int numFailedVerifications();
 
 #define VERIFY(cond, label) (verify(cond, label, #cond, __FILE__, __LINE__))
@@ -0,0 +1,337 @@
+//
+// Win32 utilities library
+// Tests for the worker thread timer queue.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_queue_tests.h"
+#include "test_util.h"
+#include "timer_queue.h"
+#ifdef _WIN32
+#include "message_util.h"
+#include "ui_dispatcher.h"
+#endif
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Counts down to zero and wakes up waiters.
+class Latch
+{
+ public:
+   explicit Latch(int count) : m_count{count} {}
+
+   void countDown();
+   // Returns false on time-out.
+   bool wait(std::chrono::milliseconds timeOut);
+
+ private:
+   std::mutex m_guard;
+   std::condition_variable m_cond;
+   int m_count = 0;
+};
+
+
+void Latch::countDown()
+{
+   std::scoped_lock lock{m_guard};
+   if (--m_count == 0)
+      m_cond.notify_all();
+}
+
+
+bool Latch::wait(std::chrono::milliseconds timeOut)
+{
+   std::unique_lock lock{m_guard};
+   return m_cond.wait_for(lock, timeOut, [this]() { return m_count <= 0; });
+}
+
+
+///////////////////
+
+void testTimerQueueStart()
+{
+   {
+      const std::string caseLabel{"TimerQueue::start one-shot timer"};
+      TimerQueue queue;
+      Latch fired{1};
+      const auto started = TimerQueue::Clock::now();
+      std::atomic<TimerQueue::Clock::time_point> firedAt{};
+      const TimerQueue::TimerId id = queue.start(5ms,
+                                                 [&]()
+                                                 {
+                                                    firedAt = TimerQueue::Clock::now();
+                                                    fired.countDown();
+                                                 });
+      VERIFY(id != 0, caseLabel);
+      VERIFY(fired.wait(5s), caseLabel);
+      VERIFY(firedAt.load() >= started + 5ms, caseLabel);
+      // Give the worker time to retire the timer.
+      std::this_thread::sleep_for(10ms);
+      VERIFY(!queue.isActive(id), caseLabel);
+      VERIFY(queue.size() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue::start without callback"};
+      TimerQueue queue;
+      VERIFY(queue.start(1ms, nullptr) == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue::start with move-only callback"};
+      TimerQueue queue;
+      Latch fired{1};
+      auto value = std::make_unique<int>(42);
+      std::atomic<int> received = 0;
+      queue.start(1ms,
+                  [&fired, &received, value = std::move(value)]()
+                  {
+                     received = *value;
+                     fired.countDown();
+                  });
+      VERIFY(fired.wait(5s), caseLabel);
+      VERIFY(received == 42, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue fires timers in due order"};
+      TimerQueue queue;
+      Latch fired{3};
+      std::mutex guard;
+      std::string order;
+      auto append = [&](char ch)
+      {
+         {
+            std::scoped_lock lock{guard};
+            order += ch;
+         }
+         fired.countDown();
+      };
+      queue.start(30ms, [&]() { append('c'); });
+      queue.start(10ms, [&]() { append('a'); });
+      queue.start(20ms, [&]() { append('b'); });
+      VERIFY(fired.wait(5s), caseLabel);
+      VERIFY(order == "abc", caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue periodic timer"};
+      TimerQueue queue;
+      Latch fired{5};
+      const TimerQueue::TimerId id = queue.start(1ms, [&]() { fired.countDown(); }, 2ms);
+      VERIFY(fired.wait(5s), caseLabel);
+      VERIFY(queue.isActive(id), caseLabel);
+      VERIFY(queue.cancel(id), caseLabel);
+      VERIFY(!queue.isActive(id), caseLabel);
+   }
+}
+
+
+void testTimerQueueCancel()
+{
+   {
+      const std::string caseLabel{"TimerQueue::cancel pending timer"};
+      TimerQueue queue;
+      std::atomic<int> numCalls = 0;
+      const TimerQueue::TimerId id = queue.start(20ms, [&]() { ++numCalls; });
+      VERIFY(queue.cancel(id), caseLabel);
+      VERIFY(!queue.cancel(id), caseLabel);
+      std::this_thread::sleep_for(40ms);
+      VERIFY(numCalls == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue::cancel for unknown id"};
+      TimerQueue queue;
+      VERIFY(!queue.cancel(1234), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue::cancel waits for running callback"};
+      TimerQueue queue;
+      Latch entered{1};
+      std::atomic<bool> isDone = false;
+      const TimerQueue::TimerId id = queue.start(0ms,
+                                                 [&]()
+                                                 {
+                                                    entered.countDown();
+                                                    std::this_thread::sleep_for(30ms);
+                                                    isDone = true;
+                                                 });
+      VERIFY(entered.wait(5s), caseLabel);
+      VERIFY(queue.cancel(id), caseLabel);
+      VERIFY(isDone, caseLabel);
+      VERIFY(queue.size() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue::cancel from own callback"};
+      TimerQueue queue;
+      Latch fired{1};
+      std::atomic<int> numCalls = 0;
+      std::atomic<TimerQueue::TimerId> id = 0;
+      id = queue.start(
+         1ms,
+         [&]()
+         {
+            ++numCalls;
+            queue.cancel(id);
+            fired.countDown();
+         },
+         1ms);
+      VERIFY(fired.wait(5s), caseLabel);
+      std::this_thread::sleep_for(20ms);
+      VERIFY(numCalls == 1, caseLabel);
+      VERIFY(!queue.isActive(id), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue destruction discards pending timers"};
+      std::atomic<int> numCalls = 0;
+      {
+         TimerQueue queue{TimerQueue::Execution::Parallel, 2};
+         queue.start(1h, [&]() { ++numCalls; });
+      }
+      VERIFY(numCalls == 0, caseLabel);
+   }
+}
+
+
+void testTimerQueueExecution()
+{
+   {
+      const std::string caseLabel{"TimerQueue serial execution"};
+      TimerQueue queue{TimerQueue::Execution::Serial};
+      VERIFY(queue.numThreads() == 1, caseLabel);
+
+      Latch fired{4};
+      std::atomic<int> numRunning = 0;
+      std::atomic<int> maxRunning = 0;
+      auto callback = [&]()
+      {
+         const int running = ++numRunning;
+         if (running > maxRunning)
+            maxRunning = running;
+         std::this_thread::sleep_for(5ms);
+         --numRunning;
+         fired.countDown();
+      };
+      for (int i = 0; i < 4; ++i)
+         queue.start(1ms, callback);
+      VERIFY(fired.wait(5s), caseLabel);
+      VERIFY(maxRunning == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue parallel execution"};
+      TimerQueue queue{TimerQueue::Execution::Parallel, 2};
+      VERIFY(queue.numThreads() == 2, caseLabel);
+
+      // Each callback only finishes after the other one started, which needs both
+      // to run at the same time.
+      Latch started{2};
+      Latch fired{2};
+      std::atomic<bool> haveOverlap = true;
+      auto callback = [&]()
+      {
+         started.countDown();
+         if (!started.wait(5s))
+            haveOverlap = false;
+         fired.countDown();
+      };
+      queue.start(1ms, callback);
+      queue.start(1ms, callback);
+      VERIFY(fired.wait(10s), caseLabel);
+      VERIFY(haveOverlap, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerQueue parallel periodic timer does not overlap"};
+      TimerQueue queue{TimerQueue::Execution::Parallel, 4};
+      Latch fired{5};
+      std::atomic<int> numRunning = 0;
+      std::atomic<bool> haveOverlap = false;
+      const TimerQueue::TimerId id = queue.start(0ms,
+                                                 [&]()
+                                                 {
+                                                    if (++numRunning > 1)
+                                                       haveOverlap = true;
+                                                    std::this_thread::sleep_for(3ms);
+                                                    --numRunning;
+                                                    fired.countDown();
+                                                 },
+                                                 1ms);
+      VERIFY(fired.wait(5s), caseLabel);
+      queue.cancel(id);
+      VERIFY(!haveOverlap, caseLabel);
+   }
+}
+
+
+#ifdef _WIN32
+void testUiDispatcher()
+{
+   {
+      const std::string caseLabel{"UiDispatcher batches timer callbacks"};
+      UiDispatcher dispatcher;
+      VERIFY(dispatcher.create(), caseLabel);
+
+      constexpr int NumTimers = 20;
+      const DWORD uiThreadId = GetCurrentThreadId();
+      int numCalls = 0;
+      bool isOnUiThread = true;
+      bool stopMsgLoop = false;
+      Latch posted{NumTimers};
+      {
+         TimerQueue queue{TimerQueue::Execution::Parallel, 4};
+         for (int i = 0; i < NumTimers; ++i)
+         {
+            queue.start(1ms,
+                        [&]()
+                        {
+                           dispatcher.post(
+                              [&]()
+                              {
+                                 isOnUiThread =
+                                    isOnUiThread && GetCurrentThreadId() == uiThreadId;
+                                 if (++numCalls == NumTimers)
+                                    stopMsgLoop = true;
+                              });
+                           posted.countDown();
+                        });
+         }
+         // Let all callbacks post before the UI thread runs the batch.
+         VERIFY(posted.wait(5s), caseLabel);
+      }
+
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+      VERIFY(numCalls == NumTimers, caseLabel);
+      VERIFY(isOnUiThread, caseLabel);
+      VERIFY(dispatcher.numPostedMessages() == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"UiDispatcher::post without window"};
+      UiDispatcher dispatcher;
+      VERIFY(!dispatcher.post([]() {}), caseLabel);
+   }
+}
+#endif //_WIN32
+
+} // namespace
+
+
+///////////////////
+
+void testTimerQueue()
+{
+   testTimerQueueStart();
+   testTimerQueueCancel();
+   testTimerQueueExecution();
+#ifdef _WIN32
+   testUiDispatcher();
+#endif
+}
@@ -6,11 +6,13 @@
 // MIT license
 //
 #include "timer_tests.h"
+#include "alloc_counter.h"
 #include "message_util.h"
 #include "timer.h"
 #include "test_util.h"
 #include "window.h"
 #include <tchar.h>
+#include <chrono>
 #include <functional>
 #include <thread>
 
@@ -298,6 +300,30 @@ void testTimedCallbackCtorForCallback()
       TimedCallback timedCb{{}};
       VERIFY(!timedCb, caseLabel);
    }
+   {
+      const std::string caseLabel{"TimedCallback ctor for std::function"};
+      std::function<void(DWORD)> fn = [](DWORD sysTime) {};
+      TimedCallback timedCb{std::move(fn)};
+      VERIFY(static_cast<bool>(timedCb), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimedCallback ctor for empty std::function"};
+      TimedCallback timedCb{std::function<void(DWORD)>{}};
+      VERIFY(!timedCb, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimedCallback ctor for lambda with large capture"};
+      void* a = nullptr;
+      void* b = nullptr;
+      void* c = nullptr;
+      void* d = nullptr;
+      void* e = nullptr;
+      void* f = nullptr;
+      void* g = nullptr;
+      void* h = nullptr;
+      TimedCallback timedCb{[a, b, c, d, e, f, g, h](DWORD sysTime) {}};
+      VERIFY(static_cast<bool>(timedCb), caseLabel);
+   }
 }
 
 
@@ -336,6 +362,22 @@ void testTimedCallbackMoveCtor()
       VERIFY(static_cast<bool>(b), caseLabel);
       VERIFY(!a, caseLabel);
    }
+   {
+      const std::string caseLabel{"TimedCallback move ctor for running timer"};
+
+      bool stopMsgLoop = false;
+      std::size_t callCount = 0;
+      TimedCallback a{[&callCount, &stopMsgLoop](DWORD sysTime) {
+         ++callCount;
+         stopMsgLoop = true;
+      }};
+      a.start(20);
+      TimedCallback b{std::move(a)};
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+      b.stop();
+
+      VERIFY(callCount > 0, caseLabel);
+   }
 }
 
 
@@ -352,6 +394,23 @@ void testTimedCallbackMoveAssignment()
       VERIFY(static_cast<bool>(b), caseLabel);
       VERIFY(!a, caseLabel);
    }
+   {
+      const std::string caseLabel{"TimedCallback move assignment for running timer"};
+
+      bool stopMsgLoop = false;
+      std::size_t callCount = 0;
+      TimedCallback a{[&callCount, &stopMsgLoop](DWORD sysTime) {
+         ++callCount;
+         stopMsgLoop = true;
+      }};
+      TimedCallback b;
+      a.start(20);
+      b = std::move(a);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+      b.stop();
+
+      VERIFY(callCount > 0, caseLabel);
+   }
 }
 
 
@@ -433,6 +492,44 @@ void testTimedCallbackStart()
 
       VERIFY(callCount == 20, caseLabel);
    }
+   {
+      const std::string caseLabel{"TimedCallback::start restart without allocation"};
+
+      bool stopMsgLoop = false;
+      std::size_t callCount = 0;
+      TimedCallback timedCb{[&callCount, &stopMsgLoop, &timedCb](DWORD sysTime) {
+         if (++callCount == 10)
+         {
+            timedCb.stop();
+            stopMsgLoop = true;
+         }
+      }};
+      timedCb.start(1000);
+      // Restarting reuses the timer id, so the timer does not need to be registered
+      // again.
+      EXPECT_NO_ALLOC(timedCb.start(20), caseLabel);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+
+      VERIFY(callCount == 10, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimedCallback::start with tolerance"};
+
+      bool stopMsgLoop = false;
+      std::size_t callCount = 0;
+      TimedCallback timedCb{[&callCount, &stopMsgLoop, &timedCb](DWORD sysTime) {
+         if (++callCount == 3)
+         {
+            timedCb.stop();
+            stopMsgLoop = true;
+         }
+      }};
+      const bool startResult = timedCb.start(20, 50);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+
+      VERIFY(startResult, caseLabel);
+      VERIFY(callCount == 3, caseLabel);
+   }
 }
 
 
@@ -496,6 +593,66 @@ void testTimedCallbackId()
    }
 }
 
+
+void testTimedCallbackStats()
+{
+   {
+      const std::string caseLabel{"TimedCallback::setStats records expirations"};
+
+      TimerStats stats;
+      bool stopMsgLoop = false;
+      std::size_t callCount = 0;
+      TimedCallback timedCb{[&callCount, &stopMsgLoop, &timedCb](DWORD sysTime) {
+         std::this_thread::sleep_for(std::chrono::milliseconds{2});
+         if (++callCount == 5)
+         {
+            timedCb.stop();
+            stopMsgLoop = true;
+         }
+      }};
+      timedCb.setStats(&stats);
+      timedCb.start(10);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+
+      const TimerStatsSnapshot snapshot = stats.snapshot();
+      VERIFY(snapshot.lateness.count == 5, caseLabel);
+      VERIFY(snapshot.callbackDuration.count == 5, caseLabel);
+      VERIFY(snapshot.callbackDuration.min >= 2000, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimedCallback aggregate stats"};
+
+      enableTimerStats(true);
+      aggregateTimerStats().reset();
+
+      bool stopMsgLoop = false;
+      TimedCallback timedCb{[&stopMsgLoop, &timedCb](DWORD sysTime) {
+         timedCb.stop();
+         stopMsgLoop = true;
+      }};
+      timedCb.start(10);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+      enableTimerStats(false);
+
+      VERIFY(aggregateTimerStats().snapshot().lateness.count == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimedCallback without stats"};
+
+      aggregateTimerStats().reset();
+
+      bool stopMsgLoop = false;
+      TimedCallback timedCb{[&stopMsgLoop, &timedCb](DWORD sysTime) {
+         timedCb.stop();
+         stopMsgLoop = true;
+      }};
+      timedCb.start(10);
+      modalMessageLoop(NULL, stopMsgLoop, NULL);
+
+      VERIFY(aggregateTimerStats().snapshot().lateness.count == 0, caseLabel);
+   }
+}
+
 } // namespace
 
 
@@ -523,4 +680,5 @@ void testTimer(HWND testRunnerWnd)
    testTimedCallbackStart();
    testTimedCallbackStop();
    testTimedCallbackId();
+   testTimedCallbackStats();
 }
@@ -0,0 +1,339 @@
+//
+// Win32 utilities library
+// Tests for the timer wheel.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_wheel_tests.h"
+#include "test_util.h"
+#include "timer_wheel.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+void testTimerWheelStart()
+{
+   {
+      const std::string caseLabel{"TimerWheel::start"};
+      TimerWheel wheel;
+      std::uint64_t firedAt = 0;
+      const TimerWheel::TimerId id =
+         wheel.start(10, [&](TimerWheel::TimerId) { firedAt = wheel.now(); });
+      VERIFY(id != 0, caseLabel);
+      VERIFY(wheel.isActive(id), caseLabel);
+      VERIFY(wheel.size() == 1, caseLabel);
+
+      VERIFY(wheel.advance(9) == 0, caseLabel);
+      VERIFY(firedAt == 0, caseLabel);
+      VERIFY(wheel.advance(10) == 1, caseLabel);
+      VERIFY(firedAt == 10, caseLabel);
+      VERIFY(!wheel.isActive(id), caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::start without callback"};
+      TimerWheel wheel;
+      VERIFY(wheel.start(10, nullptr) == 0, caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::start for passed deadline"};
+      TimerWheel wheel{100};
+      std::uint64_t firedAt = 0;
+      wheel.start(50, [&](TimerWheel::TimerId) { firedAt = wheel.now(); });
+      wheel.advance(200);
+      VERIFY(firedAt == 101, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::startAfter"};
+      TimerWheel wheel{1000};
+      std::uint64_t firedAt = 0;
+      wheel.startAfter(5, [&](TimerWheel::TimerId) { firedAt = wheel.now(); });
+      wheel.advance(2000);
+      VERIFY(firedAt == 1005, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel timers at all levels"};
+      TimerWheel wheel{7};
+      const std::vector<std::uint64_t> delays{
+         1, 63, 64, 65, 4095, 4096, 4097, 300000, 16777216, 1073741823, 1073741824};
+      std::vector<std::uint64_t> firedAt(delays.size(), 0);
+      for (std::size_t i = 0; i < delays.size(); ++i)
+         wheel.startAfter(delays[i], [&firedAt, &wheel, i](TimerWheel::TimerId)
+                          { firedAt[i] = wheel.now(); });
+
+      // Advance in uneven steps to exercise skipping of empty ticks.
+      for (std::uint64_t now = 7; now < 1073741840; now += 999983)
+         wheel.advance(now);
+      wheel.advance(1073741840);
+
+      bool isOnTime = true;
+      for (std::size_t i = 0; i < delays.size(); ++i)
+         isOnTime = isOnTime && firedAt[i] == 7 + delays[i];
+      VERIFY(isOnTime, caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel timer beyond top level"};
+      const std::uint64_t delay = (std::uint64_t(1) << 36) + 12345;
+      TimerWheel wheel{3};
+      std::uint64_t firedAt = 0;
+      wheel.startAfter(delay, [&](TimerWheel::TimerId) { firedAt = wheel.now(); });
+      wheel.advance(delay);
+      VERIFY(firedAt == 0, caseLabel);
+      wheel.advance(delay + 3);
+      VERIFY(firedAt == delay + 3, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel expires in deadline order"};
+      TimerWheel wheel;
+      std::vector<int> order;
+      wheel.start(300, [&](TimerWheel::TimerId) { order.push_back(3); });
+      wheel.start(100, [&](TimerWheel::TimerId) { order.push_back(1); });
+      wheel.start(200, [&](TimerWheel::TimerId) { order.push_back(2); });
+      wheel.advance(1000);
+      VERIFY((order == std::vector<int>{1, 2, 3}), caseLabel);
+   }
+}
+
+
+void testTimerWheelStop()
+{
+   {
+      const std::string caseLabel{"TimerWheel::stop"};
+      TimerWheel wheel;
+      bool hasFired = false;
+      const TimerWheel::TimerId id =
+         wheel.start(5000, [&](TimerWheel::TimerId) { hasFired = true; });
+      VERIFY(wheel.stop(id), caseLabel);
+      VERIFY(!wheel.isActive(id), caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+      wheel.advance(10000);
+      VERIFY(!hasFired, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::stop for invalid ids"};
+      TimerWheel wheel;
+      const TimerWheel::TimerId id = wheel.start(1, [](TimerWheel::TimerId) {});
+      wheel.advance(1);
+      VERIFY(!wheel.stop(0), caseLabel);
+      VERIFY(!wheel.stop(id), caseLabel);
+      VERIFY(!wheel.stop(12345), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel ids of reused nodes are unique"};
+      TimerWheel wheel;
+      const TimerWheel::TimerId first = wheel.start(10, [](TimerWheel::TimerId) {});
+      wheel.stop(first);
+      const TimerWheel::TimerId second = wheel.start(10, [](TimerWheel::TimerId) {});
+      VERIFY(first != second, caseLabel);
+      VERIFY(!wheel.stop(first), caseLabel);
+      VERIFY(wheel.isActive(second), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel stop timer from own callback"};
+      TimerWheel wheel;
+      int numFired = 0;
+      wheel.start(
+         10,
+         [&](TimerWheel::TimerId id)
+         {
+            ++numFired;
+            wheel.stop(id);
+         },
+         10);
+      wheel.advance(100);
+      VERIFY(numFired == 1, caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel stop other timer of same tick"};
+      TimerWheel wheel;
+      int numFired = 0;
+      TimerWheel::TimerId a = 0;
+      TimerWheel::TimerId b = 0;
+      a = wheel.start(10, [&](TimerWheel::TimerId)
+                   {
+                      ++numFired;
+                      wheel.stop(b);
+                   });
+      b = wheel.start(10, [&](TimerWheel::TimerId)
+                   {
+                      ++numFired;
+                      wheel.stop(a);
+                   });
+      wheel.advance(10);
+      VERIFY(numFired == 1, caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel start timers from callback"};
+      TimerWheel wheel;
+      std::vector<std::uint64_t> firedAt;
+      wheel.start(10,
+                  [&](TimerWheel::TimerId)
+                  {
+                     firedAt.push_back(wheel.now());
+                     // Causes the node storage to grow while the callback runs.
+                     for (int i = 0; i < 100; ++i)
+                        wheel.start(0, [&](TimerWheel::TimerId)
+                                    { firedAt.push_back(wheel.now()); });
+                  });
+      wheel.advance(20);
+      VERIFY(firedAt.size() == 101, caseLabel);
+      VERIFY(firedAt.back() == 11, caseLabel);
+   }
+}
+
+
+void testTimerWheelPeriodic()
+{
+   {
+      const std::string caseLabel{"TimerWheel periodic timer"};
+      TimerWheel wheel;
+      std::vector<std::uint64_t> firedAt;
+      const TimerWheel::TimerId id = wheel.start(
+         100, [&](TimerWheel::TimerId) { firedAt.push_back(wheel.now()); }, 100);
+      wheel.advance(450);
+      VERIFY((firedAt == std::vector<std::uint64_t>{100, 200, 300, 400}), caseLabel);
+      VERIFY(wheel.isActive(id), caseLabel);
+      VERIFY(wheel.stop(id), caseLabel);
+      wheel.advance(1000);
+      VERIFY(firedAt.size() == 4, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel periodic timer does not drift"};
+      TimerWheel wheel;
+      std::vector<std::uint64_t> firedAt;
+      wheel.start(
+         7, [&](TimerWheel::TimerId) { firedAt.push_back(wheel.now()); }, 7);
+      // Advancing in big steps runs each expiry at its own tick.
+      wheel.advance(15);
+      wheel.advance(30);
+      VERIFY((firedAt == std::vector<std::uint64_t>{7, 14, 21, 28}), caseLabel);
+   }
+}
+
+
+void testTimerWheelMany()
+{
+   {
+      const std::string caseLabel{"TimerWheel with many timers"};
+      constexpr std::size_t NumTimers = 100000;
+      TimerWheel wheel;
+      std::size_t numFired = 0;
+      std::size_t numLate = 0;
+      std::vector<TimerWheel::TimerId> ids;
+      ids.reserve(NumTimers);
+      for (std::size_t i = 0; i < NumTimers; ++i)
+      {
+         const std::uint64_t deadline = (i * 7919) % 1000000 + 1;
+         ids.push_back(wheel.start(deadline,
+                                   [&, deadline](TimerWheel::TimerId)
+                                   {
+                                      ++numFired;
+                                      if (wheel.now() != deadline)
+                                         ++numLate;
+                                   }));
+      }
+      // Stop every other timer.
+      for (std::size_t i = 0; i < NumTimers; i += 2)
+         wheel.stop(ids[i]);
+      VERIFY(wheel.size() == NumTimers / 2, caseLabel);
+
+      wheel.advance(1000000);
+      VERIFY(numFired == NumTimers / 2, caseLabel);
+      VERIFY(numLate == 0, caseLabel);
+      VERIFY(wheel.empty(), caseLabel);
+   }
+}
+
+
+void testTimerWheelNextDueTick()
+{
+   {
+      const std::string caseLabel{"TimerWheel::nextDueTick for empty wheel"};
+      TimerWheel wheel;
+      VERIFY(wheel.nextDueTick() == TimerWheel::NoDueTick, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::nextDueTick"};
+      TimerWheel wheel;
+      const TimerWheel::TimerId id = wheel.start(10, [](TimerWheel::TimerId) {});
+      VERIFY(wheel.nextDueTick() == 10, caseLabel);
+      wheel.stop(id);
+      VERIFY(wheel.nextDueTick() == TimerWheel::NoDueTick, caseLabel);
+
+      // Far timers are due when they move to a lower level.
+      wheel.start(1000, [](TimerWheel::TimerId) {});
+      VERIFY(wheel.nextDueTick() == 960, caseLabel);
+      wheel.advance(960);
+      VERIFY(wheel.nextDueTick() == 1000, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel advanced to next due ticks only"};
+      constexpr std::size_t NumTimers = 1000;
+      TimerWheel wheel;
+      std::size_t numFired = 0;
+      std::size_t numLate = 0;
+      for (std::size_t i = 0; i < NumTimers; ++i)
+      {
+         const std::uint64_t deadline = (i * 7919) % 10000000 + 1;
+         wheel.start(deadline,
+                     [&, deadline](TimerWheel::TimerId)
+                     {
+                        ++numFired;
+                        if (wheel.now() != deadline)
+                           ++numLate;
+                     });
+      }
+
+      std::size_t numSteps = 0;
+      while (!wheel.empty())
+      {
+         wheel.advance(wheel.nextDueTick());
+         ++numSteps;
+      }
+      VERIFY(numFired == NumTimers, caseLabel);
+      VERIFY(numLate == 0, caseLabel);
+      VERIFY(numSteps <= NumTimers * TimerWheel::NumLevels, caseLabel);
+   }
+   {
+      const std::string caseLabel{"TimerWheel::nextDueTick for single far timer"};
+      TimerWheel wheel;
+      bool hasFired = false;
+      wheel.start(600000, [&](TimerWheel::TimerId) { hasFired = true; });
+
+      std::size_t numSteps = 0;
+      while (!wheel.empty())
+      {
+         wheel.advance(wheel.nextDueTick());
+         ++numSteps;
+      }
+      VERIFY(hasFired, caseLabel);
+      VERIFY(wheel.now() == 600000, caseLabel);
+      VERIFY(numSteps <= TimerWheel::NumLevels, caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testTimerWheel()
+{
+   testTimerWheelStart();
+   testTimerWheelStop();
+   testTimerWheelPeriodic();
+   testTimerWheelMany();
+   testTimerWheelNextDueTick();
+}
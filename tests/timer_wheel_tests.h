@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for the timer wheel.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testTimerWheel();
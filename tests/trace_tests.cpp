@@ -0,0 +1,312 @@
+//
+// Win32 utilities library
+// Tests for tracing.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "trace_tests.h"
+#include "test_util.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+// Enables tracing while in scope and starts with an empty trace.
+class ScopedTracing
+{
+ public:
+   ScopedTracing()
+   {
+      resetTracing();
+      enableTracing(true);
+   }
+   ~ScopedTracing()
+   {
+      enableTracing(false);
+      resetTracing();
+   }
+   ScopedTracing(const ScopedTracing&) = delete;
+   ScopedTracing& operator=(const ScopedTracing&) = delete;
+};
+
+
+bool contains(const std::string& str, const std::string& part)
+{
+   return str.find(part) != std::string::npos;
+}
+
+
+///////////////////
+
+void testTraceRecording()
+{
+   {
+      const std::string caseLabel{"Tracing disabled"};
+      resetTracing();
+      {
+         TraceZone zone{"zone"};
+         traceInstant("instant");
+         traceCounter("counter", 1.);
+      }
+      VERIFY(collectTraceEvents().empty(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"TraceZone"};
+      ScopedTracing tracing;
+      const std::uint64_t before = traceTimestamp();
+      {
+         TraceZone zone{"zone", "test"};
+         std::this_thread::sleep_for(2ms);
+      }
+
+      const std::vector<TraceEvent> events = collectTraceEvents();
+      VERIFY(events.size() == 1, caseLabel);
+      VERIFY(events[0].type == TraceEventType::Complete, caseLabel);
+      VERIFY(std::strcmp(events[0].name, "zone") == 0, caseLabel);
+      VERIFY(std::strcmp(events[0].category, "test") == 0, caseLabel);
+      VERIFY(events[0].timestamp >= before, caseLabel);
+      VERIFY(events[0].duration >= traceTicksPerSecond() / 500, caseLabel);
+      VERIFY(events[0].threadId != 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"traceInstant and traceCounter"};
+      ScopedTracing tracing;
+      traceInstant("instant");
+      traceCounter("counter", 42.5);
+
+      const std::vector<TraceEvent> events = collectTraceEvents();
+      VERIFY(events.size() == 2, caseLabel);
+      VERIFY(events[0].type == TraceEventType::Instant, caseLabel);
+      VERIFY(events[1].type == TraceEventType::Counter, caseLabel);
+      VERIFY(events[1].value == 42.5, caseLabel);
+      VERIFY(events[0].timestamp <= events[1].timestamp, caseLabel);
+   }
+   {
+      const std::string caseLabel{"WIN32UTIL_TRACE_ZONE"};
+      ScopedTracing tracing;
+      {
+         WIN32UTIL_TRACE_ZONE("outer", "test");
+         WIN32UTIL_TRACE_ZONE("inner", "test");
+      }
+      VERIFY(collectTraceEvents().size() == 2, caseLabel);
+   }
+   {
+      const std::string caseLabel{"collectTraceEvents removes events"};
+      ScopedTracing tracing;
+      traceInstant("instant");
+      VERIFY(collectTraceEvents().size() == 1, caseLabel);
+      VERIFY(collectTraceEvents().empty(), caseLabel);
+   }
+}
+
+
+void testTraceThreads()
+{
+   {
+      const std::string caseLabel{"Tracing on multiple threads"};
+      ScopedTracing tracing;
+      constexpr int NumThreads = 4;
+      constexpr int NumEvents = 1000;
+
+      std::vector<std::thread> threads;
+      for (int i = 0; i < NumThreads; ++i)
+      {
+         threads.emplace_back(
+            []()
+            {
+               for (int j = 0; j < NumEvents; ++j)
+                  TraceZone zone{"work"};
+            });
+      }
+      for (std::thread& th : threads)
+         th.join();
+
+      // Events of exited threads are kept.
+      const std::vector<TraceEvent> events = collectTraceEvents();
+      VERIFY(events.size() == NumThreads * NumEvents, caseLabel);
+      std::set<std::uint32_t> threadIds;
+      bool isSorted = true;
+      for (std::size_t i = 0; i < events.size(); ++i)
+      {
+         threadIds.insert(events[i].threadId);
+         if (i > 0)
+            isSorted = isSorted && events[i - 1].timestamp <= events[i].timestamp;
+      }
+      VERIFY(threadIds.size() == NumThreads, caseLabel);
+      VERIFY(isSorted, caseLabel);
+   }
+   {
+      const std::string caseLabel{"Tracing drops events of full buffers"};
+      ScopedTracing tracing;
+      setTraceBufferSize(1);
+
+      // The buffer of a new thread uses the small size.
+      std::thread producer{[]()
+                           {
+                              for (int i = 0; i < 100000; ++i)
+                                 traceInstant("instant");
+                           }};
+      producer.join();
+      setTraceBufferSize(std::size_t(1) << 20);
+
+      const std::vector<TraceEvent> events = collectTraceEvents();
+      VERIFY(numDroppedTraceEvents() > 0, caseLabel);
+      VERIFY(events.size() + numDroppedTraceEvents() == 100000, caseLabel);
+   }
+}
+
+
+void testTraceExport()
+{
+   {
+      const std::string caseLabel{"exportChromeTrace"};
+      std::vector<TraceEvent> events(3);
+      const std::uint64_t ticksPerUs = traceTicksPerSecond() / 1000000;
+      events[0].timestamp = 1000 * ticksPerUs;
+      events[0].duration = 250 * ticksPerUs;
+      events[0].name = "zone \"quoted\"";
+      events[0].category = "test";
+      events[0].threadId = 1;
+      events[0].type = TraceEventType::Complete;
+      events[1].timestamp = 1100 * ticksPerUs;
+      events[1].name = "instant";
+      events[1].threadId = 2;
+      events[1].type = TraceEventType::Instant;
+      events[2].timestamp = 1200 * ticksPerUs;
+      events[2].value = 7.;
+      events[2].name = "counter";
+      events[2].threadId = 1;
+      events[2].type = TraceEventType::Counter;
+
+      const std::string json = exportChromeTrace(events);
+      VERIFY(contains(json, "{\"traceEvents\":["), caseLabel);
+      VERIFY(contains(json, "\"name\":\"zone \\\"quoted\\\"\""), caseLabel);
+      VERIFY(contains(json, "\"ts\":0.000,\"pid\":1,\"tid\":1,\"ph\":\"X\""),
+             caseLabel);
+      VERIFY(contains(json, "\"dur\":250.000"), caseLabel);
+      VERIFY(contains(json, "\"ts\":100.000,\"pid\":1,\"tid\":2,\"ph\":\"i\""),
+             caseLabel);
+      VERIFY(contains(json, "\"ph\":\"C\",\"args\":{\"value\":7.000}"), caseLabel);
+   }
+   {
+      const std::string caseLabel{"exportBinaryTrace and importBinaryTrace"};
+      std::vector<TraceEvent> events(3);
+      const char* names[] = {"a", "b", "a"};
+      for (std::size_t i = 0; i < events.size(); ++i)
+      {
+         events[i].timestamp = 100 + i;
+         events[i].duration = 10 * i;
+         events[i].value = 0.5 * static_cast<double>(i);
+         events[i].name = names[i];
+         events[i].category = "cat";
+         events[i].threadId = static_cast<std::uint32_t>(i + 1);
+         events[i].type = TraceEventType::Complete;
+      }
+
+      const std::vector<std::byte> data = exportBinaryTrace(events);
+      std::vector<std::string> strings;
+      std::uint64_t ticksPerSecond = 0;
+      const auto imported = importBinaryTrace(data, strings, ticksPerSecond);
+      VERIFY(imported.has_value(), caseLabel);
+      VERIFY(ticksPerSecond == traceTicksPerSecond(), caseLabel);
+      // Names are stored once.
+      VERIFY(strings.size() == 3, caseLabel);
+
+      bool isEqual = imported->size() == events.size();
+      for (std::size_t i = 0; isEqual && i < events.size(); ++i)
+      {
+         const TraceEvent& a = events[i];
+         const TraceEvent& b = (*imported)[i];
+         isEqual = a.timestamp == b.timestamp && a.duration == b.duration &&
+                   a.value == b.value && std::strcmp(a.name, b.name) == 0 &&
+                   std::strcmp(a.category, b.category) == 0 &&
+                   a.threadId == b.threadId && a.type == b.type;
+      }
+      VERIFY(isEqual, caseLabel);
+   }
+   {
+      const std::string caseLabel{"importBinaryTrace for invalid data"};
+      std::vector<std::string> strings;
+      std::uint64_t ticksPerSecond = 0;
+      VERIFY(!importBinaryTrace({}, strings, ticksPerSecond), caseLabel);
+
+      std::vector<std::byte> truncated = exportBinaryTrace(std::vector<TraceEvent>(2));
+      truncated.pop_back();
+      VERIFY(!importBinaryTrace(truncated, strings, ticksPerSecond), caseLabel);
+   }
+   {
+      const std::string caseLabel{"exportChromeTrace for imported trace"};
+      // Recorded on a machine whose clock runs at 10 MHz.
+      constexpr std::uint64_t RecordedTicksPerSecond = 10000000;
+      constexpr std::size_t TicksPerSecondOffset = 8 + 4;
+      std::vector<TraceEvent> events(2);
+      events[0].timestamp = 1000;
+      events[0].duration = 2500;
+      events[0].name = "zone";
+      events[0].type = TraceEventType::Complete;
+      events[1].timestamp = 11000;
+      events[1].name = "instant";
+      events[1].type = TraceEventType::Instant;
+
+      std::vector<std::byte> data = exportBinaryTrace(events);
+      std::memcpy(data.data() + TicksPerSecondOffset, &RecordedTicksPerSecond,
+                  sizeof(RecordedTicksPerSecond));
+      std::vector<std::string> strings;
+      std::uint64_t ticksPerSecond = 0;
+      const auto imported = importBinaryTrace(data, strings, ticksPerSecond);
+      VERIFY(imported.has_value(), caseLabel);
+      VERIFY(ticksPerSecond == RecordedTicksPerSecond, caseLabel);
+
+      const std::string json = exportChromeTrace(*imported, ticksPerSecond);
+      VERIFY(contains(json, "\"dur\":250.000"), caseLabel);
+      VERIFY(contains(json, "\"ts\":1000.000"), caseLabel);
+
+      // A zero rate cannot be converted.
+      const std::uint64_t zero = 0;
+      std::memcpy(data.data() + TicksPerSecondOffset, &zero, sizeof(zero));
+      VERIFY(!importBinaryTrace(data, strings, ticksPerSecond), caseLabel);
+   }
+   {
+      const std::string caseLabel{"importBinaryTrace for corrupt counts"};
+      std::vector<std::string> strings;
+      std::uint64_t ticksPerSecond = 0;
+      // Header: magic, version, ticks per second, string count, event count.
+      constexpr std::size_t NumStringsOffset = 8 + 4 + 8;
+      constexpr std::size_t NumEventsOffset = NumStringsOffset + 4;
+
+      std::vector<std::byte> data = exportBinaryTrace({});
+      const std::uint32_t numStrings = 0xFFFFFFFF;
+      std::memcpy(data.data() + NumStringsOffset, &numStrings, sizeof(numStrings));
+      VERIFY(!importBinaryTrace(data, strings, ticksPerSecond), caseLabel);
+
+      data = exportBinaryTrace({});
+      const std::uint64_t numEvents = 0xFFFFFFFFFFFF;
+      std::memcpy(data.data() + NumEventsOffset, &numEvents, sizeof(numEvents));
+      VERIFY(!importBinaryTrace(data, strings, ticksPerSecond), caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testTrace()
+{
+   testTraceRecording();
+   testTraceThreads();
+   testTraceExport();
+}
@@ -0,0 +1,324 @@
+//
+// Win32 utilities library
+// Tests for virtual memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "virtual_mem_tests.h"
+#include "test_util.h"
+#include "virtual_mem.h"
+#include <cstdint>
+#include <string>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+void testPageSize()
+{
+   {
+      const std::string caseLabel{"pageSize"};
+      VERIFY(pageSize() > 0, caseLabel);
+      VERIFY((pageSize() & (pageSize() - 1)) == 0, caseLabel);
+   }
+}
+
+
+void testVirtualMemReserve()
+{
+   {
+      const std::string caseLabel{"VirtualMem::reserve"};
+      VirtualMem mem;
+      VERIFY(mem.reserve(1024 * 1024), caseLabel);
+      VERIFY(mem.operator bool(), caseLabel);
+      VERIFY(mem.data() != nullptr, caseLabel);
+      VERIFY(mem.reserved() == 1024 * 1024, caseLabel);
+      VERIFY(mem.committed() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::reserve rounds up to pages"};
+      VirtualMem mem;
+      VERIFY(mem.reserve(1), caseLabel);
+      VERIFY(mem.reserved() == pageSize(), caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::reserve zero bytes"};
+      VirtualMem mem;
+      VERIFY(!mem.reserve(0), caseLabel);
+      VERIFY(!mem, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::reserve with large page hint"};
+      VirtualMem mem;
+      // Falls back to normal pages if large pages are not available.
+      VERIFY(mem.reserve(1024 * 1024, PageHint::Large), caseLabel);
+      VERIFY(mem.commit(1024 * 1024), caseLabel);
+      mem.data()[1024 * 1024 - 1] = std::byte{1};
+      VERIFY(mem.data()[1024 * 1024 - 1] == std::byte{1}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem large pages are aligned"};
+      VirtualMem mem;
+      if (mem.reserve(3 * pageSize(), PageHint::Large) && mem.isLargePages())
+      {
+         const auto addr = reinterpret_cast<std::uintptr_t>(mem.data());
+         VERIFY(addr % largePageSize() == 0, caseLabel);
+         VERIFY(mem.reserved() % largePageSize() == 0, caseLabel);
+      }
+   }
+}
+
+
+void testVirtualMemCommit()
+{
+   {
+      const std::string caseLabel{"VirtualMem::commit"};
+      VirtualMem mem;
+      mem.reserve(16 * pageSize());
+      VERIFY(mem.commit(pageSize() + 1), caseLabel);
+      VERIFY(mem.committed() == 2 * pageSize(), caseLabel);
+      VERIFY(mem.span().size() == mem.committed(), caseLabel);
+      mem.data()[2 * pageSize() - 1] = std::byte{7};
+      VERIFY(mem.data()[2 * pageSize() - 1] == std::byte{7}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::commit keeps content"};
+      VirtualMem mem;
+      mem.reserve(16 * pageSize());
+      mem.commit(pageSize());
+      mem.data()[0] = std::byte{3};
+      const std::byte* prevData = mem.data();
+      VERIFY(mem.commit(8 * pageSize()), caseLabel);
+      VERIFY(mem.data() == prevData, caseLabel);
+      VERIFY(mem.data()[0] == std::byte{3}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::commit beyond reserved range"};
+      VirtualMem mem;
+      mem.reserve(pageSize());
+      VERIFY(!mem.commit(2 * pageSize()), caseLabel);
+      VERIFY(mem.committed() == 0, caseLabel);
+   }
+}
+
+
+void testVirtualMemDecommit()
+{
+   {
+      const std::string caseLabel{"VirtualMem::decommit"};
+      VirtualMem mem;
+      mem.reserve(16 * pageSize());
+      mem.commit(8 * pageSize());
+      mem.data()[0] = std::byte{5};
+      VERIFY(mem.decommit(pageSize()), caseLabel);
+      VERIFY(mem.committed() == pageSize(), caseLabel);
+      VERIFY(mem.data()[0] == std::byte{5}, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::decommit to zero"};
+      VirtualMem mem;
+      mem.reserve(16 * pageSize());
+      mem.commit(8 * pageSize());
+      VERIFY(mem.decommit(0), caseLabel);
+      VERIFY(mem.committed() == 0, caseLabel);
+      VERIFY(mem.commit(pageSize()), caseLabel);
+   }
+}
+
+
+void testVirtualMemMove()
+{
+   {
+      const std::string caseLabel{"VirtualMem move ctor"};
+      VirtualMem src;
+      src.reserve(4 * pageSize());
+      src.commit(pageSize());
+      const std::byte* data = src.data();
+
+      VirtualMem dest{std::move(src)};
+      VERIFY(dest.data() == data, caseLabel);
+      VERIFY(dest.committed() == pageSize(), caseLabel);
+      VERIFY(!src, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem move assignment"};
+      VirtualMem src;
+      src.reserve(4 * pageSize());
+      const std::byte* data = src.data();
+
+      VirtualMem dest;
+      dest.reserve(pageSize());
+      dest = std::move(src);
+      VERIFY(dest.data() == data, caseLabel);
+      VERIFY(dest.reserved() == 4 * pageSize(), caseLabel);
+      VERIFY(!src, caseLabel);
+   }
+   {
+      const std::string caseLabel{"VirtualMem::release"};
+      VirtualMem mem;
+      mem.reserve(4 * pageSize());
+      mem.release();
+      VERIFY(!mem, caseLabel);
+      VERIFY(mem.reserved() == 0, caseLabel);
+   }
+}
+
+
+///////////////////
+
+struct Tracked
+{
+   explicit Tracked(int v) : val{v} { ++alive; }
+   Tracked() : Tracked{0} {}
+   Tracked(const Tracked& other) : Tracked{other.val} {}
+   ~Tracked() { --alive; }
+
+   int val = 0;
+   inline static int alive = 0;
+};
+
+
+void testReservedArrayCtor()
+{
+   {
+      const std::string caseLabel{"ReservedArray ctor"};
+      ReservedArray<int> arr{1000};
+      VERIFY(arr.operator bool(), caseLabel);
+      VERIFY(arr.empty(), caseLabel);
+      VERIFY(arr.maxSize() >= 1000, caseLabel);
+      VERIFY(arr.capacity() == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray default ctor"};
+      ReservedArray<int> arr;
+      VERIFY(!arr, caseLabel);
+      VERIFY(!arr.pushBack(1), caseLabel);
+   }
+}
+
+
+void testReservedArrayPushBack()
+{
+   {
+      const std::string caseLabel{"ReservedArray::pushBack"};
+      ReservedArray<int> arr{100000};
+      for (int i = 0; i < 100000; ++i)
+         arr.pushBack(i);
+      VERIFY(arr.size() == 100000, caseLabel);
+      VERIFY(arr[0] == 0 && arr[99999] == 99999, caseLabel);
+      VERIFY(arr.back() == 99999, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray::pushBack does not move elements"};
+      ReservedArray<int> arr{100000};
+      arr.pushBack(1);
+      const int* first = &arr[0];
+      for (int i = 0; i < 99999; ++i)
+         arr.pushBack(i);
+      VERIFY(&arr[0] == first, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray::pushBack beyond max size"};
+      ReservedArray<int> arr{1};
+      const std::size_t maxSize = arr.maxSize();
+      for (std::size_t i = 0; i < maxSize; ++i)
+         arr.pushBack(1);
+      VERIFY(!arr.pushBack(1), caseLabel);
+      VERIFY(arr.size() == maxSize, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray::emplaceBack"};
+      ReservedArray<Tracked> arr{10};
+      Tracked* elem = arr.emplaceBack(5);
+      VERIFY(elem != nullptr && elem->val == 5, caseLabel);
+      VERIFY(Tracked::alive == 1, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray dtor destroys elements"};
+      {
+         ReservedArray<Tracked> arr{10};
+         arr.emplaceBack(1);
+         arr.emplaceBack(2);
+      }
+      VERIFY(Tracked::alive == 0, caseLabel);
+   }
+}
+
+
+void testReservedArrayResize()
+{
+   {
+      const std::string caseLabel{"ReservedArray::resize"};
+      ReservedArray<Tracked> arr{1000};
+      VERIFY(arr.resize(10), caseLabel);
+      VERIFY(arr.size() == 10 && Tracked::alive == 10, caseLabel);
+      VERIFY(arr.resize(3), caseLabel);
+      VERIFY(arr.size() == 3 && Tracked::alive == 3, caseLabel);
+      arr.popBack();
+      VERIFY(arr.size() == 2 && Tracked::alive == 2, caseLabel);
+      arr.clear();
+      VERIFY(arr.empty() && Tracked::alive == 0, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray::shrinkToFit"};
+      ReservedArray<int> arr{100000};
+      arr.resize(100000);
+      arr.resize(10);
+      VERIFY(arr.shrinkToFit(), caseLabel);
+      VERIFY(arr.capacity() * sizeof(int) == pageSize(), caseLabel);
+      VERIFY(arr.size() == 10, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray::reserve"};
+      ReservedArray<int> arr{100000};
+      VERIFY(arr.reserve(5000), caseLabel);
+      VERIFY(arr.capacity() >= 5000, caseLabel);
+      VERIFY(!arr.reserve(arr.maxSize() + 1), caseLabel);
+   }
+}
+
+
+void testReservedArrayIteration()
+{
+   {
+      const std::string caseLabel{"ReservedArray iteration"};
+      ReservedArray<int> arr{10};
+      for (int i = 1; i <= 4; ++i)
+         arr.pushBack(i);
+      int sum = 0;
+      for (int val : arr)
+         sum += val;
+      VERIFY(sum == 10, caseLabel);
+      VERIFY(arr.span().size() == 4, caseLabel);
+   }
+   {
+      const std::string caseLabel{"ReservedArray move ctor"};
+      ReservedArray<int> src{10};
+      src.pushBack(1);
+      ReservedArray<int> dest{std::move(src)};
+      VERIFY(dest.size() == 1 && dest[0] == 1, caseLabel);
+      VERIFY(!src && src.empty(), caseLabel);
+   }
+}
+
+} // namespace
+
+
+///////////////////
+
+void testVirtualMem()
+{
+   testPageSize();
+   testVirtualMemReserve();
+   testVirtualMemCommit();
+   testVirtualMemDecommit();
+   testVirtualMemMove();
+   testReservedArrayCtor();
+   testReservedArrayPushBack();
+   testReservedArrayResize();
+   testReservedArrayIteration();
+}
@@ -0,0 +1,11 @@
+//
+// Win32 utilities library
+// Tests for virtual memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+
+
+void testVirtualMem();
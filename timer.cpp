@@ -7,10 +7,11 @@
 //
 #ifdef _WIN32
 #include "timer.h"
+#include "alloc_stats.h"
+#include "concurrent_id_map.h"
+#include "trace.h"
 #include "tstring.h"
 #include <cassert>
-#include <mutex>
-#include <unordered_map>
 
 
 namespace
@@ -18,7 +19,8 @@ namespace
 ///////////////////
 
 // Keeps track of all TimedCallback objects.
-// Thread-safe.
+// Thread-safe. Lookups from the timer procedure never block, so threads that start
+// and stop timers do not delay the threads whose timers expire.
 class TimedCallbackRegistry
 {
  public:
@@ -27,34 +29,30 @@ class TimedCallbackRegistry
    static win32::TimedCallback* getTimer(UINT_PTR id);
 
  private:
-   static std::unordered_map<UINT_PTR, win32::TimedCallback*> m_timers;
-   static std::mutex m_guard;
+   static win32::ConcurrentIdMap<win32::TimedCallback>& timers();
 };
 
 
-std::unordered_map<UINT_PTR, win32::TimedCallback*> TimedCallbackRegistry::m_timers;
-std::mutex TimedCallbackRegistry::m_guard;
-
-
 void TimedCallbackRegistry::registerTimer(UINT_PTR id, win32::TimedCallback* timer)
 {
-   std::lock_guard<std::mutex> lock(m_guard);
-   m_timers[id] = timer;
+   timers().insert(id, timer);
 }
 
 void TimedCallbackRegistry::unregisterTimer(UINT_PTR id)
 {
-   std::lock_guard<std::mutex> lock(m_guard);
-   m_timers.erase(id);
+   timers().erase(id);
 }
 
 win32::TimedCallback* TimedCallbackRegistry::getTimer(UINT_PTR id)
 {
-   std::lock_guard<std::mutex> lock(m_guard);
-   auto pos = m_timers.find(id);
-   if (pos != m_timers.end())
-      return pos->second;
-   return nullptr;
+   return timers().find(id);
+}
+
+win32::ConcurrentIdMap<win32::TimedCallback>& TimedCallbackRegistry::timers()
+{
+   static win32::ConcurrentIdMap<win32::TimedCallback> timerMap{
+      win32::allocResource(win32::AllocTag::Timer)};
+   return timerMap;
 }
 
 } // namespace
@@ -75,10 +73,14 @@ Timer& Timer::operator=(Timer&& other) noexcept
 }
 
 
-bool Timer::start(unsigned int timeOutMs)
+bool Timer::start(unsigned int timeOutMs, unsigned int toleranceMs)
 {
    if (isValid())
-      return (::SetTimer(m_hwnd, m_id, timeOutMs, NULL) != 0);
+   {
+      const ULONG tolerance =
+         (toleranceMs == 0) ? TIMERV_DEFAULT_COALESCING : toleranceMs;
+      return (::SetCoalescableTimer(m_hwnd, m_id, timeOutMs, NULL, tolerance) != 0);
+   }
    return false;
 }
 
@@ -109,24 +111,33 @@ TimedCallback& TimedCallback::operator=(TimedCallback&& other) noexcept
 {
    stop();
 
-   m_callback = other.m_callback;
+   m_callback = std::move(other.m_callback);
    m_id = other.m_id;
+   m_stats = other.m_stats;
+   m_timeOutMs = other.m_timeOutMs;
+   m_deadline = other.m_deadline;
    // Make sure dtor of moved-from timer does nothing.
-   other.m_callback = {};
    other.m_id = 0;
+   updateRegistration();
    return *this;
 }
 
 
-bool TimedCallback::start(unsigned int timeOutMs)
+bool TimedCallback::start(unsigned int timeOutMs, unsigned int toleranceMs)
 {
    if (!m_callback)
       return false;
 
-   const UINT_PTR newId =
-      ::SetTimer(NULL, m_id, timeOutMs, reinterpret_cast<TIMERPROC>(timerProc));
+   const ULONG tolerance = (toleranceMs == 0) ? TIMERV_DEFAULT_COALESCING : toleranceMs;
+   const UINT_PTR newId = ::SetCoalescableTimer(
+      NULL, m_id, timeOutMs, reinterpret_cast<TIMERPROC>(timerProc), tolerance);
    setId(newId);
 
+   m_timeOutMs = timeOutMs;
+   m_deadline = isInstrumented() ? TimerStats::Clock::now() +
+                                      std::chrono::milliseconds{timeOutMs}
+                                 : TimerStats::Clock::time_point{};
+
    return (newId != 0);
 }
 
@@ -154,6 +165,13 @@ void TimedCallback::setId(UINT_PTR id)
 }
 
 
+void TimedCallback::updateRegistration()
+{
+   if (m_id != 0)
+      TimedCallbackRegistry::registerTimer(m_id, this);
+}
+
+
 void TimedCallback::timerProc(HWND hwnd, UINT msgId, UINT timerId, DWORD sysTime)
 {
    assert(msgId == WM_TIMER);
@@ -162,14 +180,43 @@ void TimedCallback::timerProc(HWND hwnd, UINT msgId, UINT timerId, DWORD sysTime
 
    TimedCallback* timer = TimedCallbackRegistry::getTimer(timerId);
    if (timer)
+   {
+      WIN32UTIL_TRACE_ZONE("TimedCallback dispatch", "timer");
       timer->onTimerElapsed(sysTime);
+   }
 }
 
 
 void TimedCallback::onTimerElapsed(DWORD sysTime)
 {
-   if (m_callback)
+   if (!m_callback)
+      return;
+
+   if (!isInstrumented())
+   {
+      m_deadline = {};
       m_callback(sysTime);
+      return;
+   }
+
+   using Clock = TimerStats::Clock;
+   const Clock::time_point firedAt = Clock::now();
+   // Without a deadline tracking starts with the next expiry.
+   const Clock::time_point deadline = m_deadline;
+   // Win32 timers keep running with their time-out as period.
+   m_deadline = firedAt + std::chrono::milliseconds{m_timeOutMs};
+   // The callback can change the timer's stats.
+   TimerStats* stats = m_stats;
+
+   m_callback(sysTime);
+
+   if (deadline == Clock::time_point{})
+      return;
+   const Clock::time_point finishedAt = Clock::now();
+   if (stats)
+      stats->record(deadline, firedAt, finishedAt);
+   if (isTimerStatsEnabled())
+      aggregateTimerStats().record(deadline, firedAt, finishedAt);
 }
 
 } // namespace win32
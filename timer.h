@@ -7,8 +7,12 @@
 //
 #pragma once
 #ifdef _WIN32
+#include "inplace_function.h"
+#include "timer_stats.h"
 #include "win32_util_api.h"
 #include "win32_windows.h"
+#include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <utility>
 
@@ -35,7 +39,9 @@ class WIN32UTIL_API Timer
    explicit operator bool() const;
    friend void swap(Timer& a, Timer& b) noexcept;
 
-   bool start(unsigned int timeOutMs);
+   // The tolerance allows the system to delay the timer to expire together with
+   // other timers. Zero uses the system's default coalescing.
+   bool start(unsigned int timeOutMs, unsigned int toleranceMs = 0);
    bool stop();
 
  private:
@@ -95,9 +101,13 @@ inline bool Timer::isValid() const
 class WIN32UTIL_API TimedCallback
 {
  public:
+   // Fits std::function, which was the callback type before, and lambdas that
+   // capture up to eight pointers.
+   static constexpr std::size_t CallbackCapacity =
+      std::max(sizeof(std::function<void(DWORD)>), 8 * sizeof(void*));
    // Type of the callback function. Is passed the system time
-   // when the timer expired.
-   using Callback_t = std::function<void(DWORD)>;
+   // when the timer expired. Stores the callback without allocating.
+   using Callback_t = InplaceFunction<void(DWORD), CallbackCapacity>;
 
  public:
    TimedCallback() = default;
@@ -111,25 +121,40 @@ class WIN32UTIL_API TimedCallback
    explicit operator bool() const;
    friend void swap(TimedCallback& a, TimedCallback& b) noexcept;
 
-   bool start(unsigned int timeOutMs);
+   // See Timer::start for the tolerance.
+   bool start(unsigned int timeOutMs, unsigned int toleranceMs = 0);
    void stop();
 
+   // Records lateness and callback durations into the given stats, in addition to
+   // the aggregate stats if they are enabled. The stats have to outlive the timer or
+   // be detached by passing null.
+   void setStats(TimerStats* stats);
+   TimerStats* stats() const;
+
    // Only useful for testing.
    UINT_PTR id() const;
 
  private:
    void setId(UINT_PTR id);
+   // Points the registry entry of a running timer to this instance.
+   void updateRegistration();
 
    static void timerProc(HWND hwnd, UINT msgId, UINT timerId, DWORD sysTime);
    void onTimerElapsed(DWORD sysTime);
+   bool isInstrumented() const;
 
  private:
    Callback_t m_callback;
    UINT_PTR m_id = 0;
+   TimerStats* m_stats = nullptr;
+   unsigned int m_timeOutMs = 0;
+   // Deadline of the next expiry. Only tracked while instrumented, otherwise the
+   // default value.
+   TimerStats::Clock::time_point m_deadline;
 };
 
 
-inline TimedCallback::TimedCallback(Callback_t callback) : m_callback{callback}
+inline TimedCallback::TimedCallback(Callback_t callback) : m_callback{std::move(callback)}
 {
 }
 
@@ -140,8 +165,23 @@ inline TimedCallback::operator bool() const
 
 inline void swap(TimedCallback& a, TimedCallback& b) noexcept
 {
-   std::swap(a.m_callback, b.m_callback);
+   swap(a.m_callback, b.m_callback);
    std::swap(a.m_id, b.m_id);
+   std::swap(a.m_stats, b.m_stats);
+   std::swap(a.m_timeOutMs, b.m_timeOutMs);
+   std::swap(a.m_deadline, b.m_deadline);
+   a.updateRegistration();
+   b.updateRegistration();
+}
+
+inline void TimedCallback::setStats(TimerStats* stats)
+{
+   m_stats = stats;
+}
+
+inline TimerStats* TimedCallback::stats() const
+{
+   return m_stats;
 }
 
 inline UINT_PTR TimedCallback::id() const
@@ -149,6 +189,11 @@ inline UINT_PTR TimedCallback::id() const
    return m_id;
 }
 
+inline bool TimedCallback::isInstrumented() const
+{
+   return m_stats || isTimerStatsEnabled();
+}
+
 } // namespace win32
 
 #endif //_WIN32
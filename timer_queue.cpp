@@ -0,0 +1,179 @@
+//
+// Win32 utilities library
+// Timers that run on worker threads.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_queue.h"
+#include "trace.h"
+#include <algorithm>
+#include <utility>
+
+using namespace win32;
+
+
+namespace win32
+{
+///////////////////
+
+TimerQueue::TimerQueue(Execution execution, std::size_t numThreads)
+{
+   if (execution == Execution::Serial)
+      numThreads = 1;
+   else if (numThreads == 0)
+      numThreads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+   m_threads.reserve(numThreads);
+   for (std::size_t i = 0; i < numThreads; ++i)
+      m_threads.emplace_back([this]() { threadFunc(); });
+}
+
+
+TimerQueue::~TimerQueue()
+{
+   {
+      std::scoped_lock lock{m_guard};
+      m_isShuttingDown = true;
+   }
+   m_wakeup.notify_all();
+
+   for (std::thread& th : m_threads)
+      th.join();
+}
+
+
+std::size_t TimerQueue::size() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_timers.size();
+}
+
+
+TimerQueue::TimerId TimerQueue::start(Duration delay, Callback_t callback,
+                                      Duration period)
+{
+   if (!callback)
+      return 0;
+
+   const Clock::time_point due = Clock::now() + std::max(delay, Duration::zero());
+   TimerId id = 0;
+   bool isEarliest = false;
+   {
+      std::scoped_lock lock{m_guard};
+      id = m_nextId++;
+      Entry& entry = m_timers[id];
+      entry.callback = std::move(callback);
+      entry.due = due;
+      entry.period = std::max(period, Duration::zero());
+      isEarliest = m_dueTimes.empty() || due < m_dueTimes.top().due;
+      m_dueTimes.push({due, id});
+   }
+
+   // Waiting threads only need to recompute their wait time if the new timer is due
+   // before all others.
+   if (isEarliest)
+      m_wakeup.notify_one();
+   return id;
+}
+
+
+bool TimerQueue::cancel(TimerId id)
+{
+   std::unique_lock lock{m_guard};
+
+   auto pos = m_timers.find(id);
+   if (pos == m_timers.end() || pos->second.isCancelled)
+      return false;
+
+   if (!pos->second.isRunning)
+   {
+      m_timers.erase(pos);
+      return true;
+   }
+
+   // The running thread removes the entry when the callback returns.
+   pos->second.isCancelled = true;
+   if (pos->second.runningThread != std::this_thread::get_id())
+      m_finished.wait(lock, [this, id]() { return m_timers.find(id) == m_timers.end(); });
+   return true;
+}
+
+
+bool TimerQueue::isActive(TimerId id) const
+{
+   std::scoped_lock lock{m_guard};
+   auto pos = m_timers.find(id);
+   return pos != m_timers.end() && !pos->second.isCancelled;
+}
+
+
+void TimerQueue::threadFunc()
+{
+   std::unique_lock lock{m_guard};
+
+   while (!m_isShuttingDown)
+   {
+      if (m_dueTimes.empty())
+      {
+         m_wakeup.wait(lock);
+         continue;
+      }
+
+      const Due next = m_dueTimes.top();
+      if (next.due > Clock::now())
+      {
+         m_wakeup.wait_until(lock, next.due);
+         continue;
+      }
+      m_dueTimes.pop();
+
+      auto pos = m_timers.find(next.id);
+      // Cancelled while waiting.
+      if (pos == m_timers.end() || pos->second.isRunning)
+         continue;
+
+      // Another thread might be needed for the next timer.
+      if (!m_dueTimes.empty())
+         m_wakeup.notify_one();
+
+      Entry& entry = pos->second;
+      entry.isRunning = true;
+      entry.runningThread = std::this_thread::get_id();
+      Callback_t callback = std::move(entry.callback);
+
+      lock.unlock();
+      {
+         WIN32UTIL_TRACE_ZONE("TimerQueue dispatch", "timer");
+         callback();
+      }
+      lock.lock();
+
+      // Entries of running timers are only removed by their running thread.
+      pos = m_timers.find(next.id);
+      Entry& finished = pos->second;
+      finished.isRunning = false;
+      finished.runningThread = {};
+
+      if (finished.isCancelled || finished.period == Duration::zero())
+      {
+         m_timers.erase(pos);
+         m_finished.notify_all();
+      }
+      else
+      {
+         // Stay on the grid of the period but skip due times that already passed.
+         const Clock::time_point now = Clock::now();
+         finished.due += finished.period;
+         if (finished.due <= now)
+         {
+            const auto numPassed = (now - finished.due) / finished.period + 1;
+            finished.due += numPassed * finished.period;
+         }
+         finished.callback = std::move(callback);
+         m_dueTimes.push({finished.due, next.id});
+      }
+   }
+}
+
+} // namespace win32
@@ -0,0 +1,110 @@
+//
+// Win32 utilities library
+// Timers that run on worker threads.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "inplace_function.h"
+#include "win32_util_api.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Calls functions after a time-out or periodically on worker threads that the queue
+// owns, so no message loop is needed. Callbacks that have to run on a UI thread can
+// be passed on with a UiDispatcher.
+// Thread-safe.
+class WIN32UTIL_API TimerQueue
+{
+ public:
+   using Clock = std::chrono::steady_clock;
+   using Duration = Clock::duration;
+   // Zero is never used as id.
+   using TimerId = std::uint64_t;
+   using Callback_t = UniqueFunction<void()>;
+
+   enum class Execution
+   {
+      // Callbacks run one after the other on a single thread.
+      Serial,
+      // Callbacks of different timers run concurrently on a pool of threads. The
+      // callback of a single timer never overlaps with itself.
+      Parallel
+   };
+
+ public:
+   // A thread count of zero uses one thread per processor for parallel execution.
+   explicit TimerQueue(Execution execution = Execution::Serial,
+                       std::size_t numThreads = 0);
+   // Waits for running callbacks. Pending timers are discarded.
+   ~TimerQueue();
+   TimerQueue(const TimerQueue&) = delete;
+   TimerQueue& operator=(const TimerQueue&) = delete;
+
+   std::size_t numThreads() const;
+   std::size_t size() const;
+
+   // Periodic timers are due at multiples of the period after the first due time.
+   // Due times that passed while the callback was running are skipped.
+   TimerId start(Duration delay, Callback_t callback, Duration period = Duration::zero());
+   // Waits until a running callback of the timer has returned, unless called from
+   // that callback. Cancelling each other's timers from concurrently running
+   // callbacks deadlocks.
+   bool cancel(TimerId id);
+   bool isActive(TimerId id) const;
+
+ private:
+   struct Entry
+   {
+      Callback_t callback;
+      Clock::time_point due;
+      Duration period = Duration::zero();
+      bool isRunning = false;
+      bool isCancelled = false;
+      std::thread::id runningThread;
+   };
+
+   struct Due
+   {
+      Clock::time_point due;
+      TimerId id = 0;
+
+      // Makes the priority queue return the earliest time first.
+      friend bool operator<(const Due& a, const Due& b) { return a.due > b.due; }
+   };
+
+   void threadFunc();
+
+ private:
+   mutable std::mutex m_guard;
+   std::condition_variable m_wakeup;
+   // Signaled when a callback finished.
+   std::condition_variable m_finished;
+   std::unordered_map<TimerId, Entry> m_timers;
+   // Can hold entries for cancelled timers, which are skipped.
+   std::priority_queue<Due> m_dueTimes;
+   TimerId m_nextId = 1;
+   bool m_isShuttingDown = false;
+   std::vector<std::thread> m_threads;
+};
+
+
+inline std::size_t TimerQueue::numThreads() const
+{
+   return m_threads.size();
+}
+
+} // namespace win32
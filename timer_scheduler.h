@@ -0,0 +1,93 @@
+//
+// Win32 utilities library
+// Interface for scheduling timers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "clock.h"
+#ifdef _WIN32
+#include "coalescing_scheduler.h"
+#endif
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+// Schedules callbacks at times of a clock. Code that takes a scheduler instead of
+// using OS timers directly can run against SimulatedScheduler in tests.
+class TimerScheduler
+{
+ public:
+   // Zero is never used as id.
+   using TimerId = std::uint64_t;
+   using Callback_t = std::function<void(TimerId)>;
+
+ public:
+   virtual ~TimerScheduler() = default;
+
+   virtual const Clock& clock() const = 0;
+   // Periodic timers are due at multiples of the period after the first due time.
+   virtual TimerId start(std::uint64_t delayMs, Callback_t callback,
+                         std::uint64_t periodMs = 0) = 0;
+   // Can be called from callbacks.
+   virtual bool stop(TimerId id) = 0;
+   virtual bool isActive(TimerId id) const = 0;
+};
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Scheduler that runs on Win32 timers. Needs a message loop to work.
+class SystemTimerScheduler : public TimerScheduler
+{
+ public:
+   const Clock& clock() const override;
+   TimerId start(std::uint64_t delayMs, Callback_t callback,
+                 std::uint64_t periodMs = 0) override;
+   bool stop(TimerId id) override;
+   bool isActive(TimerId id) const override;
+
+ private:
+   TickCountClock m_clock;
+   CoalescingTimerScheduler m_scheduler;
+};
+
+
+inline const Clock& SystemTimerScheduler::clock() const
+{
+   return m_clock;
+}
+
+inline SystemTimerScheduler::TimerId
+SystemTimerScheduler::start(std::uint64_t delayMs, Callback_t callback,
+                            std::uint64_t periodMs)
+{
+   constexpr std::uint64_t MaxMs = std::numeric_limits<unsigned int>::max();
+   return m_scheduler.start(static_cast<unsigned int>(std::min(delayMs, MaxMs)), 0,
+                            std::move(callback),
+                            static_cast<unsigned int>(std::min(periodMs, MaxMs)));
+}
+
+inline bool SystemTimerScheduler::stop(TimerId id)
+{
+   return m_scheduler.stop(id);
+}
+
+inline bool SystemTimerScheduler::isActive(TimerId id) const
+{
+   return m_scheduler.isActive(id);
+}
+
+#endif //_WIN32
+
+} // namespace win32
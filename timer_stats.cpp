@@ -0,0 +1,79 @@
+//
+// Win32 utilities library
+// Lateness and duration statistics for timers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_stats.h"
+#include <atomic>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+std::atomic<bool> s_enabled = false;
+
+
+std::uint64_t toMicroseconds(TimerStats::Clock::duration d)
+{
+   // Fires that are early, e.g. because of coarse deadlines, count as on time.
+   if (d <= TimerStats::Clock::duration::zero())
+      return 0;
+   return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+}
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+void TimerStats::record(Clock::time_point deadline, Clock::time_point firedAt,
+                        Clock::time_point finishedAt)
+{
+   m_lateness.record(toMicroseconds(firedAt - deadline));
+   m_callbackDuration.record(toMicroseconds(finishedAt - firedAt));
+}
+
+
+TimerStatsSnapshot TimerStats::snapshot() const
+{
+   return {m_lateness.snapshot(), m_callbackDuration.snapshot()};
+}
+
+
+void TimerStats::reset()
+{
+   m_lateness.reset();
+   m_callbackDuration.reset();
+}
+
+
+///////////////////
+
+void enableTimerStats(bool enable)
+{
+   s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+bool isTimerStatsEnabled()
+{
+   return s_enabled.load(std::memory_order_relaxed);
+}
+
+
+TimerStats& aggregateTimerStats()
+{
+   // Function-local to be available during static initialization and destruction.
+   static TimerStats stats;
+   return stats;
+}
+
+} // namespace win32
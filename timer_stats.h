@@ -0,0 +1,60 @@
+//
+// Win32 utilities library
+// Lateness and duration statistics for timers.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "latency_histogram.h"
+#include "win32_util_api.h"
+#include <chrono>
+#include <cstdint>
+
+
+namespace win32
+{
+///////////////////
+
+struct TimerStatsSnapshot
+{
+   // How long after their deadline timers fired, in microseconds.
+   HistogramSnapshot lateness;
+   // How long callbacks ran, in microseconds.
+   HistogramSnapshot callbackDuration;
+};
+
+
+// Collects lateness and callback durations of timer expirations. Can be attached to
+// individual timers, while the aggregate instance collects data for all timers.
+// Thread-safe and lock-free.
+class WIN32UTIL_API TimerStats
+{
+ public:
+   using Clock = std::chrono::steady_clock;
+
+ public:
+   TimerStats() = default;
+   TimerStats(const TimerStats&) = delete;
+   TimerStats& operator=(const TimerStats&) = delete;
+
+   void record(Clock::time_point deadline, Clock::time_point firedAt,
+               Clock::time_point finishedAt);
+   TimerStatsSnapshot snapshot() const;
+   void reset();
+
+ private:
+   LatencyHistogram m_lateness;
+   LatencyHistogram m_callbackDuration;
+};
+
+
+///////////////////
+
+// Aggregate statistics are collected for all instrumented timers while enabled.
+// Disabled by default.
+WIN32UTIL_API void enableTimerStats(bool enable);
+WIN32UTIL_API bool isTimerStatsEnabled();
+WIN32UTIL_API TimerStats& aggregateTimerStats();
+
+} // namespace win32
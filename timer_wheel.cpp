@@ -0,0 +1,438 @@
+//
+// Win32 utilities library
+// Hierarchical timer wheel.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "timer_wheel.h"
+#include <algorithm>
+#include <utility>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr std::uint64_t SlotMask = TimerWheel::NumSlots - 1;
+
+// Number of ticks covered by all levels below the given level.
+constexpr std::uint64_t levelSpan(std::size_t level)
+{
+   return std::uint64_t(1) << (level * TimerWheel::SlotBits);
+}
+
+// Largest delay that the wheel can hold. Longer delays are placed at the top level
+// and get reinserted when they are cascaded.
+constexpr std::uint64_t MaxDelay = levelSpan(TimerWheel::NumLevels) - 1;
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+TimerWheel::TimerWheel(std::uint64_t now) : m_now{now}
+{
+   m_slots.fill(Nil);
+}
+
+
+TimerWheel::TimerId TimerWheel::start(std::uint64_t deadline, Callback_t callback,
+                                      std::uint64_t period)
+{
+   if (!callback)
+      return 0;
+
+   const std::uint32_t idx = allocateNode();
+   Node& node = m_nodes[idx];
+   node.callback = std::move(callback);
+   node.deadline = std::max(deadline, m_now + 1);
+   node.period = period;
+   node.state = State::Scheduled;
+   insert(idx, m_now + 1);
+   ++m_size;
+
+   return makeId(idx, node.generation);
+}
+
+
+TimerWheel::TimerId TimerWheel::startAfter(std::uint64_t delay, Callback_t callback,
+                                           std::uint64_t period)
+{
+   return start(m_now + delay, std::move(callback), period);
+}
+
+
+bool TimerWheel::stop(TimerId id)
+{
+   Node* node = lookup(id);
+   if (!node)
+      return false;
+
+   const auto idx = static_cast<std::uint32_t>(node - m_nodes.data());
+   switch (node->state)
+   {
+   case State::Scheduled:
+      if (node->list == DetachedList)
+      {
+         // Freed when the expiry reaches the node.
+         node->state = State::Cancelled;
+      }
+      else
+      {
+         unlink(idx);
+         freeNode(idx);
+      }
+      --m_size;
+      return true;
+
+   case State::Firing:
+      // Freed after the callback returned.
+      node->state = State::Cancelled;
+      --m_size;
+      return true;
+
+   default:
+      return false;
+   }
+}
+
+
+bool TimerWheel::isActive(TimerId id) const
+{
+   const Node* node = lookup(id);
+   return node && (node->state == State::Scheduled || node->state == State::Firing);
+}
+
+
+std::size_t TimerWheel::advance(std::uint64_t now)
+{
+   std::size_t numFired = 0;
+
+   while (m_now < now)
+   {
+      if (m_size == 0)
+      {
+         m_now = now;
+         break;
+      }
+
+      // Skip ahead to the next tick that has to be processed. With empty lower
+      // levels nothing happens until the next boundary of the lowest used level.
+      std::size_t lowestUsed = 0;
+      while (lowestUsed < NumLevels && m_levelSizes[lowestUsed] == 0)
+         ++lowestUsed;
+      if (lowestUsed > 0 && lowestUsed < NumLevels)
+      {
+         const std::uint64_t span = levelSpan(lowestUsed);
+         const std::uint64_t boundary = (m_now / span + 1) * span;
+         if (boundary > now)
+         {
+            m_now = now;
+            break;
+         }
+         m_now = boundary - 1;
+      }
+
+      ++m_now;
+      for (std::size_t level = NumLevels - 1; level > 0; --level)
+      {
+         if (m_now % levelSpan(level) == 0)
+            cascade(level);
+      }
+      numFired += expire();
+   }
+
+   return numFired;
+}
+
+
+std::uint64_t TimerWheel::nextDueTick() const
+{
+   if (m_size == 0)
+      return NoDueTick;
+
+   // Each level has work at the next boundary of its span whose slot holds timers.
+   // Lower levels are done at their first used slot, because their boundaries come
+   // first.
+   std::uint64_t due = NoDueTick;
+   for (std::size_t level = 0; level < NumLevels; ++level)
+   {
+      if (m_levelSizes[level] == 0)
+         continue;
+
+      const std::size_t shift = level * SlotBits;
+      const std::uint64_t base = m_now >> shift;
+      for (std::uint64_t i = 1; i <= NumSlots; ++i)
+      {
+         const auto slot = static_cast<std::size_t>((base + i) & SlotMask);
+         if (m_slots[level * NumSlots + slot] != Nil)
+         {
+            due = std::min(due, (base + i) << shift);
+            break;
+         }
+      }
+   }
+
+   // Timers that were stopped while expiring keep the size up without being in a
+   // slot.
+   return (due == NoDueTick) ? m_now + 1 : due;
+}
+
+
+TimerWheel::TimerId TimerWheel::makeId(std::uint32_t idx, std::uint32_t generation)
+{
+   return (static_cast<TimerId>(generation) << 32) | (static_cast<TimerId>(idx) + 1);
+}
+
+
+TimerWheel::Node* TimerWheel::lookup(TimerId id)
+{
+   return const_cast<Node*>(std::as_const(*this).lookup(id));
+}
+
+
+const TimerWheel::Node* TimerWheel::lookup(TimerId id) const
+{
+   const std::uint64_t idxPlusOne = id & 0xFFFFFFFF;
+   if (idxPlusOne == 0 || idxPlusOne > m_nodes.size())
+      return nullptr;
+
+   const Node& node = m_nodes[static_cast<std::size_t>(idxPlusOne - 1)];
+   const auto generation = static_cast<std::uint32_t>(id >> 32);
+   if (node.generation != generation || node.state == State::Free)
+      return nullptr;
+   return &node;
+}
+
+
+std::uint32_t TimerWheel::allocateNode()
+{
+   if (m_freeHead != Nil)
+   {
+      const std::uint32_t idx = m_freeHead;
+      m_freeHead = m_nodes[idx].next;
+      return idx;
+   }
+
+   m_nodes.emplace_back();
+   return static_cast<std::uint32_t>(m_nodes.size() - 1);
+}
+
+
+void TimerWheel::freeNode(std::uint32_t idx)
+{
+   Node& node = m_nodes[idx];
+   node.callback = nullptr;
+   node.state = State::Free;
+   // Invalidates all ids of the node.
+   ++node.generation;
+   node.next = m_freeHead;
+   m_freeHead = idx;
+}
+
+
+void TimerWheel::insert(std::uint32_t idx, std::uint64_t minDeadline)
+{
+   Node& node = m_nodes[idx];
+
+   // Choose the level by the remaining delay and the slot by the deadline's digit
+   // for that level. The slot is reached before the deadline, at which point the
+   // node gets cascaded to a lower level.
+   const std::uint64_t deadline = std::max(node.deadline, minDeadline);
+   const std::uint64_t delay = std::min(deadline - m_now, MaxDelay);
+   const std::uint64_t placedDeadline = m_now + delay;
+   std::size_t level = 0;
+   while (level < NumLevels - 1 && delay >= levelSpan(level + 1))
+      ++level;
+   const auto slot =
+      static_cast<std::size_t>((placedDeadline >> (level * SlotBits)) & SlotMask);
+
+   const auto list = static_cast<std::uint32_t>(level * NumSlots + slot);
+   node.list = list;
+   node.prev = Nil;
+   node.next = m_slots[list];
+   if (node.next != Nil)
+      m_nodes[node.next].prev = idx;
+   m_slots[list] = idx;
+   ++m_levelSizes[level];
+}
+
+
+void TimerWheel::unlink(std::uint32_t idx)
+{
+   Node& node = m_nodes[idx];
+   if (node.prev != Nil)
+      m_nodes[node.prev].next = node.next;
+   else
+      m_slots[node.list] = node.next;
+   if (node.next != Nil)
+      m_nodes[node.next].prev = node.prev;
+
+   --m_levelSizes[node.list / NumSlots];
+   node.next = Nil;
+   node.prev = Nil;
+}
+
+
+std::uint32_t TimerWheel::detach(std::uint32_t list)
+{
+   const std::uint32_t head = m_slots[list];
+   m_slots[list] = Nil;
+
+   for (std::uint32_t idx = head; idx != Nil; idx = m_nodes[idx].next)
+   {
+      m_nodes[idx].list = DetachedList;
+      --m_levelSizes[list / NumSlots];
+   }
+   return head;
+}
+
+
+void TimerWheel::cascade(std::size_t level)
+{
+   const auto slot = static_cast<std::size_t>((m_now >> (level * SlotBits)) & SlotMask);
+   std::uint32_t idx = detach(static_cast<std::uint32_t>(level * NumSlots + slot));
+
+   while (idx != Nil)
+   {
+      const std::uint32_t next = m_nodes[idx].next;
+      // Nodes that are due now end up in the slot that gets expired next.
+      insert(idx, m_now);
+      idx = next;
+   }
+}
+
+
+std::size_t TimerWheel::expire()
+{
+   std::size_t numFired = 0;
+   std::uint32_t idx = detach(static_cast<std::uint32_t>(m_now & SlotMask));
+
+   while (idx != Nil)
+   {
+      Node& node = m_nodes[idx];
+      const std::uint32_t next = node.next;
+
+      if (node.state == State::Cancelled)
+      {
+         freeNode(idx);
+      }
+      else if (node.deadline > m_now)
+      {
+         // Placed with a clipped delay.
+         insert(idx, m_now + 1);
+      }
+      else
+      {
+         fire(idx);
+         ++numFired;
+      }
+
+      idx = next;
+   }
+
+   return numFired;
+}
+
+
+void TimerWheel::fire(std::uint32_t idx)
+{
+   // The callback is moved out of the node because it might start timers and cause
+   // the node storage to grow.
+   Callback_t callback = std::move(m_nodes[idx].callback);
+   m_nodes[idx].state = State::Firing;
+   const TimerId id = makeId(idx, m_nodes[idx].generation);
+
+   callback(id);
+
+   Node& node = m_nodes[idx];
+   if (node.state == State::Firing && node.period > 0)
+   {
+      node.callback = std::move(callback);
+      node.state = State::Scheduled;
+      node.deadline += node.period;
+      insert(idx, m_now + 1);
+   }
+   else
+   {
+      if (node.state == State::Firing)
+         --m_size;
+      freeNode(idx);
+   }
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+TimerWheelScheduler::TimerWheelScheduler(unsigned int resolutionMs)
+: m_wheel{GetTickCount64()}, m_osTimer{[this](DWORD) { onTick(); }},
+  m_resolutionMs{resolutionMs}
+{
+}
+
+
+TimerWheelScheduler::TimerId
+TimerWheelScheduler::start(unsigned int timeOutMs, Callback_t callback,
+                           unsigned int periodMs)
+{
+   // Catch up with real time before computing the deadline.
+   m_wheel.advance(GetTickCount64());
+   const TimerId id = m_wheel.startAfter(timeOutMs, std::move(callback), periodMs);
+
+   // Only an earlier deadline needs the OS timer to be moved.
+   if (id != 0 && (!m_isOsTimerRunning || m_wheel.now() + timeOutMs < m_osTimerDue))
+      reprogram();
+   return id;
+}
+
+
+bool TimerWheelScheduler::stop(TimerId id)
+{
+   const bool res = m_wheel.stop(id);
+   // Otherwise the OS timer fires early at worst and gets reprogrammed then.
+   if (m_wheel.empty())
+      reprogram();
+   return res;
+}
+
+
+void TimerWheelScheduler::onTick()
+{
+   m_wheel.advance(GetTickCount64());
+   reprogram();
+}
+
+
+void TimerWheelScheduler::reprogram()
+{
+   const std::uint64_t due = m_wheel.nextDueTick();
+   if (due == TimerWheel::NoDueTick)
+   {
+      if (m_isOsTimerRunning)
+      {
+         m_osTimer.stop();
+         m_isOsTimerRunning = false;
+      }
+      return;
+   }
+
+   const std::uint64_t now = m_wheel.now();
+   const std::uint64_t delay = (due > now) ? due - now : 0;
+   const auto minTimeOutMs =
+      std::max<std::uint64_t>(m_resolutionMs, USER_TIMER_MINIMUM);
+   const auto timeOutMs = static_cast<unsigned int>(
+      std::clamp<std::uint64_t>(delay, minTimeOutMs, USER_TIMER_MAXIMUM));
+   m_isOsTimerRunning = m_osTimer.start(timeOutMs);
+   m_osTimerDue = now + timeOutMs;
+}
+
+#endif //_WIN32
+
+} // namespace win32
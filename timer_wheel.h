@@ -0,0 +1,193 @@
+//
+// Win32 utilities library
+// Hierarchical timer wheel.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#ifdef _WIN32
+#include "timer.h"
+#endif
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Schedules large numbers of timers with constant cost for starting, stopping and
+// expiring them.
+// Time is measured in ticks and only advances when the owner calls advance(). The
+// wheel has no notion of real time, so the unit of a tick is up to the owner.
+// Not thread-safe.
+class WIN32UTIL_API TimerWheel
+{
+ public:
+   // Zero is never used as id.
+   using TimerId = std::uint64_t;
+   using Callback_t = std::function<void(TimerId)>;
+
+   static constexpr std::size_t SlotBits = 6;
+   static constexpr std::size_t NumSlots = std::size_t(1) << SlotBits;
+   static constexpr std::size_t NumLevels = 6;
+   static constexpr std::uint64_t NoDueTick = std::numeric_limits<std::uint64_t>::max();
+
+ public:
+   explicit TimerWheel(std::uint64_t now = 0);
+   TimerWheel(const TimerWheel&) = delete;
+   TimerWheel& operator=(const TimerWheel&) = delete;
+
+   std::uint64_t now() const;
+   // Number of active timers.
+   std::size_t size() const;
+   bool empty() const;
+
+   // Starts a timer that expires at the given tick. Deadlines that already passed
+   // expire at the next tick. Periodic timers are rescheduled relative to their
+   // previous deadline, so they do not drift.
+   TimerId start(std::uint64_t deadline, Callback_t callback, std::uint64_t period = 0);
+   TimerId startAfter(std::uint64_t delay, Callback_t callback, std::uint64_t period = 0);
+   // Can be called from callbacks, also for the timer that is expiring.
+   bool stop(TimerId id);
+   bool isActive(TimerId id) const;
+
+   // Advances time and runs the callbacks of all timers that became due. Returns the
+   // number of run callbacks.
+   std::size_t advance(std::uint64_t now);
+   // Next tick at which advancing has work to do, i.e. expires timers or moves them
+   // closer to expiry. Owners can sleep until then. NoDueTick if no timers are
+   // active.
+   std::uint64_t nextDueTick() const;
+
+ private:
+   enum class State : std::uint8_t
+   {
+      Free,
+      Scheduled,
+      Firing,
+      Cancelled
+   };
+
+   // Timers are kept in intrusive lists of the slots and referenced by index, so
+   // that no allocations are needed after the node storage has grown.
+   struct Node
+   {
+      Callback_t callback;
+      std::uint64_t deadline = 0;
+      std::uint64_t period = 0;
+      std::uint32_t next = 0;
+      std::uint32_t prev = 0;
+      // Slot list that the node is in.
+      std::uint32_t list = 0;
+      std::uint32_t generation = 0;
+      State state = State::Free;
+   };
+
+   static constexpr std::uint32_t Nil = 0xFFFFFFFF;
+   // List id of nodes that are detached for expiry.
+   static constexpr std::uint32_t DetachedList = NumLevels * NumSlots;
+
+   static TimerId makeId(std::uint32_t idx, std::uint32_t generation);
+   Node* lookup(TimerId id);
+   const Node* lookup(TimerId id) const;
+
+   std::uint32_t allocateNode();
+   void freeNode(std::uint32_t idx);
+   // Inserts a node into the slot for its deadline. Deadlines before the given
+   // minimum are treated as due at the minimum.
+   void insert(std::uint32_t idx, std::uint64_t minDeadline);
+   void unlink(std::uint32_t idx);
+   // Detaches the list of a slot. Returns the first node.
+   std::uint32_t detach(std::uint32_t list);
+   void cascade(std::size_t level);
+   std::size_t expire();
+   void fire(std::uint32_t idx);
+
+ private:
+   std::uint64_t m_now = 0;
+   std::size_t m_size = 0;
+   std::vector<Node> m_nodes;
+   std::uint32_t m_freeHead = Nil;
+   std::array<std::uint32_t, NumLevels * NumSlots> m_slots;
+   std::array<std::size_t, NumLevels> m_levelSizes{};
+};
+
+
+inline std::uint64_t TimerWheel::now() const
+{
+   return m_now;
+}
+
+inline std::size_t TimerWheel::size() const
+{
+   return m_size;
+}
+
+inline bool TimerWheel::empty() const
+{
+   return m_size == 0;
+}
+
+
+#ifdef _WIN32
+
+///////////////////
+
+// Runs a timer wheel with millisecond ticks on a single OS timer that is only active
+// while timers are scheduled. The OS timer is set to the next tick that the wheel
+// has work for. All timers that are due are expired in one batch.
+// Needs a message loop to work.
+class WIN32UTIL_API TimerWheelScheduler
+{
+ public:
+   using TimerId = TimerWheel::TimerId;
+   using Callback_t = TimerWheel::Callback_t;
+
+ public:
+   // The resolution is the shortest interval of the OS timer. Timers that are due
+   // closer together expire in one batch.
+   explicit TimerWheelScheduler(unsigned int resolutionMs = USER_TIMER_MINIMUM);
+   TimerWheelScheduler(const TimerWheelScheduler&) = delete;
+   TimerWheelScheduler& operator=(const TimerWheelScheduler&) = delete;
+
+   std::size_t size() const;
+
+   TimerId start(unsigned int timeOutMs, Callback_t callback, unsigned int periodMs = 0);
+   bool stop(TimerId id);
+   bool isActive(TimerId id) const;
+
+ private:
+   void onTick();
+   // Sets the OS timer to the next tick that the wheel has work for.
+   void reprogram();
+
+ private:
+   TimerWheel m_wheel;
+   TimedCallback m_osTimer;
+   unsigned int m_resolutionMs = USER_TIMER_MINIMUM;
+   bool m_isOsTimerRunning = false;
+   // Tick at which the OS timer fires next.
+   std::uint64_t m_osTimerDue = 0;
+};
+
+
+inline std::size_t TimerWheelScheduler::size() const
+{
+   return m_wheel.size();
+}
+
+inline bool TimerWheelScheduler::isActive(TimerId id) const
+{
+   return m_wheel.isActive(id);
+}
+
+#endif //_WIN32
+
+} // namespace win32
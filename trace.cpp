@@ -0,0 +1,539 @@
+//
+// Win32 utilities library
+// Low-overhead tracing.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "trace.h"
+#include "ring_buffer.h"
+#ifdef _WIN32
+#include "win32_windows.h"
+#else
+#include <time.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+std::atomic<std::size_t> s_bufferSize = std::size_t(1) << 20;
+std::atomic<std::size_t> s_numDropped = 0;
+std::atomic<std::uint32_t> s_nextThreadId = 1;
+
+
+///////////////////
+
+// Events of one thread. The thread is the producer of the ring buffer, the
+// collecting thread its consumer.
+class ThreadTraceBuffer
+{
+ public:
+   ThreadTraceBuffer();
+   ~ThreadTraceBuffer();
+   ThreadTraceBuffer(const ThreadTraceBuffer&) = delete;
+   ThreadTraceBuffer& operator=(const ThreadTraceBuffer&) = delete;
+
+   void record(TraceEvent event);
+   // Has to be called with the registry lock held.
+   void drainTo(std::vector<TraceEvent>& events);
+
+ private:
+   std::uint32_t m_threadId = 0;
+   SpscRingBuffer m_buffer;
+};
+
+
+///////////////////
+
+// Keeps track of the buffers of all threads.
+class TraceRegistry
+{
+ public:
+   static void add(ThreadTraceBuffer* buffer);
+   // Keeps the events of the exiting thread until they are collected.
+   static void remove(ThreadTraceBuffer* buffer);
+   static std::vector<TraceEvent> collect();
+
+ private:
+   static std::mutex& guard();
+   static std::vector<ThreadTraceBuffer*>& threads();
+   static std::vector<TraceEvent>& retired();
+};
+
+
+void TraceRegistry::add(ThreadTraceBuffer* buffer)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   threads().push_back(buffer);
+}
+
+
+void TraceRegistry::remove(ThreadTraceBuffer* buffer)
+{
+   std::lock_guard<std::mutex> lock(guard());
+   buffer->drainTo(retired());
+   threads().erase(std::remove(threads().begin(), threads().end(), buffer),
+                   threads().end());
+}
+
+
+std::vector<TraceEvent> TraceRegistry::collect()
+{
+   std::lock_guard<std::mutex> lock(guard());
+
+   std::vector<TraceEvent> events;
+   events.swap(retired());
+   for (ThreadTraceBuffer* buffer : threads())
+      buffer->drainTo(events);
+
+   std::stable_sort(events.begin(), events.end(),
+                    [](const TraceEvent& a, const TraceEvent& b)
+                    { return a.timestamp < b.timestamp; });
+   return events;
+}
+
+
+std::mutex& TraceRegistry::guard()
+{
+   // Function-local to be available during static initialization and destruction.
+   static std::mutex registryGuard;
+   return registryGuard;
+}
+
+
+std::vector<ThreadTraceBuffer*>& TraceRegistry::threads()
+{
+   static std::vector<ThreadTraceBuffer*> threadBuffers;
+   return threadBuffers;
+}
+
+
+std::vector<TraceEvent>& TraceRegistry::retired()
+{
+   static std::vector<TraceEvent> retiredEvents;
+   return retiredEvents;
+}
+
+
+///////////////////
+
+// Set when the buffer of the current thread was destroyed during thread exit.
+// Events that are recorded afterwards are dropped.
+thread_local bool t_isBufferDestroyed = false;
+
+
+ThreadTraceBuffer* threadBuffer()
+{
+   if (t_isBufferDestroyed)
+      return nullptr;
+   thread_local ThreadTraceBuffer buffer;
+   return &buffer;
+}
+
+
+ThreadTraceBuffer::ThreadTraceBuffer()
+: m_threadId{s_nextThreadId.fetch_add(1, std::memory_order_relaxed)},
+  m_buffer{s_bufferSize.load(std::memory_order_relaxed)}
+{
+   TraceRegistry::add(this);
+}
+
+
+ThreadTraceBuffer::~ThreadTraceBuffer()
+{
+   TraceRegistry::remove(this);
+   t_isBufferDestroyed = true;
+}
+
+
+void ThreadTraceBuffer::record(TraceEvent event)
+{
+   event.threadId = m_threadId;
+   if (!m_buffer || !m_buffer.write(std::as_bytes(std::span{&event, 1})))
+      s_numDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void ThreadTraceBuffer::drainTo(std::vector<TraceEvent>& events)
+{
+   if (!m_buffer)
+      return;
+
+   // Producers only write whole events.
+   const std::span<const std::byte> readable = m_buffer.beginRead();
+   const std::size_t numEvents = readable.size() / sizeof(TraceEvent);
+   if (numEvents == 0)
+      return;
+
+   const std::size_t first = events.size();
+   events.resize(first + numEvents);
+   std::memcpy(events.data() + first, readable.data(), numEvents * sizeof(TraceEvent));
+   m_buffer.endRead(numEvents * sizeof(TraceEvent));
+}
+
+
+///////////////////
+
+void writeJsonString(std::ostringstream& out, const char* str)
+{
+   out << '"';
+   for (; *str; ++str)
+   {
+      const char ch = *str;
+      if (ch == '"' || ch == '\\')
+         out << '\\' << ch;
+      else if (static_cast<unsigned char>(ch) < 0x20)
+         out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+             << static_cast<int>(ch) << std::dec << std::setfill(' ');
+      else
+         out << ch;
+   }
+   out << '"';
+}
+
+
+///////////////////
+
+constexpr std::array<char, 8> BinaryTraceMagic{'W', '3', '2', 'T', 'R', 'A', 'C', 'E'};
+constexpr std::uint32_t BinaryTraceVersion = 1;
+
+
+template <typename T> void appendPod(std::vector<std::byte>& data, const T& val)
+{
+   static_assert(std::is_trivially_copyable_v<T>);
+   const std::size_t pos = data.size();
+   data.resize(pos + sizeof(T));
+   std::memcpy(data.data() + pos, &val, sizeof(T));
+}
+
+
+// Reads from a byte vector with bounds checks.
+class BinaryReader
+{
+ public:
+   explicit BinaryReader(const std::vector<std::byte>& data) : m_data{data} {}
+
+   template <typename T> bool read(T& val)
+   {
+      static_assert(std::is_trivially_copyable_v<T>);
+      if (m_data.size() - m_pos < sizeof(T))
+         return false;
+      std::memcpy(&val, m_data.data() + m_pos, sizeof(T));
+      m_pos += sizeof(T);
+      return true;
+   }
+
+   std::size_t remaining() const { return m_data.size() - m_pos; }
+
+   bool read(std::string& str, std::size_t len)
+   {
+      if (m_data.size() - m_pos < len)
+         return false;
+      str.assign(reinterpret_cast<const char*>(m_data.data() + m_pos), len);
+      m_pos += len;
+      return true;
+   }
+
+ private:
+   const std::vector<std::byte>& m_data;
+   std::size_t m_pos = 0;
+};
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+namespace detail
+{
+
+std::atomic<bool> tracingEnabledFlag = false;
+
+
+void recordTraceEvent(const TraceEvent& event)
+{
+   ThreadTraceBuffer* buffer = threadBuffer();
+   if (buffer)
+      buffer->record(event);
+}
+
+} // namespace detail
+
+
+///////////////////
+
+std::uint64_t traceTimestamp()
+{
+#ifdef _WIN32
+   LARGE_INTEGER counter;
+   ::QueryPerformanceCounter(&counter);
+   return static_cast<std::uint64_t>(counter.QuadPart);
+#else
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 +
+          static_cast<std::uint64_t>(ts.tv_nsec);
+#endif
+}
+
+
+std::uint64_t traceTicksPerSecond()
+{
+#ifdef _WIN32
+   static const std::uint64_t ticksPerSecond = []()
+   {
+      LARGE_INTEGER freq;
+      ::QueryPerformanceFrequency(&freq);
+      return static_cast<std::uint64_t>(freq.QuadPart);
+   }();
+   return ticksPerSecond;
+#else
+   return 1000000000;
+#endif
+}
+
+
+void enableTracing(bool enable)
+{
+   detail::tracingEnabledFlag.store(enable, std::memory_order_relaxed);
+}
+
+
+void setTraceBufferSize(std::size_t numBytes)
+{
+   s_bufferSize.store(numBytes, std::memory_order_relaxed);
+}
+
+
+std::vector<TraceEvent> collectTraceEvents()
+{
+   return TraceRegistry::collect();
+}
+
+
+std::size_t numDroppedTraceEvents()
+{
+   return s_numDropped.load(std::memory_order_relaxed);
+}
+
+
+void resetTracing()
+{
+   TraceRegistry::collect();
+   s_numDropped.store(0, std::memory_order_relaxed);
+}
+
+
+void traceInstant(const char* name, const char* category)
+{
+   if (!isTracingEnabled())
+      return;
+
+   TraceEvent event;
+   event.timestamp = traceTimestamp();
+   event.name = name;
+   event.category = category;
+   event.type = TraceEventType::Instant;
+   detail::recordTraceEvent(event);
+}
+
+
+void traceCounter(const char* name, double value, const char* category)
+{
+   if (!isTracingEnabled())
+      return;
+
+   TraceEvent event;
+   event.timestamp = traceTimestamp();
+   event.value = value;
+   event.name = name;
+   event.category = category;
+   event.type = TraceEventType::Counter;
+   detail::recordTraceEvent(event);
+}
+
+
+///////////////////
+
+std::string exportChromeTrace(const std::vector<TraceEvent>& events,
+                              std::uint64_t ticksPerSecond)
+{
+   assert(ticksPerSecond > 0);
+
+   // Times are in microseconds relative to the first event.
+   const double usPerTick = 1e6 / static_cast<double>(ticksPerSecond);
+   const std::uint64_t base = events.empty() ? 0 : events.front().timestamp;
+   auto toUs = [usPerTick](std::uint64_t ticks)
+   { return static_cast<double>(ticks) * usPerTick; };
+
+   std::ostringstream out;
+   out << std::fixed << std::setprecision(3);
+   out << "{\"traceEvents\":[";
+
+   for (std::size_t i = 0; i < events.size(); ++i)
+   {
+      const TraceEvent& event = events[i];
+      if (i > 0)
+         out << ',';
+      out << "\n{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"cat\":";
+      writeJsonString(out, event.category);
+      // Events recorded before the base are not expected but must not underflow.
+      const std::uint64_t ts = (event.timestamp > base) ? event.timestamp - base : 0;
+      out << ",\"ts\":" << toUs(ts) << ",\"pid\":1,\"tid\":" << event.threadId;
+
+      switch (event.type)
+      {
+      case TraceEventType::Complete:
+         out << ",\"ph\":\"X\",\"dur\":" << toUs(event.duration);
+         break;
+      case TraceEventType::Instant:
+         out << ",\"ph\":\"i\",\"s\":\"t\"";
+         break;
+      case TraceEventType::Counter:
+         out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << '}';
+         break;
+      }
+      out << '}';
+   }
+
+   out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+   return out.str();
+}
+
+
+std::vector<std::byte> exportBinaryTrace(const std::vector<TraceEvent>& events)
+{
+   // Assign indices to distinct names and categories.
+   std::vector<const char*> strings;
+   std::unordered_map<std::string, std::uint32_t> stringIndices;
+   auto indexOf = [&](const char* str)
+   {
+      auto [pos, isNew] =
+         stringIndices.emplace(str, static_cast<std::uint32_t>(strings.size()));
+      if (isNew)
+         strings.push_back(str);
+      return pos->second;
+   };
+
+   std::vector<std::pair<std::uint32_t, std::uint32_t>> eventStrings;
+   eventStrings.reserve(events.size());
+   for (const TraceEvent& event : events)
+      eventStrings.emplace_back(indexOf(event.name), indexOf(event.category));
+
+   std::vector<std::byte> data;
+   appendPod(data, BinaryTraceMagic);
+   appendPod(data, BinaryTraceVersion);
+   appendPod(data, traceTicksPerSecond());
+   appendPod(data, static_cast<std::uint32_t>(strings.size()));
+   appendPod(data, static_cast<std::uint64_t>(events.size()));
+
+   for (const char* str : strings)
+   {
+      const std::size_t len = std::strlen(str);
+      appendPod(data, static_cast<std::uint32_t>(len));
+      const std::size_t pos = data.size();
+      data.resize(pos + len);
+      std::memcpy(data.data() + pos, str, len);
+   }
+
+   for (std::size_t i = 0; i < events.size(); ++i)
+   {
+      const TraceEvent& event = events[i];
+      appendPod(data, event.timestamp);
+      appendPod(data, event.duration);
+      appendPod(data, event.value);
+      appendPod(data, eventStrings[i].first);
+      appendPod(data, eventStrings[i].second);
+      appendPod(data, event.threadId);
+      appendPod(data, event.type);
+   }
+
+   return data;
+}
+
+
+std::optional<std::vector<TraceEvent>>
+importBinaryTrace(const std::vector<std::byte>& data, std::vector<std::string>& strings,
+                  std::uint64_t& ticksPerSecond)
+{
+   BinaryReader reader{data};
+
+   std::array<char, 8> magic{};
+   std::uint32_t version = 0;
+   std::uint32_t numStrings = 0;
+   std::uint64_t numEvents = 0;
+   if (!reader.read(magic) || magic != BinaryTraceMagic || !reader.read(version) ||
+       version != BinaryTraceVersion || !reader.read(ticksPerSecond) ||
+       ticksPerSecond == 0 || !reader.read(numStrings) || !reader.read(numEvents))
+   {
+      return std::nullopt;
+   }
+
+   // Reject counts that the data cannot hold before allocating for them.
+   if (numStrings > reader.remaining() / sizeof(std::uint32_t))
+      return std::nullopt;
+
+   // Fill the strings completely before events point into them.
+   strings.clear();
+   strings.resize(numStrings);
+   for (std::string& str : strings)
+   {
+      std::uint32_t len = 0;
+      if (!reader.read(len) || !reader.read(str, len))
+         return std::nullopt;
+   }
+
+   constexpr std::size_t EventSize =
+      sizeof(TraceEvent::timestamp) + sizeof(TraceEvent::duration) +
+      sizeof(TraceEvent::value) + 2 * sizeof(std::uint32_t) +
+      sizeof(TraceEvent::threadId) + sizeof(TraceEvent::type);
+   if (numEvents > reader.remaining() / EventSize)
+      return std::nullopt;
+
+   std::vector<TraceEvent> events;
+   events.reserve(static_cast<std::size_t>(numEvents));
+   for (std::uint64_t i = 0; i < numEvents; ++i)
+   {
+      TraceEvent event;
+      std::uint32_t nameIdx = 0;
+      std::uint32_t categoryIdx = 0;
+      if (!reader.read(event.timestamp) || !reader.read(event.duration) ||
+          !reader.read(event.value) || !reader.read(nameIdx) ||
+          !reader.read(categoryIdx) || !reader.read(event.threadId) ||
+          !reader.read(event.type))
+      {
+         return std::nullopt;
+      }
+      if (nameIdx >= strings.size() || categoryIdx >= strings.size() ||
+          event.type > TraceEventType::Counter)
+      {
+         return std::nullopt;
+      }
+
+      event.name = strings[nameIdx].c_str();
+      event.category = strings[categoryIdx].c_str();
+      events.push_back(event);
+   }
+
+   return events;
+}
+
+} // namespace win32
@@ -0,0 +1,163 @@
+//
+// Win32 utilities library
+// Low-overhead tracing.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "win32_util_api.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+enum class TraceEventType : std::uint8_t
+{
+   // Zone with a duration.
+   Complete,
+   Instant,
+   Counter
+};
+
+
+// Names and categories have to be string literals or otherwise outlive all uses of
+// the trace.
+struct TraceEvent
+{
+   // Ticks of traceTimestamp().
+   std::uint64_t timestamp = 0;
+   // Ticks. Only used by complete events.
+   std::uint64_t duration = 0;
+   // Only used by counter events.
+   double value = 0.;
+   const char* name = "";
+   const char* category = "";
+   // Numbered in the order threads first recorded an event, starting at one.
+   std::uint32_t threadId = 0;
+   TraceEventType type = TraceEventType::Instant;
+};
+
+
+///////////////////
+
+// Ticks of a monotonic clock. Uses QueryPerformanceCounter on Windows, which reads
+// the invariant TSC on current hardware, and clock_gettime on Linux.
+WIN32UTIL_API std::uint64_t traceTimestamp();
+WIN32UTIL_API std::uint64_t traceTicksPerSecond();
+
+// Events are recorded into a ring buffer per thread and only merged when they are
+// collected, so recording does not synchronize threads. Events that do not fit into
+// a full buffer are dropped. Disabled by default.
+WIN32UTIL_API void enableTracing(bool enable);
+inline bool isTracingEnabled();
+// Capacity of the buffers of threads that record their first event afterwards.
+WIN32UTIL_API void setTraceBufferSize(std::size_t numBytes);
+// Removes the events of all threads and returns them sorted by time.
+WIN32UTIL_API std::vector<TraceEvent> collectTraceEvents();
+WIN32UTIL_API std::size_t numDroppedTraceEvents();
+// Discards recorded events and resets the drop count.
+WIN32UTIL_API void resetTracing();
+
+WIN32UTIL_API void traceInstant(const char* name, const char* category = "");
+WIN32UTIL_API void traceCounter(const char* name, double value,
+                                const char* category = "");
+
+
+///////////////////
+
+// Chrome Trace Event format, loadable in chrome://tracing and Perfetto. Ticks are
+// converted with the given rate, e.g. the rate of the machine that recorded an
+// imported trace.
+WIN32UTIL_API std::string
+exportChromeTrace(const std::vector<TraceEvent>& events,
+                  std::uint64_t ticksPerSecond = traceTicksPerSecond());
+
+// Compact binary format that stores names in a string table. Imported events
+// reference names in the given string storage and keep the ticks of the machine that
+// recorded them.
+WIN32UTIL_API std::vector<std::byte>
+exportBinaryTrace(const std::vector<TraceEvent>& events);
+WIN32UTIL_API std::optional<std::vector<TraceEvent>>
+importBinaryTrace(const std::vector<std::byte>& data, std::vector<std::string>& strings,
+                  std::uint64_t& ticksPerSecond);
+
+
+///////////////////
+
+namespace detail
+{
+
+extern WIN32UTIL_API std::atomic<bool> tracingEnabledFlag;
+
+WIN32UTIL_API void recordTraceEvent(const TraceEvent& event);
+
+} // namespace detail
+
+
+inline bool isTracingEnabled()
+{
+   return detail::tracingEnabledFlag.load(std::memory_order_relaxed);
+}
+
+
+///////////////////
+
+// Records the time between construction and destruction as a complete event. Costs
+// a branch while tracing is disabled.
+class TraceZone
+{
+ public:
+   explicit TraceZone(const char* name, const char* category = "");
+   ~TraceZone();
+   TraceZone(const TraceZone&) = delete;
+   TraceZone& operator=(const TraceZone&) = delete;
+
+ private:
+   const char* m_name = "";
+   const char* m_category = "";
+   // Zero if tracing was disabled when the zone started.
+   std::uint64_t m_start = 0;
+};
+
+
+inline TraceZone::TraceZone(const char* name, const char* category)
+: m_name{name}, m_category{category}
+{
+   if (isTracingEnabled())
+      m_start = traceTimestamp();
+}
+
+inline TraceZone::~TraceZone()
+{
+   if (m_start != 0)
+   {
+      TraceEvent event;
+      event.timestamp = m_start;
+      event.duration = traceTimestamp() - m_start;
+      event.name = m_name;
+      event.category = m_category;
+      event.type = TraceEventType::Complete;
+      detail::recordTraceEvent(event);
+   }
+}
+
+} // namespace win32
+
+
+// Defining WIN32UTIL_NO_TRACE compiles the library's zones out.
+#define WIN32UTIL_TRACE_CONCAT_IMPL(a, b) a##b
+#define WIN32UTIL_TRACE_CONCAT(a, b) WIN32UTIL_TRACE_CONCAT_IMPL(a, b)
+#ifdef WIN32UTIL_NO_TRACE
+#define WIN32UTIL_TRACE_ZONE(name, category)
+#else
+#define WIN32UTIL_TRACE_ZONE(name, category)                                             \
+   win32::TraceZone WIN32UTIL_TRACE_CONCAT(traceZone, __LINE__) { name, category }
+#endif
@@ -0,0 +1,106 @@
+//
+// Win32 utilities library
+// Marshals work to a UI thread.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#ifdef _WIN32
+#include "ui_dispatcher.h"
+#include <tchar.h>
+#include <utility>
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+constexpr UINT WM_RUN_TASKS = WM_APP + 1;
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+UiDispatcher::~UiDispatcher()
+{
+   if (hwnd())
+      ::DestroyWindow(hwnd());
+}
+
+
+bool UiDispatcher::create()
+{
+   return Window::create(HWND_MESSAGE, Rect{}, _T(""), 0);
+}
+
+
+bool UiDispatcher::post(Task_t task)
+{
+   if (!task || !hwnd())
+      return false;
+
+   std::scoped_lock lock{m_guard};
+   m_pending.push_back(std::move(task));
+
+   // A message is already on its way for the earlier tasks.
+   if (m_isMessagePosted)
+      return true;
+
+   m_isMessagePosted = postMessage(WM_RUN_TASKS);
+   if (!m_isMessagePosted)
+   {
+      m_pending.pop_back();
+      return false;
+   }
+   ++m_numPostedMessages;
+   return true;
+}
+
+
+std::size_t UiDispatcher::numPostedMessages() const
+{
+   std::scoped_lock lock{m_guard};
+   return m_numPostedMessages;
+}
+
+
+const TCHAR* UiDispatcher::windowClassName() const
+{
+   return _T("Win32UiDispatcherClass");
+}
+
+
+LRESULT UiDispatcher::handleMessage(HWND hwnd, UINT msgId, WPARAM wParam, LPARAM lParam)
+{
+   if (msgId == WM_RUN_TASKS)
+   {
+      runTasks();
+      return 0;
+   }
+   return Window::handleMessage(hwnd, msgId, wParam, lParam);
+}
+
+
+void UiDispatcher::runTasks()
+{
+   std::vector<Task_t> batch;
+   {
+      std::scoped_lock lock{m_guard};
+      batch.swap(m_pending);
+      // Tasks posted from now on need a new message.
+      m_isMessagePosted = false;
+   }
+
+   // Tasks can post further tasks or run nested message loops.
+   for (Task_t& task : batch)
+      task();
+}
+
+} // namespace win32
+
+#endif //_WIN32
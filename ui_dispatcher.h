@@ -0,0 +1,58 @@
+//
+// Win32 utilities library
+// Marshals work to a UI thread.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#ifdef _WIN32
+#include "inplace_function.h"
+#include "win32_util_api.h"
+#include "win32_windows.h"
+#include "window.h"
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+
+namespace win32
+{
+///////////////////
+
+// Runs tasks that other threads post on the thread that created the dispatcher.
+// All tasks that are posted before the UI thread gets to run them share a single
+// posted message, so bursts of timer callbacks from a TimerQueue cost one message
+// per batch instead of one per callback.
+// Posting is thread-safe. Creation and destruction have to happen on the UI thread.
+class WIN32UTIL_API UiDispatcher : private Window
+{
+ public:
+   using Task_t = UniqueFunction<void()>;
+
+ public:
+   UiDispatcher() = default;
+   ~UiDispatcher();
+   UiDispatcher(const UiDispatcher&) = delete;
+   UiDispatcher& operator=(const UiDispatcher&) = delete;
+
+   // Creates the message-only window that receives the batch messages.
+   bool create();
+   bool post(Task_t task);
+   std::size_t numPostedMessages() const;
+
+ private:
+   const TCHAR* windowClassName() const override;
+   LRESULT handleMessage(HWND hwnd, UINT msgId, WPARAM wParam, LPARAM lParam) override;
+   void runTasks();
+
+ private:
+   mutable std::mutex m_guard;
+   std::vector<Task_t> m_pending;
+   bool m_isMessagePosted = false;
+   std::size_t m_numPostedMessages = 0;
+};
+
+} // namespace win32
+
+#endif //_WIN32
@@ -0,0 +1,264 @@
+//
+// Win32 utilities library
+// Page-granular virtual memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#include "virtual_mem.h"
+#include <cstdint>
+#ifdef _WIN32
+#include "win32_windows.h"
+#else
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace win32;
+
+
+namespace
+{
+///////////////////
+
+std::size_t roundUp(std::size_t numBytes, std::size_t granularity)
+{
+   return (numBytes + granularity - 1) / granularity * granularity;
+}
+
+
+#ifdef _WIN32
+
+std::size_t querySystemPageSize()
+{
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwPageSize;
+}
+
+
+std::size_t querySystemLargePageSize()
+{
+   return GetLargePageMinimum();
+}
+
+
+std::byte* reserveLargePages(std::size_t numBytes)
+{
+   // Large pages cannot be committed on demand.
+   return static_cast<std::byte*>(VirtualAlloc(
+      NULL, numBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+}
+
+
+std::byte* reservePages(std::size_t numBytes)
+{
+   return static_cast<std::byte*>(
+      VirtualAlloc(NULL, numBytes, MEM_RESERVE, PAGE_NOACCESS));
+}
+
+
+bool commitPages(std::byte* p, std::size_t numBytes)
+{
+   return VirtualAlloc(p, numBytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+
+bool decommitPages(std::byte* p, std::size_t numBytes)
+{
+   return VirtualFree(p, numBytes, MEM_DECOMMIT) != FALSE;
+}
+
+
+void releasePages(std::byte* p, std::size_t /*numBytes*/)
+{
+   VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#else
+
+std::size_t querySystemPageSize()
+{
+   return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+std::size_t querySystemLargePageSize()
+{
+   std::ifstream meminfo{"/proc/meminfo"};
+   std::string key;
+   while (meminfo >> key)
+   {
+      if (key == "Hugepagesize:")
+      {
+         std::size_t sizeKb = 0;
+         meminfo >> sizeKb;
+         return sizeKb * 1024;
+      }
+   }
+   return 0;
+}
+
+
+std::byte* reservePages(std::size_t numBytes)
+{
+   void* p = mmap(nullptr, numBytes, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   return (p != MAP_FAILED) ? static_cast<std::byte*>(p) : nullptr;
+}
+
+
+std::byte* reserveLargePages(std::size_t numBytes)
+{
+#ifdef MADV_HUGEPAGE
+   // Only huge page aligned ranges can be backed by transparent huge pages, so
+   // reserve an extra page to align the start and unmap the slack.
+   const std::size_t hugePageSize = win32::largePageSize();
+   const std::size_t reservedSize = numBytes + hugePageSize;
+   std::byte* reserved = reservePages(reservedSize);
+   if (!reserved)
+      return nullptr;
+
+   const auto addr = reinterpret_cast<std::uintptr_t>(reserved);
+   std::byte* p = reserved + (roundUp(addr, hugePageSize) - addr);
+   const std::size_t headSize = static_cast<std::size_t>(p - reserved);
+   const std::size_t tailSize = reservedSize - headSize - numBytes;
+   if (headSize > 0)
+      munmap(reserved, headSize);
+   if (tailSize > 0)
+      munmap(p + numBytes, tailSize);
+
+   // Transparent huge pages can still be committed on demand.
+   if (madvise(p, numBytes, MADV_HUGEPAGE) != 0)
+   {
+      munmap(p, numBytes);
+      return nullptr;
+   }
+   return p;
+#else
+   return nullptr;
+#endif
+}
+
+
+bool commitPages(std::byte* p, std::size_t numBytes)
+{
+   return mprotect(p, numBytes, PROT_READ | PROT_WRITE) == 0;
+}
+
+
+bool decommitPages(std::byte* p, std::size_t numBytes)
+{
+   return (madvise(p, numBytes, MADV_DONTNEED) == 0 &&
+           mprotect(p, numBytes, PROT_NONE) == 0);
+}
+
+
+void releasePages(std::byte* p, std::size_t numBytes)
+{
+   munmap(p, numBytes);
+}
+
+#endif //_WIN32
+
+} // namespace
+
+
+namespace win32
+{
+///////////////////
+
+std::size_t pageSize()
+{
+   static const std::size_t size = querySystemPageSize();
+   return size;
+}
+
+
+std::size_t largePageSize()
+{
+   static const std::size_t size = querySystemLargePageSize();
+   return size;
+}
+
+
+///////////////////
+
+bool VirtualMem::reserve(std::size_t numBytes, PageHint hint)
+{
+   release();
+   if (numBytes == 0)
+      return false;
+
+   if (hint == PageHint::Large && largePageSize() != 0)
+   {
+      const std::size_t size = roundUp(numBytes, largePageSize());
+      m_ptr = reserveLargePages(size);
+      if (m_ptr)
+      {
+         m_reserved = size;
+#ifdef _WIN32
+         m_committed = size;
+#endif
+         m_isLargePages = true;
+         return true;
+      }
+   }
+
+   const std::size_t size = roundUp(numBytes, pageSize());
+   m_ptr = reservePages(size);
+   if (m_ptr)
+      m_reserved = size;
+   return m_ptr != nullptr;
+}
+
+
+bool VirtualMem::commit(std::size_t numBytes)
+{
+   if (numBytes <= m_committed)
+      return true;
+   if (numBytes > m_reserved)
+      return false;
+
+   const std::size_t newCommitted = roundUp(numBytes, pageSize());
+   if (!commitPages(m_ptr + m_committed, newCommitted - m_committed))
+      return false;
+
+   m_committed = newCommitted;
+   return true;
+}
+
+
+bool VirtualMem::decommit(std::size_t numBytes)
+{
+#ifdef _WIN32
+   if (m_isLargePages)
+      return true;
+#endif
+
+   const std::size_t newCommitted = roundUp(numBytes, pageSize());
+   if (newCommitted >= m_committed)
+      return true;
+
+   if (!decommitPages(m_ptr + newCommitted, m_committed - newCommitted))
+      return false;
+
+   m_committed = newCommitted;
+   return true;
+}
+
+
+void VirtualMem::release()
+{
+   if (m_ptr)
+      releasePages(m_ptr, m_reserved);
+
+   m_ptr = nullptr;
+   m_reserved = 0;
+   m_committed = 0;
+   m_isLargePages = false;
+}
+
+} // namespace win32
@@ -0,0 +1,420 @@
+//
+// Win32 utilities library
+// Page-granular virtual memory.
+//
+// Jun-2019, Michael Lindner
+// MIT license
+//
+#pragma once
+#include "mem_util.h"
+#include "win32_util_api.h"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+
+namespace win32
+{
+///////////////////
+
+// Size of the pages that memory is committed in.
+WIN32UTIL_API std::size_t pageSize();
+// Size of large pages or zero if large pages are not supported.
+WIN32UTIL_API std::size_t largePageSize();
+
+
+enum class PageHint
+{
+   Default,
+   // Tries to back the memory with large pages. On Windows this requires the lock
+   // memory privilege and commits the whole range up front. On Linux transparent huge
+   // pages are requested for the range.
+   Large
+};
+
+
+///////////////////
+
+// RAII class for a range of reserved address space whose pages are committed on
+// demand. The committed pages always form a prefix of the reserved range, so the
+// memory never moves when it grows.
+class WIN32UTIL_API VirtualMem
+{
+ public:
+   VirtualMem() = default;
+   ~VirtualMem();
+   VirtualMem(const VirtualMem&) = delete;
+   VirtualMem(VirtualMem&& other) noexcept;
+   VirtualMem& operator=(const VirtualMem&) = delete;
+   VirtualMem& operator=(VirtualMem&& other) noexcept;
+
+   explicit operator bool() const;
+   friend void swap(VirtualMem& a, VirtualMem& b) noexcept;
+
+   std::byte* data();
+   const std::byte* data() const;
+   // Size of the reserved range.
+   std::size_t reserved() const;
+   // Size of the committed prefix of the range.
+   std::size_t committed() const;
+   bool isLargePages() const;
+   std::span<std::byte> span();
+   std::span<const std::byte> span() const;
+
+   // Reserves address space. Releases any previous range. Sizes get rounded up to
+   // whole pages.
+   bool reserve(std::size_t numBytes, PageHint hint = PageHint::Default);
+   // Makes sure at least the given number of bytes are committed.
+   bool commit(std::size_t numBytes);
+   // Returns the pages beyond the given number of bytes to the system. Their
+   // content is lost. Has no effect for large pages on Windows because they are
+   // committed up front.
+   bool decommit(std::size_t numBytes);
+   void release();
+
+ private:
+   std::byte* m_ptr = nullptr;
+   std::size_t m_reserved = 0;
+   std::size_t m_committed = 0;
+   bool m_isLargePages = false;
+};
+
+
+inline VirtualMem::~VirtualMem()
+{
+   release();
+}
+
+inline VirtualMem::VirtualMem(VirtualMem&& other) noexcept
+{
+   swap(*this, other);
+}
+
+inline VirtualMem& VirtualMem::operator=(VirtualMem&& other) noexcept
+{
+   release();
+   swap(*this, other);
+   return *this;
+}
+
+inline VirtualMem::operator bool() const
+{
+   return m_ptr != nullptr;
+}
+
+inline void swap(VirtualMem& a, VirtualMem& b) noexcept
+{
+   std::swap(a.m_ptr, b.m_ptr);
+   std::swap(a.m_reserved, b.m_reserved);
+   std::swap(a.m_committed, b.m_committed);
+   std::swap(a.m_isLargePages, b.m_isLargePages);
+}
+
+inline std::byte* VirtualMem::data()
+{
+   return m_ptr;
+}
+
+inline const std::byte* VirtualMem::data() const
+{
+   return m_ptr;
+}
+
+inline std::size_t VirtualMem::reserved() const
+{
+   return m_reserved;
+}
+
+inline std::size_t VirtualMem::committed() const
+{
+   return m_committed;
+}
+
+inline bool VirtualMem::isLargePages() const
+{
+   return m_isLargePages;
+}
+
+inline std::span<std::byte> VirtualMem::span()
+{
+   return {m_ptr, m_committed};
+}
+
+inline std::span<const std::byte> VirtualMem::span() const
+{
+   return {m_ptr, m_committed};
+}
+
+
+///////////////////
+
+// Array with a fixed maximal size whose elements are stored in reserved virtual
+// memory. Pages get committed as the array grows, so elements never move and
+// pointers to them stay valid.
+template <typename T> class ReservedArray
+{
+   static_assert(alignof(T) <= alignof(std::max_align_t),
+                 "Over-aligned types are not supported.");
+
+ public:
+   using value_type = T;
+   using iterator = T*;
+   using const_iterator = const T*;
+   using Growth_t = GeometricGrowth;
+
+ public:
+   ReservedArray() = default;
+   explicit ReservedArray(std::size_t maxSize, PageHint hint = PageHint::Default);
+   ~ReservedArray();
+   ReservedArray(const ReservedArray&) = delete;
+   ReservedArray(ReservedArray&& other) noexcept;
+   ReservedArray& operator=(const ReservedArray&) = delete;
+   ReservedArray& operator=(ReservedArray&& other) noexcept;
+
+   explicit operator bool() const;
+   template <typename U>
+   friend void swap(ReservedArray<U>& a, ReservedArray<U>& b) noexcept;
+
+   T* data();
+   const T* data() const;
+   std::size_t size() const;
+   // Number of elements that fit into the committed memory.
+   std::size_t capacity() const;
+   // Number of elements that fit into the reserved memory.
+   std::size_t maxSize() const;
+   bool empty() const;
+   std::span<T> span();
+   std::span<const T> span() const;
+   T& operator[](std::size_t idx);
+   const T& operator[](std::size_t idx) const;
+   T& back();
+   const T& back() const;
+   iterator begin();
+   iterator end();
+   const_iterator begin() const;
+   const_iterator end() const;
+
+   // Returns null if the maximal size is reached or memory cannot be committed.
+   template <typename... Args> T* emplaceBack(Args&&... args);
+   bool pushBack(const T& val);
+   bool pushBack(T&& val);
+   void popBack();
+   // Added elements are value-initialized.
+   bool resize(std::size_t size);
+   // Makes sure memory for the given number of elements is committed.
+   bool reserve(std::size_t capacity);
+   void clear();
+   // Decommits unused pages.
+   bool shrinkToFit();
+
+ private:
+   bool ensureCapacity(std::size_t capacity);
+
+ private:
+   VirtualMem m_mem;
+   std::size_t m_size = 0;
+};
+
+
+template <typename T>
+ReservedArray<T>::ReservedArray(std::size_t maxSize, PageHint hint)
+{
+   if (maxSize <= std::numeric_limits<std::size_t>::max() / sizeof(T))
+      m_mem.reserve(maxSize * sizeof(T), hint);
+}
+
+template <typename T> ReservedArray<T>::~ReservedArray()
+{
+   clear();
+}
+
+template <typename T> ReservedArray<T>::ReservedArray(ReservedArray&& other) noexcept
+{
+   swap(*this, other);
+}
+
+template <typename T>
+ReservedArray<T>& ReservedArray<T>::operator=(ReservedArray&& other) noexcept
+{
+   clear();
+   m_mem.release();
+   swap(*this, other);
+   return *this;
+}
+
+template <typename T> ReservedArray<T>::operator bool() const
+{
+   return m_mem.operator bool();
+}
+
+template <typename T> void swap(ReservedArray<T>& a, ReservedArray<T>& b) noexcept
+{
+   swap(a.m_mem, b.m_mem);
+   std::swap(a.m_size, b.m_size);
+}
+
+template <typename T> T* ReservedArray<T>::data()
+{
+   return reinterpret_cast<T*>(m_mem.data());
+}
+
+template <typename T> const T* ReservedArray<T>::data() const
+{
+   return reinterpret_cast<const T*>(m_mem.data());
+}
+
+template <typename T> std::size_t ReservedArray<T>::size() const
+{
+   return m_size;
+}
+
+template <typename T> std::size_t ReservedArray<T>::capacity() const
+{
+   return m_mem.committed() / sizeof(T);
+}
+
+template <typename T> std::size_t ReservedArray<T>::maxSize() const
+{
+   return m_mem.reserved() / sizeof(T);
+}
+
+template <typename T> bool ReservedArray<T>::empty() const
+{
+   return m_size == 0;
+}
+
+template <typename T> std::span<T> ReservedArray<T>::span()
+{
+   return {data(), m_size};
+}
+
+template <typename T> std::span<const T> ReservedArray<T>::span() const
+{
+   return {data(), m_size};
+}
+
+template <typename T> T& ReservedArray<T>::operator[](std::size_t idx)
+{
+   return data()[idx];
+}
+
+template <typename T> const T& ReservedArray<T>::operator[](std::size_t idx) const
+{
+   return data()[idx];
+}
+
+template <typename T> T& ReservedArray<T>::back()
+{
+   return data()[m_size - 1];
+}
+
+template <typename T> const T& ReservedArray<T>::back() const
+{
+   return data()[m_size - 1];
+}
+
+template <typename T> typename ReservedArray<T>::iterator ReservedArray<T>::begin()
+{
+   return data();
+}
+
+template <typename T> typename ReservedArray<T>::iterator ReservedArray<T>::end()
+{
+   return data() + m_size;
+}
+
+template <typename T>
+typename ReservedArray<T>::const_iterator ReservedArray<T>::begin() const
+{
+   return data();
+}
+
+template <typename T>
+typename ReservedArray<T>::const_iterator ReservedArray<T>::end() const
+{
+   return data() + m_size;
+}
+
+template <typename T>
+template <typename... Args>
+T* ReservedArray<T>::emplaceBack(Args&&... args)
+{
+   if (!ensureCapacity(m_size + 1))
+      return nullptr;
+
+   T* elem = new (data() + m_size) T(std::forward<Args>(args)...);
+   ++m_size;
+   return elem;
+}
+
+template <typename T> bool ReservedArray<T>::pushBack(const T& val)
+{
+   return emplaceBack(val) != nullptr;
+}
+
+template <typename T> bool ReservedArray<T>::pushBack(T&& val)
+{
+   return emplaceBack(std::move(val)) != nullptr;
+}
+
+template <typename T> void ReservedArray<T>::popBack()
+{
+   if (m_size > 0)
+   {
+      --m_size;
+      data()[m_size].~T();
+   }
+}
+
+template <typename T> bool ReservedArray<T>::resize(std::size_t size)
+{
+   if (!ensureCapacity(size))
+      return false;
+
+   while (m_size > size)
+      popBack();
+   for (; m_size < size; ++m_size)
+      new (data() + m_size) T();
+   return true;
+}
+
+template <typename T> bool ReservedArray<T>::reserve(std::size_t capacity)
+{
+   if (capacity > maxSize())
+      return false;
+   return m_mem.commit(capacity * sizeof(T));
+}
+
+template <typename T> void ReservedArray<T>::clear()
+{
+   if constexpr (std::is_trivially_destructible_v<T>)
+      m_size = 0;
+   else
+      while (m_size > 0)
+         popBack();
+}
+
+template <typename T> bool ReservedArray<T>::shrinkToFit()
+{
+   return m_mem.decommit(m_size * sizeof(T));
+}
+
+template <typename T> bool ReservedArray<T>::ensureCapacity(std::size_t capacity)
+{
+   if (capacity <= this->capacity())
+      return true;
+   if (capacity > maxSize())
+      return false;
+
+   // Commit geometrically to amortize the cost of the system calls. Fall back to
+   // the required size close to the end of the reserved range.
+   const std::size_t grownCapacity =
+      std::min(Growth_t::nextCapacity(this->capacity(), capacity), maxSize());
+   return reserve(grownCapacity) || reserve(capacity);
+}
+
+} // namespace win32
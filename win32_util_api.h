@@ -19,9 +19,9 @@
 #  endif
 #endif
 
+#endif //_WIN32
+
 // If not defined yet, define it as empty/nothing.
 #ifndef WIN32UTIL_API
 #  define WIN32UTIL_API
 #endif
-
-#endif //_WIN32
@@ -7,6 +7,7 @@
 //
 #ifdef _WIN32
 #include "window.h"
+#include "trace.h"
 #include <tchar.h>
 #include <windowsx.h>
 #include <array>
@@ -335,7 +336,10 @@ LRESULT Window::windowProc(HWND hwnd, UINT msgId, WPARAM wParam, LPARAM lParam)
    // self pointer is not available yet.
    assert(self || msgId == WM_GETMINMAXINFO);
    if (self)
+   {
+      WIN32UTIL_TRACE_ZONE("Window::handleMessage", "window");
       return self->handleMessage(hwnd, msgId, wParam, lParam);
+   }
    return ::DefWindowProc(hwnd, msgId, wParam, lParam);
 }
 